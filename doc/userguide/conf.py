@@ -296,6 +296,8 @@ man_pages = [
      "Suricata Control", [], 1),
     ("manpages/suricatactl-filestore", "suricatactl-filestore",
      "Perform actions on filestore", [], 1),
+    ("manpages/suricatactl-eve", "suricatactl-eve",
+     "Perform actions on EVE logs", [], 1),
 ]
 
 # If true, show URL addresses after external links.
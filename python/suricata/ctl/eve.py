@@ -0,0 +1,187 @@
+# Copyright (C) 2020 Open Information Security Foundation
+#
+# You can copy, redistribute or modify this Program under the terms of
+# the GNU General Public License version 2 as published by the Free
+# Software Foundation.
+
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# version 2 along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+# 02110-1301, USA.
+
+from __future__ import print_function
+
+import sys
+import struct
+import json
+import logging
+
+logger = logging.getLogger("eve")
+
+# Size of the big endian length written in front of each record.
+RECORD_PREFIX_LEN = 4
+
+
+class DecodeError(Exception):
+    pass
+
+
+def register_args(parser):
+    subparser = parser.add_subparsers(help="sub-command help")
+    decode_parser = subparser.add_parser("decode",
+            help="Decode a binary (CBOR) EVE log to JSON lines")
+    decode_parser.add_argument("filename", nargs="?", default="-",
+            help="CBOR EVE log file, - for stdin (default)")
+    decode_parser.set_defaults(func=decode)
+
+
+class Decoder(object):
+    """ Minimal CBOR (RFC 7049) decoder covering the subset produced by
+    Suricata's EVE CBOR output. """
+
+    def __init__(self, buf):
+        self.buf = bytearray(buf)
+        self.offset = 0
+
+    def read(self, n):
+        if self.offset + n > len(self.buf):
+            raise DecodeError("truncated record")
+        data = self.buf[self.offset:self.offset + n]
+        self.offset += n
+        return data
+
+    def read_argument(self, info):
+        if info < 24:
+            return info
+        if info == 24:
+            return self.read(1)[0]
+        if info == 25:
+            return struct.unpack(">H", bytes(self.read(2)))[0]
+        if info == 26:
+            return struct.unpack(">I", bytes(self.read(4)))[0]
+        if info == 27:
+            return struct.unpack(">Q", bytes(self.read(8)))[0]
+        raise DecodeError("unsupported additional information %d" % (info))
+
+    def decode(self):
+        initial = self.read(1)[0]
+        major = initial >> 5
+        info = initial & 0x1f
+
+        if major == 7:
+            if info == 20:
+                return False
+            if info == 21:
+                return True
+            if info == 22:
+                return None
+            if info == 25:
+                return _half_to_float(self.read(2))
+            if info == 26:
+                return struct.unpack(">f", bytes(self.read(4)))[0]
+            if info == 27:
+                return struct.unpack(">d", bytes(self.read(8)))[0]
+            raise DecodeError("unsupported simple value %d" % (info))
+
+        arg = self.read_argument(info)
+        if major == 0:
+            return arg
+        if major == 1:
+            return -1 - arg
+        if major == 2:
+            return bytes(self.read(arg))
+        if major == 3:
+            return bytes(self.read(arg)).decode("utf-8", "replace")
+        if major == 4:
+            return [self.decode() for _ in range(arg)]
+        if major == 5:
+            obj = {}
+            keys = []
+            for _ in range(arg):
+                key = self.decode()
+                obj[key] = self.decode()
+                keys.append(key)
+            return OrderedRecord(keys, obj)
+        # Tags (major 6) carry no meaning for EVE, return the tagged item.
+        return self.decode()
+
+
+class OrderedRecord(dict):
+    """ Dict that remembers the key order of the encoded map so records
+    are printed in the same order as the JSON output. """
+
+    def __init__(self, keys, values):
+        dict.__init__(self, values)
+        self.keys_order = keys
+
+    def items(self):
+        return [(key, self[key]) for key in self.keys_order]
+
+
+def _half_to_float(data):
+    half = (data[0] << 8) | data[1]
+    exp = (half >> 10) & 0x1f
+    mant = half & 0x3ff
+    if exp == 0:
+        val = mant * 2.0 ** -24
+    elif exp != 31:
+        val = (mant + 1024) * 2.0 ** (exp - 25)
+    else:
+        val = float("inf") if mant == 0 else float("nan")
+    return -val if half & 0x8000 else val
+
+
+def decode_record(buf):
+    decoder = Decoder(buf)
+    value = decoder.decode()
+    if decoder.offset != len(decoder.buf):
+        raise DecodeError("trailing data in record")
+    return value
+
+
+def read_records(fileobj):
+    """ Generator returning the decoded records of a length-prefixed CBOR
+    EVE stream. """
+    while True:
+        prefix = fileobj.read(RECORD_PREFIX_LEN)
+        if not prefix:
+            return
+        if len(prefix) != RECORD_PREFIX_LEN:
+            raise DecodeError("truncated record length")
+        length = struct.unpack(">I", prefix)[0]
+        buf = fileobj.read(length)
+        if len(buf) != length:
+            raise DecodeError("truncated record")
+        yield decode_record(buf)
+
+
+def to_json(record):
+    if isinstance(record, OrderedRecord):
+        return "{%s}" % ",".join(
+            "%s:%s" % (json.dumps(key), to_json(value))
+            for key, value in record.items())
+    if isinstance(record, list):
+        return "[%s]" % ",".join(to_json(value) for value in record)
+    return json.dumps(record)
+
+
+def decode(args):
+    if args.filename == "-":
+        fileobj = getattr(sys.stdin, "buffer", sys.stdin)
+    else:
+        fileobj = open(args.filename, "rb")
+    try:
+        for record in read_records(fileobj):
+            print(to_json(record))
+    except DecodeError as err:
+        logger.error("Failed to decode %s: %s", args.filename, err)
+        return 1
+    finally:
+        if fileobj is not getattr(sys.stdin, "buffer", sys.stdin):
+            fileobj.close()
+    return 0
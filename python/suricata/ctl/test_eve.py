@@ -0,0 +1,39 @@
+from __future__ import print_function
+
+import io
+import unittest
+
+from suricata.ctl import eve
+
+class DecodeTestCase(unittest.TestCase):
+
+    def test_decode_map(self):
+        buf = bytearray([
+            0xa4,
+            0x61, ord("a"), 0x01,
+            0x61, ord("b"), 0x39, 0x01, 0xf3,
+            0x61, ord("c"), 0x63, ord("x"), ord("y"), ord("z"),
+            0x61, ord("d"), 0xf5,
+        ])
+        record = eve.decode_record(buf)
+        self.assertEqual(record, {"a": 1, "b": -500, "c": "xyz", "d": True})
+        self.assertEqual(eve.to_json(record),
+                '{"a":1,"b":-500,"c":"xyz","d":true}')
+
+    def test_read_records(self):
+        buf = bytearray([
+            0x00, 0x00, 0x00, 0x14,
+            0x83,
+            0x1b, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+            0xfb, 0x3f, 0xf8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+            0xf6,
+            0x00, 0x00, 0x00, 0x01,
+            0xa0,
+        ])
+        records = list(eve.read_records(io.BytesIO(bytes(buf))))
+        self.assertEqual(records, [[4294967296, 1.5, None], {}])
+
+    def test_truncated(self):
+        buf = bytearray([0x00, 0x00, 0x00, 0x05, 0xa1])
+        with self.assertRaises(eve.DecodeError):
+            list(eve.read_records(io.BytesIO(bytes(buf))))
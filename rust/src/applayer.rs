@@ -226,6 +226,7 @@ extern {
 // Defined in app-layer-detect-proto.h
 extern {
     pub fn AppLayerProtoDetectConfProtoDetectionEnabled(ipproto: *const c_char, proto: *const c_char) -> c_int;
+    pub fn AppLayerProtoDetectPPRegisterFirstBytes(ipproto: u8, alproto: AppProto, bytes: *const u8, nbytes: u16);
 }
 
 // Defined in app-layer-parser.h
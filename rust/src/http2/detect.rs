@@ -0,0 +1,93 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+use crate::core::STREAM_TOSERVER;
+use crate::http2::http2::*;
+use std::ffi::CStr;
+use std::ptr;
+
+fn set_buffer(data: &[u8], buffer: *mut *const u8, buffer_len: *mut u32) -> u8 {
+    unsafe {
+        if data.len() > 0 {
+            *buffer = data.as_ptr();
+            *buffer_len = data.len() as u32;
+            return 1;
+        }
+        *buffer = ptr::null();
+        *buffer_len = 0;
+    }
+    return 0;
+}
+
+fn get_message(tx: &HTTP2Transaction, direction: u8) -> &HTTP2Message {
+    if direction & STREAM_TOSERVER != 0 {
+        &tx.request
+    } else {
+        &tx.response
+    }
+}
+
+/// Get the value of the first header `name`, which can be a pseudo
+/// header like ":path".
+#[no_mangle]
+pub unsafe extern "C" fn rs_http2_tx_get_header_value(
+    tx: &mut HTTP2Transaction,
+    direction: u8,
+    name: *const std::os::raw::c_char,
+    buffer: *mut *const u8,
+    buffer_len: *mut u32,
+) -> u8 {
+    let name = CStr::from_ptr(name).to_bytes();
+    match get_message(tx, direction).get_header(name) {
+        Some(value) => set_buffer(value, buffer, buffer_len),
+        None => set_buffer(&[], buffer, buffer_len),
+    }
+}
+
+/// Get all regular headers as "name: value\r\n" lines.
+#[no_mangle]
+pub unsafe extern "C" fn rs_http2_tx_get_headers(
+    tx: &mut HTTP2Transaction,
+    direction: u8,
+    buffer: *mut *const u8,
+    buffer_len: *mut u32,
+) -> u8 {
+    set_buffer(&get_message(tx, direction).raw_headers, buffer, buffer_len)
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn rs_http2_tx_get_body(
+    tx: &mut HTTP2Transaction,
+    direction: u8,
+    buffer: *mut *const u8,
+    buffer_len: *mut u32,
+) -> u8 {
+    set_buffer(&get_message(tx, direction).body, buffer, buffer_len)
+}
+
+/// Get the normalized host: lowercase and without the port.
+#[no_mangle]
+pub unsafe extern "C" fn rs_http2_tx_get_host(
+    tx: &mut HTTP2Transaction,
+    buffer: *mut *const u8,
+    buffer_len: *mut u32,
+) -> u8 {
+    if let Some(ref host) = tx.host {
+        return set_buffer(host, buffer, buffer_len);
+    }
+    set_buffer(&[], buffer, buffer_len)
+}
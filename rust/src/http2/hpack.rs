@@ -0,0 +1,377 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+//! HPACK header block decoder (RFC 7541).
+
+use std::collections::VecDeque;
+use super::huffman;
+
+/// Default dynamic table size (SETTINGS_HEADER_TABLE_SIZE).
+pub const HPACK_DEFAULT_TABLE_SIZE: usize = 4096;
+
+/// Per entry overhead used for the dynamic table size accounting.
+const HPACK_ENTRY_OVERHEAD: usize = 32;
+
+const HPACK_STATIC_TABLE: [(&'static [u8], &'static [u8]); 61] = [
+    (b":authority", b""),
+    (b":method", b"GET"),
+    (b":method", b"POST"),
+    (b":path", b"/"),
+    (b":path", b"/index.html"),
+    (b":scheme", b"http"),
+    (b":scheme", b"https"),
+    (b":status", b"200"),
+    (b":status", b"204"),
+    (b":status", b"206"),
+    (b":status", b"304"),
+    (b":status", b"400"),
+    (b":status", b"404"),
+    (b":status", b"500"),
+    (b"accept-charset", b""),
+    (b"accept-encoding", b"gzip, deflate"),
+    (b"accept-language", b""),
+    (b"accept-ranges", b""),
+    (b"accept", b""),
+    (b"access-control-allow-origin", b""),
+    (b"age", b""),
+    (b"allow", b""),
+    (b"authorization", b""),
+    (b"cache-control", b""),
+    (b"content-disposition", b""),
+    (b"content-encoding", b""),
+    (b"content-language", b""),
+    (b"content-length", b""),
+    (b"content-location", b""),
+    (b"content-range", b""),
+    (b"content-type", b""),
+    (b"cookie", b""),
+    (b"date", b""),
+    (b"etag", b""),
+    (b"expect", b""),
+    (b"expires", b""),
+    (b"from", b""),
+    (b"host", b""),
+    (b"if-match", b""),
+    (b"if-modified-since", b""),
+    (b"if-none-match", b""),
+    (b"if-range", b""),
+    (b"if-unmodified-since", b""),
+    (b"last-modified", b""),
+    (b"link", b""),
+    (b"location", b""),
+    (b"max-forwards", b""),
+    (b"proxy-authenticate", b""),
+    (b"proxy-authorization", b""),
+    (b"range", b""),
+    (b"referer", b""),
+    (b"refresh", b""),
+    (b"retry-after", b""),
+    (b"server", b""),
+    (b"set-cookie", b""),
+    (b"strict-transport-security", b""),
+    (b"transfer-encoding", b""),
+    (b"user-agent", b""),
+    (b"vary", b""),
+    (b"via", b""),
+    (b"www-authenticate", b""),
+];
+
+#[derive(Debug, PartialEq)]
+pub enum HpackError {
+    /// Malformed header block.
+    Invalid,
+    /// Table size update above the allowed maximum.
+    TableSizeExceeded,
+}
+
+#[derive(Debug, PartialEq)]
+pub struct HpackHeader {
+    pub name: Vec<u8>,
+    pub value: Vec<u8>,
+}
+
+/// Decoder for one direction of a connection.
+///
+/// The dynamic table is bounded by the size the peer announced, which
+/// itself is capped by `limit` so a peer can't make us keep more header
+/// state than configured.
+pub struct HpackDecoder {
+    table: VecDeque<HpackHeader>,
+    size: usize,
+    max_size: usize,
+    limit: usize,
+}
+
+/// Decode an integer with an `n` bit prefix. Returns the value and
+/// the number of bytes consumed.
+fn decode_integer(input: &[u8], n: u8) -> Result<(usize, usize), HpackError> {
+    if input.len() == 0 {
+        return Err(HpackError::Invalid);
+    }
+    let mask = ((1u16 << n) - 1) as u8;
+    let mut value = (input[0] & mask) as usize;
+    if value < mask as usize {
+        return Ok((value, 1));
+    }
+    let mut shift = 0;
+    for i in 1..input.len() {
+        // Anything above 28 bits is far beyond any sane header.
+        if shift > 21 {
+            return Err(HpackError::Invalid);
+        }
+        value += ((input[i] & 0x7f) as usize) << shift;
+        if input[i] & 0x80 == 0 {
+            return Ok((value, i + 1));
+        }
+        shift += 7;
+    }
+    Err(HpackError::Invalid)
+}
+
+/// Decode a string literal. Returns the string and the number of bytes
+/// consumed.
+fn decode_string(input: &[u8]) -> Result<(Vec<u8>, usize), HpackError> {
+    if input.len() == 0 {
+        return Err(HpackError::Invalid);
+    }
+    let huffman = input[0] & 0x80 != 0;
+    let (len, used) = decode_integer(input, 7)?;
+    if len > input.len() - used {
+        return Err(HpackError::Invalid);
+    }
+    let data = &input[used..used + len];
+    if huffman {
+        let mut out = Vec::with_capacity(len + len / 2);
+        if !huffman::decode(data, &mut out) {
+            return Err(HpackError::Invalid);
+        }
+        Ok((out, used + len))
+    } else {
+        Ok((data.to_vec(), used + len))
+    }
+}
+
+impl HpackDecoder {
+    pub fn new(limit: usize) -> HpackDecoder {
+        HpackDecoder {
+            table: VecDeque::new(),
+            size: 0,
+            max_size: std::cmp::min(HPACK_DEFAULT_TABLE_SIZE, limit),
+            limit: limit,
+        }
+    }
+
+    /// Lower or raise the max table size the peer's encoder may use.
+    pub fn set_limit(&mut self, limit: usize) {
+        self.limit = limit;
+        if self.max_size > limit {
+            self.max_size = limit;
+            self.evict(limit);
+        }
+    }
+
+    /// Current size of the dynamic table.
+    pub fn table_size(&self) -> usize {
+        self.size
+    }
+
+    fn evict(&mut self, max: usize) {
+        while self.size > max {
+            match self.table.pop_back() {
+                Some(h) => {
+                    self.size -= h.name.len() + h.value.len() +
+                        HPACK_ENTRY_OVERHEAD;
+                }
+                None => {
+                    self.size = 0;
+                }
+            }
+        }
+    }
+
+    fn insert(&mut self, name: &[u8], value: &[u8]) {
+        let entry_size = name.len() + value.len() + HPACK_ENTRY_OVERHEAD;
+        if entry_size > self.max_size {
+            // Entries larger than the table just empty it.
+            self.table.clear();
+            self.size = 0;
+            return;
+        }
+        let max = self.max_size - entry_size;
+        self.evict(max);
+        self.table.push_front(HpackHeader {
+            name: name.to_vec(),
+            value: value.to_vec(),
+        });
+        self.size += entry_size;
+    }
+
+    fn get(&self, index: usize) -> Result<(&[u8], &[u8]), HpackError> {
+        if index == 0 {
+            return Err(HpackError::Invalid);
+        }
+        if index <= HPACK_STATIC_TABLE.len() {
+            let (n, v) = HPACK_STATIC_TABLE[index - 1];
+            return Ok((n, v));
+        }
+        match self.table.get(index - HPACK_STATIC_TABLE.len() - 1) {
+            Some(h) => Ok((&h.name, &h.value)),
+            None => Err(HpackError::Invalid),
+        }
+    }
+
+    /// Decode a complete header block.
+    ///
+    /// On error the decoder state can no longer be trusted, as the peer's
+    /// table has likely diverged from ours.
+    pub fn decode(&mut self, block: &[u8]) -> Result<Vec<HpackHeader>, HpackError> {
+        let mut headers = Vec::new();
+        let mut i = 0;
+        while i < block.len() {
+            let b = block[i];
+            if b & 0x80 != 0 {
+                // Indexed header field.
+                let (index, used) = decode_integer(&block[i..], 7)?;
+                i += used;
+                let (n, v) = self.get(index)?;
+                headers.push(HpackHeader { name: n.to_vec(), value: v.to_vec() });
+            } else if b & 0xe0 == 0x20 {
+                // Dynamic table size update.
+                let (size, used) = decode_integer(&block[i..], 5)?;
+                i += used;
+                if size > self.limit {
+                    return Err(HpackError::TableSizeExceeded);
+                }
+                self.max_size = size;
+                self.evict(size);
+            } else {
+                // Literal header field, with incremental indexing (01),
+                // without indexing (0000) or never indexed (0001).
+                let (prefix, index_it) = if b & 0xc0 == 0x40 {
+                    (6, true)
+                } else {
+                    (4, false)
+                };
+                let (index, used) = decode_integer(&block[i..], prefix)?;
+                i += used;
+                let name = if index == 0 {
+                    let (n, used) = decode_string(&block[i..])?;
+                    i += used;
+                    n
+                } else {
+                    self.get(index)?.0.to_vec()
+                };
+                let (value, used) = decode_string(&block[i..])?;
+                i += used;
+                if index_it {
+                    self.insert(&name, &value);
+                }
+                headers.push(HpackHeader { name: name, value: value });
+            }
+        }
+        Ok(headers)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn check(headers: &Vec<HpackHeader>, expected: &[(&[u8], &[u8])]) {
+        assert_eq!(headers.len(), expected.len());
+        for (h, e) in headers.iter().zip(expected.iter()) {
+            assert_eq!(&h.name[..], e.0);
+            assert_eq!(&h.value[..], e.1);
+        }
+    }
+
+    #[test]
+    fn test_hpack_integer() {
+        // RFC 7541 C.1
+        assert_eq!(decode_integer(&[0x0a], 5), Ok((10, 1)));
+        assert_eq!(decode_integer(&[0x1f, 0x9a, 0x0a], 5), Ok((1337, 3)));
+        assert_eq!(decode_integer(&[0x2a], 8), Ok((42, 1)));
+        assert!(decode_integer(&[0x1f, 0x9a], 5).is_err());
+        assert!(decode_integer(&[0x1f, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01], 5).is_err());
+    }
+
+    #[test]
+    fn test_hpack_requests_huffman() {
+        // RFC 7541 C.4
+        let mut d = HpackDecoder::new(65536);
+        let r1 = [0x82, 0x86, 0x84, 0x41, 0x8c, 0xf1, 0xe3, 0xc2, 0xe5, 0xf2,
+                  0x3a, 0x6b, 0xa0, 0xab, 0x90, 0xf4, 0xff];
+        check(&d.decode(&r1).unwrap(), &[
+            (b":method", b"GET"), (b":scheme", b"http"), (b":path", b"/"),
+            (b":authority", b"www.example.com")]);
+        assert_eq!(d.table_size(), 57);
+
+        let r2 = [0x82, 0x86, 0x84, 0xbe, 0x58, 0x86, 0xa8, 0xeb, 0x10, 0x64,
+                  0x9c, 0xbf];
+        check(&d.decode(&r2).unwrap(), &[
+            (b":method", b"GET"), (b":scheme", b"http"), (b":path", b"/"),
+            (b":authority", b"www.example.com"), (b"cache-control", b"no-cache")]);
+        assert_eq!(d.table_size(), 110);
+
+        let r3 = [0x82, 0x87, 0x85, 0xbf, 0x40, 0x88, 0x25, 0xa8, 0x49, 0xe9,
+                  0x5b, 0xa9, 0x7d, 0x7f, 0x89, 0x25, 0xa8, 0x49, 0xe9, 0x5b,
+                  0xb8, 0xe8, 0xb4, 0xbf];
+        check(&d.decode(&r3).unwrap(), &[
+            (b":method", b"GET"), (b":scheme", b"https"),
+            (b":path", b"/index.html"), (b":authority", b"www.example.com"),
+            (b"custom-key", b"custom-value")]);
+        assert_eq!(d.table_size(), 164);
+    }
+
+    #[test]
+    fn test_hpack_eviction() {
+        // RFC 7541 C.5.1 - C.5.2, with a 256 byte table
+        let mut d = HpackDecoder::new(256);
+        let mut r1 = vec![0x3f, 0xe1, 0x01];
+        r1.extend_from_slice(&[0x48, 0x03]);
+        r1.extend_from_slice(b"302");
+        r1.extend_from_slice(&[0x58, 0x07]);
+        r1.extend_from_slice(b"private");
+        r1.extend_from_slice(&[0x61, 0x1d]);
+        r1.extend_from_slice(b"Mon, 21 Oct 2013 20:13:21 GMT");
+        r1.extend_from_slice(&[0x6e, 0x17]);
+        r1.extend_from_slice(b"https://www.example.com");
+        let h = d.decode(&r1).unwrap();
+        assert_eq!(h.len(), 4);
+        assert_eq!(d.table_size(), 222);
+
+        let r2 = [0x48, 0x03, 0x33, 0x30, 0x37, 0xc1, 0xc0, 0xbf];
+        check(&d.decode(&r2).unwrap(), &[
+            (b":status", b"307"), (b"cache-control", b"private"),
+            (b"date", b"Mon, 21 Oct 2013 20:13:21 GMT"),
+            (b"location", b"https://www.example.com")]);
+        assert_eq!(d.table_size(), 222);
+    }
+
+    #[test]
+    fn test_hpack_invalid() {
+        let mut d = HpackDecoder::new(4096);
+        // index 0
+        assert_eq!(d.decode(&[0x80]), Err(HpackError::Invalid));
+        // index past the end of the (empty) dynamic table
+        assert_eq!(d.decode(&[0xbe]), Err(HpackError::Invalid));
+        // truncated literal
+        assert_eq!(d.decode(&[0x40, 0x05, 0x61]), Err(HpackError::Invalid));
+        // size update above the limit
+        assert_eq!(d.decode(&[0x3f, 0xe2, 0x1f]), Err(HpackError::TableSizeExceeded));
+    }
+}
@@ -0,0 +1,1146 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+use std;
+use std::ffi::{CStr, CString};
+use std::mem::transmute;
+use crate::core::{self, ALPROTO_UNKNOWN, AppProto, Flow, IPPROTO_TCP};
+use crate::log::*;
+use crate::applayer::{self, *};
+use nom;
+use super::parser::*;
+use super::hpack::{HpackDecoder, HpackError, HpackHeader};
+
+static mut ALPROTO_HTTP2: AppProto = ALPROTO_UNKNOWN;
+
+/// Max dynamic HPACK table size we accept from a peer.
+static mut HTTP2_MAX_TABLE_SIZE: usize = 65536;
+/// Max size of a header block, or of any other non DATA frame.
+static mut HTTP2_MAX_HEADER_BLOCK: usize = 65536;
+/// Max number of body bytes kept per stream and direction.
+static mut HTTP2_BODY_LIMIT: usize = 102400;
+/// Max number of open streams (transactions) per connection.
+static mut HTTP2_MAX_STREAMS: usize = 4096;
+
+/// Transaction progress, per direction.
+pub const HTTP2_PROGRESS_NONE: u8 = 0;
+pub const HTTP2_PROGRESS_HEADERS: u8 = 1;
+pub const HTTP2_PROGRESS_COMPLETE: u8 = 2;
+
+const HTTP2_DIR_TOSERVER: usize = 0;
+const HTTP2_DIR_TOCLIENT: usize = 1;
+
+#[derive(Debug, PartialEq)]
+#[repr(u32)]
+pub enum HTTP2Event {
+    InvalidFrameHeader = 0,
+    InvalidFrameLength,
+    HeaderDecompressionFailed,
+    HeaderTableSizeExceeded,
+    HeaderBlockTooLong,
+    InvalidStreamId,
+    TooManyStreams,
+}
+
+impl HTTP2Event {
+    fn from_i32(value: i32) -> Option<HTTP2Event> {
+        match value {
+            0 => Some(HTTP2Event::InvalidFrameHeader),
+            1 => Some(HTTP2Event::InvalidFrameLength),
+            2 => Some(HTTP2Event::HeaderDecompressionFailed),
+            3 => Some(HTTP2Event::HeaderTableSizeExceeded),
+            4 => Some(HTTP2Event::HeaderBlockTooLong),
+            5 => Some(HTTP2Event::InvalidStreamId),
+            6 => Some(HTTP2Event::TooManyStreams),
+            _ => None,
+        }
+    }
+}
+
+/// Headers and body of one direction of a stream.
+#[derive(Default)]
+pub struct HTTP2Message {
+    pub headers: Vec<HpackHeader>,
+    /// Regular (non pseudo, non cookie) headers as "name: value\r\n" lines.
+    pub raw_headers: Vec<u8>,
+    pub body: Vec<u8>,
+    pub progress: u8,
+}
+
+impl HTTP2Message {
+    pub fn get_header(&self, name: &[u8]) -> Option<&[u8]> {
+        for h in &self.headers {
+            if h.name == name {
+                return Some(&h.value);
+            }
+        }
+        None
+    }
+
+    /// Add headers, `cookie` is the cookie header of the direction
+    /// which, like for HTTP/1, is left out of the raw header buffer.
+    fn add_headers(&mut self, headers: Vec<HpackHeader>, cookie: &[u8]) {
+        for h in headers {
+            if !h.name.starts_with(b":") && h.name != cookie {
+                self.raw_headers.extend_from_slice(&h.name);
+                self.raw_headers.extend_from_slice(b": ");
+                self.raw_headers.extend_from_slice(&h.value);
+                self.raw_headers.extend_from_slice(b"\r\n");
+            }
+            self.headers.push(h);
+        }
+    }
+
+    fn add_body(&mut self, data: &[u8]) {
+        let limit = unsafe { HTTP2_BODY_LIMIT };
+        if self.body.len() < limit {
+            let n = std::cmp::min(limit - self.body.len(), data.len());
+            self.body.extend_from_slice(&data[..n]);
+        }
+    }
+}
+
+/// One transaction per stream.
+pub struct HTTP2Transaction {
+    tx_id: u64,
+    pub stream_id: u32,
+    pub request: HTTP2Message,
+    pub response: HTTP2Message,
+    /// Normalized host: lowercase and without port.
+    pub host: Option<Vec<u8>>,
+
+    logged: LoggerFlags,
+    de_state: Option<*mut core::DetectEngineState>,
+    events: *mut core::AppLayerDecoderEvents,
+    detect_flags: applayer::TxDetectFlags,
+}
+
+impl HTTP2Transaction {
+    pub fn new(stream_id: u32) -> HTTP2Transaction {
+        HTTP2Transaction {
+            tx_id: 0,
+            stream_id: stream_id,
+            request: HTTP2Message::default(),
+            response: HTTP2Message::default(),
+            host: None,
+            logged: LoggerFlags::new(),
+            de_state: None,
+            events: std::ptr::null_mut(),
+            detect_flags: applayer::TxDetectFlags::default(),
+        }
+    }
+
+    pub fn message(&self, dir: usize) -> &HTTP2Message {
+        if dir == HTTP2_DIR_TOSERVER {
+            &self.request
+        } else {
+            &self.response
+        }
+    }
+
+    fn message_mut(&mut self, dir: usize) -> &mut HTTP2Message {
+        if dir == HTTP2_DIR_TOSERVER {
+            &mut self.request
+        } else {
+            &mut self.response
+        }
+    }
+
+    fn set_host(&mut self) {
+        let value = match self.request.get_header(b":authority") {
+            Some(v) => v,
+            None => match self.request.get_header(b"host") {
+                Some(v) => v,
+                None => {
+                    return;
+                }
+            },
+        };
+        let end = if value.starts_with(b"[") {
+            match value.iter().position(|&c| c == b']') {
+                Some(p) => p + 1,
+                None => value.len(),
+            }
+        } else {
+            match value.iter().rposition(|&c| c == b':') {
+                Some(p) => p,
+                None => value.len(),
+            }
+        };
+        self.host = Some(value[..end].to_ascii_lowercase());
+    }
+
+    pub fn free(&mut self) {
+        if self.events != std::ptr::null_mut() {
+            core::sc_app_layer_decoder_events_free_events(&mut self.events);
+        }
+        if let Some(state) = self.de_state {
+            core::sc_detect_engine_state_free(state);
+        }
+    }
+}
+
+impl Drop for HTTP2Transaction {
+    fn drop(&mut self) {
+        self.free();
+    }
+}
+
+/// Frame and header block state of one direction.
+struct HTTP2DirState {
+    hpack: HpackDecoder,
+    /// Set once a header block could not be decoded. As the peer's
+    /// dynamic table has diverged from ours we stop decoding headers.
+    hpack_failed: bool,
+
+    /// Header block being reassembled from HEADERS/PUSH_PROMISE and
+    /// CONTINUATION frames.
+    block: Vec<u8>,
+    in_block: bool,
+    block_stream: u32,
+    block_promised: u32,
+    block_end_stream: bool,
+
+    /// DATA payload bytes still to come, streamed into the body.
+    data_left: u32,
+    data_stream: u32,
+    data_end_stream: bool,
+    /// Padding or oversized frame bytes still to skip.
+    skip_left: u32,
+}
+
+impl HTTP2DirState {
+    fn new() -> HTTP2DirState {
+        HTTP2DirState {
+            hpack: HpackDecoder::new(unsafe { HTTP2_MAX_TABLE_SIZE }),
+            hpack_failed: false,
+            block: Vec::new(),
+            in_block: false,
+            block_stream: 0,
+            block_promised: 0,
+            block_end_stream: false,
+            data_left: 0,
+            data_stream: 0,
+            data_end_stream: false,
+            skip_left: 0,
+        }
+    }
+}
+
+pub struct HTTP2State {
+    tx_id: u64,
+    transactions: Vec<HTTP2Transaction>,
+    dirs: [HTTP2DirState; 2],
+    preface_done: bool,
+}
+
+impl HTTP2State {
+    pub fn new() -> Self {
+        Self {
+            tx_id: 0,
+            transactions: Vec::new(),
+            dirs: [HTTP2DirState::new(), HTTP2DirState::new()],
+            preface_done: false,
+        }
+    }
+
+    // Free a transaction by ID.
+    fn free_tx(&mut self, tx_id: u64) {
+        let len = self.transactions.len();
+        let mut found = false;
+        let mut index = 0;
+        for i in 0..len {
+            let tx = &self.transactions[i];
+            if tx.tx_id == tx_id + 1 {
+                found = true;
+                index = i;
+                break;
+            }
+        }
+        if found {
+            self.transactions.remove(index);
+        }
+    }
+
+    pub fn get_tx(&mut self, tx_id: u64) -> Option<&HTTP2Transaction> {
+        for tx in &mut self.transactions {
+            if tx.tx_id == tx_id + 1 {
+                return Some(tx);
+            }
+        }
+        return None;
+    }
+
+    fn new_tx(&mut self, stream_id: u32) -> HTTP2Transaction {
+        let mut tx = HTTP2Transaction::new(stream_id);
+        self.tx_id += 1;
+        tx.tx_id = self.tx_id;
+        return tx;
+    }
+
+    fn find_stream(&mut self, stream_id: u32) -> Option<&mut HTTP2Transaction> {
+        // Recent streams are at the end.
+        for tx in self.transactions.iter_mut().rev() {
+            if tx.stream_id == stream_id {
+                return Some(tx);
+            }
+        }
+        None
+    }
+
+    fn get_or_create_stream(&mut self, stream_id: u32) -> Option<&mut HTTP2Transaction> {
+        let index = match self.transactions.iter().rposition(|tx| tx.stream_id == stream_id) {
+            Some(index) => index,
+            None => {
+                if self.transactions.len() >= unsafe { HTTP2_MAX_STREAMS } {
+                    self.set_event(stream_id, HTTP2Event::TooManyStreams);
+                    return None;
+                }
+                let tx = self.new_tx(stream_id);
+                self.transactions.push(tx);
+                self.transactions.len() - 1
+            }
+        };
+        Some(&mut self.transactions[index])
+    }
+
+    /// Set an event on the stream's transaction, or on the last one for
+    /// connection level events.
+    fn set_event(&mut self, stream_id: u32, event: HTTP2Event) {
+        let ev = event as u8;
+        let index = match self.transactions.iter().rposition(|tx| tx.stream_id == stream_id) {
+            Some(index) => index,
+            None => {
+                if self.transactions.len() == 0 {
+                    // Stream 0 is the connection, it has no messages.
+                    let mut tx = self.new_tx(0);
+                    tx.request.progress = HTTP2_PROGRESS_COMPLETE;
+                    tx.response.progress = HTTP2_PROGRESS_COMPLETE;
+                    self.transactions.push(tx);
+                }
+                self.transactions.len() - 1
+            }
+        };
+        core::sc_app_layer_decoder_events_set_event_raw(
+            &mut self.transactions[index].events, ev);
+    }
+
+    fn end_stream(&mut self, dir: usize, stream_id: u32) {
+        if let Some(tx) = self.find_stream(stream_id) {
+            tx.message_mut(dir).progress = HTTP2_PROGRESS_COMPLETE;
+        }
+    }
+
+    fn handle_data(&mut self, dir: usize, stream_id: u32, data: &[u8]) {
+        if let Some(tx) = self.find_stream(stream_id) {
+            tx.message_mut(dir).add_body(data);
+        }
+    }
+
+    fn handle_headers(&mut self, dir: usize, stream_id: u32, promised: u32,
+                      end_stream: bool, headers: Vec<HpackHeader>)
+    {
+        if promised != 0 {
+            // A pushed stream: the promise carries its request.
+            if let Some(tx) = self.get_or_create_stream(promised) {
+                tx.request.add_headers(headers, b"cookie");
+                tx.request.progress = HTTP2_PROGRESS_COMPLETE;
+                tx.set_host();
+            }
+            return;
+        }
+
+        let tx = match self.get_or_create_stream(stream_id) {
+            Some(tx) => tx,
+            None => {
+                return;
+            }
+        };
+        let first = tx.message(dir).headers.len() == 0;
+        if dir == HTTP2_DIR_TOCLIENT && first && !end_stream {
+            // Skip informational (1xx) responses, the final one follows.
+            if let Some(status) = headers.iter().find(|h| h.name == b":status") {
+                if status.value.starts_with(b"1") {
+                    return;
+                }
+            }
+        }
+        let cookie: &[u8] = if dir == HTTP2_DIR_TOSERVER {
+            b"cookie"
+        } else {
+            b"set-cookie"
+        };
+        let msg = tx.message_mut(dir);
+        msg.add_headers(headers, cookie);
+        if msg.progress < HTTP2_PROGRESS_HEADERS {
+            msg.progress = HTTP2_PROGRESS_HEADERS;
+        }
+        if end_stream {
+            msg.progress = HTTP2_PROGRESS_COMPLETE;
+        }
+        if dir == HTTP2_DIR_TOSERVER && first {
+            tx.set_host();
+        }
+    }
+
+    fn start_block(&mut self, dir: usize, hdr: &HTTP2FrameHeader, promised: u32,
+                   fragment: &[u8])
+    {
+        let d = &mut self.dirs[dir];
+        d.block.clear();
+        d.block.extend_from_slice(fragment);
+        d.in_block = true;
+        d.block_stream = hdr.stream_id;
+        d.block_promised = promised;
+        d.block_end_stream = hdr.flags & HTTP2_FLAG_END_STREAM != 0;
+        if hdr.flags & HTTP2_FLAG_END_HEADERS != 0 {
+            self.finish_block(dir);
+        }
+    }
+
+    fn finish_block(&mut self, dir: usize) {
+        let stream_id = self.dirs[dir].block_stream;
+        let promised = self.dirs[dir].block_promised;
+        let end_stream = self.dirs[dir].block_end_stream;
+        self.dirs[dir].in_block = false;
+
+        let mut headers = Vec::new();
+        let mut event = None;
+        if !self.dirs[dir].hpack_failed {
+            let d = &mut self.dirs[dir];
+            match d.hpack.decode(&d.block) {
+                Ok(h) => {
+                    headers = h;
+                }
+                Err(e) => {
+                    d.hpack_failed = true;
+                    event = Some(match e {
+                        HpackError::TableSizeExceeded => HTTP2Event::HeaderTableSizeExceeded,
+                        HpackError::Invalid => HTTP2Event::HeaderDecompressionFailed,
+                    });
+                }
+            }
+        }
+        self.dirs[dir].block.clear();
+        self.handle_headers(dir, stream_id, promised, end_stream, headers);
+        if let Some(event) = event {
+            self.set_event(stream_id, event);
+        }
+    }
+
+    /// Handle a complete frame other than DATA.
+    fn handle_frame(&mut self, dir: usize, hdr: &HTTP2FrameHeader, payload: &[u8]) {
+        if self.dirs[dir].in_block && hdr.ftype != HTTP2_FRAME_CONTINUATION {
+            // The header block was never completed, so its decoding
+            // context is lost.
+            self.set_event(hdr.stream_id, HTTP2Event::InvalidFrameHeader);
+            self.dirs[dir].in_block = false;
+            self.dirs[dir].hpack_failed = true;
+        }
+
+        match hdr.ftype {
+            HTTP2_FRAME_HEADERS => {
+                if hdr.stream_id == 0 {
+                    self.set_event(0, HTTP2Event::InvalidStreamId);
+                    self.dirs[dir].hpack_failed = true;
+                    return;
+                }
+                match strip_padding(payload, hdr.flags, true) {
+                    Some(fragment) => {
+                        self.start_block(dir, hdr, 0, fragment);
+                    }
+                    None => {
+                        self.set_event(hdr.stream_id, HTTP2Event::InvalidFrameLength);
+                        self.dirs[dir].hpack_failed = true;
+                    }
+                }
+            }
+            HTTP2_FRAME_PUSH_PROMISE => {
+                let promise = match strip_padding(payload, hdr.flags, false) {
+                    Some(p) => parse_stream_id(p).ok(),
+                    None => None,
+                };
+                match promise {
+                    Some((fragment, promised)) if promised != 0 => {
+                        self.start_block(dir, hdr, promised, fragment);
+                    }
+                    _ => {
+                        self.set_event(hdr.stream_id, HTTP2Event::InvalidFrameLength);
+                        self.dirs[dir].hpack_failed = true;
+                    }
+                }
+            }
+            HTTP2_FRAME_CONTINUATION => {
+                if !self.dirs[dir].in_block || self.dirs[dir].block_stream != hdr.stream_id {
+                    self.set_event(hdr.stream_id, HTTP2Event::InvalidFrameHeader);
+                    self.dirs[dir].in_block = false;
+                    self.dirs[dir].hpack_failed = true;
+                    return;
+                }
+                if self.dirs[dir].block.len() + payload.len() > unsafe { HTTP2_MAX_HEADER_BLOCK } {
+                    self.set_event(hdr.stream_id, HTTP2Event::HeaderBlockTooLong);
+                    self.dirs[dir].hpack_failed = true;
+                    self.finish_block(dir);
+                    return;
+                }
+                self.dirs[dir].block.extend_from_slice(payload);
+                if hdr.flags & HTTP2_FLAG_END_HEADERS != 0 {
+                    self.finish_block(dir);
+                }
+            }
+            HTTP2_FRAME_SETTINGS => {
+                if hdr.flags & HTTP2_FLAG_ACK != 0 {
+                    return;
+                }
+                if hdr.stream_id != 0 || payload.len() % 6 != 0 {
+                    self.set_event(hdr.stream_id, HTTP2Event::InvalidFrameLength);
+                    return;
+                }
+                if let Ok((_, settings)) = parse_settings(payload) {
+                    for s in settings {
+                        if s.id == HTTP2_SETTINGS_HEADER_TABLE_SIZE {
+                            // Bounds the table of the encoder of the peer.
+                            let limit = std::cmp::min(s.value as usize,
+                                                      unsafe { HTTP2_MAX_TABLE_SIZE });
+                            self.dirs[dir ^ 1].hpack.set_limit(limit);
+                        }
+                    }
+                }
+            }
+            HTTP2_FRAME_RST_STREAM => {
+                if let Some(tx) = self.find_stream(hdr.stream_id) {
+                    tx.request.progress = HTTP2_PROGRESS_COMPLETE;
+                    tx.response.progress = HTTP2_PROGRESS_COMPLETE;
+                }
+            }
+            _ => {
+                // PRIORITY, PING, GOAWAY, WINDOW_UPDATE and unknown
+                // extension frames don't affect the transactions.
+            }
+        }
+    }
+
+    fn parse(&mut self, input: &[u8], dir: usize) -> AppLayerResult {
+        let mut rem = input;
+
+        if dir == HTTP2_DIR_TOSERVER && !self.preface_done {
+            let n = std::cmp::min(rem.len(), HTTP2_CLIENT_PREFACE.len());
+            if rem[..n] == HTTP2_CLIENT_PREFACE[..n] {
+                if n < HTTP2_CLIENT_PREFACE.len() {
+                    return AppLayerResult::incomplete(0, HTTP2_CLIENT_PREFACE.len() as u32);
+                }
+                rem = &rem[n..];
+            }
+            // Without the preface we picked up the session midstream.
+            self.preface_done = true;
+        }
+
+        loop {
+            // Continue with the payload of a DATA frame.
+            if self.dirs[dir].data_left > 0 {
+                let n = std::cmp::min(self.dirs[dir].data_left as usize, rem.len());
+                let stream_id = self.dirs[dir].data_stream;
+                self.handle_data(dir, stream_id, &rem[..n]);
+                self.dirs[dir].data_left -= n as u32;
+                rem = &rem[n..];
+                if self.dirs[dir].data_left > 0 {
+                    return AppLayerResult::ok();
+                }
+            }
+            if self.dirs[dir].skip_left > 0 {
+                let n = std::cmp::min(self.dirs[dir].skip_left as usize, rem.len());
+                self.dirs[dir].skip_left -= n as u32;
+                rem = &rem[n..];
+                if self.dirs[dir].skip_left > 0 {
+                    return AppLayerResult::ok();
+                }
+            }
+            if self.dirs[dir].data_end_stream {
+                self.dirs[dir].data_end_stream = false;
+                let stream_id = self.dirs[dir].data_stream;
+                self.end_stream(dir, stream_id);
+            }
+            if rem.len() == 0 {
+                return AppLayerResult::ok();
+            }
+
+            let consumed = (input.len() - rem.len()) as u32;
+            let (payload, hdr) = match parse_frame_header(rem) {
+                Ok(r) => r,
+                Err(nom::Err::Incomplete(_)) => {
+                    return AppLayerResult::incomplete(consumed,
+                                                      HTTP2_FRAME_HEADER_LEN as u32);
+                }
+                Err(_) => {
+                    return AppLayerResult::err();
+                }
+            };
+
+            if hdr.ftype == HTTP2_FRAME_DATA {
+                let end_stream = hdr.flags & HTTP2_FLAG_END_STREAM != 0;
+                let mut length = hdr.length;
+                let mut pad = 0;
+                if hdr.flags & HTTP2_FLAG_PADDED != 0 && length > 0 {
+                    if payload.len() == 0 {
+                        return AppLayerResult::incomplete(consumed,
+                                                          HTTP2_FRAME_HEADER_LEN as u32 + 1);
+                    }
+                    pad = payload[0] as u32;
+                    length -= 1;
+                    rem = &payload[1..];
+                } else {
+                    rem = payload;
+                }
+                let d = &mut self.dirs[dir];
+                if hdr.stream_id == 0 || pad > length {
+                    d.skip_left = length;
+                    let event = if hdr.stream_id == 0 {
+                        HTTP2Event::InvalidStreamId
+                    } else {
+                        HTTP2Event::InvalidFrameLength
+                    };
+                    self.set_event(hdr.stream_id, event);
+                    continue;
+                }
+                d.data_stream = hdr.stream_id;
+                d.data_left = length - pad;
+                d.skip_left = pad;
+                d.data_end_stream = end_stream;
+                continue;
+            }
+
+            let length = hdr.length as usize;
+            if length > unsafe { HTTP2_MAX_HEADER_BLOCK } {
+                match hdr.ftype {
+                    HTTP2_FRAME_HEADERS | HTTP2_FRAME_PUSH_PROMISE |
+                        HTTP2_FRAME_CONTINUATION =>
+                    {
+                        self.set_event(hdr.stream_id, HTTP2Event::HeaderBlockTooLong);
+                        self.dirs[dir].in_block = false;
+                        self.dirs[dir].hpack_failed = true;
+                        // Still track the stream, its headers are lost.
+                        let end_stream = hdr.flags & HTTP2_FLAG_END_STREAM != 0;
+                        if hdr.ftype == HTTP2_FRAME_HEADERS && hdr.stream_id != 0 {
+                            self.handle_headers(dir, hdr.stream_id, 0, end_stream, Vec::new());
+                        }
+                    }
+                    _ => {
+                        self.set_event(hdr.stream_id, HTTP2Event::InvalidFrameLength);
+                    }
+                }
+                self.dirs[dir].skip_left = hdr.length;
+                rem = payload;
+                continue;
+            }
+            if payload.len() < length {
+                return AppLayerResult::incomplete(consumed,
+                                                  (HTTP2_FRAME_HEADER_LEN + length) as u32);
+            }
+            self.handle_frame(dir, &hdr, &payload[..length]);
+            rem = &payload[length..];
+        }
+    }
+
+    fn parse_eof(&mut self, dir: usize) {
+        for tx in &mut self.transactions {
+            tx.message_mut(dir).progress = HTTP2_PROGRESS_COMPLETE;
+        }
+    }
+
+    fn tx_iterator(
+        &mut self,
+        min_tx_id: u64,
+        state: &mut u64,
+    ) -> Option<(&HTTP2Transaction, u64, bool)> {
+        let mut index = *state as usize;
+        let len = self.transactions.len();
+
+        while index < len {
+            let tx = &self.transactions[index];
+            if tx.tx_id < min_tx_id + 1 {
+                index += 1;
+                continue;
+            }
+            *state = index as u64;
+            return Some((tx, tx.tx_id - 1, (len - index) > 1));
+        }
+
+        return None;
+    }
+}
+
+/// Probe for the server side of a connection: the first frame a server
+/// sends is a SETTINGS frame on stream 0.
+fn probe_server(input: &[u8]) -> bool {
+    match parse_frame_header(input) {
+        Ok((_, hdr)) => {
+            hdr.ftype == HTTP2_FRAME_SETTINGS && hdr.stream_id == 0 &&
+                hdr.flags & !HTTP2_FLAG_ACK == 0 && hdr.length % 6 == 0
+        }
+        Err(_) => false,
+    }
+}
+
+// C exports.
+
+export_tx_get_detect_state!(
+    rs_http2_tx_get_detect_state,
+    HTTP2Transaction
+);
+export_tx_set_detect_state!(
+    rs_http2_tx_set_detect_state,
+    HTTP2Transaction
+);
+
+export_tx_detect_flags_set!(rs_http2_set_tx_detect_flags, HTTP2Transaction);
+export_tx_detect_flags_get!(rs_http2_get_tx_detect_flags, HTTP2Transaction);
+
+/// Set the limits from the configuration. Called before the parser is
+/// registered.
+#[no_mangle]
+pub extern "C" fn rs_http2_set_limits(max_table_size: u32, max_header_block: u32,
+                                      body_limit: u32, max_streams: u32)
+{
+    unsafe {
+        HTTP2_MAX_TABLE_SIZE = max_table_size as usize;
+        HTTP2_MAX_HEADER_BLOCK = max_header_block as usize;
+        HTTP2_BODY_LIMIT = body_limit as usize;
+        HTTP2_MAX_STREAMS = max_streams as usize;
+    }
+}
+
+/// C entry point for the client side probing parser.
+#[no_mangle]
+pub extern "C" fn rs_http2_probing_parser_ts(
+    _flow: *const Flow,
+    _direction: u8,
+    input: *const u8,
+    input_len: u32,
+    _rdir: *mut u8
+) -> AppProto {
+    if input_len > 0 && input != std::ptr::null_mut() {
+        let slice = build_slice!(input, input_len as usize);
+        let n = std::cmp::min(slice.len(), HTTP2_CLIENT_PREFACE.len());
+        if slice[..n] != HTTP2_CLIENT_PREFACE[..n] {
+            return unsafe { core::ALPROTO_FAILED };
+        }
+        if n == HTTP2_CLIENT_PREFACE.len() {
+            return unsafe { ALPROTO_HTTP2 };
+        }
+    }
+    return ALPROTO_UNKNOWN;
+}
+
+/// C entry point for the server side probing parser.
+#[no_mangle]
+pub extern "C" fn rs_http2_probing_parser_tc(
+    _flow: *const Flow,
+    _direction: u8,
+    input: *const u8,
+    input_len: u32,
+    _rdir: *mut u8
+) -> AppProto {
+    if input_len as usize >= HTTP2_FRAME_HEADER_LEN && input != std::ptr::null_mut() {
+        let slice = build_slice!(input, input_len as usize);
+        if probe_server(slice) {
+            return unsafe { ALPROTO_HTTP2 };
+        }
+        return unsafe { core::ALPROTO_FAILED };
+    }
+    return ALPROTO_UNKNOWN;
+}
+
+#[no_mangle]
+pub extern "C" fn rs_http2_state_new() -> *mut std::os::raw::c_void {
+    let state = HTTP2State::new();
+    let boxed = Box::new(state);
+    return unsafe { transmute(boxed) };
+}
+
+#[no_mangle]
+pub extern "C" fn rs_http2_state_free(state: *mut std::os::raw::c_void) {
+    // Just unbox...
+    let _drop: Box<HTTP2State> = unsafe { transmute(state) };
+}
+
+#[no_mangle]
+pub extern "C" fn rs_http2_state_tx_free(
+    state: *mut std::os::raw::c_void,
+    tx_id: u64,
+) {
+    let state = cast_pointer!(state, HTTP2State);
+    state.free_tx(tx_id);
+}
+
+#[no_mangle]
+pub extern "C" fn rs_http2_parse_request(
+    _flow: *const Flow,
+    state: *mut std::os::raw::c_void,
+    pstate: *mut std::os::raw::c_void,
+    input: *const u8,
+    input_len: u32,
+    _data: *const std::os::raw::c_void,
+    _flags: u8,
+) -> AppLayerResult {
+    let state = cast_pointer!(state, HTTP2State);
+    let eof = unsafe {
+        AppLayerParserStateIssetFlag(pstate, APP_LAYER_PARSER_EOF) > 0
+    };
+    let mut res = AppLayerResult::ok();
+    if input != std::ptr::null_mut() && input_len > 0 {
+        let buf = build_slice!(input, input_len as usize);
+        res = state.parse(buf, HTTP2_DIR_TOSERVER);
+    }
+    if eof {
+        state.parse_eof(HTTP2_DIR_TOSERVER);
+    }
+    res
+}
+
+#[no_mangle]
+pub extern "C" fn rs_http2_parse_response(
+    _flow: *const Flow,
+    state: *mut std::os::raw::c_void,
+    pstate: *mut std::os::raw::c_void,
+    input: *const u8,
+    input_len: u32,
+    _data: *const std::os::raw::c_void,
+    _flags: u8,
+) -> AppLayerResult {
+    let state = cast_pointer!(state, HTTP2State);
+    let eof = unsafe {
+        AppLayerParserStateIssetFlag(pstate, APP_LAYER_PARSER_EOF) > 0
+    };
+    let mut res = AppLayerResult::ok();
+    if input != std::ptr::null_mut() && input_len > 0 {
+        let buf = build_slice!(input, input_len as usize);
+        res = state.parse(buf, HTTP2_DIR_TOCLIENT);
+    }
+    if eof {
+        state.parse_eof(HTTP2_DIR_TOCLIENT);
+    }
+    res
+}
+
+#[no_mangle]
+pub extern "C" fn rs_http2_state_get_tx(
+    state: *mut std::os::raw::c_void,
+    tx_id: u64,
+) -> *mut std::os::raw::c_void {
+    let state = cast_pointer!(state, HTTP2State);
+    match state.get_tx(tx_id) {
+        Some(tx) => {
+            return unsafe { transmute(tx) };
+        }
+        None => {
+            return std::ptr::null_mut();
+        }
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn rs_http2_state_get_tx_count(
+    state: *mut std::os::raw::c_void,
+) -> u64 {
+    let state = cast_pointer!(state, HTTP2State);
+    return state.tx_id;
+}
+
+#[no_mangle]
+pub extern "C" fn rs_http2_state_progress_completion_status(
+    _direction: u8,
+) -> std::os::raw::c_int {
+    return HTTP2_PROGRESS_COMPLETE as std::os::raw::c_int;
+}
+
+#[no_mangle]
+pub extern "C" fn rs_http2_tx_get_alstate_progress(
+    tx: *mut std::os::raw::c_void,
+    direction: u8,
+) -> std::os::raw::c_int {
+    let tx = cast_pointer!(tx, HTTP2Transaction);
+    if direction & core::STREAM_TOSERVER != 0 {
+        return tx.request.progress as std::os::raw::c_int;
+    }
+    return tx.response.progress as std::os::raw::c_int;
+}
+
+#[no_mangle]
+pub extern "C" fn rs_http2_tx_get_logged(
+    _state: *mut std::os::raw::c_void,
+    tx: *mut std::os::raw::c_void,
+) -> u32 {
+    let tx = cast_pointer!(tx, HTTP2Transaction);
+    return tx.logged.get();
+}
+
+#[no_mangle]
+pub extern "C" fn rs_http2_tx_set_logged(
+    _state: *mut std::os::raw::c_void,
+    tx: *mut std::os::raw::c_void,
+    logged: u32,
+) {
+    let tx = cast_pointer!(tx, HTTP2Transaction);
+    tx.logged.set(logged);
+}
+
+#[no_mangle]
+pub extern "C" fn rs_http2_state_get_events(
+    tx: *mut std::os::raw::c_void
+) -> *mut core::AppLayerDecoderEvents {
+    let tx = cast_pointer!(tx, HTTP2Transaction);
+    return tx.events;
+}
+
+#[no_mangle]
+pub extern "C" fn rs_http2_state_get_event_info(
+    event_name: *const std::os::raw::c_char,
+    event_id: *mut std::os::raw::c_int,
+    event_type: *mut core::AppLayerEventType,
+) -> std::os::raw::c_int {
+    if event_name == std::ptr::null() {
+        return -1;
+    }
+    let c_event_name: &CStr = unsafe { CStr::from_ptr(event_name) };
+    let event = match c_event_name.to_str() {
+        Ok(s) => {
+            match s {
+                "invalid_frame_header" => HTTP2Event::InvalidFrameHeader as i32,
+                "invalid_frame_length" => HTTP2Event::InvalidFrameLength as i32,
+                "header_decompression_failed" => HTTP2Event::HeaderDecompressionFailed as i32,
+                "header_table_size_exceeded" => HTTP2Event::HeaderTableSizeExceeded as i32,
+                "header_block_too_long" => HTTP2Event::HeaderBlockTooLong as i32,
+                "invalid_stream_id" => HTTP2Event::InvalidStreamId as i32,
+                "too_many_streams" => HTTP2Event::TooManyStreams as i32,
+                _ => -1, // unknown event
+            }
+        }
+        Err(_) => -1, // UTF-8 conversion failed
+    };
+    unsafe {
+        *event_type = core::APP_LAYER_EVENT_TYPE_TRANSACTION;
+        *event_id = event as std::os::raw::c_int;
+    };
+    0
+}
+
+#[no_mangle]
+pub extern "C" fn rs_http2_state_get_event_info_by_id(
+    event_id: std::os::raw::c_int,
+    event_name: *mut *const std::os::raw::c_char,
+    event_type: *mut core::AppLayerEventType,
+) -> i8 {
+    if let Some(e) = HTTP2Event::from_i32(event_id as i32) {
+        let estr = match e {
+            HTTP2Event::InvalidFrameHeader => "invalid_frame_header\0",
+            HTTP2Event::InvalidFrameLength => "invalid_frame_length\0",
+            HTTP2Event::HeaderDecompressionFailed => "header_decompression_failed\0",
+            HTTP2Event::HeaderTableSizeExceeded => "header_table_size_exceeded\0",
+            HTTP2Event::HeaderBlockTooLong => "header_block_too_long\0",
+            HTTP2Event::InvalidStreamId => "invalid_stream_id\0",
+            HTTP2Event::TooManyStreams => "too_many_streams\0",
+        };
+        unsafe {
+            *event_name = estr.as_ptr() as *const std::os::raw::c_char;
+            *event_type = core::APP_LAYER_EVENT_TYPE_TRANSACTION;
+        };
+        0
+    } else {
+        -1
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn rs_http2_state_get_tx_iterator(
+    _ipproto: u8,
+    _alproto: AppProto,
+    state: *mut std::os::raw::c_void,
+    min_tx_id: u64,
+    _max_tx_id: u64,
+    istate: &mut u64,
+) -> applayer::AppLayerGetTxIterTuple {
+    let state = cast_pointer!(state, HTTP2State);
+    match state.tx_iterator(min_tx_id, istate) {
+        Some((tx, out_tx_id, has_next)) => {
+            let c_tx = unsafe { transmute(tx) };
+            let ires = applayer::AppLayerGetTxIterTuple::with_values(
+                c_tx,
+                out_tx_id,
+                has_next,
+            );
+            return ires;
+        }
+        None => {
+            return applayer::AppLayerGetTxIterTuple::not_found();
+        }
+    }
+}
+
+// Parser name as a C style string.
+const PARSER_NAME: &'static [u8] = b"http2\0";
+
+#[no_mangle]
+pub unsafe extern "C" fn rs_http2_register_parser() {
+    let default_port = CString::new("[80]").unwrap();
+    let parser = RustParser {
+        name: PARSER_NAME.as_ptr() as *const std::os::raw::c_char,
+        default_port: default_port.as_ptr(),
+        ipproto: IPPROTO_TCP,
+        probe_ts: Some(rs_http2_probing_parser_ts),
+        probe_tc: Some(rs_http2_probing_parser_tc),
+        min_depth: 0,
+        max_depth: HTTP2_CLIENT_PREFACE.len() as u16,
+        state_new: rs_http2_state_new,
+        state_free: rs_http2_state_free,
+        tx_free: rs_http2_state_tx_free,
+        parse_ts: rs_http2_parse_request,
+        parse_tc: rs_http2_parse_response,
+        get_tx_count: rs_http2_state_get_tx_count,
+        get_tx: rs_http2_state_get_tx,
+        tx_get_comp_st: rs_http2_state_progress_completion_status,
+        tx_get_progress: rs_http2_tx_get_alstate_progress,
+        get_tx_logged: Some(rs_http2_tx_get_logged),
+        set_tx_logged: Some(rs_http2_tx_set_logged),
+        get_de_state: rs_http2_tx_get_detect_state,
+        set_de_state: rs_http2_tx_set_detect_state,
+        get_events: Some(rs_http2_state_get_events),
+        get_eventinfo: Some(rs_http2_state_get_event_info),
+        get_eventinfo_byid : Some(rs_http2_state_get_event_info_by_id),
+        localstorage_new: None,
+        localstorage_free: None,
+        get_tx_mpm_id: None,
+        set_tx_mpm_id: None,
+        get_files: None,
+        get_tx_iterator: Some(rs_http2_state_get_tx_iterator),
+        get_tx_detect_flags: Some(rs_http2_get_tx_detect_flags),
+        set_tx_detect_flags: Some(rs_http2_set_tx_detect_flags),
+    };
+
+    let ip_proto_str = CString::new("tcp").unwrap();
+
+    if AppLayerProtoDetectConfProtoDetectionEnabled(
+        ip_proto_str.as_ptr(),
+        parser.name,
+    ) != 0
+    {
+        let alproto = AppLayerRegisterProtocolDetection(&parser, 1);
+        ALPROTO_HTTP2 = alproto;
+        if AppLayerParserConfParserEnabled(
+            ip_proto_str.as_ptr(),
+            parser.name,
+        ) != 0
+        {
+            let _ = AppLayerRegisterParser(&parser, alproto);
+        }
+        SCLogDebug!("Rust http2 parser registered.");
+    } else {
+        SCLogDebug!("Protocol detector and parser disabled for HTTP2.");
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn frame(ftype: u8, flags: u8, stream_id: u32, payload: &[u8]) -> Vec<u8> {
+        let len = payload.len();
+        let mut v = vec![(len >> 16) as u8, (len >> 8) as u8, len as u8, ftype, flags,
+                         (stream_id >> 24) as u8, (stream_id >> 16) as u8,
+                         (stream_id >> 8) as u8, stream_id as u8];
+        v.extend_from_slice(payload);
+        v
+    }
+
+    #[test]
+    fn test_http2_streams() {
+        let mut state = HTTP2State::new();
+
+        let mut ts = HTTP2_CLIENT_PREFACE.to_vec();
+        ts.extend(frame(HTTP2_FRAME_SETTINGS, 0, 0, &[]));
+        // GET / on stream 1 and 3, :authority www.example.com
+        let block = [0x82, 0x86, 0x84, 0x41, 0x8c, 0xf1, 0xe3, 0xc2, 0xe5, 0xf2,
+                     0x3a, 0x6b, 0xa0, 0xab, 0x90, 0xf4, 0xff];
+        ts.extend(frame(HTTP2_FRAME_HEADERS,
+                        HTTP2_FLAG_END_HEADERS | HTTP2_FLAG_END_STREAM, 1, &block));
+        // POST with a body, the block references the dynamic table
+        ts.extend(frame(HTTP2_FRAME_HEADERS, HTTP2_FLAG_END_HEADERS, 3,
+                        &[0x83, 0x86, 0x84, 0xbe]));
+
+        // feed it in two parts to exercise the incomplete handling
+        let split = ts.len() - 3;
+        let r = state.parse(&ts[..split], HTTP2_DIR_TOSERVER);
+        assert_eq!(r.status, 1);
+        let consumed = r.consumed as usize;
+        let r = state.parse(&ts[consumed..], HTTP2_DIR_TOSERVER);
+        assert_eq!(r.status, 0);
+
+        let data = frame(HTTP2_FRAME_DATA, HTTP2_FLAG_END_STREAM | HTTP2_FLAG_PADDED, 3,
+                         &[0x02, b'a', b'b', b'c', 0x00, 0x00]);
+        // stream the DATA frame byte by byte, buffering like the
+        // app-layer does on incomplete results
+        let mut buf = Vec::new();
+        for b in data {
+            buf.push(b);
+            let r = state.parse(&buf, HTTP2_DIR_TOSERVER);
+            if r.status == 1 {
+                buf.drain(..r.consumed as usize);
+            } else {
+                assert_eq!(r.status, 0);
+                buf.clear();
+            }
+        }
+        assert_eq!(buf.len(), 0);
+
+        assert_eq!(state.transactions.len(), 2);
+        let tx = &state.transactions[0];
+        assert_eq!(tx.stream_id, 1);
+        assert_eq!(tx.request.get_header(b":method"), Some(&b"GET"[..]));
+        assert_eq!(tx.host, Some(b"www.example.com".to_vec()));
+        assert_eq!(tx.request.progress, HTTP2_PROGRESS_COMPLETE);
+        let tx = &state.transactions[1];
+        assert_eq!(tx.stream_id, 3);
+        assert_eq!(tx.request.get_header(b":method"), Some(&b"POST"[..]));
+        assert_eq!(tx.request.get_header(b":authority"), Some(&b"www.example.com"[..]));
+        assert_eq!(tx.request.body, b"abc");
+        assert_eq!(tx.request.progress, HTTP2_PROGRESS_COMPLETE);
+
+        // response on stream 3, with a regular header
+        let mut tc = frame(HTTP2_FRAME_SETTINGS, 0, 0, &[]);
+        let mut block = vec![0x88, 0x0f, 0x10, 0x0a];
+        block.extend_from_slice(b"text/plain");
+        tc.extend(frame(HTTP2_FRAME_HEADERS, HTTP2_FLAG_END_HEADERS, 3, &block));
+        assert!(probe_server(&tc));
+        assert_eq!(state.parse(&tc, HTTP2_DIR_TOCLIENT).status, 0);
+        let tx = &state.transactions[1];
+        assert_eq!(tx.response.get_header(b":status"), Some(&b"200"[..]));
+        assert_eq!(tx.response.raw_headers, b"content-type: text/plain\r\n");
+        assert_eq!(tx.response.progress, HTTP2_PROGRESS_HEADERS);
+    }
+
+    #[test]
+    fn test_http2_hpack_failure() {
+        let mut state = HTTP2State::new();
+        // index 70 doesn't exist
+        let ts = frame(HTTP2_FRAME_HEADERS, HTTP2_FLAG_END_HEADERS, 1, &[0xc6]);
+        assert_eq!(state.parse(&ts, HTTP2_DIR_TOSERVER).status, 0);
+        assert!(state.dirs[HTTP2_DIR_TOSERVER].hpack_failed);
+        assert_eq!(state.transactions.len(), 1);
+        assert_eq!(state.transactions[0].stream_id, 1);
+        assert_eq!(state.transactions[0].request.headers.len(), 0);
+        assert_eq!(state.transactions[0].request.progress, HTTP2_PROGRESS_HEADERS);
+    }
+}
@@ -0,0 +1,149 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+//! HPACK Huffman decoder (RFC 7541 Appendix B).
+//!
+//! The code is canonical, so instead of a 257 entry code table we only
+//! keep the number of codes per bit length and the symbols sorted by
+//! code. Decoding walks the code one bit at a time and checks whether
+//! the bits read so far fall in the range of codes of that length.
+
+/// Longest code in the table.
+const HUFFMAN_MAX_BITS: usize = 30;
+/// End of string symbol, never valid in an encoded string.
+const HUFFMAN_EOS: u16 = 256;
+
+// Number of codes of each bit length.
+const HUFFMAN_COUNT: [u32; 31] = [
+    0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3,
+    0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 4,
+];
+
+// First code of each bit length.
+const HUFFMAN_FIRST: [u32; 31] = [
+    0, 0, 0, 0, 0, 0,
+    20, 92, 248, 508, 1016, 2042,
+    4090, 8184, 16380, 32764, 65534, 131068,
+    262136, 524272, 1048550, 2097116, 4194258, 8388568,
+    16777194, 33554412, 67108832, 134217694, 268435426, 536870910,
+    1073741820,
+];
+
+// Index in HUFFMAN_SYMBOLS of the first code of each bit length.
+const HUFFMAN_OFFSET: [u16; 31] = [
+    0, 0, 0, 0, 0, 0, 10, 36, 68, 74, 74, 79, 82, 84, 90, 92,
+    95, 95, 95, 95, 98, 106, 119, 145, 174, 186, 190, 205, 224, 253, 253,
+];
+
+// Symbols in code order.
+const HUFFMAN_SYMBOLS: [u16; 257] = [
+    48, 49, 50, 97, 99, 101, 105, 111, 115, 116, 32, 37, 45, 46, 47, 51,
+    52, 53, 54, 55, 56, 57, 61, 65, 95, 98, 100, 102, 103, 104, 108, 109,
+    110, 112, 114, 117, 58, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76,
+    77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 89, 106, 107, 113, 118,
+    119, 120, 121, 122, 38, 42, 44, 59, 88, 90, 33, 34, 40, 41, 63, 39,
+    43, 124, 35, 62, 0, 36, 64, 91, 93, 126, 94, 125, 60, 96, 123, 92,
+    195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161, 167, 172, 176, 177,
+    179, 209, 216, 217, 227, 229, 230, 129, 132, 133, 134, 136, 146, 154, 156, 160,
+    163, 164, 169, 170, 173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+    233, 1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150, 151, 152, 155, 157,
+    158, 165, 166, 168, 174, 175, 180, 182, 183, 188, 191, 197, 231, 239, 9, 142,
+    144, 145, 148, 159, 171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+    200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243, 255, 203, 204, 211,
+    212, 214, 221, 222, 223, 241, 244, 245, 246, 247, 248, 250, 251, 252, 253, 254,
+    2, 3, 4, 5, 6, 7, 8, 11, 12, 14, 15, 16, 17, 18, 19, 20,
+    21, 23, 24, 25, 26, 27, 28, 29, 30, 31, 127, 220, 249, 10, 13, 22,
+    256,
+];
+
+/// Decode a Huffman encoded string, appending the result to `out`.
+///
+/// Returns false if the input is not a valid encoding: it contains
+/// EOS, or the padding is longer than 7 bits or not all ones.
+pub fn decode(input: &[u8], out: &mut Vec<u8>) -> bool {
+    let mut code: u32 = 0;
+    let mut len: usize = 0;
+
+    for byte in input {
+        for shift in (0..8).rev() {
+            code = (code << 1) | ((*byte as u32 >> shift) & 1);
+            len += 1;
+
+            let count = HUFFMAN_COUNT[len];
+            if count > 0 && code >= HUFFMAN_FIRST[len] &&
+                code - HUFFMAN_FIRST[len] < count
+            {
+                let index = HUFFMAN_OFFSET[len] as usize +
+                    (code - HUFFMAN_FIRST[len]) as usize;
+                let sym = HUFFMAN_SYMBOLS[index];
+                if sym == HUFFMAN_EOS {
+                    return false;
+                }
+                out.push(sym as u8);
+                code = 0;
+                len = 0;
+            } else if len == HUFFMAN_MAX_BITS {
+                return false;
+            }
+        }
+    }
+
+    // Trailing bits must be a prefix of EOS, which is all ones.
+    len < 8 && code == (1 << len) - 1
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn decode_str(input: &[u8]) -> Option<Vec<u8>> {
+        let mut out = Vec::new();
+        if decode(input, &mut out) {
+            Some(out)
+        } else {
+            None
+        }
+    }
+
+    #[test]
+    fn test_huffman_rfc_examples() {
+        // RFC 7541 C.4.1 - C.4.3
+        assert_eq!(decode_str(&[0xf1, 0xe3, 0xc2, 0xe5, 0xf2, 0x3a, 0x6b,
+                                0xa0, 0xab, 0x90, 0xf4, 0xff]).unwrap(),
+                   b"www.example.com");
+        assert_eq!(decode_str(&[0xa8, 0xeb, 0x10, 0x64, 0x9c, 0xbf]).unwrap(),
+                   b"no-cache");
+        assert_eq!(decode_str(&[0x25, 0xa8, 0x49, 0xe9, 0x5b, 0xa9, 0x7d,
+                                0x7f]).unwrap(),
+                   b"custom-key");
+        // RFC 7541 C.6.1
+        assert_eq!(decode_str(&[0x64, 0x02]).unwrap(), b"302");
+        assert_eq!(decode_str(&[0xae, 0xc3, 0x77, 0x1a, 0x4b]).unwrap(),
+                   b"private");
+        assert_eq!(decode_str(&[]).unwrap(), b"");
+    }
+
+    #[test]
+    fn test_huffman_invalid() {
+        // 'a' (00011) followed by a zero padding bit
+        assert!(decode_str(&[0x1c]).is_none());
+        // a full byte of padding
+        assert!(decode_str(&[0x1f, 0xff]).is_none());
+        // EOS
+        assert!(decode_str(&[0xff, 0xff, 0xff, 0xff]).is_none());
+    }
+}
@@ -0,0 +1,164 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+use nom::number::streaming::{be_u8, be_u16, be_u24, be_u32};
+
+/// Connection preface sent by the client (RFC 7540 section 3.5).
+pub const HTTP2_CLIENT_PREFACE: &'static [u8] = b"PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+pub const HTTP2_FRAME_HEADER_LEN: usize = 9;
+
+pub const HTTP2_FRAME_DATA: u8 = 0;
+pub const HTTP2_FRAME_HEADERS: u8 = 1;
+pub const HTTP2_FRAME_PRIORITY: u8 = 2;
+pub const HTTP2_FRAME_RST_STREAM: u8 = 3;
+pub const HTTP2_FRAME_SETTINGS: u8 = 4;
+pub const HTTP2_FRAME_PUSH_PROMISE: u8 = 5;
+pub const HTTP2_FRAME_PING: u8 = 6;
+pub const HTTP2_FRAME_GOAWAY: u8 = 7;
+pub const HTTP2_FRAME_WINDOW_UPDATE: u8 = 8;
+pub const HTTP2_FRAME_CONTINUATION: u8 = 9;
+
+pub const HTTP2_FLAG_END_STREAM: u8 = 0x01;
+pub const HTTP2_FLAG_ACK: u8 = 0x01;
+pub const HTTP2_FLAG_END_HEADERS: u8 = 0x04;
+pub const HTTP2_FLAG_PADDED: u8 = 0x08;
+pub const HTTP2_FLAG_PRIORITY: u8 = 0x20;
+
+pub const HTTP2_SETTINGS_HEADER_TABLE_SIZE: u16 = 1;
+
+#[derive(Debug, PartialEq)]
+pub struct HTTP2FrameHeader {
+    pub length: u32,
+    pub ftype: u8,
+    pub flags: u8,
+    pub stream_id: u32,
+}
+
+#[derive(Debug, PartialEq)]
+pub struct HTTP2Setting {
+    pub id: u16,
+    pub value: u32,
+}
+
+named!(pub parse_frame_header<HTTP2FrameHeader>,
+    do_parse!(
+        length: be_u24
+        >> ftype: be_u8
+        >> flags: be_u8
+        >> stream_id: be_u32
+        >> (HTTP2FrameHeader {
+            length: length,
+            ftype: ftype,
+            flags: flags,
+            stream_id: stream_id & 0x7fff_ffff,
+        })
+    )
+);
+
+named!(pub parse_settings<Vec<HTTP2Setting>>,
+    many0!(complete!(
+        do_parse!(
+            id: be_u16
+            >> value: be_u32
+            >> (HTTP2Setting {
+                id: id,
+                value: value,
+            })
+        )
+    ))
+);
+
+named!(pub parse_stream_id<u32>,
+    map!(be_u32, |v| v & 0x7fff_ffff)
+);
+
+/// Strip the padding and priority fields of a HEADERS or PUSH_PROMISE
+/// payload, returning the header block fragment (and for PUSH_PROMISE
+/// the promised stream id in front of it).
+pub fn strip_padding(payload: &[u8], flags: u8, priority: bool) -> Option<&[u8]> {
+    let mut p = payload;
+    let mut pad = 0;
+    if flags & HTTP2_FLAG_PADDED != 0 {
+        if p.len() < 1 {
+            return None;
+        }
+        pad = p[0] as usize;
+        p = &p[1..];
+    }
+    if priority && flags & HTTP2_FLAG_PRIORITY != 0 {
+        if p.len() < 5 {
+            return None;
+        }
+        p = &p[5..];
+    }
+    if pad > p.len() {
+        return None;
+    }
+    Some(&p[..p.len() - pad])
+}
+
+#[cfg(test)]
+mod tests {
+
+    use nom::*;
+    use super::*;
+
+    #[test]
+    fn test_parse_frame_header() {
+        // SETTINGS frame with two settings
+        let buf: &[u8] = &[0x00, 0x00, 0x0c, 0x04, 0x00, 0x00, 0x00, 0x00,
+                           0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x64, 0x00,
+                           0x04, 0x40, 0x00, 0x00, 0x00];
+        match parse_frame_header(buf) {
+            Ok((rem, hdr)) => {
+                assert_eq!(hdr.length, 12);
+                assert_eq!(hdr.ftype, HTTP2_FRAME_SETTINGS);
+                assert_eq!(hdr.flags, 0);
+                assert_eq!(hdr.stream_id, 0);
+                let settings = parse_settings(rem).unwrap().1;
+                assert_eq!(settings.len(), 2);
+                assert_eq!(settings[0], HTTP2Setting { id: 3, value: 100 });
+                assert_eq!(settings[1], HTTP2Setting { id: 4, value: 0x40000000 });
+            }
+            _ => {
+                panic!("Result should have been ok.");
+            }
+        }
+
+        // reserved bit of the stream id is ignored
+        let buf: &[u8] = &[0x00, 0x00, 0x00, 0x01, 0x05, 0x80, 0x00, 0x00, 0x03];
+        let (_, hdr) = parse_frame_header(buf).unwrap();
+        assert_eq!(hdr.stream_id, 3);
+
+        match parse_frame_header(&buf[..8]) {
+            Err(Err::Incomplete(_)) => {}
+            _ => {
+                panic!("Result should have been incomplete.");
+            }
+        }
+    }
+
+    #[test]
+    fn test_strip_padding() {
+        let buf: &[u8] = &[0x02, 0x80, 0x00, 0x00, 0x01, 0x10, 0x82, 0x00, 0x00];
+        assert_eq!(strip_padding(buf, HTTP2_FLAG_PADDED | HTTP2_FLAG_PRIORITY, true),
+                   Some(&[0x82][..]));
+        assert_eq!(strip_padding(&buf[..2], HTTP2_FLAG_PADDED, true), None);
+        assert_eq!(strip_padding(&[0x82], 0, true), Some(&[0x82][..]));
+    }
+}
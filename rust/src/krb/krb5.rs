@@ -690,6 +690,15 @@ pub unsafe extern "C" fn rs_register_krb5_parser() {
         let alproto = AppLayerRegisterProtocolDetection(&parser, 1);
         // store the allocated ID for the probe function
         ALPROTO_KRB5 = alproto;
+        // messages start with an APPLICATION header with a tag below 30,
+        // see rs_krb5_probing_parser
+        let mut first_bytes : Vec<u8> = Vec::with_capacity(60);
+        for tag in 0..30 {
+            first_bytes.push(0x40 | tag);
+            first_bytes.push(0x60 | tag);
+        }
+        AppLayerProtoDetectPPRegisterFirstBytes(core::IPPROTO_UDP as u8, alproto,
+                first_bytes.as_ptr(), first_bytes.len() as u16);
         if AppLayerParserConfParserEnabled(ip_proto_str.as_ptr(), parser.name) != 0 {
             let _ = AppLayerRegisterParser(&parser, alproto);
         }
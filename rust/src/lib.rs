@@ -67,6 +67,7 @@ pub mod tftp;
 pub mod dhcp;
 pub mod sip;
 pub mod rfb;
+pub mod http2;
 pub mod applayertemplate;
 pub mod rdp;
 pub mod x509;
@@ -443,6 +443,17 @@ pub unsafe extern "C" fn rs_register_ntp_parser() {
         let alproto = AppLayerRegisterProtocolDetection(&parser, 1);
         // store the allocated ID for the probe function
         ALPROTO_NTP = alproto;
+        // the probing parser only accepts versions 3 and 4, the version is
+        // in bits 3-5 of the first byte
+        let mut first_bytes : Vec<u8> = Vec::with_capacity(128);
+        for b in 0..=255u8 {
+            let version = (b >> 3) & 0x7;
+            if version == 3 || version == 4 {
+                first_bytes.push(b);
+            }
+        }
+        AppLayerProtoDetectPPRegisterFirstBytes(core::IPPROTO_UDP as u8, alproto,
+                first_bytes.as_ptr(), first_bytes.len() as u16);
         if AppLayerParserConfParserEnabled(ip_proto_str.as_ptr(), parser.name) != 0 {
             let _ = AppLayerRegisterParser(&parser, alproto);
         }
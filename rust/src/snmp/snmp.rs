@@ -622,6 +622,10 @@ pub unsafe extern "C" fn rs_register_snmp_parser() {
         let alproto = AppLayerRegisterProtocolDetection(&parser, 1);
         // store the allocated ID for the probe function
         ALPROTO_SNMP = alproto;
+        // all messages are a BER SEQUENCE
+        let first_bytes : [u8; 1] = [0x30];
+        AppLayerProtoDetectPPRegisterFirstBytes(core::IPPROTO_UDP as u8, alproto,
+                first_bytes.as_ptr(), first_bytes.len() as u16);
         if AppLayerParserConfParserEnabled(ip_proto_str.as_ptr(), parser.name) != 0 {
             let _ = AppLayerRegisterParser(&parser, alproto);
         }
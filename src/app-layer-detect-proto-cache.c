@@ -0,0 +1,369 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Cache of the detected app-layer protocol per server ip:port.
+ *
+ * Servers tend to speak the same protocol on a port for a long time. When
+ * enabled, the protocol detected for a flow is remembered in the host
+ * storage of the server. The next flow to the same ip:port then only has
+ * to confirm that protocol instead of running the full pattern and probing
+ * parser detection. The confirmation itself is done by the protocol
+ * detection code, see AppLayerProtoDetectGetProto().
+ *
+ * Entries are kept until they are not used for 'timeout' seconds. Memory
+ * use is bound by the host table memcap.
+ */
+
+#include "suricata-common.h"
+#include "debug.h"
+#include "conf.h"
+#include "flow.h"
+#include "host.h"
+#include "host-storage.h"
+#include "util-unittest.h"
+#include "util-unittest-helper.h"
+
+#include "app-layer-protos.h"
+#include "app-layer-detect-proto-cache.h"
+
+/** max number of ports cached per server */
+#define ALPD_CACHE_HOST_SIZE        8
+#define ALPD_CACHE_DEFAULT_TIMEOUT  3600
+
+typedef struct AppLayerProtoDetectCacheEntry_ {
+    uint32_t last_ts;   /**< last time the entry was stored or used (sec) */
+    uint16_t port;
+    uint8_t ipproto;
+    AppProto alproto;
+} AppLayerProtoDetectCacheEntry;
+
+typedef struct AppLayerProtoDetectCacheHost_ {
+    AppLayerProtoDetectCacheEntry entries[ALPD_CACHE_HOST_SIZE];
+} AppLayerProtoDetectCacheHost;
+
+static int g_alpd_cache_enabled = 0;
+static uint32_t g_alpd_cache_timeout = ALPD_CACHE_DEFAULT_TIMEOUT;
+static int g_alpd_cache_host_id = -1;
+
+SC_ATOMIC_DECLARE(uint64_t, alpd_cache_hits);
+SC_ATOMIC_DECLARE(uint64_t, alpd_cache_misses);
+SC_ATOMIC_DECLARE(uint64_t, alpd_cache_mismatches);
+
+static void AppLayerProtoDetectCacheHostFree(void *ptr)
+{
+    SCFree(ptr);
+}
+
+void AppLayerProtoDetectCacheSetup(void)
+{
+    /* storage can only be registered once, but the setup is
+     * called again by the unittests */
+    if (g_alpd_cache_host_id == -1) {
+        g_alpd_cache_host_id = HostStorageRegister("alproto-cache",
+                sizeof(void *), NULL, AppLayerProtoDetectCacheHostFree);
+    }
+    SC_ATOMIC_INIT(alpd_cache_hits);
+    SC_ATOMIC_INIT(alpd_cache_misses);
+    SC_ATOMIC_INIT(alpd_cache_mismatches);
+
+    g_alpd_cache_enabled = 0;
+    int enabled = 0;
+    if (ConfGetBool("app-layer.detection-cache.enabled", &enabled) != 1 || !enabled)
+        return;
+    if (g_alpd_cache_host_id == -1) {
+        SCLogWarning(SC_ERR_HOST_INIT, "can't initiate host storage for the "
+                "protocol detection cache, cache disabled");
+        return;
+    }
+
+    intmax_t timeout = 0;
+    if (ConfGetInt("app-layer.detection-cache.timeout", &timeout) == 1) {
+        if (timeout <= 0 || timeout > UINT32_MAX) {
+            SCLogWarning(SC_ERR_INVALID_VALUE, "invalid "
+                    "app-layer.detection-cache.timeout %"PRIdMAX", using %u",
+                    timeout, ALPD_CACHE_DEFAULT_TIMEOUT);
+            timeout = ALPD_CACHE_DEFAULT_TIMEOUT;
+        }
+        g_alpd_cache_timeout = (uint32_t)timeout;
+    }
+    g_alpd_cache_enabled = 1;
+    SCLogConfig("protocol detection cache enabled, timeout %us",
+            g_alpd_cache_timeout);
+}
+
+int AppLayerProtoDetectCacheEnabled(void)
+{
+    return g_alpd_cache_enabled;
+}
+
+/** \internal
+ *  \brief get the server address of the flow
+ *  \retval 0 ok, -1 unsupported flow */
+static int GetServerAddress(const Flow *f, Address *a)
+{
+    const FlowAddress *fa = (f->flags & FLOW_DIR_REVERSED) ? &f->src : &f->dst;
+
+    memset(a, 0, sizeof(*a));
+    if (FLOW_IS_IPV4(f)) {
+        FLOW_COPY_IPV4_ADDR_TO_PACKET(fa, a);
+    } else if (FLOW_IS_IPV6(f)) {
+        FLOW_COPY_IPV6_ADDR_TO_PACKET(fa, a);
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+static inline int EntryIsExpired(const AppLayerProtoDetectCacheEntry *e, uint32_t now)
+{
+    return (now > e->last_ts && now - e->last_ts > g_alpd_cache_timeout);
+}
+
+/** \brief look up the protocol cached for the server of the flow
+ *
+ *  \param dp server port
+ *
+ *  \retval alproto cached protocol or ALPROTO_UNKNOWN on a miss
+ */
+AppProto AppLayerProtoDetectCacheLookup(const Flow *f, uint16_t dp)
+{
+    AppProto alproto = ALPROTO_UNKNOWN;
+    Address a;
+
+    if (GetServerAddress(f, &a) < 0)
+        return ALPROTO_UNKNOWN;
+
+    Host *h = HostLookupHostFromHash(&a);
+    if (h != NULL) {
+        AppLayerProtoDetectCacheHost *ch = HostGetStorageById(h, g_alpd_cache_host_id);
+        if (ch != NULL) {
+            const uint32_t now = (uint32_t)f->lastts.tv_sec;
+            for (int i = 0; i < ALPD_CACHE_HOST_SIZE; i++) {
+                AppLayerProtoDetectCacheEntry *e = &ch->entries[i];
+                if (e->alproto != ALPROTO_UNKNOWN && e->port == dp &&
+                        e->ipproto == f->proto && !EntryIsExpired(e, now)) {
+                    e->last_ts = now;
+                    alproto = e->alproto;
+                    break;
+                }
+            }
+        }
+        HostRelease(h);
+    }
+
+    SCLogDebug("cache lookup for port %u: %s", dp, AppProtoToString(alproto));
+    return alproto;
+}
+
+/** \brief account the result of confirming a cached protocol */
+void AppLayerProtoDetectCacheConfirmed(int confirmed)
+{
+    if (confirmed)
+        (void)SC_ATOMIC_ADD(alpd_cache_hits, 1);
+    else
+        (void)SC_ATOMIC_ADD(alpd_cache_mismatches, 1);
+}
+
+/** \brief account a protocol that was detected without help of the cache */
+void AppLayerProtoDetectCacheMissed(void)
+{
+    (void)SC_ATOMIC_ADD(alpd_cache_misses, 1);
+}
+
+static inline int EntryIsFree(const AppLayerProtoDetectCacheEntry *e, uint32_t now)
+{
+    return (e->alproto == ALPROTO_UNKNOWN || EntryIsExpired(e, now));
+}
+
+/** \internal
+ *  \brief get the entry for the port, or else a free or expired entry,
+ *         or else the least recently used one */
+static AppLayerProtoDetectCacheEntry *GetSlot(AppLayerProtoDetectCacheHost *ch,
+        uint16_t port, uint8_t ipproto, uint32_t now)
+{
+    AppLayerProtoDetectCacheEntry *victim = &ch->entries[0];
+
+    for (int i = 0; i < ALPD_CACHE_HOST_SIZE; i++) {
+        AppLayerProtoDetectCacheEntry *e = &ch->entries[i];
+        if (EntryIsFree(e, now)) {
+            if (!EntryIsFree(victim, now))
+                victim = e;
+            continue;
+        }
+        if (e->port == port && e->ipproto == ipproto)
+            return e;
+        if (!EntryIsFree(victim, now) && e->last_ts < victim->last_ts)
+            victim = e;
+    }
+    return victim;
+}
+
+/** \brief remember the protocol detected for the server of the flow
+ *
+ *  Replaces the entry for the port if there is one, otherwise an unused,
+ *  expired or the least recently used entry.
+ */
+void AppLayerProtoDetectCacheStore(const Flow *f, uint16_t dp, AppProto alproto)
+{
+    Address a;
+
+    if (GetServerAddress(f, &a) < 0)
+        return;
+
+    Host *h = HostGetHostFromHash(&a);
+    if (h == NULL)
+        return;
+
+    AppLayerProtoDetectCacheHost *ch = HostGetStorageById(h, g_alpd_cache_host_id);
+    if (ch == NULL) {
+        ch = SCCalloc(1, sizeof(*ch));
+        if (unlikely(ch == NULL)) {
+            HostRelease(h);
+            return;
+        }
+        HostSetStorageById(h, g_alpd_cache_host_id, ch);
+    }
+
+    AppLayerProtoDetectCacheEntry *slot = GetSlot(ch, dp, f->proto,
+            (uint32_t)f->lastts.tv_sec);
+    slot->port = dp;
+    slot->ipproto = f->proto;
+    slot->alproto = alproto;
+    slot->last_ts = (uint32_t)f->lastts.tv_sec;
+    SCLogDebug("cached %s for port %u", AppProtoToString(alproto), dp);
+
+    HostRelease(h);
+}
+
+int AppLayerProtoDetectCacheHostHasEntries(Host *h)
+{
+    if (g_alpd_cache_host_id == -1)
+        return 0;
+    return HostGetStorageById(h, g_alpd_cache_host_id) ? 1 : 0;
+}
+
+/** \brief expire the cache entries of a host
+ *
+ *  \retval 1 all entries timed out, storage is freed
+ *  \retval 0 host still has active entries
+ */
+int AppLayerProtoDetectCacheTimeoutCheck(Host *h, struct timeval *ts)
+{
+    AppLayerProtoDetectCacheHost *ch = HostGetStorageById(h, g_alpd_cache_host_id);
+    if (ch == NULL)
+        return 1;
+
+    int active = 0;
+    for (int i = 0; i < ALPD_CACHE_HOST_SIZE; i++) {
+        AppLayerProtoDetectCacheEntry *e = &ch->entries[i];
+        if (e->alproto == ALPROTO_UNKNOWN)
+            continue;
+        if (EntryIsExpired(e, (uint32_t)ts->tv_sec)) {
+            memset(e, 0, sizeof(*e));
+            continue;
+        }
+        active++;
+    }
+    if (active)
+        return 0;
+
+    HostFreeStorageById(h, g_alpd_cache_host_id);
+    return 1;
+}
+
+uint64_t AppLayerProtoDetectCacheHitsGlobalCounter(void)
+{
+    return SC_ATOMIC_GET(alpd_cache_hits);
+}
+
+uint64_t AppLayerProtoDetectCacheMissesGlobalCounter(void)
+{
+    return SC_ATOMIC_GET(alpd_cache_misses);
+}
+
+uint64_t AppLayerProtoDetectCacheMismatchesGlobalCounter(void)
+{
+    return SC_ATOMIC_GET(alpd_cache_mismatches);
+}
+
+#ifdef UNITTESTS
+
+static int AppLayerProtoDetectCacheTest01(void)
+{
+    HostInitConfig(HOST_QUIET);
+
+    Flow *f = UTHBuildFlow(AF_INET, "1.2.3.4", "5.6.7.8", 1024, 443);
+    FAIL_IF_NULL(f);
+    f->proto = IPPROTO_TCP;
+    f->lastts.tv_sec = 1000;
+
+    FAIL_IF(AppLayerProtoDetectCacheLookup(f, 443) != ALPROTO_UNKNOWN);
+    AppLayerProtoDetectCacheStore(f, 443, ALPROTO_TLS);
+    FAIL_IF(AppLayerProtoDetectCacheLookup(f, 443) != ALPROTO_TLS);
+    /* other port or ipproto */
+    FAIL_IF(AppLayerProtoDetectCacheLookup(f, 80) != ALPROTO_UNKNOWN);
+    f->proto = IPPROTO_UDP;
+    FAIL_IF(AppLayerProtoDetectCacheLookup(f, 443) != ALPROTO_UNKNOWN);
+    f->proto = IPPROTO_TCP;
+
+    /* update in place */
+    AppLayerProtoDetectCacheStore(f, 443, ALPROTO_HTTP);
+    FAIL_IF(AppLayerProtoDetectCacheLookup(f, 443) != ALPROTO_HTTP);
+
+    /* fill up the host, the least recently used port is replaced */
+    for (int i = 1; i <= ALPD_CACHE_HOST_SIZE; i++) {
+        f->lastts.tv_sec = 1000 + i;
+        AppLayerProtoDetectCacheStore(f, 8000 + i, ALPROTO_HTTP);
+    }
+    FAIL_IF(AppLayerProtoDetectCacheLookup(f, 443) != ALPROTO_UNKNOWN);
+    FAIL_IF(AppLayerProtoDetectCacheLookup(f, 8001) != ALPROTO_HTTP);
+
+    /* lookup on the client address misses */
+    f->flags |= FLOW_DIR_REVERSED;
+    FAIL_IF(AppLayerProtoDetectCacheLookup(f, 8001) != ALPROTO_UNKNOWN);
+    f->flags &= ~FLOW_DIR_REVERSED;
+
+    /* expire */
+    Address a;
+    FAIL_IF(GetServerAddress(f, &a) != 0);
+    Host *h = HostLookupHostFromHash(&a);
+    FAIL_IF_NULL(h);
+    FAIL_IF_NOT(AppLayerProtoDetectCacheHostHasEntries(h));
+    struct timeval ts = { 1000 + g_alpd_cache_timeout, 0 };
+    FAIL_IF(AppLayerProtoDetectCacheTimeoutCheck(h, &ts) != 0);
+    ts.tv_sec += ALPD_CACHE_HOST_SIZE + 1;
+    FAIL_IF(AppLayerProtoDetectCacheTimeoutCheck(h, &ts) != 1);
+    FAIL_IF(AppLayerProtoDetectCacheHostHasEntries(h));
+    HostRelease(h);
+
+    UTHFreeFlow(f);
+    HostShutdown();
+    PASS;
+}
+
+#endif /* UNITTESTS */
+
+void AppLayerProtoDetectCacheRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("AppLayerProtoDetectCacheTest01",
+            AppLayerProtoDetectCacheTest01);
+#endif
+}
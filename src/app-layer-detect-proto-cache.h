@@ -0,0 +1,46 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Cache of the detected app-layer protocol per server ip:port.
+ */
+
+#ifndef __APP_LAYER_DETECT_PROTO_CACHE_H__
+#define __APP_LAYER_DETECT_PROTO_CACHE_H__
+
+#include "host.h"
+
+void AppLayerProtoDetectCacheSetup(void);
+int AppLayerProtoDetectCacheEnabled(void);
+
+AppProto AppLayerProtoDetectCacheLookup(const Flow *f, uint16_t dp);
+void AppLayerProtoDetectCacheStore(const Flow *f, uint16_t dp, AppProto alproto);
+void AppLayerProtoDetectCacheConfirmed(int confirmed);
+void AppLayerProtoDetectCacheMissed(void);
+
+int AppLayerProtoDetectCacheHostHasEntries(Host *h);
+int AppLayerProtoDetectCacheTimeoutCheck(Host *h, struct timeval *ts);
+
+uint64_t AppLayerProtoDetectCacheHitsGlobalCounter(void);
+uint64_t AppLayerProtoDetectCacheMissesGlobalCounter(void);
+uint64_t AppLayerProtoDetectCacheMismatchesGlobalCounter(void);
+
+void AppLayerProtoDetectCacheRegisterTests(void);
+
+#endif /* __APP_LAYER_DETECT_PROTO_CACHE_H__ */
@@ -56,6 +56,7 @@
 #include "app-layer-parser.h"
 #include "app-layer-detect-proto.h"
 #include "app-layer-expectation.h"
+#include "app-layer-detect-proto-cache.h"
 
 #include "conf.h"
 #include "util-memcmp.h"
@@ -82,6 +83,10 @@ typedef struct AppLayerProtoDetectProbingParserElement_ {
     /* the to_client probing parser function */
     ProbingParserFPtr ProbingParserTc;
 
+    /* bitmap of the valid first bytes, NULL if any byte is valid. Only set
+     * on compiled elements, see AppLayerProtoDetectPPRegisterFirstBytes() */
+    const uint8_t *first_bytes;
+
     struct AppLayerProtoDetectProbingParserElement_ *next;
 } AppLayerProtoDetectProbingParserElement;
 
@@ -98,6 +103,11 @@ typedef struct AppLayerProtoDetectProbingParserPort_ {
     AppLayerProtoDetectProbingParserElement *dp;
     AppLayerProtoDetectProbingParserElement *sp;
 
+    /* dp and sp lists compiled into arrays at prepare time, the elements
+     * are still linked through next so they can be walked the same way */
+    AppLayerProtoDetectProbingParserElement *dp_compiled;
+    AppLayerProtoDetectProbingParserElement *sp_compiled;
+
     struct AppLayerProtoDetectProbingParserPort_ *next;
 } AppLayerProtoDetectProbingParserPort;
 
@@ -105,6 +115,12 @@ typedef struct AppLayerProtoDetectProbingParser_ {
     uint8_t ipproto;
     AppLayerProtoDetectProbingParserPort *port;
 
+    /* compiled at prepare time so the lookup doesn't walk the port list:
+     * port_idx maps each of the 65536 ports to the port entry to use in
+     * port_map. port_map[0] is the 'any' entry, NULL if there is none. */
+    uint16_t *port_idx;
+    AppLayerProtoDetectProbingParserPort **port_map;
+
     struct AppLayerProtoDetectProbingParser_ *next;
 } AppLayerProtoDetectProbingParser;
 
@@ -155,6 +171,10 @@ typedef struct AppLayerProtoDetectCtx_ {
 
     AppLayerProtoDetectProbingParser *ctx_pp;
 
+    /* Bitmaps of the valid first bytes per ipproto map and protocol, used
+     * as pre-check before calling the probing parsers. */
+    uint8_t *pp_first_bytes[FLOW_PROTO_DEFAULT][ALPROTO_MAX];
+
     /* Indicates the protocols that have registered themselves
      * for protocol detection.  This table is independent of the
      * ipproto. */
@@ -414,6 +434,11 @@ static AppLayerProtoDetectProbingParserPort *AppLayerProtoDetectGetProbingParser
     if (pp == NULL)
         goto end;
 
+    if (pp->port_idx != NULL) {
+        pp_port = pp->port_map[pp->port_idx[port]];
+        goto end;
+    }
+
     pp_port = pp->port;
     while (pp_port != NULL) {
         if (pp_port->port == port || pp_port->port == 0) {
@@ -459,7 +484,12 @@ static inline AppProto PPGetProto(
         }
 
         AppProto alproto = ALPROTO_UNKNOWN;
-        if (direction & STREAM_TOSERVER && pe->ProbingParserTs != NULL) {
+        if (pe->first_bytes != NULL && buflen > 0 &&
+            !(pe->first_bytes[buf[0] >> 3] & (1 << (buf[0] & 7)))) {
+            /* cheap pre-check failed, same as the parser not matching */
+            SCLogDebug("first byte %02x rules out %s", buf[0],
+                    AppProtoToString(pe->alproto));
+        } else if (direction & STREAM_TOSERVER && pe->ProbingParserTs != NULL) {
             alproto = pe->ProbingParserTs(f, direction, buf, buflen, rdir);
         } else if (pe->ProbingParserTc != NULL) {
             alproto = pe->ProbingParserTc(f, direction, buf, buflen, rdir);
@@ -477,6 +507,15 @@ static inline AppProto PPGetProto(
     SCReturnUInt(ALPROTO_UNKNOWN);
 }
 
+/** \internal
+ *  \brief port of the server the probing parsers are looked up for */
+static inline uint16_t AppLayerProtoDetectServerPort(const Flow *f)
+{
+    if (f->protodetect_dp)
+        return f->protodetect_dp;
+    return (f->flags & FLOW_DIR_REVERSED) ? f->sp : f->dp;
+}
+
 /**
  * \brief Call the probing parser if it exists for this flow.
  *
@@ -515,7 +554,7 @@ again_midstream:
             SCLogDebug("toserver - Probing parser found for destination port %"PRIu16, dp);
 
             /* found based on destination port, so use dp registration */
-            pe1 = pp_port_dp->dp;
+            pe1 = pp_port_dp->dp_compiled ? pp_port_dp->dp_compiled : pp_port_dp->dp;
         } else {
             SCLogDebug("toserver - No probing parser registered for dest port %"PRIu16, dp);
         }
@@ -525,7 +564,7 @@ again_midstream:
             SCLogDebug("toserver - Probing parser found for source port %"PRIu16, sp);
 
             /* found based on source port, so use sp registration */
-            pe2 = pp_port_sp->sp;
+            pe2 = pp_port_sp->sp_compiled ? pp_port_sp->sp_compiled : pp_port_sp->sp;
         } else {
             SCLogDebug("toserver - No probing parser registered for source port %"PRIu16, sp);
         }
@@ -537,7 +576,7 @@ again_midstream:
             SCLogDebug("toclient - Probing parser found for destination port %"PRIu16, dp);
 
             /* found based on destination port, so use dp registration */
-            pe1 = pp_port_dp->dp;
+            pe1 = pp_port_dp->dp_compiled ? pp_port_dp->dp_compiled : pp_port_dp->dp;
         } else {
             SCLogDebug("toclient - No probing parser registered for dest port %"PRIu16, dp);
         }
@@ -546,7 +585,7 @@ again_midstream:
         if (pp_port_sp != NULL) {
             SCLogDebug("toclient - Probing parser found for source port %"PRIu16, sp);
 
-            pe2 = pp_port_sp->sp;
+            pe2 = pp_port_sp->sp_compiled ? pp_port_sp->sp_compiled : pp_port_sp->sp;
         } else {
             SCLogDebug("toclient - No probing parser registered for source port %"PRIu16, sp);
         }
@@ -705,6 +744,8 @@ static void AppLayerProtoDetectProbingParserPortFree(AppLayerProtoDetectProbingP
         e = e_next;
     }
 
+    SCFree(p->dp_compiled);
+    SCFree(p->sp_compiled);
     SCFree(p);
 
     SCReturn;
@@ -734,11 +775,30 @@ static void AppLayerProtoDetectProbingParserFree(AppLayerProtoDetectProbingParse
         pt = pt_next;
     }
 
+    SCFree(p->port_idx);
+    SCFree(p->port_map);
     SCFree(p);
 
     SCReturn;
 }
 
+/** \brief drop the compiled lookup state of an ipproto, it's rebuilt by
+ *         AppLayerProtoDetectPrepareState() */
+static void AppLayerProtoDetectProbingParserFreeCompiled(AppLayerProtoDetectProbingParser *p)
+{
+    AppLayerProtoDetectProbingParserPort *pt;
+    for (pt = p->port; pt != NULL; pt = pt->next) {
+        SCFree(pt->dp_compiled);
+        pt->dp_compiled = NULL;
+        SCFree(pt->sp_compiled);
+        pt->sp_compiled = NULL;
+    }
+    SCFree(p->port_idx);
+    p->port_idx = NULL;
+    SCFree(p->port_map);
+    p->port_map = NULL;
+}
+
 static AppLayerProtoDetectProbingParserElement *
 AppLayerProtoDetectProbingParserElementCreate(AppProto alproto,
                                               uint16_t port,
@@ -869,6 +929,8 @@ static void AppLayerProtoDetectPrintProbingParsers(AppLayerProtoDetectProbingPar
                         printf("            alproto: ALPROTO_TEMPLATE_RUST\n");
                     else if (pp_pe->alproto == ALPROTO_RFB)
                         printf("            alproto: ALPROTO_RFB\n");
+                    else if (pp_pe->alproto == ALPROTO_HTTP2)
+                        printf("            alproto: ALPROTO_HTTP2\n");
                     else if (pp_pe->alproto == ALPROTO_TEMPLATE)
                         printf("            alproto: ALPROTO_TEMPLATE\n");
                     else if (pp_pe->alproto == ALPROTO_DNP3)
@@ -944,6 +1006,8 @@ static void AppLayerProtoDetectPrintProbingParsers(AppLayerProtoDetectProbingPar
                     printf("            alproto: ALPROTO_TEMPLATE_RUST\n");
                 else if (pp_pe->alproto == ALPROTO_RFB)
                     printf("            alproto: ALPROTO_RFB\n");
+                else if (pp_pe->alproto == ALPROTO_HTTP2)
+                    printf("            alproto: ALPROTO_HTTP2\n");
                 else if (pp_pe->alproto == ALPROTO_TEMPLATE)
                     printf("            alproto: ALPROTO_TEMPLATE\n");
                 else if (pp_pe->alproto == ALPROTO_DNP3)
@@ -1073,6 +1137,7 @@ static void AppLayerProtoDetectInsertNewProbingParser(AppLayerProtoDetectProbing
         AppLayerProtoDetectProbingParserAppend(pp, new_pp);
         curr_pp = new_pp;
     }
+    AppLayerProtoDetectProbingParserFreeCompiled(curr_pp);
 
     /* get the top level port pp */
     AppLayerProtoDetectProbingParserPort *curr_port = curr_pp->port;
@@ -1488,6 +1553,75 @@ static int AppLayerProtoDetectPMRegisterPattern(uint8_t ipproto, AppProto alprot
 
 /***** Protocol Retrieval *****/
 
+/** \internal
+ *  \brief confirm the protocol from the detection cache
+ *
+ *  Only runs the pattern and probing parser checks of the cached protocol
+ *  for the server port.
+ *
+ *  \retval 1 confirmed
+ *  \retval 0 not confirmed
+ *  \retval -1 not enough data to tell yet
+ */
+static int AppLayerProtoDetectCacheConfirm(AppLayerProtoDetectThreadCtx *tctx,
+        Flow *f, const uint8_t *buf, uint32_t buflen,
+        uint8_t ipproto, uint8_t direction, AppProto alproto, uint16_t dp)
+{
+    int incomplete = 0;
+    bool rflow = false;
+
+    if (f->protomap >= FLOW_PROTO_DEFAULT)
+        return 0;
+
+    const AppLayerProtoDetectPMCtx *pm_ctx =
+        &alpd_ctx.ctx_ipp[f->protomap].ctx_pm[(direction & STREAM_TOSERVER) ? 0 : 1];
+    const uint16_t searchlen = MIN(buflen, pm_ctx->mpm_ctx.maxdepth);
+    for (SigIntId id = 0; pm_ctx->map != NULL && id < pm_ctx->max_sig_id; id++) {
+        const AppLayerProtoDetectPMSignature *s = pm_ctx->map[id];
+        if (s->alproto != alproto)
+            continue;
+        if (s->cd->depth > searchlen) {
+            incomplete = 1;
+            continue;
+        }
+        if (AppLayerProtoDetectPMMatchSignature(s, tctx, f, direction,
+                    buf, buflen, searchlen, &rflow) == alproto && !rflow) {
+            return 1;
+        }
+    }
+
+    const AppLayerProtoDetectProbingParserPort *pp_port =
+        AppLayerProtoDetectGetProbingParsers(alpd_ctx.ctx_pp, ipproto, dp);
+    if (pp_port != NULL) {
+        const AppLayerProtoDetectProbingParserElement *pe =
+            pp_port->dp_compiled ? pp_port->dp_compiled : pp_port->dp;
+        for ( ; pe != NULL; pe = pe->next) {
+            if (pe->alproto != alproto)
+                continue;
+            if (buflen < pe->min_depth) {
+                incomplete = 1;
+                continue;
+            }
+            if (pe->first_bytes != NULL && buflen > 0 &&
+                !(pe->first_bytes[buf[0] >> 3] & (1 << (buf[0] & 7))))
+                continue;
+
+            ProbingParserFPtr Func = (direction & STREAM_TOSERVER) ?
+                pe->ProbingParserTs : pe->ProbingParserTc;
+            if (Func == NULL)
+                continue;
+            uint8_t rdir = 0;
+            AppProto r = Func(f, direction, buf, buflen, &rdir);
+            if (r == alproto && (rdir == 0 || rdir == direction))
+                return 1;
+            if (r == ALPROTO_UNKNOWN && buflen < pe->max_depth)
+                incomplete = 1;
+        }
+    }
+
+    return incomplete ? -1 : 0;
+}
+
 AppProto AppLayerProtoDetectGetProto(AppLayerProtoDetectThreadCtx *tctx,
                                      Flow *f,
                                      const uint8_t *buf, uint32_t buflen,
@@ -1500,6 +1634,26 @@ AppProto AppLayerProtoDetectGetProto(AppLayerProtoDetectThreadCtx *tctx,
 
     AppProto alproto = ALPROTO_UNKNOWN;
     AppProto pm_alproto = ALPROTO_UNKNOWN;
+    AppProto cached_alproto = ALPROTO_UNKNOWN;
+
+    /* first data in this direction: try the protocol last seen on the
+     * server ip:port */
+    if (AppLayerProtoDetectCacheEnabled() &&
+        !FLOW_IS_PM_DONE(f, direction) && !FLOW_IS_PP_DONE(f, direction))
+    {
+        const uint16_t dp = AppLayerProtoDetectServerPort(f);
+        cached_alproto = AppLayerProtoDetectCacheLookup(f, dp);
+        if (cached_alproto != ALPROTO_UNKNOWN) {
+            int r = AppLayerProtoDetectCacheConfirm(tctx, f, buf, buflen,
+                    ipproto, direction, cached_alproto, dp);
+            if (r == 1) {
+                AppLayerProtoDetectCacheConfirmed(1);
+                SCReturnUInt(cached_alproto);
+            } else if (r == 0) {
+                AppLayerProtoDetectCacheConfirmed(0);
+            }
+        }
+    }
 
     if (!FLOW_IS_PM_DONE(f, direction)) {
         AppProto pm_results[ALPROTO_MAX];
@@ -1534,12 +1688,27 @@ AppProto AppLayerProtoDetectGetProto(AppLayerProtoDetectThreadCtx *tctx,
     /* Look if flow can be found in expectation list */
     if (!FLOW_IS_PE_DONE(f, direction)) {
         alproto = AppLayerProtoDetectPEGetProto(f, ipproto, direction);
+        /* expected flows use ephemeral ports: mark the result as
+         * cached so it is not stored below */
+        if (AppProtoIsValid(alproto))
+            cached_alproto = alproto;
     }
 
  end:
     if (!AppProtoIsValid(alproto))
         alproto = pm_alproto;
 
+    if (AppLayerProtoDetectCacheEnabled() && AppProtoIsValid(alproto) &&
+        alproto != cached_alproto)
+    {
+        /* the lookup runs for every chunk of data until the protocol is
+         * known, so a miss is only counted when detection completed */
+        if (cached_alproto == ALPROTO_UNKNOWN)
+            AppLayerProtoDetectCacheMissed();
+        if (!*reverse_flow)
+            AppLayerProtoDetectCacheStore(f, AppLayerProtoDetectServerPort(f), alproto);
+    }
+
     SCReturnUInt(alproto);
 }
 
@@ -1564,6 +1733,98 @@ static void AppLayerProtoDetectFreeProbingParsers(AppLayerProtoDetectProbingPars
 
 /***** State Preparation *****/
 
+/** \brief copy a probing parser element list into a contiguous array
+ *
+ *  The elements keep their order and stay linked through next, so the
+ *  array can be walked by PPGetProto() just like the list.
+ */
+static AppLayerProtoDetectProbingParserElement *
+AppLayerProtoDetectPPCompileList(const AppLayerProtoDetectProbingParserElement *head,
+                                 uint8_t **first_bytes)
+{
+    const AppLayerProtoDetectProbingParserElement *pe;
+    uint32_t cnt = 0;
+    uint32_t i = 0;
+
+    for (pe = head; pe != NULL; pe = pe->next)
+        cnt++;
+    if (cnt == 0)
+        return NULL;
+
+    AppLayerProtoDetectProbingParserElement *array = SCCalloc(cnt, sizeof(*array));
+    if (unlikely(array == NULL))
+        return NULL;
+
+    for (pe = head; pe != NULL; pe = pe->next, i++) {
+        array[i] = *pe;
+        array[i].first_bytes = first_bytes[pe->alproto];
+        array[i].next = (i + 1 < cnt) ? &array[i + 1] : NULL;
+    }
+    return array;
+}
+
+/** \brief compile the probing parsers into a per port lookup table
+ *
+ *  For each ipproto every port maps directly to the port entry that the
+ *  list walk in AppLayerProtoDetectGetProbingParsers() would find: the
+ *  first entry registered for that port or for port 0 (any port).
+ *
+ *  \retval 0 ok, -1 on memory error. The lists are still used then.
+ */
+static int AppLayerProtoDetectPPCompile(void)
+{
+    AppLayerProtoDetectProbingParser *pp;
+    AppLayerProtoDetectProbingParserPort *pt;
+
+    for (pp = alpd_ctx.ctx_pp; pp != NULL; pp = pp->next) {
+        AppLayerProtoDetectProbingParserFreeCompiled(pp);
+
+        uint8_t **first_bytes = alpd_ctx.pp_first_bytes[FlowGetProtoMapping(pp->ipproto)];
+        for (pt = pp->port; pt != NULL; pt = pt->next) {
+            pt->dp_compiled = AppLayerProtoDetectPPCompileList(pt->dp, first_bytes);
+            pt->sp_compiled = AppLayerProtoDetectPPCompileList(pt->sp, first_bytes);
+            if ((pt->dp != NULL && pt->dp_compiled == NULL) ||
+                (pt->sp != NULL && pt->sp_compiled == NULL))
+                goto error;
+        }
+
+        /* only entries in front of the 'any' entry can win, as port
+         * entries are unique these are at most 65535 */
+        AppLayerProtoDetectProbingParserPort *any = NULL;
+        uint32_t cnt = 0;
+        for (pt = pp->port; pt != NULL; pt = pt->next) {
+            if (pt->port == 0) {
+                any = pt;
+                break;
+            }
+            cnt++;
+        }
+
+        pp->port_map = SCCalloc(cnt + 1, sizeof(AppLayerProtoDetectProbingParserPort *));
+        if (unlikely(pp->port_map == NULL))
+            goto error;
+        /* zeroed, so every port starts out at the 'any' entry */
+        pp->port_idx = SCCalloc(65536, sizeof(uint16_t));
+        if (unlikely(pp->port_idx == NULL))
+            goto error;
+
+        pp->port_map[0] = any;
+        uint16_t idx = 1;
+        for (pt = pp->port; pt != NULL && pt != any; pt = pt->next, idx++) {
+            pp->port_map[idx] = pt;
+            pp->port_idx[pt->port] = idx;
+        }
+    }
+    return 0;
+
+error:
+    SCLogError(SC_ERR_MEM_ALLOC, "failed to compile probing parsers, "
+            "using the uncompiled lists");
+    for (pp = alpd_ctx.ctx_pp; pp != NULL; pp = pp->next)
+        AppLayerProtoDetectProbingParserFreeCompiled(pp);
+    return -1;
+}
+
 int AppLayerProtoDetectPrepareState(void)
 {
     SCEnter();
@@ -1589,6 +1850,9 @@ int AppLayerProtoDetectPrepareState(void)
         }
     }
 
+    /* not fatal, detection falls back to walking the lists */
+    (void)AppLayerProtoDetectPPCompile();
+
 #ifdef DEBUG
     if (SCLogDebugEnabled()) {
         AppLayerProtoDetectPrintProbingParsers(alpd_ctx.ctx_pp);
@@ -1642,6 +1906,34 @@ void AppLayerProtoDetectPPRegister(uint8_t ipproto,
     SCReturn;
 }
 
+/** \brief register the bytes a protocol's messages can start with
+ *
+ *  Every message of the protocol, in both directions, has to start with
+ *  one of the bytes. Probing parsers of the protocol are then only called
+ *  if the first byte of the data matches. Calling this again adds bytes.
+ */
+void AppLayerProtoDetectPPRegisterFirstBytes(uint8_t ipproto, AppProto alproto,
+                                             const uint8_t *bytes, uint16_t nbytes)
+{
+    SCEnter();
+
+    uint8_t **first_bytes = &alpd_ctx.pp_first_bytes[FlowGetProtoMapping(ipproto)][alproto];
+    if (*first_bytes == NULL) {
+        *first_bytes = SCCalloc(1, 256 / 8);
+        if (unlikely(*first_bytes == NULL)) {
+            /* no pre-check, the probing parsers are simply always called */
+            SCReturn;
+        }
+    }
+
+    uint16_t i;
+    for (i = 0; i < nbytes; i++) {
+        (*first_bytes)[bytes[i] >> 3] |= (uint8_t)(1 << (bytes[i] & 7));
+    }
+
+    SCReturn;
+}
+
 int AppLayerProtoDetectPPParseConfPorts(const char *ipproto_name,
                                          uint8_t ipproto,
                                          const char *alproto_name,
@@ -1786,6 +2078,7 @@ int AppLayerProtoDetectSetup(void)
     }
 
     AppLayerExpectationSetup();
+    AppLayerProtoDetectCacheSetup();
 
     SCReturnInt(0);
 }
@@ -1820,6 +2113,14 @@ int AppLayerProtoDetectDeSetup(void)
 
     AppLayerProtoDetectFreeProbingParsers(alpd_ctx.ctx_pp);
 
+    for (ipproto_map = 0; ipproto_map < FLOW_PROTO_DEFAULT; ipproto_map++) {
+        AppProto a;
+        for (a = 0; a < ALPROTO_MAX; a++) {
+            SCFree(alpd_ctx.pp_first_bytes[ipproto_map][a]);
+            alpd_ctx.pp_first_bytes[ipproto_map][a] = NULL;
+        }
+    }
+
     SCReturnInt(0);
 }
 
@@ -3615,6 +3916,78 @@ static int AppLayerProtoDetectTest19(void)
     return result;
 }
 
+static uint32_t pp_first_bytes_calls = 0;
+
+static AppProto ProbingParserFirstBytesForTesting(Flow *f, uint8_t direction,
+                                                  const uint8_t *input,
+                                                  uint32_t input_len, uint8_t *rdir)
+{
+    pp_first_bytes_calls++;
+    return ALPROTO_TFTP;
+}
+
+/** \test compiled port map and first byte pre-check */
+static int AppLayerProtoDetectTest20(void)
+{
+    AppLayerProtoDetectUnittestCtxBackup();
+    AppLayerProtoDetectSetup();
+
+    AppLayerProtoDetectPPRegister(IPPROTO_UDP, "0", ALPROTO_DNS,
+                                  0, 4, STREAM_TOSERVER,
+                                  ProbingParserDummyForTesting, NULL);
+    AppLayerProtoDetectPPRegister(IPPROTO_UDP, "69", ALPROTO_TFTP,
+                                  0, 4, STREAM_TOSERVER,
+                                  ProbingParserFirstBytesForTesting,
+                                  ProbingParserFirstBytesForTesting);
+    const uint8_t first_bytes[] = { 0x00 };
+    AppLayerProtoDetectPPRegisterFirstBytes(IPPROTO_UDP, ALPROTO_TFTP,
+                                            first_bytes, sizeof(first_bytes));
+    AppLayerProtoDetectPrepareState();
+
+    AppLayerProtoDetectProbingParser *pp = alpd_ctx.ctx_pp;
+    FAIL_IF_NULL(pp);
+    FAIL_IF_NULL(pp->port_idx);
+    FAIL_IF_NULL(pp->port_map);
+    FAIL_IF(pp->port_idx[53] != 0);
+    FAIL_IF(pp->port_idx[69] != 1);
+    FAIL_IF_NULL(pp->port_map[0]);
+    FAIL_IF(pp->port_map[0]->port != 0);
+    FAIL_IF_NULL(pp->port_map[1]);
+    FAIL_IF(pp->port_map[1]->port != 69);
+    FAIL_IF(AppLayerProtoDetectGetProbingParsers(pp, IPPROTO_UDP, 53) != pp->port_map[0]);
+    FAIL_IF(AppLayerProtoDetectGetProbingParsers(pp, IPPROTO_UDP, 69) != pp->port_map[1]);
+
+    /* the port 69 list is TFTP followed by the DNS 'any' entry */
+    const AppLayerProtoDetectProbingParserElement *pe = pp->port_map[1]->dp_compiled;
+    FAIL_IF_NULL(pe);
+    FAIL_IF(pe->alproto != ALPROTO_TFTP);
+    FAIL_IF_NULL(pe->first_bytes);
+    FAIL_IF_NULL(pe->next);
+    FAIL_IF(pe->next->alproto != ALPROTO_DNS);
+    FAIL_IF_NOT_NULL(pe->next->first_bytes);
+
+    Flow f;
+    memset(&f, 0, sizeof(f));
+    uint32_t mask = 0;
+    uint8_t rdir = 0;
+
+    const uint8_t no_tftp[] = { 0x45, 0x00, 0x01, 0x02 };
+    AppProto alproto = PPGetProto(pe, &f, STREAM_TOSERVER, no_tftp,
+                                  sizeof(no_tftp), &mask, &rdir);
+    FAIL_IF(alproto != ALPROTO_UNKNOWN);
+    FAIL_IF(pp_first_bytes_calls != 0);
+
+    const uint8_t tftp[] = { 0x00, 0x01, 'a', 0x00 };
+    mask = 0;
+    alproto = PPGetProto(pe, &f, STREAM_TOSERVER, tftp, sizeof(tftp), &mask, &rdir);
+    FAIL_IF(alproto != ALPROTO_TFTP);
+    FAIL_IF(pp_first_bytes_calls != 1);
+
+    AppLayerProtoDetectDeSetup();
+    AppLayerProtoDetectUnittestCtxRestore();
+    PASS;
+}
+
 void AppLayerProtoDetectUnittestsRegister(void)
 {
     SCEnter();
@@ -3638,6 +4011,9 @@ void AppLayerProtoDetectUnittestsRegister(void)
     UtRegisterTest("AppLayerProtoDetectTest17", AppLayerProtoDetectTest17);
     UtRegisterTest("AppLayerProtoDetectTest18", AppLayerProtoDetectTest18);
     UtRegisterTest("AppLayerProtoDetectTest19", AppLayerProtoDetectTest19);
+    UtRegisterTest("AppLayerProtoDetectTest20", AppLayerProtoDetectTest20);
+
+    AppLayerProtoDetectCacheRegisterTests();
 
     SCReturn;
 }
@@ -70,6 +70,12 @@ void AppLayerProtoDetectPPRegister(uint8_t ipproto,
                                    uint8_t direction,
                                    ProbingParserFPtr ProbingParser1,
                                    ProbingParserFPtr ProbingParser2);
+/**
+ * \brief Registers the bytes all messages of alproto start with, used
+ *        as a cheap pre-check before calling its probing parsers.
+ */
+void AppLayerProtoDetectPPRegisterFirstBytes(uint8_t ipproto, AppProto alproto,
+                                             const uint8_t *bytes, uint16_t nbytes);
 /**
  *  \retval bool 0 if no config was found, 1 if config was found
  */
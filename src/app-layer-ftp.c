@@ -254,18 +254,13 @@ static void FTPFree(void *ptr, size_t size)
     FTPDecrMemuse((uint64_t)size);
 }
 
-static FTPString *FTPStringAlloc(void)
-{
-    return FTPCalloc(1, sizeof(FTPString));
-}
+static const AppLayerTxArenaMemcap ftp_tx_arena_memcap = {
+    FTPCheckMemcap, FTPIncrMemuse, FTPDecrMemuse
+};
 
-static void FTPStringFree(FTPString *str)
+static FTPString *FTPStringAlloc(FTPTransaction *tx)
 {
-    if (str->str) {
-        FTPFree(str->str, str->len);
-    }
-
-    FTPFree(str, sizeof(FTPString));
+    return AppLayerTxArenaCalloc(tx->arena, 1, sizeof(FTPString));
 }
 
 static void *FTPLocalStorageAlloc(void)
@@ -312,10 +307,16 @@ static void FTPLocalStorageFree(void *ptr)
 static FTPTransaction *FTPTransactionCreate(FtpState *state)
 {
     SCEnter();
-    FTPTransaction *tx = FTPCalloc(1, sizeof(*tx));
+    AppLayerTxArena *arena = AppLayerTxArenaCreate(&ftp_tx_arena_memcap);
+    if (arena == NULL) {
+        return NULL;
+    }
+    FTPTransaction *tx = AppLayerTxArenaCalloc(arena, 1, sizeof(*tx));
     if (tx == NULL) {
+        AppLayerTxArenaDestroy(arena);
         return NULL;
     }
+    tx->arena = arena;
 
     TAILQ_INSERT_TAIL(&state->tx_list, tx, next);
     tx->tx_id = state->tx_cnt++;
@@ -334,17 +335,8 @@ static void FTPTransactionFree(FTPTransaction *tx)
         DetectEngineStateFree(tx->de_state);
     }
 
-    if (tx->request) {
-        FTPFree(tx->request, tx->request_length);
-    }
-
-    FTPString *str = NULL;
-    while ((str = TAILQ_FIRST(&tx->response_list))) {
-        TAILQ_REMOVE(&tx->response_list, str, next);
-        FTPStringFree(str);
-    }
-
-    SCFree(tx);
+    /* request and responses are in the arena as well */
+    AppLayerTxArenaDestroy(tx->arena);
 }
 
 static int FTPGetLineForDirection(FtpState *state, FtpLineState *line_state)
@@ -518,10 +510,11 @@ static void FtpTransferCmdFree(void *data)
     FTPFree(cmd, sizeof(struct FtpTransferCmd));
 }
 
-static uint32_t CopyCommandLine(uint8_t **dest, const uint8_t *src, uint32_t length)
+static uint32_t CopyCommandLine(FTPTransaction *tx, uint8_t **dest,
+        const uint8_t *src, uint32_t length)
 {
     if (likely(length)) {
-        uint8_t *where = FTPCalloc(length + 1, sizeof(char));
+        uint8_t *where = AppLayerTxArenaAlloc(tx->arena, length + 1);
         if (unlikely(where == NULL)) {
             return 0;
         }
@@ -593,7 +586,7 @@ static AppLayerResult FTPParseRequest(Flow *f, void *ftp_state,
         state->curr_tx = tx;
 
         tx->command_descriptor = cmd_descriptor;
-        tx->request_length = CopyCommandLine(&tx->request,
+        tx->request_length = CopyCommandLine(tx, &tx->request,
                 state->current_line, state->current_line_len);
 
         switch (state->command) {
@@ -795,9 +788,9 @@ static AppLayerResult FTPParseResponse(Flow *f, void *ftp_state, AppLayerParserS
     }
 
     if (likely(input_len)) {
-        FTPString *response = FTPStringAlloc();
+        FTPString *response = FTPStringAlloc(tx);
         if (likely(response)) {
-            response->len = CopyCommandLine(&response->str, input, input_len);
+            response->len = CopyCommandLine(tx, &response->str, input, input_len);
             TAILQ_INSERT_TAIL(&tx->response_list, response, next);
         }
     }
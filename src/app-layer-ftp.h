@@ -139,6 +139,9 @@ typedef struct FTPTransaction_  {
     /** indicates loggers done logging */
     uint32_t logged;
 
+    /** the tx, its request and responses are allocated from this */
+    struct AppLayerTxArena_ *arena;
+
     /* for the request */
     uint32_t request_length;
     uint8_t *request;
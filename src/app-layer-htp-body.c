@@ -118,6 +118,268 @@ int HtpBodyAppendChunk(const HTPCfgDir *hcfg, HtpBody *body,
     SCReturnInt(0);
 }
 
+/**
+ * \internal
+ * \brief Get the absolute offset of data in the tcp stream buffer
+ *
+ * \retval offset of the data, HTP_BODY_NO_STREAM_OFFSET if the data is
+ *         not in the stream buffer
+ */
+static uint64_t HtpBodyStreamOffset(const StreamingBuffer *stream_sb,
+                                    const uint8_t *data, uint32_t len)
+{
+    if (stream_sb == NULL || stream_sb->buf == NULL)
+        return HTP_BODY_NO_STREAM_OFFSET;
+
+    const uintptr_t start = (uintptr_t)stream_sb->buf;
+    const uintptr_t ptr = (uintptr_t)data;
+    if (ptr < start || ptr + len > start + stream_sb->buf_offset)
+        return HTP_BODY_NO_STREAM_OFFSET;
+
+    return stream_sb->stream_offset + (ptr - start);
+}
+
+/**
+ * \brief Append a chunk of body, referencing the data in the tcp stream
+ *        if possible
+ *
+ * The first chunk decides: if its data is in the stream reassembly buffer
+ * the body becomes a zero copy body and its chunks only record where
+ * their data is in the stream. Otherwise, e.g. when the data was
+ * decompressed, the body is copied by HtpBodyAppendChunk().
+ *
+ * The stream has to be told to keep the referenced data, see
+ * HtpBodyGetStreamHold().
+ *
+ * \param stream_sb tcp stream buffer of the direction, can be NULL
+ *
+ * \retval 0 ok
+ * \retval -1 error
+ */
+int HtpBodyAppendChunkRef(const HTPCfgDir *hcfg, HtpBody *body,
+                          const StreamingBuffer *stream_sb,
+                          const uint8_t *data, uint32_t len)
+{
+    SCEnter();
+
+    if (len == 0 || data == NULL) {
+        SCReturnInt(0);
+    }
+
+    if (body->stream_sb == NULL) {
+        if (body->content_len_so_far != 0 ||
+            HtpBodyStreamOffset(stream_sb, data, len) == HTP_BODY_NO_STREAM_OFFSET)
+        {
+            SCReturnInt(HtpBodyAppendChunk(hcfg, body, data, len));
+        }
+        body->stream_sb = stream_sb;
+    }
+
+    HtpBodyChunk *bd = (HtpBodyChunk *)HTPCalloc(1, sizeof(HtpBodyChunk));
+    if (bd == NULL) {
+        SCReturnInt(-1);
+    }
+
+    bd->stream_offset = HtpBodyStreamOffset(body->stream_sb, data, len);
+    if (bd->stream_offset == HTP_BODY_NO_STREAM_OFFSET) {
+        /* not part of the stream data, so keep a copy */
+        bd->data = HTPMalloc(len);
+        if (bd->data == NULL) {
+            HTPFree(bd, sizeof(HtpBodyChunk));
+            SCReturnInt(-1);
+        }
+        memcpy(bd->data, data, len);
+    }
+    bd->sbseg.stream_offset = body->content_len_so_far;
+    bd->sbseg.segment_len = len;
+
+    if (body->first == NULL) {
+        body->first = body->last = bd;
+    } else {
+        body->last->next = bd;
+        body->last = bd;
+    }
+    body->content_len_so_far += len;
+
+    SCLogDebug("body %p, chunk at stream offset %"PRIu64, body, bd->stream_offset);
+
+    SCReturnInt(0);
+}
+
+/**
+ * \brief Get the data of a body chunk
+ */
+void HtpBodyChunkGetData(const HtpBody *body, const HtpBodyChunk *chunk,
+                         const uint8_t **data, uint32_t *data_len)
+{
+    if (body->stream_sb == NULL) {
+        StreamingBufferSegmentGetData(body->sb, &chunk->sbseg, data, data_len);
+    } else if (chunk->data != NULL) {
+        *data = chunk->data;
+        *data_len = chunk->sbseg.segment_len;
+    } else if (StreamingBufferGetDataAtOffset(body->stream_sb, data, data_len,
+                                              chunk->stream_offset)) {
+        if (*data_len > chunk->sbseg.segment_len)
+            *data_len = chunk->sbseg.segment_len;
+    }
+}
+
+/**
+ * \brief Get the contiguous body data starting at a body offset
+ *
+ * For zero copy bodies this covers the chunk holding the offset and
+ * the chunks directly following it in memory. Compatible with
+ * InspectionBufferSegmentFunc.
+ *
+ * \param ctx the HtpBody
+ *
+ * \retval 1 data set
+ * \retval 0 no data at offset
+ */
+int HtpBodyGetDataAtOffset(const void *ctx, uint64_t offset,
+                           const uint8_t **data, uint32_t *data_len)
+{
+    const HtpBody *body = ctx;
+
+    if (body->stream_sb == NULL) {
+        return StreamingBufferGetDataAtOffset(body->sb, data, data_len, offset);
+    }
+
+    *data = NULL;
+    *data_len = 0;
+
+    const HtpBodyChunk *cur = body->first;
+    while (cur != NULL &&
+           offset >= cur->sbseg.stream_offset + cur->sbseg.segment_len) {
+        cur = cur->next;
+    }
+    if (cur == NULL || offset < cur->sbseg.stream_offset) {
+        return 0;
+    }
+
+    const uint8_t *chunk_data = NULL;
+    uint32_t chunk_len = 0;
+    HtpBodyChunkGetData(body, cur, &chunk_data, &chunk_len);
+
+    const uint32_t skip = offset - cur->sbseg.stream_offset;
+    if (chunk_data == NULL || chunk_len <= skip) {
+        return 0;
+    }
+    *data = chunk_data + skip;
+    *data_len = chunk_len - skip;
+
+    /* extend over chunks adjacent in memory, which is the common case for
+     * bodies without chunked transfer encoding */
+    while (chunk_len == cur->sbseg.segment_len && (cur = cur->next) != NULL) {
+        HtpBodyChunkGetData(body, cur, &chunk_data, &chunk_len);
+        if (chunk_data != *data + *data_len)
+            break;
+        *data_len += chunk_len;
+    }
+    return 1;
+}
+
+/**
+ * \brief Get all buffered body data, from the oldest chunk on, as one
+ *        block
+ *
+ * \param alloc set to a buffer the caller has to SCFree if the data had
+ *              to be gathered from several chunks, NULL otherwise
+ *
+ * \retval 1 data set
+ * \retval 0 no data
+ */
+int HtpBodyGetBufferedData(const HtpBody *body, const uint8_t **data,
+                           uint32_t *data_len, uint8_t **alloc)
+{
+    *alloc = NULL;
+
+    if (body->stream_sb == NULL) {
+        uint64_t offset = 0;
+        if (body->sb == NULL || body->sb->buf == NULL)
+            return 0;
+        return StreamingBufferGetData(body->sb, data, data_len, &offset);
+    }
+
+    if (body->first == NULL)
+        return 0;
+
+    uint64_t offset = body->first->sbseg.stream_offset;
+    if (HtpBodyGetDataAtOffset(body, offset, data, data_len) == 0)
+        return 0;
+    if (offset + *data_len >= body->content_len_so_far ||
+        body->content_len_so_far - offset > UINT32_MAX)
+        return 1;
+
+    uint8_t *buf = SCMalloc(body->content_len_so_far - offset);
+    if (buf == NULL)
+        return 1;
+
+    uint32_t len = 0;
+    do {
+        memcpy(buf + len, *data, *data_len);
+        len += *data_len;
+        offset += *data_len;
+    } while (offset < body->content_len_so_far &&
+             HtpBodyGetDataAtOffset(body, offset, data, data_len) == 1);
+
+    *data = *alloc = buf;
+    *data_len = len;
+    return 1;
+}
+
+/**
+ * \brief Get the tcp stream offset of the oldest data a zero copy body
+ *        references
+ *
+ * \retval offset or HTP_BODY_NO_STREAM_OFFSET if the body doesn't
+ *         reference stream data
+ */
+uint64_t HtpBodyGetStreamHold(const HtpBody *body)
+{
+    if (body->stream_sb == NULL)
+        return HTP_BODY_NO_STREAM_OFFSET;
+
+    for (const HtpBodyChunk *cur = body->first; cur != NULL; cur = cur->next) {
+        if (cur->stream_offset != HTP_BODY_NO_STREAM_OFFSET)
+            return cur->stream_offset;
+    }
+    return HTP_BODY_NO_STREAM_OFFSET;
+}
+
+/**
+ * \brief Copy the stream data a zero copy body references into its chunks
+ *
+ * Used when the body is no longer tracked, so that the stream doesn't
+ * have to keep the data until the chunks are pruned.
+ *
+ * \retval 0 ok, the body doesn't reference stream data anymore
+ * \retval -1 error
+ */
+int HtpBodyDetachStream(HtpBody *body)
+{
+    if (body->stream_sb == NULL)
+        return 0;
+
+    for (HtpBodyChunk *cur = body->first; cur != NULL; cur = cur->next) {
+        if (cur->stream_offset == HTP_BODY_NO_STREAM_OFFSET)
+            continue;
+
+        const uint8_t *data = NULL;
+        uint32_t data_len = 0;
+        HtpBodyChunkGetData(body, cur, &data, &data_len);
+
+        uint8_t *copy = HTPCalloc(1, cur->sbseg.segment_len);
+        if (copy == NULL)
+            return -1;
+        if (data != NULL)
+            memcpy(copy, data, MIN(data_len, cur->sbseg.segment_len));
+        cur->data = copy;
+        cur->stream_offset = HTP_BODY_NO_STREAM_OFFSET;
+    }
+    return 0;
+}
+
 /**
  * \brief Print the information and chunks of a Body
  * \param body pointer to the HtpBody holding the list
@@ -137,7 +399,7 @@ void HtpBodyPrint(HtpBody *body)
         for (cur = body->first; cur != NULL; cur = cur->next) {
             const uint8_t *data = NULL;
             uint32_t data_len = 0;
-            StreamingBufferSegmentGetData(body->sb, &cur->sbseg, &data, &data_len);
+            HtpBodyChunkGetData(body, cur, &data, &data_len);
             SCLogDebug("Body %p; data %p, len %"PRIu32, body, data, data_len);
             printf("Body %p; data %p, len %"PRIu32"\n", body, data, data_len);
             PrintRawDataFp(stdout, data, data_len);
@@ -163,6 +425,8 @@ void HtpBodyFree(HtpBody *body)
     prev = body->first;
     while (prev != NULL) {
         cur = prev->next;
+        if (prev->data != NULL)
+            HTPFree(prev->data, prev->sbseg.segment_len);
         HTPFree(prev, sizeof(HtpBodyChunk));
         prev = cur;
     }
@@ -220,7 +484,7 @@ void HtpBodyPrune(HtpState *state, HtpBody *body, int direction)
     if (left_edge)
         left_edge -= window;
 
-    if (left_edge) {
+    if (left_edge && body->sb != NULL) {
         SCLogDebug("sliding body to offset %"PRIu64, left_edge);
         StreamingBufferSlideToOffset(body->sb, left_edge);
     }
@@ -232,7 +496,12 @@ void HtpBodyPrune(HtpState *state, HtpBody *body, int direction)
         HtpBodyChunk *next = cur->next;
         SCLogDebug("cur %p", cur);
 
-        if (!StreamingBufferSegmentIsBeforeWindow(body->sb, &cur->sbseg)) {
+        if (body->stream_sb == NULL) {
+            if (!StreamingBufferSegmentIsBeforeWindow(body->sb, &cur->sbseg)) {
+                SCLogDebug("not removed");
+                break;
+            }
+        } else if (cur->sbseg.stream_offset + cur->sbseg.segment_len > left_edge) {
             SCLogDebug("not removed");
             break;
         }
@@ -242,6 +511,8 @@ void HtpBodyPrune(HtpState *state, HtpBody *body, int direction)
             body->last = next;
         }
 
+        if (cur->data != NULL)
+            HTPFree(cur->data, cur->sbseg.segment_len);
         HTPFree(cur, sizeof(HtpBodyChunk));
 
         cur = next;
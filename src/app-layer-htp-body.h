@@ -29,6 +29,14 @@
 #define __APP_LAYER_HTP_BODY_H__
 
 int HtpBodyAppendChunk(const HTPCfgDir *, HtpBody *, const uint8_t *, uint32_t);
+int HtpBodyAppendChunkRef(const HTPCfgDir *, HtpBody *, const StreamingBuffer *,
+        const uint8_t *, uint32_t);
+void HtpBodyChunkGetData(const HtpBody *, const HtpBodyChunk *,
+        const uint8_t **, uint32_t *);
+int HtpBodyGetDataAtOffset(const void *, uint64_t, const uint8_t **, uint32_t *);
+int HtpBodyGetBufferedData(const HtpBody *, const uint8_t **, uint32_t *, uint8_t **);
+uint64_t HtpBodyGetStreamHold(const HtpBody *);
+int HtpBodyDetachStream(HtpBody *);
 void HtpBodyPrint(HtpBody *);
 void HtpBodyFree(HtpBody *);
 void HtpBodyPrune(HtpState *, HtpBody *, int);
@@ -0,0 +1,630 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Streaming decompression of HTTP response bodies.
+ *
+ * Bodies are decompressed as they arrive, one output buffer at a time,
+ * so memory use doesn't depend on the body size. The inflate and lzma
+ * states are kept per body so decompression resumes with the next
+ * packet. Idle decoder states are kept per thread and reused by the next
+ * body, which saves the (re)allocation of the decoder windows.
+ */
+
+#include "suricata-common.h"
+
+#include "app-layer-htp-decompress.h"
+#include "app-layer-htp-mem.h"
+
+#include "util-unittest.h"
+
+#include <zlib.h>
+#include <htp/lzma/LzmaDec.h>
+
+/** compression ratio above which the bomb limit applies, as in libhtp */
+#define HTP_DECOMPRESS_BOMB_RATIO       2048
+/** max idle decoder states kept per thread */
+#define HTP_DECOMPRESS_ZLIB_POOL_SIZE   16
+#define HTP_DECOMPRESS_LZMA_POOL_SIZE   2
+/** lzma-alone header: properties followed by the uncompressed size */
+#define HTP_LZMA_HEADER_SIZE            (LZMA_PROPS_SIZE + 8)
+
+enum HtpDecompressType {
+    HTP_DECOMPRESS_GZIP = 1,
+    HTP_DECOMPRESS_DEFLATE,
+    HTP_DECOMPRESS_LZMA,
+};
+
+typedef struct HtpZlibCtx_ {
+    z_stream z;
+    struct HtpZlibCtx_ *next;
+} HtpZlibCtx;
+
+typedef struct HtpLzmaCtx_ {
+    CLzmaDec state;
+    struct HtpLzmaCtx_ *next;
+} HtpLzmaCtx;
+
+typedef struct HtpDecompressLayer_ {
+    uint8_t type;
+    /** lzma header bytes seen so far */
+    uint8_t header_len;
+    uint8_t header[HTP_LZMA_HEADER_SIZE];
+    /** decoder state, set up on the first data of the layer */
+    HtpZlibCtx *zlib;
+    HtpLzmaCtx *lzma;
+} HtpDecompressLayer;
+
+struct HtpDecompressor_ {
+    uint32_t window;
+    uint32_t lzma_memlimit;
+    uint32_t bomb_limit;
+    uint8_t nlayers;
+    uint8_t done;
+    /** compressed bytes in, decompressed bytes out */
+    uint64_t in_total;
+    uint64_t out_total;
+    /** layer 0 is the outermost encoding */
+    HtpDecompressLayer layers[HTP_DECOMPRESS_MAX_LAYERS];
+};
+
+struct HtpDecompressThreadCtx_ {
+    HtpZlibCtx *zlib_pool;
+    HtpLzmaCtx *lzma_pool;
+    uint32_t zlib_pool_size;
+    uint32_t lzma_pool_size;
+    /** output buffers, HTP_DECOMPRESS_BUFFER_SIZE bytes per layer */
+    uint8_t *buffer;
+};
+
+static void *HtpSzAlloc(ISzAllocPtr p, size_t size) { return SCMalloc(size); }
+static void HtpSzFree(ISzAllocPtr p, void *address) { SCFree(address); }
+static const ISzAlloc htp_lzma_alloc = { HtpSzAlloc, HtpSzFree };
+
+HtpDecompressThreadCtx *HtpDecompressThreadCtxAlloc(void)
+{
+    return SCCalloc(1, sizeof(HtpDecompressThreadCtx));
+}
+
+void HtpDecompressThreadCtxFree(HtpDecompressThreadCtx *tctx)
+{
+    if (tctx == NULL)
+        return;
+
+    while (tctx->zlib_pool != NULL) {
+        HtpZlibCtx *c = tctx->zlib_pool;
+        tctx->zlib_pool = c->next;
+        inflateEnd(&c->z);
+        SCFree(c);
+    }
+    while (tctx->lzma_pool != NULL) {
+        HtpLzmaCtx *c = tctx->lzma_pool;
+        tctx->lzma_pool = c->next;
+        LzmaDec_Free(&c->state, &htp_lzma_alloc);
+        SCFree(c);
+    }
+    if (tctx->buffer != NULL)
+        SCFree(tctx->buffer);
+    SCFree(tctx);
+}
+
+static HtpZlibCtx *HtpZlibGet(HtpDecompressThreadCtx *tctx, int window_bits)
+{
+    HtpZlibCtx *c = tctx->zlib_pool;
+    if (c != NULL) {
+        tctx->zlib_pool = c->next;
+        tctx->zlib_pool_size--;
+        c->next = NULL;
+        if (inflateReset2(&c->z, window_bits) == Z_OK)
+            return c;
+        inflateEnd(&c->z);
+    } else {
+        c = SCCalloc(1, sizeof(*c));
+        if (unlikely(c == NULL))
+            return NULL;
+    }
+
+    memset(&c->z, 0, sizeof(c->z));
+    if (inflateInit2(&c->z, window_bits) != Z_OK) {
+        SCFree(c);
+        return NULL;
+    }
+    return c;
+}
+
+static void HtpZlibPut(HtpDecompressThreadCtx *tctx, HtpZlibCtx *c)
+{
+    if (tctx != NULL && tctx->zlib_pool_size < HTP_DECOMPRESS_ZLIB_POOL_SIZE) {
+        c->next = tctx->zlib_pool;
+        tctx->zlib_pool = c;
+        tctx->zlib_pool_size++;
+        return;
+    }
+    inflateEnd(&c->z);
+    SCFree(c);
+}
+
+static HtpLzmaCtx *HtpLzmaGet(HtpDecompressThreadCtx *tctx, const uint8_t *props)
+{
+    HtpLzmaCtx *c = tctx->lzma_pool;
+    if (c != NULL) {
+        tctx->lzma_pool = c->next;
+        tctx->lzma_pool_size--;
+        c->next = NULL;
+    } else {
+        c = SCCalloc(1, sizeof(*c));
+        if (unlikely(c == NULL))
+            return NULL;
+        LzmaDec_Construct(&c->state);
+    }
+
+    /* reuses the probabilities of the previous body if the properties
+     * match */
+    if (LzmaDec_Allocate(&c->state, props, LZMA_PROPS_SIZE, &htp_lzma_alloc) != SZ_OK) {
+        LzmaDec_Free(&c->state, &htp_lzma_alloc);
+        SCFree(c);
+        return NULL;
+    }
+    LzmaDec_Init(&c->state);
+    return c;
+}
+
+static void HtpLzmaPut(HtpDecompressThreadCtx *tctx, HtpLzmaCtx *c)
+{
+    if (tctx != NULL && tctx->lzma_pool_size < HTP_DECOMPRESS_LZMA_POOL_SIZE) {
+        c->next = tctx->lzma_pool;
+        tctx->lzma_pool = c;
+        tctx->lzma_pool_size++;
+        return;
+    }
+    LzmaDec_Free(&c->state, &htp_lzma_alloc);
+    SCFree(c);
+}
+
+static void HtpDecompressorReleaseLayers(HtpDecompressThreadCtx *tctx,
+        HtpDecompressor *d)
+{
+    for (uint8_t i = 0; i < d->nlayers; i++) {
+        HtpDecompressLayer *l = &d->layers[i];
+        if (l->zlib != NULL) {
+            HtpZlibPut(tctx, l->zlib);
+            l->zlib = NULL;
+        }
+        if (l->lzma != NULL) {
+            HtpLzmaPut(tctx, l->lzma);
+            l->lzma = NULL;
+        }
+    }
+}
+
+static int HtpDecompressTokenIs(const uint8_t *token, uint32_t len, const char *name)
+{
+    return (len == strlen(name) && strncasecmp((const char *)token, name, len) == 0);
+}
+
+/**
+ * \brief Set up a decompressor for a Content-Encoding header value
+ *
+ * \retval d decompressor or NULL if the body can't or shouldn't be
+ *           decompressed, e.g. for identity or unknown codings
+ */
+HtpDecompressor *HtpDecompressorNew(const HtpDecompressConfig *cfg,
+        const uint8_t *encoding, uint32_t encoding_len)
+{
+    uint8_t types[HTP_DECOMPRESS_MAX_LAYERS];
+    uint32_t n = 0;
+
+    if (cfg->layer_limit == 0)
+        return NULL;
+
+    const uint8_t *p = encoding;
+    const uint8_t *end = encoding + encoding_len;
+    while (p < end) {
+        while (p < end && (*p == ',' || isspace(*p)))
+            p++;
+        const uint8_t *token = p;
+        while (p < end && *p != ',' && !isspace(*p))
+            p++;
+        const uint32_t token_len = p - token;
+        if (token_len == 0)
+            continue;
+
+        uint8_t type;
+        if (HtpDecompressTokenIs(token, token_len, "gzip") ||
+                HtpDecompressTokenIs(token, token_len, "x-gzip")) {
+            type = HTP_DECOMPRESS_GZIP;
+        } else if (HtpDecompressTokenIs(token, token_len, "deflate") ||
+                HtpDecompressTokenIs(token, token_len, "x-deflate")) {
+            type = HTP_DECOMPRESS_DEFLATE;
+        } else if (HtpDecompressTokenIs(token, token_len, "lzma") &&
+                cfg->lzma_memlimit > 0) {
+            type = HTP_DECOMPRESS_LZMA;
+        } else if (HtpDecompressTokenIs(token, token_len, "identity")) {
+            continue;
+        } else {
+            /* coding we can't undo, leave the body as is */
+            return NULL;
+        }
+
+        /* codings are listed in the order they were applied, so only
+         * the last ones matter if there are too many */
+        if (n == HTP_DECOMPRESS_MAX_LAYERS) {
+            memmove(types, types + 1, n - 1);
+            n--;
+        }
+        types[n++] = type;
+    }
+    if (n == 0)
+        return NULL;
+
+    HtpDecompressor *d = HTPCalloc(1, sizeof(HtpDecompressor));
+    if (unlikely(d == NULL))
+        return NULL;
+
+    d->window = cfg->window;
+    d->lzma_memlimit = cfg->lzma_memlimit;
+    d->bomb_limit = cfg->bomb_limit;
+    d->nlayers = (uint8_t)MIN(n, cfg->layer_limit);
+    for (uint8_t i = 0; i < d->nlayers; i++) {
+        d->layers[i].type = types[n - 1 - i];
+    }
+    return d;
+}
+
+void HtpDecompressorFree(HtpDecompressThreadCtx *tctx, HtpDecompressor *d)
+{
+    if (d == NULL)
+        return;
+
+    HtpDecompressorReleaseLayers(tctx, d);
+    HTPFree(d, sizeof(HtpDecompressor));
+}
+
+static int HtpDecompressRun(HtpDecompressThreadCtx *tctx, HtpDecompressor *d,
+        uint8_t idx, const uint8_t *data, uint32_t len,
+        HtpDecompressOutputFunc Output, void *output_ctx);
+
+static int HtpDecompressOutput(HtpDecompressor *d, const uint8_t *data, uint32_t len,
+        HtpDecompressOutputFunc Output, void *output_ctx)
+{
+    if (d->window > 0) {
+        if (d->out_total >= d->window)
+            return HTP_DECOMPRESS_DONE;
+        if (d->out_total + len > d->window)
+            len = (uint32_t)(d->window - d->out_total);
+    }
+
+    d->out_total += len;
+    if (d->bomb_limit > 0 && d->out_total > d->bomb_limit &&
+            d->out_total > HTP_DECOMPRESS_BOMB_RATIO * d->in_total) {
+        SCLogDebug("compression bomb: %"PRIu64" bytes out of %"PRIu64,
+                d->out_total, d->in_total);
+        return HTP_DECOMPRESS_BOMB;
+    }
+
+    if (Output(output_ctx, data, len) != 0)
+        return HTP_DECOMPRESS_DONE;
+    if (d->window > 0 && d->out_total >= d->window)
+        return HTP_DECOMPRESS_DONE;
+    return HTP_DECOMPRESS_OK;
+}
+
+/** \internal
+ *  \brief check for a zlib header as described in RFC 1950 */
+static int HtpDecompressIsZlibHeader(const uint8_t *data, uint32_t len)
+{
+    if ((data[0] & 0x0f) != Z_DEFLATED || (data[0] >> 4) > 7)
+        return 0;
+    if (len >= 2 && ((data[0] << 8) | data[1]) % 31 != 0)
+        return 0;
+    return 1;
+}
+
+static int HtpDecompressZlib(HtpDecompressThreadCtx *tctx, HtpDecompressor *d,
+        uint8_t idx, const uint8_t *data, uint32_t len,
+        HtpDecompressOutputFunc Output, void *output_ctx)
+{
+    HtpDecompressLayer *l = &d->layers[idx];
+
+    if (l->zlib == NULL) {
+        /* gzip or zlib header */
+        int window_bits = 15 + 32;
+        /* deflate should be zlib wrapped, but raw deflate is common */
+        if (l->type == HTP_DECOMPRESS_DEFLATE) {
+            window_bits = HtpDecompressIsZlibHeader(data, len) ? 15 : -15;
+        }
+        l->zlib = HtpZlibGet(tctx, window_bits);
+        if (l->zlib == NULL)
+            return HTP_DECOMPRESS_ERROR;
+    }
+
+    uint8_t *out = tctx->buffer + idx * HTP_DECOMPRESS_BUFFER_SIZE;
+    z_stream *z = &l->zlib->z;
+    z->next_in = (Bytef *)data;
+    z->avail_in = len;
+    do {
+        z->next_out = out;
+        z->avail_out = HTP_DECOMPRESS_BUFFER_SIZE;
+
+        const int r = inflate(z, Z_NO_FLUSH);
+        const uint32_t produced = HTP_DECOMPRESS_BUFFER_SIZE - z->avail_out;
+        if (produced > 0) {
+            const int res = HtpDecompressRun(tctx, d, idx + 1, out, produced,
+                    Output, output_ctx);
+            if (res != HTP_DECOMPRESS_OK)
+                return res;
+        }
+        if (r == Z_STREAM_END)
+            return HTP_DECOMPRESS_DONE;
+        /* no progress possible until we get more input */
+        if (r == Z_BUF_ERROR)
+            break;
+        if (r != Z_OK) {
+            SCLogDebug("inflate failed: %d", r);
+            return HTP_DECOMPRESS_ERROR;
+        }
+    } while (z->avail_out == 0 || z->avail_in > 0);
+
+    return HTP_DECOMPRESS_OK;
+}
+
+static int HtpDecompressLzma(HtpDecompressThreadCtx *tctx, HtpDecompressor *d,
+        uint8_t idx, const uint8_t *data, uint32_t len,
+        HtpDecompressOutputFunc Output, void *output_ctx)
+{
+    HtpDecompressLayer *l = &d->layers[idx];
+
+    if (l->lzma == NULL) {
+        while (len > 0 && l->header_len < HTP_LZMA_HEADER_SIZE) {
+            l->header[l->header_len++] = *data++;
+            len--;
+        }
+        if (l->header_len < HTP_LZMA_HEADER_SIZE)
+            return HTP_DECOMPRESS_OK;
+
+        l->lzma = HtpLzmaGet(tctx, l->header);
+        if (l->lzma == NULL)
+            return HTP_DECOMPRESS_ERROR;
+    }
+
+    uint8_t *out = tctx->buffer + idx * HTP_DECOMPRESS_BUFFER_SIZE;
+    SizeT outprocessed;
+    do {
+        SizeT inprocessed = len;
+        ELzmaStatus status;
+        outprocessed = HTP_DECOMPRESS_BUFFER_SIZE;
+
+        const SRes r = LzmaDec_DecodeToBuf(&l->lzma->state, out, &outprocessed,
+                data, &inprocessed, LZMA_FINISH_ANY, &status, d->lzma_memlimit);
+        data += inprocessed;
+        len -= inprocessed;
+
+        if (outprocessed > 0) {
+            const int res = HtpDecompressRun(tctx, d, idx + 1, out,
+                    (uint32_t)outprocessed, Output, output_ctx);
+            if (res != HTP_DECOMPRESS_OK)
+                return res;
+        }
+        if (r == SZ_ERROR_MEM)
+            return HTP_DECOMPRESS_MEMLIMIT;
+        if (r != SZ_OK)
+            return HTP_DECOMPRESS_ERROR;
+        if (status == LZMA_STATUS_FINISHED_WITH_MARK)
+            return HTP_DECOMPRESS_DONE;
+        if (inprocessed == 0 && outprocessed == 0)
+            break;
+    } while (len > 0 || outprocessed == HTP_DECOMPRESS_BUFFER_SIZE);
+
+    return HTP_DECOMPRESS_OK;
+}
+
+static int HtpDecompressRun(HtpDecompressThreadCtx *tctx, HtpDecompressor *d,
+        uint8_t idx, const uint8_t *data, uint32_t len,
+        HtpDecompressOutputFunc Output, void *output_ctx)
+{
+    if (idx == d->nlayers)
+        return HtpDecompressOutput(d, data, len, Output, output_ctx);
+    if (d->layers[idx].type == HTP_DECOMPRESS_LZMA)
+        return HtpDecompressLzma(tctx, d, idx, data, len, Output, output_ctx);
+    return HtpDecompressZlib(tctx, d, idx, data, len, Output, output_ctx);
+}
+
+/**
+ * \brief Decompress the next part of a body
+ *
+ * Decompressed data is passed to Output in pieces of at most
+ * HTP_DECOMPRESS_BUFFER_SIZE bytes. Once anything but HTP_DECOMPRESS_OK
+ * is returned the decompressor is finished and its decoder states are
+ * returned to the thread for reuse.
+ *
+ * \retval result one of enum HtpDecompressResult
+ */
+int HtpDecompressorProcess(HtpDecompressThreadCtx *tctx, HtpDecompressor *d,
+        const uint8_t *data, uint32_t len,
+        HtpDecompressOutputFunc Output, void *output_ctx)
+{
+    if (d->done)
+        return HTP_DECOMPRESS_DONE;
+    if (len == 0)
+        return HTP_DECOMPRESS_OK;
+
+    if (tctx->buffer == NULL) {
+        tctx->buffer = SCMalloc(HTP_DECOMPRESS_MAX_LAYERS * HTP_DECOMPRESS_BUFFER_SIZE);
+        if (unlikely(tctx->buffer == NULL))
+            return HTP_DECOMPRESS_ERROR;
+    }
+
+    d->in_total += len;
+    const int r = HtpDecompressRun(tctx, d, 0, data, len, Output, output_ctx);
+    if (r != HTP_DECOMPRESS_OK) {
+        d->done = 1;
+        HtpDecompressorReleaseLayers(tctx, d);
+    }
+    return r;
+}
+
+#ifdef UNITTESTS
+typedef struct HtpDecompressTestOutput_ {
+    uint8_t *buf;
+    uint32_t len;
+    uint32_t size;
+    /** stop after this many bytes, 0 for no limit */
+    uint32_t stop;
+} HtpDecompressTestOutput;
+
+static int HtpDecompressTestOutputFunc(void *ctx, const uint8_t *data, uint32_t len)
+{
+    HtpDecompressTestOutput *o = ctx;
+    if (o->len + len > o->size)
+        return 1;
+    memcpy(o->buf + o->len, data, len);
+    o->len += len;
+    return (o->stop > 0 && o->len >= o->stop);
+}
+
+/** \internal
+ *  \brief compress with zlib, window_bits selects the wrapper */
+static uint32_t HtpDecompressTestCompress(const uint8_t *in, uint32_t in_len,
+        uint8_t *out, uint32_t out_size, int window_bits)
+{
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (deflateInit2(&z, Z_BEST_COMPRESSION, Z_DEFLATED, window_bits, 8,
+                Z_DEFAULT_STRATEGY) != Z_OK)
+        return 0;
+    z.next_in = (Bytef *)in;
+    z.avail_in = in_len;
+    z.next_out = out;
+    z.avail_out = out_size;
+    int r = deflate(&z, Z_FINISH);
+    uint32_t len = out_size - z.avail_out;
+    deflateEnd(&z);
+    return (r == Z_STREAM_END) ? len : 0;
+}
+
+/** \test gzip and raw deflate bodies decompressed in small pieces */
+static int HtpDecompressTest01(void)
+{
+    HtpDecompressConfig cfg = { .layer_limit = 2, .window = 0,
+        .lzma_memlimit = 0, .bomb_limit = 1048576 };
+    const uint32_t plain_len = 100000;
+    uint8_t *plain = SCMalloc(plain_len);
+    uint8_t *comp = SCMalloc(plain_len);
+    uint8_t *result = SCMalloc(plain_len);
+    FAIL_IF_NULL(plain);
+    FAIL_IF_NULL(comp);
+    FAIL_IF_NULL(result);
+    for (uint32_t i = 0; i < plain_len; i++)
+        plain[i] = "var suricata = function() { return 0; };\n"[i % 42] ^ (i % 251 == 0);
+
+    HtpDecompressThreadCtx *tctx = HtpDecompressThreadCtxAlloc();
+    FAIL_IF_NULL(tctx);
+
+    const char *encodings[] = { "gzip", "deflate" };
+    const int window_bits[] = { 15 + 16, -15 };
+    for (int t = 0; t < 2; t++) {
+        uint32_t comp_len = HtpDecompressTestCompress(plain, plain_len,
+                comp, plain_len, window_bits[t]);
+        FAIL_IF(comp_len == 0);
+
+        HtpDecompressor *d = HtpDecompressorNew(&cfg,
+                (const uint8_t *)encodings[t], strlen(encodings[t]));
+        FAIL_IF_NULL(d);
+
+        HtpDecompressTestOutput o = { result, 0, plain_len, 0 };
+        int r = HTP_DECOMPRESS_OK;
+        for (uint32_t offset = 0; offset < comp_len && r == HTP_DECOMPRESS_OK; offset += 100) {
+            r = HtpDecompressorProcess(tctx, d, comp + offset,
+                    MIN(100, comp_len - offset), HtpDecompressTestOutputFunc, &o);
+        }
+        FAIL_IF_NOT(r == HTP_DECOMPRESS_DONE);
+        FAIL_IF_NOT(o.len == plain_len);
+        FAIL_IF_NOT(memcmp(result, plain, plain_len) == 0);
+        HtpDecompressorFree(tctx, d);
+    }
+    /* both decoder states are waiting for reuse */
+    FAIL_IF_NOT(tctx->zlib_pool_size == 1);
+
+    HtpDecompressThreadCtxFree(tctx);
+    SCFree(plain);
+    SCFree(comp);
+    SCFree(result);
+    PASS;
+}
+
+/** \test window and output cutoff stop decompression early */
+static int HtpDecompressTest02(void)
+{
+    HtpDecompressConfig cfg = { .layer_limit = 2, .window = 20000,
+        .lzma_memlimit = 0, .bomb_limit = 1048576 };
+    const uint32_t plain_len = 100000;
+    uint8_t *plain = SCCalloc(1, plain_len);
+    uint8_t *comp = SCMalloc(plain_len);
+    uint8_t *result = SCMalloc(plain_len);
+    FAIL_IF_NULL(plain);
+    FAIL_IF_NULL(comp);
+    FAIL_IF_NULL(result);
+
+    uint32_t comp_len = HtpDecompressTestCompress(plain, plain_len,
+            comp, plain_len, 15 + 16);
+    FAIL_IF(comp_len == 0);
+
+    HtpDecompressThreadCtx *tctx = HtpDecompressThreadCtxAlloc();
+    FAIL_IF_NULL(tctx);
+
+    HtpDecompressor *d = HtpDecompressorNew(&cfg, (const uint8_t *)"x-gzip", 6);
+    FAIL_IF_NULL(d);
+    HtpDecompressTestOutput o = { result, 0, plain_len, 0 };
+    FAIL_IF_NOT(HtpDecompressorProcess(tctx, d, comp, comp_len,
+                HtpDecompressTestOutputFunc, &o) == HTP_DECOMPRESS_DONE);
+    FAIL_IF_NOT(o.len == cfg.window);
+    FAIL_IF_NOT(HtpDecompressorProcess(tctx, d, comp, comp_len,
+                HtpDecompressTestOutputFunc, &o) == HTP_DECOMPRESS_DONE);
+    FAIL_IF_NOT(o.len == cfg.window);
+    HtpDecompressorFree(tctx, d);
+
+    cfg.window = 0;
+    d = HtpDecompressorNew(&cfg, (const uint8_t *)"gzip", 4);
+    FAIL_IF_NULL(d);
+    HtpDecompressTestOutput o2 = { result, 0, plain_len, 1 };
+    FAIL_IF_NOT(HtpDecompressorProcess(tctx, d, comp, comp_len,
+                HtpDecompressTestOutputFunc, &o2) == HTP_DECOMPRESS_DONE);
+    FAIL_IF_NOT(o2.len == HTP_DECOMPRESS_BUFFER_SIZE);
+    HtpDecompressorFree(tctx, d);
+
+    /* nothing to do for these */
+    FAIL_IF_NOT_NULL(HtpDecompressorNew(&cfg, (const uint8_t *)"identity", 8));
+    FAIL_IF_NOT_NULL(HtpDecompressorNew(&cfg, (const uint8_t *)"gzip, br", 8));
+    FAIL_IF_NOT_NULL(HtpDecompressorNew(&cfg, (const uint8_t *)"lzma", 4));
+
+    HtpDecompressThreadCtxFree(tctx);
+    SCFree(plain);
+    SCFree(comp);
+    SCFree(result);
+    PASS;
+}
+#endif /* UNITTESTS */
+
+void HtpDecompressRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("HtpDecompressTest01", HtpDecompressTest01);
+    UtRegisterTest("HtpDecompressTest02", HtpDecompressTest02);
+#endif /* UNITTESTS */
+}
@@ -0,0 +1,70 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Streaming decompression of HTTP response bodies.
+ */
+
+#ifndef __APP_LAYER_HTP_DECOMPRESS_H__
+#define __APP_LAYER_HTP_DECOMPRESS_H__
+
+/** max number of Content-Encoding layers we can handle */
+#define HTP_DECOMPRESS_MAX_LAYERS       4
+/** size of the per thread output buffer of each layer */
+#define HTP_DECOMPRESS_BUFFER_SIZE      16384
+
+typedef struct HtpDecompressConfig_ {
+    /** max number of compression layers to decompress, 0 disables */
+    uint32_t layer_limit;
+    /** max decompressed bytes per body, 0 for no limit */
+    uint32_t window;
+    /** lzma dictionary memory limit, 0 disables lzma */
+    uint32_t lzma_memlimit;
+    /** max decompressed size with a compression ratio above 2048 */
+    uint32_t bomb_limit;
+} HtpDecompressConfig;
+
+/** results of HtpDecompressorProcess */
+enum HtpDecompressResult {
+    HTP_DECOMPRESS_OK = 0,  /**< input consumed, more expected */
+    HTP_DECOMPRESS_DONE,    /**< end of stream, window or cutoff reached */
+    HTP_DECOMPRESS_ERROR,   /**< invalid compressed data */
+    HTP_DECOMPRESS_MEMLIMIT,/**< lzma memory limit reached */
+    HTP_DECOMPRESS_BOMB,    /**< compression bomb limit reached */
+};
+
+/** output callback, returns 1 if no more data is wanted */
+typedef int (*HtpDecompressOutputFunc)(void *ctx, const uint8_t *data, uint32_t len);
+
+typedef struct HtpDecompressThreadCtx_ HtpDecompressThreadCtx;
+typedef struct HtpDecompressor_ HtpDecompressor;
+
+HtpDecompressThreadCtx *HtpDecompressThreadCtxAlloc(void);
+void HtpDecompressThreadCtxFree(HtpDecompressThreadCtx *tctx);
+
+HtpDecompressor *HtpDecompressorNew(const HtpDecompressConfig *cfg,
+        const uint8_t *encoding, uint32_t encoding_len);
+int HtpDecompressorProcess(HtpDecompressThreadCtx *tctx, HtpDecompressor *d,
+        const uint8_t *data, uint32_t len,
+        HtpDecompressOutputFunc Output, void *output_ctx);
+void HtpDecompressorFree(HtpDecompressThreadCtx *tctx, HtpDecompressor *d);
+
+void HtpDecompressRegisterTests(void);
+
+#endif /* __APP_LAYER_HTP_DECOMPRESS_H__ */
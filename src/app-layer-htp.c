@@ -357,6 +357,8 @@ static void HtpTxUserDataFree(HtpState *state, HtpTxUserData *htud)
     if (likely(htud)) {
         HtpBodyFree(&htud->request_body);
         HtpBodyFree(&htud->response_body);
+        HtpDecompressorFree(state ? state->decompress_tctx : NULL,
+                htud->response_decompressor);
         bstr_free(htud->request_uri_normalized);
         if (htud->request_headers_raw)
             HTPFree(htud->request_headers_raw, htud->request_headers_raw_len);
@@ -419,6 +421,77 @@ void HTPStateFree(void *state)
     SCReturn;
 }
 
+/**
+ *  \internal
+ *  \brief Get the tcp stream buffer zero copy bodies of a direction
+ *         reference, NULL if not enabled or not tcp
+ */
+static const StreamingBuffer *HTPGetBodyStreamBuffer(const HtpState *hstate,
+                                                     const int direction)
+{
+    if (!hstate->cfg->body_zero_copy || hstate->f == NULL ||
+        hstate->f->proto != IPPROTO_TCP || hstate->f->protoctx == NULL)
+        return NULL;
+    return StreamTcpReassemblyGetStreamingBuffer(hstate->f->protoctx, direction);
+}
+
+static bool AppLayerHtpCheckDepth(const HTPCfgDir *cfg, HtpBody *body, uint8_t flags);
+
+/**
+ *  \internal
+ *  \brief Tell the stream to keep the data zero copy bodies reference
+ *
+ *  The oldest tx with body chunks in the stream decides, as bodies of a
+ *  direction are in stream order. Txs done with the direction and not
+ *  holding data are skipped on the next update.
+ *
+ *  Bodies that are no longer tracked, because they reached their depth or
+ *  the stream stopped reassembly, get their own copy of the data they
+ *  still reference, so that the stream can release it.
+ */
+static void HTPUpdateBodyStreamHold(HtpState *hstate, const int direction)
+{
+    if (HTPGetBodyStreamBuffer(hstate, direction) == NULL)
+        return;
+
+    TcpSession *ssn = hstate->f->protoctx;
+    const int idx = (direction == STREAM_TOSERVER) ? 0 : 1;
+    const TcpStream *stream = (idx == 0) ? &ssn->client : &ssn->server;
+    const bool noreassembly = (stream->flags & STREAMTCP_STREAM_FLAG_NOREASSEMBLY);
+    const HTPCfgDir *cfg = (idx == 0) ? &hstate->cfg->request : &hstate->cfg->response;
+    const uint64_t total_txs = HTPStateGetTxCnt(hstate);
+    uint64_t hold = HTP_BODY_NO_STREAM_OFFSET;
+    bool skip = true;
+
+    for (uint64_t tx_id = hstate->body_hold_tx_id[idx]; tx_id < total_txs; tx_id++) {
+        htp_tx_t *tx = HTPStateGetTx(hstate, tx_id);
+        HtpTxUserData *htud = tx ? (HtpTxUserData *)htp_tx_get_user_data(tx) : NULL;
+        if (htud != NULL) {
+            HtpBody *body = (idx == 0) ? &htud->request_body : &htud->response_body;
+            const uint8_t flags = (idx == 0) ? htud->tsflags : htud->tcflags;
+            if (noreassembly || !AppLayerHtpCheckDepth(cfg, body, flags)) {
+                (void)HtpBodyDetachStream(body);
+            }
+            hold = HtpBodyGetStreamHold(body);
+            if (hold != HTP_BODY_NO_STREAM_OFFSET)
+                break;
+        }
+
+        const bool done = (tx == NULL) || (idx == 0 ?
+                tx->request_progress >= HTP_REQUEST_COMPLETE :
+                tx->response_progress >= HTP_RESPONSE_COMPLETE);
+        skip = skip && done;
+        if (skip)
+            hstate->body_hold_tx_id[idx] = tx_id + 1;
+    }
+
+    if (hold != HTP_BODY_NO_STREAM_OFFSET) {
+        StreamTcpReassemblySetAppHold(ssn, direction, hold);
+    } else {
+        StreamTcpReassemblyClearAppHold(ssn, direction);
+    }
+}
+
 /**
  *  \brief HTP transaction cleanup callback
  *
@@ -452,6 +525,10 @@ static void HTPStateTransactionFree(void *state, uint64_t id)
             tx->response_progress = HTP_RESPONSE_COMPLETE;
         }
         htp_tx_destroy(tx);
+
+        /* release the stream data the bodies of the tx referenced */
+        HTPUpdateBodyStreamHold(s, STREAM_TOSERVER);
+        HTPUpdateBodyStreamHold(s, STREAM_TOCLIENT);
     }
 }
 
@@ -873,6 +950,9 @@ static AppLayerResult HTPHandleRequestData(Flow *f, void *htp_state,
                 break;
         }
         HTPHandleError(hstate, STREAM_TOSERVER);
+        /* also check the other direction, it may have stopped reassembly */
+        HTPUpdateBodyStreamHold(hstate, STREAM_TOSERVER);
+        HTPUpdateBodyStreamHold(hstate, STREAM_TOCLIENT);
     }
 
     /* if the TCP connection is closed, then close the HTTP connection */
@@ -924,6 +1004,7 @@ static AppLayerResult HTPHandleResponseData(Flow *f, void *htp_state,
         }
     }
     DEBUG_VALIDATE_BUG_ON(hstate->connp == NULL);
+    hstate->decompress_tctx = local_data;
 
     htp_time_t ts = { f->lastts.tv_sec, f->lastts.tv_usec };
     if (input_len > 0) {
@@ -936,6 +1017,8 @@ static AppLayerResult HTPHandleResponseData(Flow *f, void *htp_state,
                 break;
         }
         HTPHandleError(hstate, STREAM_TOCLIENT);
+        HTPUpdateBodyStreamHold(hstate, STREAM_TOCLIENT);
+        HTPUpdateBodyStreamHold(hstate, STREAM_TOSERVER);
     }
 
     /* if we the TCP connection is closed, then close the HTTP connection */
@@ -945,6 +1028,7 @@ static AppLayerResult HTPHandleResponseData(Flow *f, void *htp_state,
         htp_connp_close(hstate->connp, &ts);
         hstate->flags |= HTP_FLAG_STATE_CLOSED_TC;
     }
+    hstate->decompress_tctx = NULL;
 
     SCLogDebug("hstate->connp %p", hstate->connp);
 
@@ -1886,7 +1970,13 @@ static int HTPCallbackRequestBodyData(htp_tx_data_t *d)
                                                      (uint32_t)d->len);
         BUG_ON(len > (uint32_t)d->len);
 
-        HtpBodyAppendChunk(&hstate->cfg->request, &tx_ud->request_body, d->data, len);
+        /* multipart parsing needs the body in one buffer */
+        if (tx_ud->request_body_type != HTP_BODY_REQUEST_MULTIPART) {
+            HtpBodyAppendChunkRef(&hstate->cfg->request, &tx_ud->request_body,
+                    HTPGetBodyStreamBuffer(hstate, STREAM_TOSERVER), d->data, len);
+        } else {
+            HtpBodyAppendChunk(&hstate->cfg->request, &tx_ud->request_body, d->data, len);
+        }
 
         const uint8_t *chunks_buffer = NULL;
         uint32_t chunks_buffer_len = 0;
@@ -1953,6 +2043,122 @@ end:
     SCReturnInt(HTP_OK);
 }
 
+/** \internal
+ *  \brief add response body data to the tx, store it in a file if needed
+ *
+ *  \param zero_copy data may be referenced in the tcp stream
+ *
+ *  \retval 1 body limits were already reached, no more data is needed
+ *  \retval 0 data was used
+ */
+static int HTPResponseBodyAppend(HtpState *hstate, HtpTxUserData *tx_ud,
+        htp_tx_t *tx, const uint8_t *data, uint32_t data_len, bool zero_copy)
+{
+    /* within limits, add the body chunk to the state. */
+    if (AppLayerHtpCheckDepth(&hstate->cfg->response, &tx_ud->response_body, tx_ud->tcflags)) {
+        uint32_t stream_depth = FileReassemblyDepth();
+        uint32_t len = AppLayerHtpComputeChunkLength(tx_ud->response_body.content_len_so_far,
+                                                     hstate->cfg->response.body_limit,
+                                                     stream_depth,
+                                                     tx_ud->tcflags,
+                                                     data_len);
+        BUG_ON(len > data_len);
+
+        if (zero_copy) {
+            HtpBodyAppendChunkRef(&hstate->cfg->response, &tx_ud->response_body,
+                    HTPGetBodyStreamBuffer(hstate, STREAM_TOCLIENT), data, len);
+        } else {
+            HtpBodyAppendChunk(&hstate->cfg->response, &tx_ud->response_body, data, len);
+        }
+
+        HtpResponseBodyHandle(hstate, tx_ud, tx, (uint8_t *)data, data_len);
+        return 0;
+    } else {
+        if (tx_ud->tcflags & HTP_FILENAME_SET) {
+            SCLogDebug("closing file that was being stored");
+            (void)HTPFileClose(hstate, NULL, 0, FILE_TRUNCATED, STREAM_TOCLIENT);
+            tx_ud->tcflags &= ~HTP_FILENAME_SET;
+        }
+        return 1;
+    }
+}
+
+typedef struct HTPResponseBodyCtx_ {
+    HtpState *hstate;
+    HtpTxUserData *tx_ud;
+    htp_tx_t *tx;
+} HTPResponseBodyCtx;
+
+static int HTPResponseBodyDecompressed(void *ctx, const uint8_t *data, uint32_t len)
+{
+    HTPResponseBodyCtx *c = ctx;
+    return HTPResponseBodyAppend(c->hstate, c->tx_ud, c->tx, data, len, false);
+}
+
+/** \internal
+ *  \brief set up our own decompression of the response body
+ *
+ *  libhtp's decompression is disabled in this mode, so the body data we
+ *  get is still encoded as the Content-Encoding header says.
+ */
+static void HTPResponseDecompressSetup(HtpState *hstate, HtpTxUserData *tx_ud,
+        htp_tx_t *tx)
+{
+    tx_ud->response_decompress = HTP_BODY_DECOMPRESS_RAW;
+
+    if (tx->response_headers == NULL)
+        return;
+    htp_header_t *h = htp_table_get_c(tx->response_headers, "content-encoding");
+    if (h == NULL || h->value == NULL)
+        return;
+
+    tx_ud->response_decompressor = HtpDecompressorNew(&hstate->cfg->decompress,
+            bstr_ptr(h->value), (uint32_t)bstr_len(h->value));
+    if (tx_ud->response_decompressor != NULL) {
+        tx_ud->response_decompress = HTP_BODY_DECOMPRESS_ACTIVE;
+    }
+}
+
+/** \internal
+ *  \brief decompress response body data, cutting off once the body limits
+ *         or the decompress window are reached */
+static void HTPResponseBodyDecompress(HtpState *hstate, HtpTxUserData *tx_ud,
+        htp_tx_t *tx, const uint8_t *data, uint32_t data_len)
+{
+    HTPResponseBodyCtx ctx = { hstate, tx_ud, tx };
+
+    const int r = HtpDecompressorProcess(hstate->decompress_tctx,
+            tx_ud->response_decompressor, data, data_len,
+            HTPResponseBodyDecompressed, &ctx);
+    if (r == HTP_DECOMPRESS_OK)
+        return;
+
+    HtpDecompressorFree(hstate->decompress_tctx, tx_ud->response_decompressor);
+    tx_ud->response_decompressor = NULL;
+
+    switch (r) {
+        case HTP_DECOMPRESS_ERROR:
+            /* like libhtp, pass the rest of the body on as is */
+            HTPSetEvent(hstate, tx_ud, STREAM_TOCLIENT,
+                    HTTP_DECODER_EVENT_GZIP_DECOMPRESSION_FAILED);
+            tx_ud->response_decompress = HTP_BODY_DECOMPRESS_RAW;
+            break;
+        case HTP_DECOMPRESS_MEMLIMIT:
+            HTPSetEvent(hstate, tx_ud, STREAM_TOCLIENT,
+                    HTTP_DECODER_EVENT_LZMA_MEMLIMIT_REACHED);
+            tx_ud->response_decompress = HTP_BODY_DECOMPRESS_DONE;
+            break;
+        case HTP_DECOMPRESS_BOMB:
+            HTPSetEvent(hstate, tx_ud, STREAM_TOCLIENT,
+                    HTTP_DECODER_EVENT_COMPRESSION_BOMB);
+            tx_ud->response_decompress = HTP_BODY_DECOMPRESS_DONE;
+            break;
+        default:
+            tx_ud->response_decompress = HTP_BODY_DECOMPRESS_DONE;
+            break;
+    }
+}
+
 /**
  * \brief Function callback to append chunks for Responses
  * \param d pointer to the htp_tx_data_t structure (a chunk from htp lib)
@@ -1997,27 +2203,20 @@ static int HTPCallbackResponseBodyData(htp_tx_data_t *d)
     SCLogDebug("tx_ud->response_body.content_len_so_far %"PRIu64, tx_ud->response_body.content_len_so_far);
     SCLogDebug("hstate->cfg->response.body_limit %u", hstate->cfg->response.body_limit);
 
-    /* within limits, add the body chunk to the state. */
-    if (AppLayerHtpCheckDepth(&hstate->cfg->response, &tx_ud->response_body, tx_ud->tcflags)) {
-        uint32_t stream_depth = FileReassemblyDepth();
-        uint32_t len = AppLayerHtpComputeChunkLength(tx_ud->response_body.content_len_so_far,
-                                                     hstate->cfg->response.body_limit,
-                                                     stream_depth,
-                                                     tx_ud->tcflags,
-                                                     (uint32_t)d->len);
-        BUG_ON(len > (uint32_t)d->len);
-
-        HtpBodyAppendChunk(&hstate->cfg->response, &tx_ud->response_body, d->data, len);
-
-        HtpResponseBodyHandle(hstate, tx_ud, d->tx, (uint8_t *)d->data, (uint32_t)d->len);
-    } else {
-        if (tx_ud->tcflags & HTP_FILENAME_SET) {
-            SCLogDebug("closing file that was being stored");
-            (void)HTPFileClose(hstate, NULL, 0, FILE_TRUNCATED, STREAM_TOCLIENT);
-            tx_ud->tcflags &= ~HTP_FILENAME_SET;
+    if (tx_ud->response_decompress == HTP_BODY_DECOMPRESS_INIT) {
+        if (hstate->cfg->body_decompress && hstate->decompress_tctx != NULL) {
+            HTPResponseDecompressSetup(hstate, tx_ud, d->tx);
+        } else {
+            tx_ud->response_decompress = HTP_BODY_DECOMPRESS_RAW;
         }
     }
 
+    if (tx_ud->response_decompress == HTP_BODY_DECOMPRESS_ACTIVE) {
+        HTPResponseBodyDecompress(hstate, tx_ud, d->tx, d->data, (uint32_t)d->len);
+    } else if (tx_ud->response_decompress == HTP_BODY_DECOMPRESS_RAW) {
+        (void)HTPResponseBodyAppend(hstate, tx_ud, d->tx, d->data, (uint32_t)d->len, true);
+    }
+
     if (hstate->conn != NULL) {
         SCLogDebug("checking body size %"PRIu64" against inspect limit %u (cur %"PRIu64", last %"PRIu64")",
                 tx_ud->response_body.content_len_so_far,
@@ -2209,6 +2408,9 @@ static int HTPCallbackResponse(htp_tx_t *tx)
             (void)HTPFileClose(hstate, NULL, 0, 0, STREAM_TOCLIENT);
             htud->tcflags &= ~HTP_FILENAME_SET;
         }
+        /* body is complete, let the next one reuse the decoders */
+        HtpDecompressorFree(hstate->decompress_tctx, htud->response_decompressor);
+        htud->response_decompressor = NULL;
     }
 
     /* response done, do raw reassembly now to inspect state and stream
@@ -2233,6 +2435,19 @@ static int HTPCallbackResponse(htp_tx_t *tx)
         }
     }
 
+    /* handle the h2c upgrade: after a 101 the connection continues
+     * with HTTP/2 frames, using stream 1 for the response to this
+     * request (RFC 7540, 3.2). */
+    if (tx->response_status_number == 101) {
+        htp_header_t *h = htp_table_get_c(tx->response_headers, "upgrade");
+        if (h != NULL && bstr_cmp_c_nocase(h->value, "h2c") == 0) {
+            /* same connection, so detect on the flow's port */
+            AppLayerRequestProtocolChange(hstate->f, 0, ALPROTO_HTTP2);
+            tx->request_progress = HTP_REQUEST_COMPLETE;
+            tx->response_progress = HTP_RESPONSE_COMPLETE;
+        }
+    }
+
     hstate->last_response_data_stamp = (uint64_t)hstate->conn->out_data_counter;
     SCReturnInt(HTP_OK);
 }
@@ -2401,6 +2616,10 @@ static void HTPConfigSetDefaultsPhase1(HTPCfgRec *cfg_prec)
     }
     cfg_prec->randomize_range = HTP_CONFIG_DEFAULT_RANDOMIZE_RANGE;
 
+    cfg_prec->decompress.layer_limit = HTP_CONFIG_DEFAULT_RESPONSE_DECOMPRESS_LAYER_LIMIT;
+    cfg_prec->decompress.lzma_memlimit = HTP_CONFIG_DEFAULT_LZMA_MEMLIMIT;
+    cfg_prec->decompress.bomb_limit = HTP_CONFIG_DEFAULT_COMPRESSION_BOMB_LIMIT;
+
     htp_config_register_request_header_data(cfg_prec->cfg, HTPCallbackRequestHeaderData);
     htp_config_register_request_trailer_data(cfg_prec->cfg, HTPCallbackRequestHeaderData);
     htp_config_register_response_header_data(cfg_prec->cfg, HTPCallbackResponseHeaderData);
@@ -2651,12 +2870,32 @@ static void HTPConfigParseParameters(HTPCfgRec *cfg_prec, ConfNode *s,
                            "from conf file - %s.  Killing engine", p->val);
                 exit(EXIT_FAILURE);
             }
+            cfg_prec->decompress.layer_limit = value;
 #ifdef HAVE_HTP_CONFIG_SET_RESPONSE_DECOMPRESSION_LAYER_LIMIT
             htp_config_set_response_decompression_layer_limit(cfg_prec->cfg, value);
 #else
             SCLogWarning(SC_WARN_OUTDATED_LIBHTP, "can't set response-body-decompress-layer-limit "
                     "to %u, libhtp version too old", value);
 #endif
+        } else if (strcasecmp("response-body-decompress-engine", p->name) == 0) {
+            if (strcasecmp("suricata", p->val) == 0) {
+                cfg_prec->body_decompress = 1;
+                htp_config_set_response_decompression(cfg_prec->cfg, 0);
+            } else if (strcasecmp("libhtp", p->val) == 0) {
+                cfg_prec->body_decompress = 0;
+                htp_config_set_response_decompression(cfg_prec->cfg, 1);
+            } else {
+                SCLogError(SC_ERR_INVALID_VALUE, "Invalid entry for "
+                           "response-body-decompress-engine: %s. "
+                           "Expected 'libhtp' or 'suricata'", p->val);
+                exit(EXIT_FAILURE);
+            }
+        } else if (strcasecmp("response-body-decompress-window", p->name) == 0) {
+            if (ParseSizeStringU32(p->val, &cfg_prec->decompress.window) < 0) {
+                SCLogError(SC_ERR_SIZE_PARSE, "Error parsing response-body-decompress-window "
+                           "from conf file - %s.  Killing engine", p->val);
+                exit(EXIT_FAILURE);
+            }
         } else if (strcasecmp("path-convert-backslash-separators", p->name) == 0) {
             htp_config_set_backslash_convert_slashes(cfg_prec->cfg,
                                                      HTP_DECODER_URL_PATH,
@@ -2752,11 +2991,13 @@ static void HTPConfigParseParameters(HTPCfgRec *cfg_prec, ConfNode *s,
             /* set default soft-limit with our new hard limit */
             SCLogConfig("Setting HTTP LZMA memory limit to %"PRIu32" bytes", limit);
             htp_config_set_lzma_memlimit(cfg_prec->cfg, (size_t)limit);
+            cfg_prec->decompress.lzma_memlimit = limit;
 #endif
 #ifdef HAVE_HTP_CONFIG_SET_LZMA_MEMLIMIT
         } else if (strcasecmp("lzma-enabled", p->name) == 0) {
             if (ConfValIsFalse(p->val)) {
                 htp_config_set_lzma_memlimit(cfg_prec->cfg, 0);
+                cfg_prec->decompress.lzma_memlimit = 0;
             }
 #endif
 #ifdef HAVE_HTP_CONFIG_SET_COMPRESSION_BOMB_LIMIT
@@ -2773,6 +3014,7 @@ static void HTPConfigParseParameters(HTPCfgRec *cfg_prec, ConfNode *s,
             /* set default soft-limit with our new hard limit */
             SCLogConfig("Setting HTTP compression bomb limit to %"PRIu32" bytes", limit);
             htp_config_set_compression_bomb_limit(cfg_prec->cfg, (size_t)limit);
+            cfg_prec->decompress.bomb_limit = limit;
 #endif
         } else if (strcasecmp("randomize-inspection-sizes", p->name) == 0) {
             if (!g_disable_randomness) {
@@ -2804,6 +3046,15 @@ static void HTPConfigParseParameters(HTPCfgRec *cfg_prec, ConfNode *s,
                     cfg_prec->http_body_inline = 0;
                 }
             }
+        } else if (strcasecmp("body-zero-copy", p->name) == 0) {
+            if (ConfValIsTrue(p->val)) {
+                cfg_prec->body_zero_copy = 1;
+            } else if (ConfValIsFalse(p->val)) {
+                cfg_prec->body_zero_copy = 0;
+            } else {
+                WarnInvalidConfEntry("body-zero-copy", "%s", "no");
+                cfg_prec->body_zero_copy = 0;
+            }
         } else if (strcasecmp("swf-decompression", p->name) == 0) {
             ConfNode *pval;
 
@@ -3159,6 +3410,24 @@ static int HTPRegisterPatternsForProtocolDetection(void)
     return 0;
 }
 
+/** per thread decompression contexts for response bodies */
+static void *HTPLocalStorageAlloc(void)
+{
+    HtpDecompressThreadCtx *tctx = HtpDecompressThreadCtxAlloc();
+    if (tctx == NULL) {
+        SCLogError(SC_ERR_MEM_ALLOC, "failed to allocate the http "
+                "decompression thread context");
+        exit(EXIT_FAILURE);
+    }
+    return tctx;
+}
+
+static void HTPLocalStorageFree(void *ptr)
+{
+    HtpDecompressThreadCtx *tctx = ptr;
+    HtpDecompressThreadCtxFree(tctx);
+}
+
 /**
  *  \brief  Register the HTTP protocol and state handling functions to APP layer
  *          of the engine.
@@ -3183,6 +3452,8 @@ void RegisterHTPParsers(void)
     if (AppLayerParserConfParserEnabled("tcp", proto_name)) {
         AppLayerParserRegisterStateFuncs(IPPROTO_TCP, ALPROTO_HTTP, HTPStateAlloc, HTPStateFree);
         AppLayerParserRegisterTxFreeFunc(IPPROTO_TCP, ALPROTO_HTTP, HTPStateTransactionFree);
+        AppLayerParserRegisterLocalStorageFunc(IPPROTO_TCP, ALPROTO_HTTP,
+                HTPLocalStorageAlloc, HTPLocalStorageFree);
         AppLayerParserRegisterGetFilesFunc(IPPROTO_TCP, ALPROTO_HTTP, HTPStateGetFiles);
         AppLayerParserRegisterGetStateProgressFunc(IPPROTO_TCP, ALPROTO_HTTP, HTPStateGetAlstateProgress);
         AppLayerParserRegisterGetTxCnt(IPPROTO_TCP, ALPROTO_HTTP, HTPStateGetTxCnt);
@@ -6115,6 +6386,91 @@ end:
     return result;
 }
 
+/** \test zero copy body chunks referencing stream data */
+static int HTPBodyZeroCopyTest01(void)
+{
+    StreamingBufferConfig cfg = STREAMING_BUFFER_CONFIG_INITIALIZER;
+    StreamingBuffer *stream_sb = StreamingBufferInit(&cfg);
+    FAIL_IF_NULL(stream_sb);
+    StreamingBufferSegment seg;
+    const uint8_t stream[] = "POST / HTTP/1.1\r\n\r\nabcdef\r\n3\r\nghi";
+    FAIL_IF(StreamingBufferAppend(stream_sb, &seg, stream, sizeof(stream) - 1) != 0);
+    const uint8_t *sdata = stream_sb->buf;
+
+    HtpBody body;
+    memset(&body, 0, sizeof(body));
+
+    /* "abc" and "def" are adjacent in the stream, "ghi" follows a chunk
+     * header, "jkl" isn't stream data */
+    const uint8_t other[] = "jkl";
+    FAIL_IF(HtpBodyAppendChunkRef(NULL, &body, stream_sb, sdata + 19, 3) != 0);
+    FAIL_IF(HtpBodyAppendChunkRef(NULL, &body, stream_sb, sdata + 22, 3) != 0);
+    FAIL_IF(HtpBodyAppendChunkRef(NULL, &body, stream_sb, sdata + 30, 3) != 0);
+    FAIL_IF(HtpBodyAppendChunkRef(NULL, &body, stream_sb, other, 3) != 0);
+    FAIL_IF(body.stream_sb != stream_sb);
+    FAIL_IF(body.sb != NULL);
+    FAIL_IF(body.content_len_so_far != 12);
+    FAIL_IF(HtpBodyGetStreamHold(&body) != 19);
+
+    const uint8_t *data = NULL;
+    uint32_t data_len = 0;
+    FAIL_IF(HtpBodyGetDataAtOffset(&body, 1, &data, &data_len) != 1);
+    FAIL_IF(data_len != 5 || memcmp(data, "bcdef", 5) != 0);
+    FAIL_IF(data != sdata + 20);
+    FAIL_IF(HtpBodyGetDataAtOffset(&body, 7, &data, &data_len) != 1);
+    FAIL_IF(data_len != 2 || memcmp(data, "hi", 2) != 0);
+    FAIL_IF(HtpBodyGetDataAtOffset(&body, 12, &data, &data_len) != 0);
+
+    uint8_t *gathered = NULL;
+    FAIL_IF(HtpBodyGetBufferedData(&body, &data, &data_len, &gathered) != 1);
+    FAIL_IF_NULL(gathered);
+    FAIL_IF(data_len != 12 || memcmp(data, "abcdefghijkl", 12) != 0);
+    SCFree(gathered);
+
+    HtpBodyFree(&body);
+    StreamingBufferFree(stream_sb);
+    PASS;
+}
+
+/** \test zero copy body starting at stream offset 0, detached from
+ *        the stream when it's no longer tracked */
+static int HTPBodyZeroCopyTest02(void)
+{
+    StreamingBufferConfig cfg = STREAMING_BUFFER_CONFIG_INITIALIZER;
+    StreamingBuffer *stream_sb = StreamingBufferInit(&cfg);
+    FAIL_IF_NULL(stream_sb);
+    StreamingBufferSegment seg;
+    const uint8_t stream[] = "abcdef";
+    FAIL_IF(StreamingBufferAppend(stream_sb, &seg, stream, sizeof(stream) - 1) != 0);
+    const uint8_t *sdata = stream_sb->buf;
+
+    HtpBody body;
+    memset(&body, 0, sizeof(body));
+
+    FAIL_IF(HtpBodyAppendChunkRef(NULL, &body, stream_sb, sdata, 3) != 0);
+    FAIL_IF(HtpBodyAppendChunkRef(NULL, &body, stream_sb, sdata + 3, 3) != 0);
+    FAIL_IF(body.stream_sb != stream_sb);
+    FAIL_IF(body.sb != NULL);
+    FAIL_IF_NOT_NULL(body.first->data);
+    FAIL_IF(HtpBodyGetStreamHold(&body) != 0);
+
+    FAIL_IF(HtpBodyDetachStream(&body) != 0);
+    FAIL_IF(HtpBodyGetStreamHold(&body) != HTP_BODY_NO_STREAM_OFFSET);
+
+    /* the data has to survive the stream buffer */
+    StreamingBufferFree(stream_sb);
+
+    const uint8_t *data = NULL;
+    uint32_t data_len = 0;
+    HtpBodyChunkGetData(&body, body.first, &data, &data_len);
+    FAIL_IF(data_len != 3 || memcmp(data, "abc", 3) != 0);
+    HtpBodyChunkGetData(&body, body.last, &data, &data_len);
+    FAIL_IF(data_len != 3 || memcmp(data, "def", 3) != 0);
+
+    HtpBodyFree(&body);
+    PASS;
+}
+
 /** \test BG crash */
 static int HTPSegvTest01(void)
 {
@@ -7472,6 +7828,8 @@ void HTPParserRegisterTests(void)
     UtRegisterTest("HTPParserDecodingTest09", HTPParserDecodingTest09);
 
     UtRegisterTest("HTPBodyReassemblyTest01", HTPBodyReassemblyTest01);
+    UtRegisterTest("HTPBodyZeroCopyTest01", HTPBodyZeroCopyTest01);
+    UtRegisterTest("HTPBodyZeroCopyTest02", HTPBodyZeroCopyTest02);
 
     UtRegisterTest("HTPSegvTest01", HTPSegvTest01);
 
@@ -7492,6 +7850,7 @@ void HTPParserRegisterTests(void)
 
     HTPFileParserRegisterTests();
     HTPXFFParserRegisterTests();
+    HtpDecompressRegisterTests();
 #endif /* UNITTESTS */
 }
 
@@ -36,6 +36,7 @@
 #include "util-radix-tree.h"
 #include "util-file.h"
 #include "app-layer-htp-mem.h"
+#include "app-layer-htp-decompress.h"
 #include "detect-engine-state.h"
 #include "util-streaming-buffer.h"
 
@@ -54,6 +55,7 @@
 /* default libhtp lzma limit, taken from libhtp. */
 #define HTP_CONFIG_DEFAULT_LZMA_MEMLIMIT                1048576U
 #define HTP_CONFIG_DEFAULT_COMPRESSION_BOMB_LIMIT       1048576U
+#define HTP_CONFIG_DEFAULT_RESPONSE_DECOMPRESS_LAYER_LIMIT  2U
 
 #define HTP_CONFIG_DEFAULT_RANDOMIZE                    1
 #define HTP_CONFIG_DEFAULT_RANDOMIZE_RANGE              10
@@ -78,6 +80,13 @@ enum {
     HTP_BODY_REQUEST_PUT,
 };
 
+enum {
+    HTP_BODY_DECOMPRESS_INIT = 0,   /* Content-Encoding not checked yet */
+    HTP_BODY_DECOMPRESS_RAW,        /* not compressed or failed, use as is */
+    HTP_BODY_DECOMPRESS_ACTIVE,
+    HTP_BODY_DECOMPRESS_DONE,       /* end or limits reached, skip the rest */
+};
+
 enum {
     /* libhtp errors/warnings */
     HTTP_DECODER_EVENT_UNKNOWN_ERROR,
@@ -159,6 +168,11 @@ typedef struct HTPCfgRec_ {
     int                 randomize;
     int                 randomize_range;
     int                 http_body_inline;
+    /** reference body data in the tcp stream instead of copying it */
+    int                 body_zero_copy;
+    /** decompress response bodies ourselves instead of in libhtp */
+    int                 body_decompress;
+    HtpDecompressConfig decompress;
 
     int                 swf_decompression_enabled;
     HtpSwfCompressType  swf_compression_type;
@@ -169,11 +183,21 @@ typedef struct HTPCfgRec_ {
     HTPCfgDir response;
 } HTPCfgRec;
 
+/** stream offset of body data that isn't in the tcp stream buffer */
+#define HTP_BODY_NO_STREAM_OFFSET   UINT64_MAX
+
 /** Struct used to hold chunks of a body on a request */
 struct HtpBodyChunk_ {
     struct HtpBodyChunk_ *next; /**< Pointer to the next chunk */
     int logged;
+    /** offset and length of the chunk in the body. For copied bodies
+     *  also its location in HtpBody::sb */
     StreamingBufferSegment sbseg;
+    /** zero copy bodies: absolute offset of the chunk data in the tcp
+     *  stream, HTP_BODY_NO_STREAM_OFFSET if the chunk has its own copy in
+     *  HtpBodyChunk::data */
+    uint64_t stream_offset;
+    uint8_t *data;
 } __attribute__((__packed__));
 typedef struct HtpBodyChunk_ HtpBodyChunk;
 
@@ -183,6 +207,9 @@ typedef struct HtpBody_ {
     HtpBodyChunk *last;  /**< Pointer to the last chunk */
 
     StreamingBuffer *sb;
+    /** tcp stream buffer the chunks point into for zero copy bodies,
+     *  NULL if the body data is copied into HtpBody::sb */
+    const StreamingBuffer *stream_sb;
 
     /* Holds the length of the htp request body seen so far */
     uint64_t content_len_so_far;
@@ -239,6 +266,10 @@ typedef struct HtpTxUserData_ {
 
     uint8_t request_body_type;
 
+    /** HTP_BODY_DECOMPRESS_* state of the response body */
+    uint8_t response_decompress;
+    HtpDecompressor *response_decompressor;
+
     DetectEngineState *de_state;
 } HtpTxUserData;
 
@@ -259,6 +290,11 @@ typedef struct HtpState_ {
     uint32_t file_track_id;             /**< used to assign file track ids to files */
     uint64_t last_request_data_stamp;
     uint64_t last_response_data_stamp;
+    /** oldest tx per direction that can have zero copy body chunks
+     *  holding tcp stream data. 0: request, 1: response */
+    uint64_t body_hold_tx_id[2];
+    /** thread's decompression context, only set while parsing */
+    HtpDecompressThreadCtx *decompress_tctx;
 } HtpState;
 
 /** part of the engine needs the request body (e.g. http_client_body keyword) */
@@ -0,0 +1,288 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * HTTP/2 application layer detector and parser. The parsing itself is
+ * done in Rust, see rust/src/http2.
+ *
+ */
+
+#include "suricata-common.h"
+
+#include "conf.h"
+#include "util-misc.h"
+#include "util-unittest.h"
+
+#include "app-layer-detect-proto.h"
+#include "app-layer-parser.h"
+#include "app-layer-http2.h"
+
+#include "rust-bindings.h"
+
+/** defaults of the limits in app-layer.protocols.http2 */
+#define HTTP2_DEFAULT_MAX_TABLE_SIZE    65536
+#define HTTP2_DEFAULT_MAX_HEADER_BLOCK  65536
+#define HTTP2_DEFAULT_BODY_LIMIT        102400
+#define HTTP2_DEFAULT_MAX_STREAMS       4096
+
+static uint32_t HTTP2ConfGetSize(const char *name, uint32_t def)
+{
+    char key[128];
+    const char *val = NULL;
+    uint32_t value = def;
+
+    snprintf(key, sizeof(key), "app-layer.protocols.http2.%s", name);
+    if (ConfGet(key, &val) == 1 && val != NULL) {
+        if (ParseSizeStringU32(val, &value) < 0) {
+            SCLogError(SC_ERR_SIZE_PARSE, "Error parsing %s "
+                       "from conf file - %s.  Killing engine", key, val);
+            exit(EXIT_FAILURE);
+        }
+    }
+    return value;
+}
+
+static void HTTP2ConfigureLimits(void)
+{
+    const uint32_t max_table_size = HTTP2ConfGetSize("max-table-size",
+            HTTP2_DEFAULT_MAX_TABLE_SIZE);
+    const uint32_t max_header_block = HTTP2ConfGetSize("max-header-block",
+            HTTP2_DEFAULT_MAX_HEADER_BLOCK);
+    const uint32_t body_limit = HTTP2ConfGetSize("body-limit",
+            HTTP2_DEFAULT_BODY_LIMIT);
+    const uint32_t max_streams = HTTP2ConfGetSize("max-streams",
+            HTTP2_DEFAULT_MAX_STREAMS);
+
+    SCLogConfig("HTTP2 max-table-size %u, max-header-block %u, "
+            "body-limit %u, max-streams %u", max_table_size,
+            max_header_block, body_limit, max_streams);
+    rs_http2_set_limits(max_table_size, max_header_block, body_limit,
+            max_streams);
+}
+
+static int HTTP2RegisterPatternsForProtocolDetection(void)
+{
+    /* prior knowledge: the client starts with the connection preface */
+    if (AppLayerProtoDetectPMRegisterPatternCS(IPPROTO_TCP, ALPROTO_HTTP2,
+                                               "PRI * HTTP/2.0|0d 0a 0d 0a|SM|0d 0a 0d 0a|",
+                                               24, 0, STREAM_TOSERVER) < 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+void HTTP2ParserRegisterTests(void);
+
+void RegisterHTTP2Parsers(void)
+{
+    HTTP2ConfigureLimits();
+    rs_http2_register_parser();
+    if (HTTP2RegisterPatternsForProtocolDetection() < 0)
+        return;
+#ifdef UNITTESTS
+    AppLayerParserRegisterProtocolUnittests(IPPROTO_TCP, ALPROTO_HTTP2,
+        HTTP2ParserRegisterTests);
+#endif
+}
+
+
+#ifdef UNITTESTS
+
+#include "stream-tcp.h"
+#include "detect.h"
+#include "detect-parse.h"
+#include "detect-engine.h"
+#include "detect-engine-alert.h"
+#include "util-unittest-helper.h"
+
+/* GET / and POST / with a body on streams 1 and 3 */
+static const uint8_t http2_request[] = {
+    /* preface */
+    0x50, 0x52, 0x49, 0x20, 0x2a, 0x20, 0x48, 0x54,
+    0x54, 0x50, 0x2f, 0x32, 0x2e, 0x30, 0x0d, 0x0a,
+    0x0d, 0x0a, 0x53, 0x4d, 0x0d, 0x0a, 0x0d, 0x0a,
+    /* SETTINGS */
+    0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00,
+    0x00,
+    /* HEADERS stream 1, END_HEADERS|END_STREAM */
+    0x00, 0x00, 0x11, 0x01, 0x05, 0x00, 0x00, 0x00,
+    0x01, 0x82, 0x86, 0x84, 0x41, 0x8c, 0xf1, 0xe3,
+    0xc2, 0xe5, 0xf2, 0x3a, 0x6b, 0xa0, 0xab, 0x90,
+    0xf4, 0xff,
+    /* HEADERS stream 3, END_HEADERS */
+    0x00, 0x00, 0x04, 0x01, 0x04, 0x00, 0x00, 0x00,
+    0x03, 0x83, 0x86, 0x84, 0xbe,
+    /* DATA stream 3, END_STREAM */
+    0x00, 0x00, 0x03, 0x00, 0x01, 0x00, 0x00, 0x00,
+    0x03, 0x61, 0x62, 0x63,
+};
+
+static int HTTP2ParserTest01(void)
+{
+    AppLayerParserThreadCtx *alp_tctx = AppLayerParserThreadCtxAlloc();
+    FAIL_IF_NULL(alp_tctx);
+
+    StreamTcpInitConfig(TRUE);
+    TcpSession ssn;
+    memset(&ssn, 0, sizeof(ssn));
+
+    Flow *f = UTHBuildFlow(AF_INET, "1.2.3.4", "1.2.3.5", 59001, 80);
+    FAIL_IF_NULL(f);
+    f->protoctx = &ssn;
+    f->proto = IPPROTO_TCP;
+    f->alproto = ALPROTO_HTTP2;
+
+    /* pass the data in two chunks, splitting a frame header */
+    int r = AppLayerParserParse(NULL, alp_tctx, f, ALPROTO_HTTP2,
+            STREAM_TOSERVER | STREAM_START, (uint8_t *)http2_request, 40);
+    FAIL_IF_NOT(r == 0);
+    r = AppLayerParserParse(NULL, alp_tctx, f, ALPROTO_HTTP2,
+            STREAM_TOSERVER, (uint8_t *)http2_request + 40,
+            sizeof(http2_request) - 40);
+    FAIL_IF_NOT(r == 0);
+
+    FAIL_IF_NOT(AppLayerParserGetTxCnt(f, f->alstate) == 2);
+
+    const uint8_t *b = NULL;
+    uint32_t b_len = 0;
+    void *tx = AppLayerParserGetTx(IPPROTO_TCP, ALPROTO_HTTP2, f->alstate, 0);
+    FAIL_IF_NULL(tx);
+    FAIL_IF_NOT(AppLayerParserGetStateProgress(IPPROTO_TCP, ALPROTO_HTTP2,
+                tx, STREAM_TOSERVER) == HTTP2_PROGRESS_COMPLETE);
+    FAIL_IF_NOT(rs_http2_tx_get_host(tx, &b, &b_len) == 1);
+    FAIL_IF_NOT(b_len == 15 && memcmp(b, "www.example.com", 15) == 0);
+
+    tx = AppLayerParserGetTx(IPPROTO_TCP, ALPROTO_HTTP2, f->alstate, 1);
+    FAIL_IF_NULL(tx);
+    FAIL_IF_NOT(rs_http2_tx_get_header_value(tx, STREAM_TOSERVER, ":method",
+                &b, &b_len) == 1);
+    FAIL_IF_NOT(b_len == 4 && memcmp(b, "POST", 4) == 0);
+    FAIL_IF_NOT(rs_http2_tx_get_body(tx, STREAM_TOSERVER, &b, &b_len) == 1);
+    FAIL_IF_NOT(b_len == 3 && memcmp(b, "abc", 3) == 0);
+    FAIL_IF_NOT(AppLayerParserGetStateProgress(IPPROTO_TCP, ALPROTO_HTTP2,
+                tx, STREAM_TOSERVER) == HTTP2_PROGRESS_COMPLETE);
+    FAIL_IF_NOT(AppLayerParserGetStateProgress(IPPROTO_TCP, ALPROTO_HTTP2,
+                tx, STREAM_TOCLIENT) == 0);
+
+    AppLayerParserThreadCtxFree(alp_tctx);
+    StreamTcpFreeConfig(TRUE);
+    UTHFreeFlow(f);
+
+    PASS;
+}
+
+/** \test http rules match HTTP/2 only if all their buffers can be
+ *        inspected in HTTP/2 */
+static int HTTP2DetectTest01(void)
+{
+    ThreadVars tv;
+    TcpSession ssn;
+    DetectEngineThreadCtx *det_ctx = NULL;
+    AppLayerParserThreadCtx *alp_tctx = AppLayerParserThreadCtxAlloc();
+    FAIL_IF_NULL(alp_tctx);
+
+    memset(&tv, 0, sizeof(tv));
+    memset(&ssn, 0, sizeof(ssn));
+
+    StreamTcpInitConfig(TRUE);
+
+    Flow *f = UTHBuildFlow(AF_INET, "1.2.3.4", "1.2.3.5", 59001, 80);
+    FAIL_IF_NULL(f);
+    f->protoctx = &ssn;
+    f->proto = IPPROTO_TCP;
+    f->alproto = ALPROTO_HTTP2;
+
+    Packet *p = UTHBuildPacket(NULL, 0, IPPROTO_TCP);
+    FAIL_IF_NULL(p);
+    p->flow = f;
+    p->flowflags |= FLOW_PKT_TOSERVER | FLOW_PKT_ESTABLISHED;
+    p->flags |= PKT_HAS_FLOW | PKT_STREAM_EST;
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+
+    Signature *s1 = DetectEngineAppendSig(de_ctx, "alert http any any -> any any "
+            "(http.method; content:\"POST\"; sid:1;)");
+    FAIL_IF_NULL(s1);
+    FAIL_IF_NOT(s1->flags & SIG_FLAG_HTTP2);
+    /* http.cookie has no HTTP/2 engine */
+    Signature *s2 = DetectEngineAppendSig(de_ctx, "alert http any any -> any any "
+            "(http.method; content:\"POST\"; http.cookie; content:\"session\"; sid:2;)");
+    FAIL_IF_NULL(s2);
+    FAIL_IF(s2->flags & SIG_FLAG_HTTP2);
+
+    SigGroupBuild(de_ctx);
+    DetectEngineThreadCtxInit(&tv, (void *)de_ctx, (void *)&det_ctx);
+
+    int r = AppLayerParserParse(NULL, alp_tctx, f, ALPROTO_HTTP2,
+            STREAM_TOSERVER | STREAM_START, (uint8_t *)http2_request,
+            sizeof(http2_request));
+    FAIL_IF_NOT(r == 0);
+
+    SigMatchSignatures(&tv, de_ctx, det_ctx, p);
+    FAIL_IF_NOT(PacketAlertCheck(p, 1));
+    FAIL_IF(PacketAlertCheck(p, 2));
+
+    AppLayerParserThreadCtxFree(alp_tctx);
+    DetectEngineThreadCtxDeinit(&tv, (void *)det_ctx);
+    DetectEngineCtxFree(de_ctx);
+    StreamTcpFreeConfig(TRUE);
+    UTHFreePacket(p);
+    UTHFreeFlow(f);
+    PASS;
+}
+
+/** \test http2 rules can't use buffers that have no HTTP/2 engine */
+static int HTTP2DetectTest02(void)
+{
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+
+    Signature *s = DetectEngineAppendSig(de_ctx, "alert http2 any any -> any any "
+            "(http.method; content:\"POST\"; sid:1;)");
+    FAIL_IF_NULL(s);
+    FAIL_IF_NOT(s->alproto == ALPROTO_HTTP2);
+
+    s = DetectEngineAppendSig(de_ctx, "alert http2 any any -> any any "
+            "(http.cookie; content:\"session\"; sid:2;)");
+    FAIL_IF_NOT_NULL(s);
+
+    /* the :path is only available as the raw uri */
+    s = DetectEngineAppendSig(de_ctx, "alert http2 any any -> any any "
+            "(http.uri.raw; content:\"/index\"; sid:3;)");
+    FAIL_IF_NULL(s);
+    s = DetectEngineAppendSig(de_ctx, "alert http2 any any -> any any "
+            "(http.uri; content:\"/index\"; sid:4;)");
+    FAIL_IF_NOT_NULL(s);
+
+    DetectEngineCtxFree(de_ctx);
+    PASS;
+}
+
+void HTTP2ParserRegisterTests(void)
+{
+    UtRegisterTest("HTTP2ParserTest01", HTTP2ParserTest01);
+    UtRegisterTest("HTTP2DetectTest01", HTTP2DetectTest01);
+    UtRegisterTest("HTTP2DetectTest02", HTTP2DetectTest02);
+}
+
+#endif
@@ -66,6 +66,7 @@
 #include "app-layer-snmp.h"
 #include "app-layer-sip.h"
 #include "app-layer-rfb.h"
+#include "app-layer-http2.h"
 #include "app-layer-template.h"
 #include "app-layer-template-rust.h"
 #include "app-layer-rdp.h"
@@ -185,6 +186,9 @@ void UTHAppLayerParserStateGetIds(void *ptr, uint64_t *i1, uint64_t *i2, uint64_
  * Post 2.0 let's look at changing this to move it out to app-layer.c. */
 static AppLayerParserCtx alp_ctx;
 
+/** memory of all transaction arena chunks, incl. the thread caches */
+SC_ATOMIC_DECLARE(uint64_t, tx_arena_memuse);
+
 int AppLayerParserProtoIsRegistered(uint8_t ipproto, AppProto alproto)
 {
     uint8_t ipproto_map = FlowGetProtoMapping(ipproto);
@@ -220,6 +224,7 @@ int AppLayerParserSetup(void)
 {
     SCEnter();
     memset(&alp_ctx, 0, sizeof(alp_ctx));
+    SC_ATOMIC_INIT(tx_arena_memuse);
     SCReturnInt(0);
 }
 
@@ -246,10 +251,219 @@ int AppLayerParserDeSetup(void)
 
     FTPParserCleanup();
     SMTPParserCleanup();
+    SSLParserCleanup();
 
     SCReturnInt(0);
 }
 
+/***** Transaction memory arena *****/
+
+/* Arena memory is handed out in chunks. Chunks of the default size are
+ * recycled through a small per thread cache, so that a transaction that
+ * fits in one chunk costs neither a malloc nor a free in the common case.
+ * Larger allocations get a chunk of their own. */
+#define TX_ARENA_CHUNK_SIZE     1024
+#define TX_ARENA_ALIGN          8
+#define TX_ARENA_CACHE_MAX      64
+
+typedef struct AppLayerTxArenaChunk_ {
+    struct AppLayerTxArenaChunk_ *next;
+    uint32_t size;  /**< size of data */
+    uint32_t used;
+    uint8_t data[] __attribute__((aligned(TX_ARENA_ALIGN)));
+} AppLayerTxArenaChunk;
+
+struct AppLayerTxArena_ {
+    /** chunk to allocate from, the full ones follow */
+    AppLayerTxArenaChunk *head;
+    const AppLayerTxArenaMemcap *memcap;
+    /** memory accounted to memcap */
+    uint64_t memuse;
+};
+
+#define TX_ARENA_ALIGN_SIZE(s) (((s) + (TX_ARENA_ALIGN - 1)) & ~((size_t)TX_ARENA_ALIGN - 1))
+
+#ifdef TLS
+typedef struct AppLayerTxArenaCache_ {
+    AppLayerTxArenaChunk *head;
+    uint32_t len;
+    /** only threads that set up the cache use it: flows can
+     *  also be freed by threads that never allocate */
+    uint32_t users;
+} AppLayerTxArenaCache;
+
+static __thread AppLayerTxArenaCache tx_arena_cache;
+#endif
+
+static void AppLayerTxArenaThreadInit(void)
+{
+#ifdef TLS
+    tx_arena_cache.users++;
+#endif
+}
+
+static void AppLayerTxArenaThreadDeinit(void)
+{
+#ifdef TLS
+    if (tx_arena_cache.users == 0 || --tx_arena_cache.users > 0)
+        return;
+
+    AppLayerTxArenaChunk *c = tx_arena_cache.head;
+    while (c != NULL) {
+        AppLayerTxArenaChunk *next = c->next;
+        (void)SC_ATOMIC_SUB(tx_arena_memuse, sizeof(*c) + c->size);
+        SCFree(c);
+        c = next;
+    }
+    tx_arena_cache.head = NULL;
+    tx_arena_cache.len = 0;
+#endif
+}
+
+static AppLayerTxArenaChunk *AppLayerTxArenaChunkGet(AppLayerTxArena *arena, size_t size)
+{
+    if (unlikely(size > UINT32_MAX))
+        return NULL;
+    const size_t chunk_size = MAX(size, TX_ARENA_CHUNK_SIZE);
+
+    if (arena != NULL && arena->memcap != NULL &&
+            arena->memcap->CheckMemcap(sizeof(AppLayerTxArenaChunk) + chunk_size) == 0)
+        return NULL;
+
+    AppLayerTxArenaChunk *c = NULL;
+#ifdef TLS
+    if (chunk_size == TX_ARENA_CHUNK_SIZE && tx_arena_cache.head != NULL) {
+        c = tx_arena_cache.head;
+        tx_arena_cache.head = c->next;
+        tx_arena_cache.len--;
+    }
+#endif
+    if (c == NULL) {
+        c = SCMalloc(sizeof(*c) + chunk_size);
+        if (unlikely(c == NULL))
+            return NULL;
+        c->size = (uint32_t)chunk_size;
+        (void)SC_ATOMIC_ADD(tx_arena_memuse, sizeof(*c) + chunk_size);
+    }
+    c->next = NULL;
+    c->used = 0;
+
+    if (arena != NULL && arena->memcap != NULL) {
+        arena->memcap->IncrMemuse(sizeof(*c) + chunk_size);
+        arena->memuse += sizeof(*c) + chunk_size;
+    }
+    return c;
+}
+
+static void AppLayerTxArenaChunkPut(AppLayerTxArenaChunk *c)
+{
+#ifdef TLS
+    if (c->size == TX_ARENA_CHUNK_SIZE && tx_arena_cache.users > 0 &&
+            tx_arena_cache.len < TX_ARENA_CACHE_MAX) {
+        c->next = tx_arena_cache.head;
+        tx_arena_cache.head = c;
+        tx_arena_cache.len++;
+        return;
+    }
+#endif
+    (void)SC_ATOMIC_SUB(tx_arena_memuse, sizeof(*c) + c->size);
+    SCFree(c);
+}
+
+/**
+ *  \brief create a new arena
+ *
+ *  The arena itself lives in its first chunk.
+ *
+ *  \param memcap optional memcap callbacks of the protocol, the memory of
+ *                all chunks used by the arena is accounted to them
+ */
+AppLayerTxArena *AppLayerTxArenaCreate(const AppLayerTxArenaMemcap *memcap)
+{
+    AppLayerTxArena tmp = { NULL, memcap, 0 };
+
+    AppLayerTxArenaChunk *c = AppLayerTxArenaChunkGet(&tmp, 0);
+    if (c == NULL)
+        return NULL;
+
+    AppLayerTxArena *arena = (AppLayerTxArena *)c->data;
+    *arena = tmp;
+    arena->head = c;
+    c->used = TX_ARENA_ALIGN_SIZE(sizeof(*arena));
+    return arena;
+}
+
+/**
+ *  \brief allocate memory from the arena
+ *
+ *  Memory is returned 8 byte aligned and can't be freed on its own, it is
+ *  released by AppLayerTxArenaDestroy().
+ */
+void *AppLayerTxArenaAlloc(AppLayerTxArena *arena, size_t size)
+{
+    AppLayerTxArenaChunk *c = arena->head;
+
+    size = TX_ARENA_ALIGN_SIZE(size);
+    if (likely(c->size - c->used >= size)) {
+        void *ptr = c->data + c->used;
+        c->used += size;
+        return ptr;
+    }
+
+    AppLayerTxArenaChunk *nc = AppLayerTxArenaChunkGet(arena, size);
+    if (nc == NULL)
+        return NULL;
+    nc->used = size;
+
+    if (nc->size - size < c->size - c->used) {
+        /* dedicated chunk, keep allocating from the current one */
+        nc->next = c->next;
+        c->next = nc;
+    } else {
+        nc->next = c;
+        arena->head = nc;
+    }
+    return nc->data;
+}
+
+void *AppLayerTxArenaCalloc(AppLayerTxArena *arena, size_t nmemb, size_t size)
+{
+    if (size != 0 && nmemb > SIZE_MAX / size)
+        return NULL;
+
+    void *ptr = AppLayerTxArenaAlloc(arena, nmemb * size);
+    if (ptr != NULL)
+        memset(ptr, 0, nmemb * size);
+    return ptr;
+}
+
+/**
+ *  \brief release all memory of the arena
+ *
+ *  The chunks go back to the thread's cache where possible.
+ */
+void AppLayerTxArenaDestroy(AppLayerTxArena *arena)
+{
+    if (arena == NULL)
+        return;
+
+    if (arena->memcap != NULL)
+        arena->memcap->DecrMemuse(arena->memuse);
+
+    /* the arena is in one of the chunks, so read it first */
+    AppLayerTxArenaChunk *c = arena->head;
+    while (c != NULL) {
+        AppLayerTxArenaChunk *next = c->next;
+        AppLayerTxArenaChunkPut(c);
+        c = next;
+    }
+}
+
+uint64_t AppLayerTxArenaMemuseGlobalCounter(void)
+{
+    return SC_ATOMIC_GET(tx_arena_memuse);
+}
+
 AppLayerParserThreadCtx *AppLayerParserThreadCtxAlloc(void)
 {
     SCEnter();
@@ -263,6 +477,8 @@ AppLayerParserThreadCtx *AppLayerParserThreadCtxAlloc(void)
         goto end;
     memset(tctx, 0, sizeof(*tctx));
 
+    AppLayerTxArenaThreadInit();
+
     for (flow_proto = 0; flow_proto < FLOW_PROTO_DEFAULT; flow_proto++) {
         for (alproto = 0; alproto < ALPROTO_MAX; alproto++) {
             uint8_t ipproto = FlowGetReverseProtoMapping(flow_proto);
@@ -292,6 +508,8 @@ void AppLayerParserThreadCtxFree(AppLayerParserThreadCtx *tctx)
         }
     }
 
+    AppLayerTxArenaThreadDeinit();
+
     SCFree(tctx);
     SCReturn;
 }
@@ -1587,6 +1805,7 @@ void AppLayerParserRegisterProtocolParsers(void)
     RegisterRFBParsers();
     RegisterTemplateParsers();
     RegisterRdpParsers();
+    RegisterHTTP2Parsers();
 
     /** IMAP */
     AppLayerProtoDetectRegisterProtocol(ALPROTO_IMAP, "imap");
@@ -1850,6 +2069,76 @@ static int AppLayerParserTest02(void)
     return result;
 }
 
+static uint64_t arena_test_memuse = 0;
+static uint64_t arena_test_memcap = 0;
+
+static int ArenaTestCheckMemcap(uint64_t size)
+{
+    return (arena_test_memuse + size <= arena_test_memcap);
+}
+
+static void ArenaTestIncrMemuse(uint64_t size)
+{
+    arena_test_memuse += size;
+}
+
+static void ArenaTestDecrMemuse(uint64_t size)
+{
+    arena_test_memuse -= size;
+}
+
+/** \test transaction arena allocations, chunk reuse and memcap */
+static int AppLayerParserTest03(void)
+{
+    const AppLayerTxArenaMemcap mc = { ArenaTestCheckMemcap,
+        ArenaTestIncrMemuse, ArenaTestDecrMemuse };
+    arena_test_memuse = 0;
+    arena_test_memcap = 3 * (sizeof(AppLayerTxArenaChunk) + TX_ARENA_CHUNK_SIZE);
+
+    AppLayerParserThreadCtx *alp_tctx = AppLayerParserThreadCtxAlloc();
+    FAIL_IF_NULL(alp_tctx);
+
+    AppLayerTxArena *arena = AppLayerTxArenaCreate(&mc);
+    FAIL_IF_NULL(arena);
+    FAIL_IF(arena_test_memuse != sizeof(AppLayerTxArenaChunk) + TX_ARENA_CHUNK_SIZE);
+
+    /* small allocs are aligned and come from the first chunk */
+    uint8_t *p1 = AppLayerTxArenaAlloc(arena, 3);
+    uint8_t *p2 = AppLayerTxArenaCalloc(arena, 1, 10);
+    FAIL_IF_NULL(p1);
+    FAIL_IF_NULL(p2);
+    FAIL_IF(((uintptr_t)p1 % TX_ARENA_ALIGN) || ((uintptr_t)p2 % TX_ARENA_ALIGN));
+    FAIL_IF(p2 != p1 + TX_ARENA_ALIGN);
+    for (int i = 0; i < 10; i++)
+        FAIL_IF(p2[i] != 0);
+    FAIL_IF(arena_test_memuse != sizeof(AppLayerTxArenaChunk) + TX_ARENA_CHUNK_SIZE);
+
+    /* too large for the current chunk: a second one */
+    uint8_t *p3 = AppLayerTxArenaAlloc(arena, TX_ARENA_CHUNK_SIZE - 16);
+    FAIL_IF_NULL(p3);
+    memset(p3, 0xff, TX_ARENA_CHUNK_SIZE - 16);
+    FAIL_IF(arena_test_memuse != 2 * (sizeof(AppLayerTxArenaChunk) + TX_ARENA_CHUNK_SIZE));
+
+    /* over the memcap */
+    FAIL_IF_NOT_NULL(AppLayerTxArenaAlloc(arena, 4 * TX_ARENA_CHUNK_SIZE));
+
+    /* the first chunk is still used for small allocs */
+    uint8_t *p4 = AppLayerTxArenaAlloc(arena, 16);
+    FAIL_IF_NULL(p4);
+    FAIL_IF(p4 != p2 + 16);
+
+    AppLayerTxArenaDestroy(arena);
+    FAIL_IF(arena_test_memuse != 0);
+
+    /* chunks are reused through the thread cache */
+    arena = AppLayerTxArenaCreate(&mc);
+    FAIL_IF_NULL(arena);
+    FAIL_IF(arena_test_memuse != sizeof(AppLayerTxArenaChunk) + TX_ARENA_CHUNK_SIZE);
+    AppLayerTxArenaDestroy(arena);
+
+    AppLayerParserThreadCtxFree(alp_tctx);
+    PASS;
+}
 
 void AppLayerParserRegisterUnittests(void)
 {
@@ -1870,6 +2159,7 @@ void AppLayerParserRegisterUnittests(void)
 
     UtRegisterTest("AppLayerParserTest01", AppLayerParserTest01);
     UtRegisterTest("AppLayerParserTest02", AppLayerParserTest02);
+    UtRegisterTest("AppLayerParserTest03", AppLayerParserTest03);
 
     SCReturn;
 }
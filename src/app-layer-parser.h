@@ -93,6 +93,30 @@ AppLayerParserThreadCtx *AppLayerParserThreadCtxAlloc(void);
  */
 void AppLayerParserThreadCtxFree(AppLayerParserThreadCtx *tctx);
 
+/***** transaction memory arena *****/
+
+/**
+ * \brief Memory arena for a transaction and the objects hanging off it.
+ *
+ *  Parsers can opt in to allocate a transaction from an arena so that all
+ *  of its memory is released at once when the transaction is freed.
+ */
+typedef struct AppLayerTxArena_ AppLayerTxArena;
+
+/** \brief memcap callbacks of a protocol, see FTPCheckMemcap() for an
+ *         example. CheckMemcap returns 1 if the size is in bounds. */
+typedef struct AppLayerTxArenaMemcap_ {
+    int (*CheckMemcap)(uint64_t size);
+    void (*IncrMemuse)(uint64_t size);
+    void (*DecrMemuse)(uint64_t size);
+} AppLayerTxArenaMemcap;
+
+AppLayerTxArena *AppLayerTxArenaCreate(const AppLayerTxArenaMemcap *memcap);
+void *AppLayerTxArenaAlloc(AppLayerTxArena *arena, size_t size);
+void *AppLayerTxArenaCalloc(AppLayerTxArena *arena, size_t nmemb, size_t size);
+void AppLayerTxArenaDestroy(AppLayerTxArena *arena);
+uint64_t AppLayerTxArenaMemuseGlobalCounter(void);
+
 /**
  * \brief Given a protocol name, checks if the parser is enabled in
  *        the conf file.
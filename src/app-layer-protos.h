@@ -55,6 +55,7 @@ enum AppProtoEnum {
     ALPROTO_TEMPLATE,
     ALPROTO_TEMPLATE_RUST,
     ALPROTO_RDP,
+    ALPROTO_HTTP2,
 
     /* used by the probing parser when alproto detection fails
      * permanently for that particular stream */
@@ -75,6 +76,24 @@ static inline bool AppProtoIsValid(AppProto a)
     return ((a > ALPROTO_UNKNOWN && a < ALPROTO_FAILED));
 }
 
+/**
+ * \brief Check if a signature's app layer protocol matches a flow's.
+ *
+ * HTTP keywords can be used in HTTP/2 signatures and HTTP signatures can
+ * apply to HTTP/2 flows. The signature decides if they do, see
+ * SignatureAppProtoMatches().
+ *
+ * \param sigproto Signature app layer protocol.
+ * \param alproto  Flow app layer protocol.
+ */
+static inline bool AppProtoEquals(AppProto sigproto, AppProto alproto)
+{
+    if (sigproto == ALPROTO_HTTP) {
+        return (alproto == ALPROTO_HTTP || alproto == ALPROTO_HTTP2);
+    }
+    return (sigproto == alproto);
+}
+
 /**
  * \brief Maps the ALPROTO_*, to its string equivalent.
  *
@@ -56,6 +56,7 @@
 #include "util-mem.h"
 #include "util-misc.h"
 #include "util-validate.h"
+#include "runmodes.h"
 
 /* content-limit default value */
 #define FILEDATA_CONTENT_LIMIT 100000
@@ -236,9 +237,12 @@ SCEnumCharMap smtp_reply_map[ ] = {
 };
 
 /* Create SMTP config structure */
-SMTPConfig smtp_config = { 0, { 0, 0, 0, 0, 0 }, 0, 0, 0, 0, STREAMING_BUFFER_CONFIG_INITIALIZER};
+SMTPConfig smtp_config = { 0, 0, { 0, 0, 0, 0, 0 }, 0, 0, 0, 0, STREAMING_BUFFER_CONFIG_INITIALIZER};
 
-static SMTPString *SMTPStringAlloc(void);
+/* MIME bodies needed by rules, see SMTPNeedFileInspection() */
+SC_ATOMIC_DECLARE(uint32_t, smtp_mime_body_flags);
+
+static SMTPString *SMTPStringAlloc(SMTPTransaction *tx);
 
 /**
  * \brief Configure SMTP Mime Decoder by parsing out mime section of YAML
@@ -263,6 +267,11 @@ static void SMTPConfigure(void) {
             smtp_config.decode_mime = val;
         }
 
+        ret = ConfGetChildValueBool(config, "skip-uninspected-bodies", &val);
+        if (ret) {
+            smtp_config.skip_bodies = val;
+        }
+
         ret = ConfGetChildValueBool(config, "decode-base64", &val);
         if (ret) {
             smtp_config.mime_config.decode_base64 = val;
@@ -361,10 +370,16 @@ static void SMTPSetEvent(SMTPState *s, uint8_t e)
 
 static SMTPTransaction *SMTPTransactionCreate(void)
 {
-    SMTPTransaction *tx = SCCalloc(1, sizeof(*tx));
+    AppLayerTxArena *arena = AppLayerTxArenaCreate(NULL);
+    if (arena == NULL) {
+        return NULL;
+    }
+    SMTPTransaction *tx = AppLayerTxArenaCalloc(arena, 1, sizeof(*tx));
     if (tx == NULL) {
+        AppLayerTxArenaDestroy(arena);
         return NULL;
     }
+    tx->arena = arena;
 
     TAILQ_INIT(&tx->rcpt_to_list);
     tx->mime_state = NULL;
@@ -404,6 +419,53 @@ static void SMTPNewFile(SMTPTransaction *tx, File *file)
             smtp_config.content_inspect_min_size);
 }
 
+/**
+ * \brief Sets a flag that informs the SMTP parser that some module in the
+ *        engine needs the attachments of MIME messages.
+ *
+ * \initonly
+ */
+void SMTPNeedFileInspection(void)
+{
+    SC_ATOMIC_OR(smtp_mime_body_flags, MIME_DEC_BODY_ATTACHMENT);
+}
+
+/**
+ * \brief Sets a flag that informs the SMTP parser that the invalid base64
+ *        and quoted-printable events are used, so all encoded MIME bodies
+ *        need to be decoded.
+ *
+ * \initonly
+ */
+void SMTPNeedMimeAnomalies(void)
+{
+    SC_ATOMIC_OR(smtp_mime_body_flags, MIME_DEC_BODY_ANOMALY);
+}
+
+/**
+ * \internal
+ * \brief Get the MIME bodies that have a consumer, the others are only
+ *        scanned for boundaries by the MIME decoder.
+ *
+ * \retval flags MIME_DEC_BODY_* flags for MimeDecParseState::body_flags
+ */
+static uint8_t SMTPGetMimeBodyFlags(void)
+{
+    if (!smtp_config.skip_bodies)
+        return MIME_DEC_BODY_ALL;
+
+    /* SMTPProcessDataChunk only uses attachments, inline bodies are
+     * only decoded for URL extraction or anomaly checks */
+    uint8_t flags = (uint8_t)SC_ATOMIC_GET(smtp_mime_body_flags);
+    if (RunModeOutputFileEnabled() || RunModeOutputFiledataEnabled()) {
+        flags |= MIME_DEC_BODY_ATTACHMENT;
+    }
+    if (AppLayerParserProtocolHasLogger(IPPROTO_TCP, ALPROTO_SMTP)) {
+        flags |= MIME_DEC_BODY_URLS;
+    }
+    return flags;
+}
+
 int SMTPProcessDataChunk(const uint8_t *chunk, uint32_t len,
         MimeDecParseState *state)
 {
@@ -1102,7 +1164,12 @@ static int SMTPParseCommandBDAT(SMTPState *state)
     return 0;
 }
 
-static int SMTPParseCommandWithParam(SMTPState *state, uint8_t prefix_len, uint8_t **target, uint16_t *target_len)
+/**
+ *  \param arena arena of the tx the parameter is stored in, NULL if it's
+ *                stored in the state
+ */
+static int SMTPParseCommandWithParam(SMTPState *state, AppLayerTxArena *arena,
+        uint8_t prefix_len, uint8_t **target, uint16_t *target_len)
 {
     int i = prefix_len + 1;
     int spc_i = 0;
@@ -1124,7 +1191,10 @@ static int SMTPParseCommandWithParam(SMTPState *state, uint8_t prefix_len, uint8
         spc_i++;
     }
 
-    *target = SCMalloc(spc_i - i + 1);
+    if (arena != NULL)
+        *target = AppLayerTxArenaAlloc(arena, spc_i - i + 1);
+    else
+        *target = SCMalloc(spc_i - i + 1);
     if (*target == NULL)
         return -1;
     memcpy(*target, state->current_line + i, spc_i - i);
@@ -1140,7 +1210,7 @@ static int SMTPParseCommandHELO(SMTPState *state)
         SMTPSetEvent(state, SMTP_DECODER_EVENT_DUPLICATE_FIELDS);
         return 0;
     }
-    return SMTPParseCommandWithParam(state, 4, &state->helo, &state->helo_len);
+    return SMTPParseCommandWithParam(state, NULL, 4, &state->helo, &state->helo_len);
 }
 
 static int SMTPParseCommandMAILFROM(SMTPState *state)
@@ -1149,7 +1219,7 @@ static int SMTPParseCommandMAILFROM(SMTPState *state)
         SMTPSetEvent(state, SMTP_DECODER_EVENT_DUPLICATE_FIELDS);
         return 0;
     }
-    return SMTPParseCommandWithParam(state, 9,
+    return SMTPParseCommandWithParam(state, state->curr_tx->arena, 9,
                                      &state->curr_tx->mail_from,
                                      &state->curr_tx->mail_from_len);
 }
@@ -1159,14 +1229,15 @@ static int SMTPParseCommandRCPTTO(SMTPState *state)
     uint8_t *rcptto;
     uint16_t rcptto_len;
 
-    if (SMTPParseCommandWithParam(state, 7, &rcptto, &rcptto_len) == 0) {
-        SMTPString *rcptto_str = SMTPStringAlloc();
+    if (SMTPParseCommandWithParam(state, state->curr_tx->arena, 7,
+                &rcptto, &rcptto_len) == 0) {
+        SMTPString *rcptto_str = SMTPStringAlloc(state->curr_tx);
         if (rcptto_str) {
             rcptto_str->str = rcptto;
             rcptto_str->len = rcptto_len;
             TAILQ_INSERT_TAIL(&state->curr_tx->rcpt_to_list, rcptto_str, next);
         } else {
-            SCFree(rcptto);
+            /* rcptto stays in the arena until the tx is freed */
             return -1;
         }
     } else {
@@ -1272,6 +1343,7 @@ static int SMTPProcessRequest(SMTPState *state, Flow *f,
                             "allocate data");
                     return MIME_DEC_ERR_MEM;
                 }
+                tx->mime_state->body_flags = SMTPGetMimeBodyFlags();
 
                 /* Add new MIME message to end of list */
                 if (tx->msg_head == NULL) {
@@ -1434,23 +1506,9 @@ void *SMTPStateAlloc(void)
     return smtp_state;
 }
 
-static SMTPString *SMTPStringAlloc(void)
+static SMTPString *SMTPStringAlloc(SMTPTransaction *tx)
 {
-    SMTPString *smtp_string = SCMalloc(sizeof(SMTPString));
-    if (unlikely(smtp_string == NULL))
-        return NULL;
-    memset(smtp_string, 0, sizeof(SMTPString));
-
-    return smtp_string;
-}
-
-
-static void SMTPStringFree(SMTPString *str)
-{
-    if (str->str) {
-        SCFree(str->str);
-    }
-    SCFree(str);
+    return AppLayerTxArenaCalloc(tx->arena, 1, sizeof(SMTPString));
 }
 
 static void *SMTPLocalStorageAlloc(void)
@@ -1509,21 +1567,14 @@ static void SMTPTransactionFree(SMTPTransaction *tx, SMTPState *state)
     if (tx->de_state != NULL)
         DetectEngineStateFree(tx->de_state);
 
-    if (tx->mail_from)
-        SCFree(tx->mail_from);
-
-    SMTPString *str = NULL;
-    while ((str = TAILQ_FIRST(&tx->rcpt_to_list))) {
-        TAILQ_REMOVE(&tx->rcpt_to_list, str, next);
-        SMTPStringFree(str);
-    }
 #if 0
         if (tx->decoder_events->cnt <= smtp_state->events)
             smtp_state->events -= tx->decoder_events->cnt;
         else
             smtp_state->events = 0;
 #endif
-    SCFree(tx);
+    /* mail from and the rcpt to list are in the arena as well */
+    AppLayerTxArenaDestroy(tx->arena);
 }
 
 /**
@@ -1838,6 +1889,7 @@ void RegisterSMTPParsers(void)
 
     SMTPSetMpmState();
 
+    SC_ATOMIC_INIT(smtp_mime_body_flags);
     SMTPConfigure();
 
 #ifdef UNITTESTS
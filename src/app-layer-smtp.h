@@ -90,12 +90,17 @@ typedef struct SMTPTransaction_ {
 
     TAILQ_HEAD(, SMTPString_) rcpt_to_list;  /**< rcpt to string list */
 
+    /** the tx, mail from and the rcpt to list are allocated from this */
+    struct AppLayerTxArena_ *arena;
+
     TAILQ_ENTRY(SMTPTransaction_) next;
 } SMTPTransaction;
 
 typedef struct SMTPConfig {
 
     int decode_mime;
+    /** only decode the MIME bodies that rules or loggers use */
+    int skip_bodies;
     MimeDecConfig mime_config;
     uint32_t content_limit;
     uint32_t content_inspect_min_size;
@@ -176,6 +181,8 @@ typedef struct SMTPState_ {
 extern SMTPConfig smtp_config;
 
 int SMTPProcessDataChunk(const uint8_t *chunk, uint32_t len, MimeDecParseState *state);
+void SMTPNeedFileInspection(void);
+void SMTPNeedMimeAnomalies(void);
 void *SMTPStateAlloc(void);
 void RegisterSMTPParsers(void);
 void SMTPParserCleanup(void);
@@ -50,6 +50,8 @@
 #include "util-pool.h"
 #include "util-byte.h"
 #include "util-ja3.h"
+#include "util-thash.h"
+#include "util-hash-lookup3.h"
 #include "flow-util.h"
 #include "flow-private.h"
 
@@ -422,28 +424,345 @@ static void TlsDecodeHSCertificateErrSetEvent(SSLState *ssl_state, uint32_t err)
     }
 }
 
-static inline int TlsDecodeHSCertificateFingerprint(SSLState *ssl_state,
-                                                    const uint8_t *input,
-                                                    uint32_t cert_len)
+/* X.509 decode cache
+ *
+ * The same server certificates are seen over and over, so the fields of the
+ * leaf certificate are decoded once and kept in a cache shared by all
+ * threads. The cache is keyed on the DER bytes of the certificate, looked
+ * up by a hash of them. Entries are bounded by the memcap and recycled when
+ * it is reached. */
+
+enum SSLCertCacheResult {
+    SSL_CERT_UNSET = 0,     /**< not decoded (yet), e.g. alloc failure */
+    SSL_CERT_OK,            /**< fields are set */
+    SSL_CERT_INVALID,       /**< decoding failed, certificate is skipped */
+    SSL_CERT_ERROR,         /**< fields couldn't be extracted */
+};
+
+typedef struct SSLCertCacheEntry_ {
+    uint32_t hash;
+    uint32_t der_len;
+    uint8_t *der;
+
+    enum SSLCertCacheResult result;
+    uint32_t err_code;
+    /** memory used by the entry outside of the hash: the DER copy and
+     *  the strings, accounted in the cache memuse */
+    uint32_t size;
+
+    char *subject;
+    char *issuerdn;
+    char *serial;
+    int64_t not_before;
+    int64_t not_after;
+    char fingerprint[SHA1_STRING_LENGTH];
+} SSLCertCacheEntry;
+
+static THashTableContext *ssl_cert_cache = NULL;
+SC_ATOMIC_DECLARE(uint64_t, ssl_cert_cache_hits);
+SC_ATOMIC_DECLARE(uint64_t, ssl_cert_cache_misses);
+
+static void SSLCertCacheEntryFreeFields(SSLCertCacheEntry *e)
 {
-    if (unlikely(ssl_state->server_connp.cert0_fingerprint != NULL))
+    if (e->subject)
+        SCFree(e->subject);
+    if (e->issuerdn)
+        SCFree(e->issuerdn);
+    if (e->serial)
+        SCFree(e->serial);
+    e->subject = e->issuerdn = e->serial = NULL;
+    e->fingerprint[0] = '\0';
+    e->result = SSL_CERT_UNSET;
+    e->err_code = 0;
+}
+
+static void SSLCertCacheEntryFree(void *data)
+{
+    SSLCertCacheEntry *e = data;
+
+    SSLCertCacheEntryFreeFields(e);
+    if (e->der)
+        SCFree(e->der);
+    e->der = NULL;
+    e->der_len = 0;
+    if (ssl_cert_cache != NULL)
+        (void)SC_ATOMIC_SUB(ssl_cert_cache->memuse, e->size);
+    e->size = 0;
+}
+
+static int SSLCertCacheEntrySet(void *dst, void *src)
+{
+    SSLCertCacheEntry *d = dst;
+    const SSLCertCacheEntry *s = src;
+
+    d->hash = s->hash;
+    d->der = SCMalloc(s->der_len);
+    if (unlikely(d->der == NULL)) {
+        /* entry can't be matched and will be recycled */
+        d->der_len = 0;
         return 0;
+    }
+    memcpy(d->der, s->der, s->der_len);
+    d->der_len = s->der_len;
+    d->size = s->der_len;
+    (void)SC_ATOMIC_ADD(ssl_cert_cache->memuse, d->size);
+    return 0;
+}
 
-    ssl_state->server_connp.cert0_fingerprint = SCCalloc(1, SHA1_STRING_LENGTH *
-                                                         sizeof(char));
-    if (ssl_state->server_connp.cert0_fingerprint == NULL)
-        return -1;
+/** \internal
+ *  \brief update the memuse of the cache for a (re)decoded entry */
+static void SSLCertCacheEntryUpdateSize(SSLCertCacheEntry *e)
+{
+    uint32_t size = e->der_len;
+    if (e->subject)
+        size += strlen(e->subject) + 1;
+    if (e->issuerdn)
+        size += strlen(e->issuerdn) + 1;
+    if (e->serial)
+        size += strlen(e->serial) + 1;
+
+    if (size > e->size)
+        (void)SC_ATOMIC_ADD(ssl_cert_cache->memuse, size - e->size);
+    else if (size < e->size)
+        (void)SC_ATOMIC_SUB(ssl_cert_cache->memuse, e->size - size);
+    e->size = size;
+}
+
+static uint32_t SSLCertCacheEntryHash(void *data)
+{
+    const SSLCertCacheEntry *e = data;
+    return e->hash;
+}
+
+static bool SSLCertCacheEntryCompare(void *a, void *b)
+{
+    const SSLCertCacheEntry *ea = a;
+    const SSLCertCacheEntry *eb = b;
 
+    return (ea->hash == eb->hash && ea->der_len == eb->der_len &&
+            memcmp(ea->der, eb->der, ea->der_len) == 0);
+}
+
+static void SSLCertCacheSetup(void)
+{
+    if (ssl_cert_cache != NULL)
+        return;
+
+    int enabled = 1;
+    (void)ConfGetBool("app-layer.protocols.tls.certificate-cache.enabled", &enabled);
+    if (!enabled) {
+        SCLogConfig("tls: certificate cache disabled");
+        return;
+    }
+
+    SC_ATOMIC_INIT(ssl_cert_cache_hits);
+    SC_ATOMIC_INIT(ssl_cert_cache_misses);
+    ssl_cert_cache = THashInit("app-layer.protocols.tls.certificate-cache",
+            sizeof(SSLCertCacheEntry), SSLCertCacheEntrySet,
+            SSLCertCacheEntryFree, SSLCertCacheEntryHash,
+            SSLCertCacheEntryCompare);
+}
+
+bool SSLCertCacheIsEnabled(void)
+{
+    return (ssl_cert_cache != NULL);
+}
+
+void SSLParserCleanup(void)
+{
+    if (ssl_cert_cache != NULL) {
+        THashShutdown(ssl_cert_cache);
+        ssl_cert_cache = NULL;
+    }
+}
+
+uint64_t SSLCertCacheHitsGlobalCounter(void)
+{
+    return SC_ATOMIC_GET(ssl_cert_cache_hits);
+}
+
+uint64_t SSLCertCacheMissesGlobalCounter(void)
+{
+    return SC_ATOMIC_GET(ssl_cert_cache_misses);
+}
+
+uint64_t SSLCertCacheMemuseGlobalCounter(void)
+{
+    if (ssl_cert_cache == NULL)
+        return 0;
+    return SC_ATOMIC_GET(ssl_cert_cache->memuse);
+}
+
+static void TlsDecodeHSCertificateFingerprint(char *fingerprint,
+                                              const uint8_t *input,
+                                              uint32_t cert_len)
+{
     uint8_t hash[SHA1_LENGTH];
     if (ComputeSHA1(input, cert_len, hash, sizeof(hash)) == 1) {
         for (int i = 0, x = 0; x < SHA1_LENGTH; x++)
         {
-            i += snprintf(ssl_state->server_connp.cert0_fingerprint + i,
+            i += snprintf(fingerprint + i,
                     SHA1_STRING_LENGTH - i, i == 0 ? "%02x" : ":%02x",
                     hash[x]);
         }
     }
-    return 0;
+}
+
+/** \internal
+ *  \brief copy a string returned by the x509 decoder
+ *  \retval 0 ok, -1 alloc failure, -2 no string */
+static int SSLCertCacheCopyString(char **dst, char *str)
+{
+    if (str == NULL)
+        return -2;
+    *dst = SCStrdup(str);
+    rs_cstring_free(str);
+    return (*dst == NULL) ? -1 : 0;
+}
+
+/** \internal
+ *  \brief decode the fields of the leaf certificate into a cache entry */
+static void SSLCertCacheEntryDecode(SSLCertCacheEntry *e,
+        const uint8_t *input, uint32_t cert_len)
+{
+    uint32_t err_code = 0;
+    int rc;
+
+    SSLCertCacheEntryFreeFields(e);
+
+    X509 *x509 = rs_x509_decode(input, cert_len, &err_code);
+    if (x509 == NULL) {
+        e->result = SSL_CERT_INVALID;
+        e->err_code = err_code;
+        return;
+    }
+
+    rc = SSLCertCacheCopyString(&e->subject, rs_x509_get_subject(x509));
+    if (rc == -2) {
+        e->err_code = ERR_EXTRACT_SUBJECT;
+        goto error;
+    } else if (rc < 0) {
+        goto alloc_error;
+    }
+    rc = SSLCertCacheCopyString(&e->issuerdn, rs_x509_get_issuer(x509));
+    if (rc == -2) {
+        e->err_code = ERR_EXTRACT_ISSUER;
+        goto error;
+    } else if (rc < 0) {
+        goto alloc_error;
+    }
+    rc = SSLCertCacheCopyString(&e->serial, rs_x509_get_serial(x509));
+    if (rc == -2) {
+        e->err_code = ERR_INVALID_SERIAL;
+        goto error;
+    } else if (rc < 0) {
+        goto alloc_error;
+    }
+    if (rs_x509_get_validity(x509, &e->not_before, &e->not_after) != 0) {
+        e->err_code = ERR_EXTRACT_VALIDITY;
+        goto error;
+    }
+    rs_x509_free(x509);
+
+    TlsDecodeHSCertificateFingerprint(e->fingerprint, input, cert_len);
+    e->result = SSL_CERT_OK;
+    return;
+
+error:
+    rs_x509_free(x509);
+    e->result = SSL_CERT_ERROR;
+    return;
+
+alloc_error:
+    rs_x509_free(x509);
+    SSLCertCacheEntryFreeFields(e);
+}
+
+/** \internal
+ *  \brief set the leaf certificate fields in the state
+ *  \retval 1 ok, 0 invalid certificate, -1 error */
+static int TlsDecodeHSCertificateSetFields(SSLState *ssl_state,
+        const SSLCertCacheEntry *e)
+{
+    switch (e->result) {
+        case SSL_CERT_UNSET:
+            return -1;
+        case SSL_CERT_INVALID:
+            TlsDecodeHSCertificateErrSetEvent(ssl_state, e->err_code);
+            return 0;
+        case SSL_CERT_ERROR:
+            TlsDecodeHSCertificateErrSetEvent(ssl_state, e->err_code);
+            return -1;
+        case SSL_CERT_OK:
+            break;
+    }
+
+    SSLStateConnp *connp = &ssl_state->server_connp;
+    connp->cert0_subject = SCStrdup(e->subject);
+    connp->cert0_issuerdn = SCStrdup(e->issuerdn);
+    connp->cert0_serial = SCStrdup(e->serial);
+    if (connp->cert0_subject == NULL || connp->cert0_issuerdn == NULL ||
+            connp->cert0_serial == NULL)
+        return -1;
+    connp->cert0_not_before = (time_t)e->not_before;
+    connp->cert0_not_after = (time_t)e->not_after;
+
+    if (connp->cert0_fingerprint == NULL) {
+        connp->cert0_fingerprint = SCStrdup(e->fingerprint);
+        if (connp->cert0_fingerprint == NULL)
+            return -1;
+    }
+    return 1;
+}
+
+/** \internal
+ *  \brief decode the leaf certificate, using the cache if enabled
+ *  \retval 1 ok, 0 invalid certificate, -1 error */
+static int TlsDecodeHSCertificateLeaf(SSLState *ssl_state,
+        const uint8_t *input, uint32_t cert_len)
+{
+    SSLCertCacheEntry local;
+    SSLCertCacheEntry *e = NULL;
+    THashData *h = NULL;
+
+    if (ssl_cert_cache != NULL) {
+        SSLCertCacheEntry lookup = {
+            .hash = hashlittle_safe(input, cert_len, 0),
+            .der_len = cert_len,
+            .der = (uint8_t *)input,
+        };
+        /* returns the entry locked, so other threads looking for the
+         * same certificate wait for us to decode it */
+        struct THashDataGetResult res = THashGetFromHash(ssl_cert_cache, &lookup);
+        if (res.data != NULL) {
+            h = res.data;
+            e = h->data;
+            if (res.is_new || e->result == SSL_CERT_UNSET) {
+                SSLCertCacheEntryDecode(e, input, cert_len);
+                SSLCertCacheEntryUpdateSize(e);
+                (void)SC_ATOMIC_ADD(ssl_cert_cache_misses, 1);
+            } else {
+                (void)SC_ATOMIC_ADD(ssl_cert_cache_hits, 1);
+            }
+        } else {
+            (void)SC_ATOMIC_ADD(ssl_cert_cache_misses, 1);
+        }
+    }
+    if (e == NULL) {
+        memset(&local, 0, sizeof(local));
+        e = &local;
+        SSLCertCacheEntryDecode(e, input, cert_len);
+    }
+
+    int r = TlsDecodeHSCertificateSetFields(ssl_state, e);
+
+    if (h != NULL) {
+        THashDataUnlock(h);
+        THashDecrUsecnt(h);
+    } else {
+        SSLCertCacheEntryFreeFields(e);
+    }
+    return r;
 }
 
 static inline int TlsDecodeHSCertificateAddCertToChain(SSLState *ssl_state,
@@ -466,9 +785,6 @@ static int TlsDecodeHSCertificate(SSLState *ssl_state,
                                   const uint32_t input_len)
 {
     const uint8_t *input = (uint8_t *)initial_input;
-    uint32_t err_code = 0;
-
-    X509 *x509 = NULL;
 
     if (!(HAS_SPACE(3)))
         return 1;
@@ -483,8 +799,6 @@ static int TlsDecodeHSCertificate(SSLState *ssl_state,
     /* coverity[tainted_data] */
     while (processed_len < cert_chain_len)
     {
-        err_code = 0;
-
         if (!(HAS_SPACE(3)))
             goto invalid_cert;
 
@@ -494,55 +808,15 @@ static int TlsDecodeHSCertificate(SSLState *ssl_state,
         if (!(HAS_SPACE(cert_len)))
             goto invalid_cert;
 
-        // uint32_t err = 0;
         int rc = 0;
 
         /* only store fields from the first certificate in the chain */
         if (processed_len == 0) {
-            char * str;
-            int64_t not_before, not_after;
-
-            x509 = rs_x509_decode(input, cert_len, &err_code);
-            if (x509 == NULL) {
-                TlsDecodeHSCertificateErrSetEvent(ssl_state, err_code);
+            rc = TlsDecodeHSCertificateLeaf(ssl_state, input, cert_len);
+            if (rc < 0)
+                return -1;
+            else if (rc == 0)
                 goto next;
-            }
-
-            str = rs_x509_get_subject(x509);
-            if (str == NULL) {
-                err_code = ERR_EXTRACT_SUBJECT;
-                goto error;
-            }
-            ssl_state->server_connp.cert0_subject = str;
-
-            str = rs_x509_get_issuer(x509);
-            if (str == NULL) {
-                err_code = ERR_EXTRACT_ISSUER;
-                goto error;
-            }
-            ssl_state->server_connp.cert0_issuerdn = str;
-
-            str = rs_x509_get_serial(x509);
-            if (str == NULL) {
-                err_code = ERR_INVALID_SERIAL;
-                goto error;
-            }
-            ssl_state->server_connp.cert0_serial = str;
-
-            rc = rs_x509_get_validity(x509, &not_before, &not_after);
-            if (rc != 0) {
-                err_code = ERR_EXTRACT_VALIDITY;
-                goto error;
-            }
-            ssl_state->server_connp.cert0_not_before = (time_t)not_before;
-            ssl_state->server_connp.cert0_not_after = (time_t)not_after;
-
-            rs_x509_free(x509);
-            x509 = NULL;
-
-            rc = TlsDecodeHSCertificateFingerprint(ssl_state, input, cert_len);
-            if (rc != 0)
-                goto error;
         }
 
         rc = TlsDecodeHSCertificateAddCertToChain(ssl_state, input, cert_len);
@@ -557,10 +831,6 @@ next:
     return (input - initial_input);
 
 error:
-    if (err_code != 0)
-        TlsDecodeHSCertificateErrSetEvent(ssl_state, err_code);
-    if (x509 != NULL)
-        rs_x509_free(x509);
     return -1;
 
 invalid_cert:
@@ -569,46 +839,10 @@ invalid_cert:
     return -1;
 }
 
-/**
- * \inline
- * \brief Check if value is GREASE.
- *
- * http://tools.ietf.org/html/draft-davidben-tls-grease-00
- *
- * \param value Value to check.
- *
- * \retval 1 if is GREASE.
- * \retval 0 if not is GREASE.
- */
-static inline int TLSDecodeValueIsGREASE(const uint16_t value)
-{
-    switch (value)
-    {
-        case 0x0a0a:
-        case 0x1a1a:
-        case 0x2a2a:
-        case 0x3a3a:
-        case 0x4a4a:
-        case 0x5a5a:
-        case 0x6a6a:
-        case 0x7a7a:
-        case 0x8a8a:
-        case 0x9a9a:
-        case 0xaaaa:
-        case 0xbaba:
-        case 0xcaca:
-        case 0xdada:
-        case 0xeaea:
-        case 0xfafa:
-            return 1;
-        default:
-            return 0;
-    }
-}
-
 static inline int TLSDecodeHSHelloVersion(SSLState *ssl_state,
                                           const uint8_t * const initial_input,
-                                          const uint32_t input_len)
+                                          const uint32_t input_len,
+                                          JA3Fields *ja3)
 {
     uint8_t *input = (uint8_t *)initial_input;
 
@@ -644,13 +878,9 @@ static inline int TLSDecodeHSHelloVersion(SSLState *ssl_state,
         ssl_state->curr_connp->version = TLS_VERSION_13_PRE_DRAFT16;
     }
 
-    if (SC_ATOMIC_GET(ssl_config.enable_ja3) && ssl_state->curr_connp->ja3_str == NULL) {
-        ssl_state->curr_connp->ja3_str = Ja3BufferInit();
-        if (ssl_state->curr_connp->ja3_str == NULL)
-            return -1;
-
-        int rc = Ja3BufferAddValue(&ssl_state->curr_connp->ja3_str, version);
-        if (rc != 0)
+    if (ja3 != NULL) {
+        if (Ja3FieldsStart(ja3) != 0 ||
+                Ja3FieldsAppend(ja3, input, SSLV3_CLIENT_HELLO_VERSION_LEN) != 0)
             return -1;
     }
 
@@ -728,7 +958,8 @@ invalid_length:
 
 static inline int TLSDecodeHSHelloCipherSuites(SSLState *ssl_state,
                                            const uint8_t * const initial_input,
-                                           const uint32_t input_len)
+                                           const uint32_t input_len,
+                                           JA3Fields *ja3)
 {
     const uint8_t *input = initial_input;
 
@@ -754,44 +985,14 @@ static inline int TLSDecodeHSHelloCipherSuites(SSLState *ssl_state,
         goto invalid_length;
     }
 
-    if (SC_ATOMIC_GET(ssl_config.enable_ja3)) {
-        JA3Buffer *ja3_cipher_suites = Ja3BufferInit();
-        if (ja3_cipher_suites == NULL)
+    if (ja3 != NULL) {
+        if (Ja3FieldsStart(ja3) != 0 ||
+                Ja3FieldsAppend(ja3, input, cipher_suites_length) != 0)
             return -1;
-
-        uint16_t processed_len = 0;
-        /* coverity[tainted_data] */
-        while (processed_len < cipher_suites_length)
-        {
-            if (!(HAS_SPACE(2))) {
-                Ja3BufferFree(&ja3_cipher_suites);
-                goto invalid_length;
-            }
-
-            uint16_t cipher_suite = *input << 8 | *(input + 1);
-            input += 2;
-
-            if (TLSDecodeValueIsGREASE(cipher_suite) != 1) {
-                int rc = Ja3BufferAddValue(&ja3_cipher_suites, cipher_suite);
-                if (rc != 0) {
-                    return -1;
-                }
-            }
-
-            processed_len += 2;
-        }
-
-        int rc = Ja3BufferAppendBuffer(&ssl_state->curr_connp->ja3_str,
-                                   &ja3_cipher_suites);
-        if (rc == -1) {
-            return -1;
-        }
-
-    } else {
-        /* Skip cipher suites */
-        input += cipher_suites_length;
     }
 
+    input += cipher_suites_length;
+
     return (input - initial_input);
 
 invalid_length:
@@ -972,7 +1173,8 @@ invalid_length:
 static inline int TLSDecodeHSHelloExtensionEllipticCurves(SSLState *ssl_state,
                                           const uint8_t * const initial_input,
                                           const uint32_t input_len,
-                                          JA3Buffer *ja3_elliptic_curves)
+                                          const uint8_t **ja3_elliptic_curves,
+                                          uint32_t *ja3_elliptic_curves_len)
 {
     const uint8_t *input = initial_input;
 
@@ -989,32 +1191,11 @@ static inline int TLSDecodeHSHelloExtensionEllipticCurves(SSLState *ssl_state,
     if (!(HAS_SPACE(elliptic_curves_len)))
         goto invalid_length;
 
-    if ((ssl_state->current_flags & SSL_AL_FLAG_STATE_CLIENT_HELLO) &&
-            SC_ATOMIC_GET(ssl_config.enable_ja3)) {
-        uint16_t ec_processed_len = 0;
-        /* coverity[tainted_data] */
-        while (ec_processed_len < elliptic_curves_len)
-        {
-            if (!(HAS_SPACE(2)))
-                goto invalid_length;
-
-            uint16_t elliptic_curve = *input << 8 | *(input + 1);
-            input += 2;
+    /* kept for JA3, which is generated once all extensions are parsed */
+    *ja3_elliptic_curves = input;
+    *ja3_elliptic_curves_len = elliptic_curves_len;
 
-            if (TLSDecodeValueIsGREASE(elliptic_curve) != 1) {
-                int rc = Ja3BufferAddValue(&ja3_elliptic_curves,
-                                           elliptic_curve);
-                if (rc != 0)
-                    return -1;
-            }
-
-            ec_processed_len += 2;
-        }
-
-    } else {
-        /* Skip elliptic curves */
-        input += elliptic_curves_len;
-    }
+    input += elliptic_curves_len;
 
     return (input - initial_input);
 
@@ -1029,7 +1210,8 @@ invalid_length:
 static inline int TLSDecodeHSHelloExtensionEllipticCurvePF(SSLState *ssl_state,
                                             const uint8_t * const initial_input,
                                             const uint32_t input_len,
-                                            JA3Buffer *ja3_elliptic_curves_pf)
+                                            const uint8_t **ja3_elliptic_curves_pf,
+                                            uint32_t *ja3_elliptic_curves_pf_len)
 {
     const uint8_t *input = initial_input;
 
@@ -1046,29 +1228,11 @@ static inline int TLSDecodeHSHelloExtensionEllipticCurvePF(SSLState *ssl_state,
     if (!(HAS_SPACE(ec_pf_len)))
         goto invalid_length;
 
-    if ((ssl_state->current_flags & SSL_AL_FLAG_STATE_CLIENT_HELLO) &&
-            SC_ATOMIC_GET(ssl_config.enable_ja3)) {
-        uint8_t ec_pf_processed_len = 0;
-        /* coverity[tainted_data] */
-        while (ec_pf_processed_len < ec_pf_len)
-        {
-            uint8_t elliptic_curve_pf = *input;
-            input += 1;
+    /* kept for JA3, which is generated once all extensions are parsed */
+    *ja3_elliptic_curves_pf = input;
+    *ja3_elliptic_curves_pf_len = ec_pf_len;
 
-            if (TLSDecodeValueIsGREASE(elliptic_curve_pf) != 1) {
-                int rc = Ja3BufferAddValue(&ja3_elliptic_curves_pf,
-                                           elliptic_curve_pf);
-                if (rc != 0)
-                    return -1;
-            }
-
-            ec_pf_processed_len += 1;
-        }
-
-    } else {
-        /* Skip elliptic curve point formats */
-        input += ec_pf_len;
-    }
+    input += ec_pf_len;
 
     return (input - initial_input);
 
@@ -1082,33 +1246,21 @@ invalid_length:
 
 static inline int TLSDecodeHSHelloExtensions(SSLState *ssl_state,
                                          const uint8_t * const initial_input,
-                                         const uint32_t input_len)
+                                         const uint32_t input_len,
+                                         JA3Fields *ja3)
 {
     const uint8_t *input = initial_input;
 
     int ret;
-    int rc;
-    const bool ja3 = (SC_ATOMIC_GET(ssl_config.enable_ja3) == 1);
-
-    JA3Buffer *ja3_extensions = NULL;
-    JA3Buffer *ja3_elliptic_curves = NULL;
-    JA3Buffer *ja3_elliptic_curves_pf = NULL;
 
-    if (ja3) {
-        ja3_extensions = Ja3BufferInit();
-        if (ja3_extensions == NULL)
-            goto error;
-
-        if (ssl_state->current_flags & SSL_AL_FLAG_STATE_CLIENT_HELLO) {
-            ja3_elliptic_curves = Ja3BufferInit();
-            if (ja3_elliptic_curves == NULL)
-                goto error;
+    /* raw JA3 values of the extensions, pointing into the record */
+    const uint8_t *ja3_elliptic_curves = NULL;
+    uint32_t ja3_elliptic_curves_len = 0;
+    const uint8_t *ja3_elliptic_curves_pf = NULL;
+    uint32_t ja3_elliptic_curves_pf_len = 0;
 
-            ja3_elliptic_curves_pf = Ja3BufferInit();
-            if (ja3_elliptic_curves_pf == NULL)
-                goto error;
-        }
-    }
+    if (ja3 != NULL && Ja3FieldsStart(ja3) != 0)
+        goto error;
 
     /* Extensions are optional (RFC5246 section 7.4.1.2) */
     if (!(HAS_SPACE(2)))
@@ -1127,6 +1279,7 @@ static inline int TLSDecodeHSHelloExtensions(SSLState *ssl_state,
         if (!(HAS_SPACE(2)))
             goto invalid_length;
 
+        const uint8_t *ext_type_raw = input;
         uint16_t ext_type = *input << 8 | *(input + 1);
         input += 2;
 
@@ -1158,7 +1311,8 @@ static inline int TLSDecodeHSHelloExtensions(SSLState *ssl_state,
                 /* coverity[tainted_data] */
                 ret = TLSDecodeHSHelloExtensionEllipticCurves(ssl_state, input,
                                                               ext_len,
-                                                              ja3_elliptic_curves);
+                                                              &ja3_elliptic_curves,
+                                                              &ja3_elliptic_curves_len);
                 if (ret < 0)
                     goto end;
 
@@ -1172,7 +1326,8 @@ static inline int TLSDecodeHSHelloExtensions(SSLState *ssl_state,
                 /* coverity[tainted_data] */
                 ret = TLSDecodeHSHelloExtensionEllipticCurvePF(ssl_state, input,
                                                                ext_len,
-                                                               ja3_elliptic_curves_pf);
+                                                               &ja3_elliptic_curves_pf,
+                                                               &ja3_elliptic_curves_pf_len);
                 if (ret < 0)
                     goto end;
 
@@ -1226,35 +1381,24 @@ static inline int TLSDecodeHSHelloExtensions(SSLState *ssl_state,
             }
         }
 
-        if (ja3) {
-            if (TLSDecodeValueIsGREASE(ext_type) != 1) {
-                rc = Ja3BufferAddValue(&ja3_extensions, ext_type);
-                if (rc != 0)
-                    goto error;
-            }
-        }
+        if (ja3 != NULL && Ja3FieldsAppend(ja3, ext_type_raw, 2) != 0)
+            goto error;
 
         processed_len += ext_len + 4;
     }
 
 end:
-    if (ja3) {
-        rc = Ja3BufferAppendBuffer(&ssl_state->curr_connp->ja3_str,
-                                   &ja3_extensions);
-        if (rc == -1)
+    if (ja3 != NULL && (ssl_state->current_flags & SSL_AL_FLAG_STATE_CLIENT_HELLO)) {
+        if (Ja3FieldsStart(ja3) != 0)
+            goto error;
+        if (ja3_elliptic_curves_len > 0 &&
+                Ja3FieldsAppend(ja3, ja3_elliptic_curves, ja3_elliptic_curves_len) != 0)
+            goto error;
+        if (Ja3FieldsStart(ja3) != 0)
+            goto error;
+        if (ja3_elliptic_curves_pf_len > 0 &&
+                Ja3FieldsAppend(ja3, ja3_elliptic_curves_pf, ja3_elliptic_curves_pf_len) != 0)
             goto error;
-
-        if (ssl_state->current_flags & SSL_AL_FLAG_STATE_CLIENT_HELLO) {
-            rc = Ja3BufferAppendBuffer(&ssl_state->curr_connp->ja3_str,
-                                       &ja3_elliptic_curves);
-            if (rc == -1)
-                goto error;
-
-            rc = Ja3BufferAppendBuffer(&ssl_state->curr_connp->ja3_str,
-                                       &ja3_elliptic_curves_pf);
-            if (rc == -1)
-                goto error;
-        }
     }
 
     return (input - initial_input);
@@ -1265,16 +1409,45 @@ invalid_length:
                 TLS_DECODER_EVENT_HANDSHAKE_INVALID_LENGTH);
 
 error:
-    if (ja3_extensions != NULL)
-        Ja3BufferFree(&ja3_extensions);
-    if (ja3_elliptic_curves != NULL)
-        Ja3BufferFree(&ja3_elliptic_curves);
-    if (ja3_elliptic_curves_pf != NULL)
-        Ja3BufferFree(&ja3_elliptic_curves_pf);
-
     return -1;
 }
 
+/** \internal
+ *  \brief set the JA3 hash and keep the raw fields for the JA3 string */
+static int TLSDecodeHSHelloJA3(SSLStateConnp *connp, const JA3Fields *ja3)
+{
+    char hash[JA3_HASH_STRING_LENGTH];
+    if (Ja3FieldsGenerateHash(ja3->data, ja3->len, hash) != 0)
+        return -1;
+
+    connp->ja3_hash = SCStrdup(hash);
+    if (connp->ja3_hash == NULL)
+        return -1;
+
+    connp->ja3_fields = SCMalloc(ja3->len);
+    if (connp->ja3_fields == NULL)
+        return -1;
+    memcpy(connp->ja3_fields, ja3->data, ja3->len);
+    connp->ja3_fields_len = ja3->len;
+    return 0;
+}
+
+/**
+ * \brief Get the JA3 string, it is built from the raw fields on first use.
+ *
+ * \param connp The client (JA3) or server (JA3S) connection state.
+ *
+ * \retval pointer to buffer or NULL if there is no JA3 for this side.
+ */
+JA3Buffer *SSLStateGetJA3String(SSLStateConnp *connp)
+{
+    if (connp->ja3_str == NULL && connp->ja3_fields != NULL) {
+        connp->ja3_str = Ja3FieldsToBuffer(connp->ja3_fields,
+                                           connp->ja3_fields_len);
+    }
+    return connp->ja3_str;
+}
+
 static int TLSDecodeHandshakeHello(SSLState *ssl_state,
                                    const uint8_t * const input,
                                    const uint32_t input_len)
@@ -1282,7 +1455,15 @@ static int TLSDecodeHandshakeHello(SSLState *ssl_state,
     int ret;
     uint32_t parsed = 0;
 
-    ret = TLSDecodeHSHelloVersion(ssl_state, input, input_len);
+    JA3Fields ja3_fields;
+    JA3Fields *ja3 = NULL;
+    if (SC_ATOMIC_GET(ssl_config.enable_ja3) &&
+            ssl_state->curr_connp->ja3_hash == NULL) {
+        Ja3FieldsInit(&ja3_fields);
+        ja3 = &ja3_fields;
+    }
+
+    ret = TLSDecodeHSHelloVersion(ssl_state, input, input_len, ja3);
     if (ret < 0)
         goto end;
 
@@ -1308,7 +1489,7 @@ static int TLSDecodeHandshakeHello(SSLState *ssl_state,
     }
 
     ret = TLSDecodeHSHelloCipherSuites(ssl_state, input + parsed,
-                                       input_len - parsed);
+                                       input_len - parsed, ja3);
     if (ret < 0)
         goto end;
 
@@ -1328,15 +1509,17 @@ static int TLSDecodeHandshakeHello(SSLState *ssl_state,
     }
 
     ret = TLSDecodeHSHelloExtensions(ssl_state, input + parsed,
-                                     input_len - parsed);
+                                     input_len - parsed, ja3);
     if (ret < 0)
         goto end;
 
-    if (SC_ATOMIC_GET(ssl_config.enable_ja3) && ssl_state->curr_connp->ja3_hash == NULL) {
-        ssl_state->curr_connp->ja3_hash = Ja3GenerateHash(ssl_state->curr_connp->ja3_str);
+    if (ja3 != NULL) {
+        (void)TLSDecodeHSHelloJA3(ssl_state->curr_connp, ja3);
     }
 
 end:
+    if (ja3 != NULL)
+        Ja3FieldsFree(ja3);
     ssl_state->curr_connp->hs_bytes_processed = 0;
     return 0;
 }
@@ -2559,11 +2742,11 @@ static void SSLStateFree(void *p)
     if (ssl_state->client_connp.trec)
         SCFree(ssl_state->client_connp.trec);
     if (ssl_state->client_connp.cert0_subject)
-        rs_cstring_free(ssl_state->client_connp.cert0_subject);
+        SCFree(ssl_state->client_connp.cert0_subject);
     if (ssl_state->client_connp.cert0_issuerdn)
-        rs_cstring_free(ssl_state->client_connp.cert0_issuerdn);
+        SCFree(ssl_state->client_connp.cert0_issuerdn);
     if (ssl_state->client_connp.cert0_serial)
-        rs_cstring_free(ssl_state->client_connp.cert0_serial);
+        SCFree(ssl_state->client_connp.cert0_serial);
     if (ssl_state->client_connp.cert0_fingerprint)
         SCFree(ssl_state->client_connp.cert0_fingerprint);
     if (ssl_state->client_connp.sni)
@@ -2574,11 +2757,11 @@ static void SSLStateFree(void *p)
     if (ssl_state->server_connp.trec)
         SCFree(ssl_state->server_connp.trec);
     if (ssl_state->server_connp.cert0_subject)
-        rs_cstring_free(ssl_state->server_connp.cert0_subject);
+        SCFree(ssl_state->server_connp.cert0_subject);
     if (ssl_state->server_connp.cert0_issuerdn)
-        rs_cstring_free(ssl_state->server_connp.cert0_issuerdn);
+        SCFree(ssl_state->server_connp.cert0_issuerdn);
     if (ssl_state->server_connp.cert0_serial)
-        rs_cstring_free(ssl_state->server_connp.cert0_serial);
+        SCFree(ssl_state->server_connp.cert0_serial);
     if (ssl_state->server_connp.cert0_fingerprint)
         SCFree(ssl_state->server_connp.cert0_fingerprint);
     if (ssl_state->server_connp.sni)
@@ -2590,10 +2773,14 @@ static void SSLStateFree(void *p)
         Ja3BufferFree(&ssl_state->client_connp.ja3_str);
     if (ssl_state->client_connp.ja3_hash)
         SCFree(ssl_state->client_connp.ja3_hash);
+    if (ssl_state->client_connp.ja3_fields)
+        SCFree(ssl_state->client_connp.ja3_fields);
     if (ssl_state->server_connp.ja3_str)
         Ja3BufferFree(&ssl_state->server_connp.ja3_str);
     if (ssl_state->server_connp.ja3_hash)
         SCFree(ssl_state->server_connp.ja3_hash);
+    if (ssl_state->server_connp.ja3_fields)
+        SCFree(ssl_state->server_connp.ja3_fields);
 
     AppLayerDecoderEventsFreeEvents(&ssl_state->decoder_events);
 
@@ -2942,6 +3129,8 @@ void RegisterSSLParsers(void)
         }
 #endif
 
+        SSLCertCacheSetup();
+
     } else {
         SCLogConfig("Parsed disabled for %s protocol. Protocol detection"
                   "still on.", proto_name);
@@ -215,8 +215,12 @@ typedef struct SSLStateConnp_ {
 
     uint32_t cert_log_flag;
 
+    /** JA3 string, built from ja3_fields on first use */
     JA3Buffer *ja3_str;
     char *ja3_hash;
+    /** raw JA3 fields, see JA3Fields */
+    uint8_t *ja3_fields;
+    uint32_t ja3_fields_len;
 
     /* buffer for the tls record.
      * We use a malloced buffer, if the record is fragmented */
@@ -264,6 +268,12 @@ void SSLParserRegisterTests(void);
 void SSLSetEvent(SSLState *ssl_state, uint8_t event);
 void SSLVersionToString(uint16_t, char *);
 void SSLEnableJA3(void);
+JA3Buffer *SSLStateGetJA3String(SSLStateConnp *connp);
+void SSLParserCleanup(void);
+bool SSLCertCacheIsEnabled(void);
+uint64_t SSLCertCacheHitsGlobalCounter(void);
+uint64_t SSLCertCacheMissesGlobalCounter(void);
+uint64_t SSLCertCacheMemuseGlobalCounter(void);
 bool SSLJA3IsEnabled(void);
 
 #endif /* __APP_LAYER_SSL_H__ */
@@ -222,6 +222,10 @@ void RegisterTFTPParsers(void)
                                               TFTPProbingParser);
             }
         }
+        /* all TFTP opcodes have a zero high byte */
+        static const uint8_t tftp_first_bytes[] = { 0x00 };
+        AppLayerProtoDetectPPRegisterFirstBytes(IPPROTO_UDP, ALPROTO_TFTP,
+                tftp_first_bytes, sizeof(tftp_first_bytes));
     } else {
         SCLogDebug("Protocol detecter and parser disabled for TFTP.");
         return;
@@ -30,7 +30,9 @@
 #include "app-layer-parser.h"
 #include "app-layer-protos.h"
 #include "app-layer-expectation.h"
+#include "app-layer-detect-proto-cache.h"
 #include "app-layer-ftp.h"
+#include "app-layer-ssl.h"
 #include "app-layer-detect-proto.h"
 #include "stream-tcp-reassemble.h"
 #include "stream-tcp-private.h"
@@ -879,6 +881,22 @@ void AppLayerRegisterGlobalCounters(void)
     StatsRegisterGlobalCounter("ftp.memuse", FTPMemuseGlobalCounter);
     StatsRegisterGlobalCounter("ftp.memcap", FTPMemcapGlobalCounter);
     StatsRegisterGlobalCounter("app_layer.expectations", ExpectationGetCounter);
+    if (SSLCertCacheIsEnabled()) {
+        StatsRegisterGlobalCounter("tls.cert_cache.hits",
+                SSLCertCacheHitsGlobalCounter);
+        StatsRegisterGlobalCounter("tls.cert_cache.misses",
+                SSLCertCacheMissesGlobalCounter);
+        StatsRegisterGlobalCounter("tls.cert_cache.memuse",
+                SSLCertCacheMemuseGlobalCounter);
+    }
+    StatsRegisterGlobalCounter("app_layer.tx_arena.memuse",
+            AppLayerTxArenaMemuseGlobalCounter);
+    StatsRegisterGlobalCounter("app_layer.detect_cache.hits",
+            AppLayerProtoDetectCacheHitsGlobalCounter);
+    StatsRegisterGlobalCounter("app_layer.detect_cache.misses",
+            AppLayerProtoDetectCacheMissesGlobalCounter);
+    StatsRegisterGlobalCounter("app_layer.detect_cache.mismatches",
+            AppLayerProtoDetectCacheMismatchesGlobalCounter);
 }
 
 #define IPPROTOS_MAX 2
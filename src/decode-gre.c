@@ -195,84 +195,51 @@ int DecodeGRE(ThreadVars *tv, DecodeThreadVars *dtv, Packet *p, const uint8_t *p
             return TM_ECODE_OK;
     }
 
+    enum DecodeTunnelProto proto;
     switch (GRE_GET_PROTO(p->greh))
     {
         case ETHERNET_TYPE_IP:
-        {
-            Packet *tp = PacketTunnelPktSetup(tv, dtv, p, pkt + header_len,
-                    len - header_len, DECODE_TUNNEL_IPV4);
-            if (tp != NULL) {
-                PKT_SET_SRC(tp, PKT_SRC_DECODER_GRE);
-                PacketEnqueueNoLock(&tv->decode_pq,tp);
-            }
+            proto = DECODE_TUNNEL_IPV4;
             break;
-        }
 
         case GRE_PROTO_PPP:
-        {
-            Packet *tp = PacketTunnelPktSetup(tv, dtv, p, pkt + header_len,
-                    len - header_len, DECODE_TUNNEL_PPP);
-            if (tp != NULL) {
-                PKT_SET_SRC(tp, PKT_SRC_DECODER_GRE);
-                PacketEnqueueNoLock(&tv->decode_pq,tp);
-            }
+            proto = DECODE_TUNNEL_PPP;
             break;
-        }
 
         case ETHERNET_TYPE_IPV6:
-        {
-            Packet *tp = PacketTunnelPktSetup(tv, dtv, p, pkt + header_len,
-                    len - header_len, DECODE_TUNNEL_IPV6);
-            if (tp != NULL) {
-                PKT_SET_SRC(tp, PKT_SRC_DECODER_GRE);
-                PacketEnqueueNoLock(&tv->decode_pq,tp);
-            }
+            proto = DECODE_TUNNEL_IPV6;
             break;
-        }
 
         case ETHERNET_TYPE_VLAN:
-        {
-            Packet *tp = PacketTunnelPktSetup(tv, dtv, p, pkt + header_len,
-                    len - header_len, DECODE_TUNNEL_VLAN);
-            if (tp != NULL) {
-                PKT_SET_SRC(tp, PKT_SRC_DECODER_GRE);
-                PacketEnqueueNoLock(&tv->decode_pq,tp);
-            }
+            proto = DECODE_TUNNEL_VLAN;
             break;
-        }
 
         case ETHERNET_TYPE_ERSPAN:
-        {
             // Determine if it's Type I or Type II based on the flags in the GRE header.
             // Type I:  0|0|0|0|0|00000|000000000|00000
             // Type II: 0|0|0|1|0|00000|000000000|00000
             //                Seq
-            Packet *tp = PacketTunnelPktSetup(tv, dtv, p, pkt + header_len,
-                    len - header_len,
-                    GRE_FLAG_ISSET_SQ(p->greh) == 0 ?
-                            DECODE_TUNNEL_ERSPANI :
-                            DECODE_TUNNEL_ERSPANII);
-            if (tp != NULL) {
-                PKT_SET_SRC(tp, PKT_SRC_DECODER_GRE);
-                PacketEnqueueNoLock(&tv->decode_pq,tp);
-            }
+            proto = GRE_FLAG_ISSET_SQ(p->greh) == 0 ?
+                    DECODE_TUNNEL_ERSPANI : DECODE_TUNNEL_ERSPANII;
             break;
-        }
 
         case ETHERNET_TYPE_BRIDGE:
-        {
-            Packet *tp = PacketTunnelPktSetup(tv, dtv, p, pkt + header_len,
-                    len - header_len, DECODE_TUNNEL_ETHERNET);
-            if (tp != NULL) {
-                PKT_SET_SRC(tp, PKT_SRC_DECODER_GRE);
-                PacketEnqueueNoLock(&tv->decode_pq,tp);
-            }
+            proto = DECODE_TUNNEL_ETHERNET;
             break;
-        }
 
         default:
             return TM_ECODE_OK;
     }
+
+    if (PacketTunnelInPlaceSetup(p, pkt + header_len, len - header_len, proto))
+        return TM_ECODE_OK;
+
+    Packet *tp = PacketTunnelPktSetup(tv, dtv, p, pkt + header_len,
+            len - header_len, proto);
+    if (tp != NULL) {
+        PKT_SET_SRC(tp, PKT_SRC_DECODER_GRE);
+        PacketEnqueueNoLock(&tv->decode_pq,tp);
+    }
     return TM_ECODE_OK;
 }
 
@@ -39,6 +39,9 @@
 #include "util-profiling.h"
 #include "host.h"
 
+#include "conf.h"
+#include "conf-yaml-loader.h"
+
 #define VXLAN_HEADER_LEN        8
 #define VXLAN_DEFAULT_PORT      4789
 #define VXLAN_DEFAULT_PORT_S    "4789"
@@ -149,6 +152,9 @@ int DecodeVXLAN(ThreadVars *tv, DecodeThreadVars *dtv, Packet *p,
             break;
         case ETHERNET_TYPE_IP: {
             SCLogDebug("VXLAN found IPv4");
+            if (PacketTunnelInPlaceSetup(p, pkt + VXLAN_HEADER_LEN + ETHERNET_HEADER_LEN,
+                    len - (VXLAN_HEADER_LEN + ETHERNET_HEADER_LEN), DECODE_TUNNEL_IPV4))
+                break;
             Packet *tp = PacketTunnelPktSetup(tv, dtv, p, pkt + VXLAN_HEADER_LEN + ETHERNET_HEADER_LEN,
                     len - (VXLAN_HEADER_LEN + ETHERNET_HEADER_LEN), DECODE_TUNNEL_IPV4);
             if (tp != NULL) {
@@ -159,6 +165,9 @@ int DecodeVXLAN(ThreadVars *tv, DecodeThreadVars *dtv, Packet *p,
         }
         case ETHERNET_TYPE_IPV6: {
             SCLogDebug("VXLAN found IPv6");
+            if (PacketTunnelInPlaceSetup(p, pkt + VXLAN_HEADER_LEN + ETHERNET_HEADER_LEN,
+                    len - (VXLAN_HEADER_LEN + ETHERNET_HEADER_LEN), DECODE_TUNNEL_IPV6))
+                break;
             Packet *tp = PacketTunnelPktSetup(tv, dtv, p, pkt + VXLAN_HEADER_LEN + ETHERNET_HEADER_LEN,
                     len - (VXLAN_HEADER_LEN + ETHERNET_HEADER_LEN), DECODE_TUNNEL_IPV6);
             if (tp != NULL) {
@@ -257,6 +266,132 @@ static int DecodeVXLANtest02 (void)
     PacketFree(p);
     PASS;
 }
+/**
+ * \test in place decoding replaces the outer layers by the inner packet
+ */
+static int DecodeVXLANtest03 (void)
+{
+    uint8_t raw_vxlan[] = {
+        0x12, 0xb5, 0x12, 0xb5, 0x00, 0x3a, 0x87, 0x51, /* UDP header */
+        0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x25, 0x00, /* VXLAN header */
+        0x10, 0x00, 0x00, 0x0c, 0x01, 0x00, /* inner destination MAC */
+        0x00, 0x51, 0x52, 0xb3, 0x54, 0xe5, /* inner source MAC */
+        0x08, 0x00, /* another IPv4 0x0800 */
+        0x45, 0x00, 0x00, 0x1c, 0x00, 0x01, 0x00, 0x00, 0x40, 0x11,
+        0x44, 0x45, 0x0a, 0x60, 0x00, 0x0a, 0xb9, 0x1b, 0x73, 0x06,  /* IPv4 hdr */
+        0x00, 0x35, 0x30, 0x39, 0x00, 0x08, 0x98, 0xe4 /* UDP probe src port 53 */
+    };
+    const char config[] = "%YAML 1.1\n---\n"
+        "decoder:\n"
+        "  tunnel:\n"
+        "    in-place: yes\n";
+
+    ConfCreateContextBackup();
+    ConfInit();
+    ConfYamlLoadString(config, strlen(config));
+    DecodeTunnelConfig();
+
+    Packet *p = PacketGetFromAlloc();
+    FAIL_IF_NULL(p);
+    ThreadVars tv;
+    DecodeThreadVars dtv;
+
+    DecodeVXLANConfigPorts("4789");
+
+    memset(&tv, 0, sizeof(ThreadVars));
+    memset(&dtv, 0, sizeof(DecodeThreadVars));
+    FAIL_IF(PacketCopyData(p, raw_vxlan, sizeof(raw_vxlan)) != 0);
+
+    FlowInitConfig(FLOW_QUIET);
+    DecodeUDP(&tv, &dtv, p, GET_PKT_DATA(p), GET_PKT_LEN(p));
+    FAIL_IF_NOT(p->tunnel_outer->state == PKT_TUNNEL_INPLACE_PENDING);
+    FAIL_IF_NOT(p->dp == 4789);
+
+    PacketDecodeFinalize(&tv, &dtv, p);
+    FAIL_IF_NOT(p->tunnel_outer->state == PKT_TUNNEL_INPLACE_DONE);
+    FAIL_IF(tv.decode_pq.top != NULL);
+    FAIL_IF(IS_TUNNEL_PKT(p));
+    FAIL_IF_NULL(p->ip4h);
+    FAIL_IF_NULL(p->udph);
+    FAIL_IF_NOT(p->sp == 53);
+    FAIL_IF_NOT(p->recursion_level == 1);
+    FAIL_IF_NOT(p->tunnel_outer->proto == IPPROTO_UDP);
+    FAIL_IF_NOT(p->tunnel_outer->dp == 4789);
+
+    FlowShutdown();
+    PacketFree(p);
+
+    ConfDeInit();
+    ConfRestoreContextBackup();
+    DecodeTunnelConfig();
+    PASS;
+}
+
+/**
+ * \test an inner packet that fails to decode is counted once and leaves
+ *       the outer packet as it is
+ */
+static int DecodeVXLANtest04 (void)
+{
+    uint8_t raw_vxlan[] = {
+        0x12, 0xb5, 0x12, 0xb5, 0x00, 0x3a, 0x87, 0x51, /* UDP header */
+        0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x25, 0x00, /* VXLAN header */
+        0x10, 0x00, 0x00, 0x0c, 0x01, 0x00, /* inner destination MAC */
+        0x00, 0x51, 0x52, 0xb3, 0x54, 0xe5, /* inner source MAC */
+        0x08, 0x00, /* another IPv4 0x0800 */
+        0x45, 0x00, 0x00, 0x40, 0x00, 0x01, 0x00, 0x00, 0x40, 0x11,
+        0x44, 0x45, 0x0a, 0x60, 0x00, 0x0a, 0xb9, 0x1b, 0x73, 0x06,  /* IPv4 hdr, len past the data */
+        0x00, 0x35, 0x30, 0x39, 0x00, 0x08, 0x98, 0xe4 /* UDP probe src port 53 */
+    };
+    const char config[] = "%YAML 1.1\n---\n"
+        "decoder:\n"
+        "  tunnel:\n"
+        "    in-place: yes\n";
+
+    ConfCreateContextBackup();
+    ConfInit();
+    ConfYamlLoadString(config, strlen(config));
+    DecodeTunnelConfig();
+
+    Packet *p = PacketGetFromAlloc();
+    FAIL_IF_NULL(p);
+    ThreadVars tv;
+    DecodeThreadVars dtv;
+
+    DecodeVXLANConfigPorts("4789");
+
+    memset(&tv, 0, sizeof(ThreadVars));
+    memset(&dtv, 0, sizeof(DecodeThreadVars));
+    DecodeRegisterPerfCounters(&dtv, &tv);
+    StatsSetupPrivate(&tv);
+    FAIL_IF(PacketCopyData(p, raw_vxlan, sizeof(raw_vxlan)) != 0);
+
+    FlowInitConfig(FLOW_QUIET);
+    DecodeUDP(&tv, &dtv, p, GET_PKT_DATA(p), GET_PKT_LEN(p));
+    PacketDecodeFinalize(&tv, &dtv, p);
+
+    /* the inner header check failed, so nothing was set up in place */
+    FAIL_IF_NOT_NULL(p->tunnel_outer);
+    FAIL_IF(tv.decode_pq.top != NULL);
+    FAIL_IF(p->flags & PKT_IS_INVALID);
+    FAIL_IF_NULL(p->udph);
+    FAIL_IF_NOT(p->dp == 4789);
+
+    FAIL_IF_NOT(StatsGetLocalCounterValue(&tv, dtv.counter_udp) == 1);
+    FAIL_IF_NOT(StatsGetLocalCounterValue(&tv, dtv.counter_vxlan) == 1);
+    FAIL_IF_NOT(StatsGetLocalCounterValue(&tv, dtv.counter_ipv4) == 1);
+    FAIL_IF_NOT(StatsGetLocalCounterValue(&tv, dtv.counter_invalid) == 0);
+
+    DecodeVXLANConfigPorts("4789"); /* reset */
+    FlowShutdown();
+    PacketFree(p);
+    StatsThreadCleanup(&tv);
+
+    ConfDeInit();
+    ConfRestoreContextBackup();
+    DecodeTunnelConfig();
+    PASS;
+}
 #endif /* UNITTESTS */
 
 void DecodeVXLANRegisterTests(void)
@@ -266,5 +401,9 @@ void DecodeVXLANRegisterTests(void)
                    DecodeVXLANtest01);
     UtRegisterTest("DecodeVXLANtest02",
                    DecodeVXLANtest02);
+    UtRegisterTest("DecodeVXLANtest03",
+                   DecodeVXLANtest03);
+    UtRegisterTest("DecodeVXLANtest04",
+                   DecodeVXLANtest04);
 #endif /* UNITTESTS */
 }
@@ -52,6 +52,7 @@
 #include "conf.h"
 #include "decode.h"
 #include "decode-teredo.h"
+#include "decode-erspan.h"
 #include "util-debug.h"
 #include "util-mem.h"
 #include "app-layer-detect-proto.h"
@@ -67,12 +68,17 @@
 #include "output.h"
 #include "output-flow.h"
 #include "flow-storage.h"
+#include "util-numa.h"
+#include "util-validate.h"
 
 uint32_t default_packet_size = 0;
 extern bool stats_decoder_events;
 extern const char *stats_decoder_events_prefix;
 extern bool stats_stream_events;
 
+/** decode tunnels in place instead of using pseudo packets (IDS only) */
+static bool g_tunnel_inplace = false;
+
 int DecodeTunnel(ThreadVars *tv, DecodeThreadVars *dtv, Packet *p,
         const uint8_t *pkt, uint32_t len, enum DecodeTunnelProto proto)
 {
@@ -108,6 +114,83 @@ void PacketFree(Packet *p)
     SCFree(p);
 }
 
+/** \internal
+ *  \brief clear the layer 2 to 4 decoder state of a packet */
+static void PacketTunnelInPlaceReset(Packet *p)
+{
+    CLEAR_ADDR(&p->src);
+    CLEAR_ADDR(&p->dst);
+    p->sp = 0;
+    p->dp = 0;
+    p->proto = 0;
+    p->ethh = NULL;
+    if (p->ip4h != NULL) {
+        CLEAR_IPV4_PACKET(p);
+    }
+    if (p->ip6h != NULL) {
+        CLEAR_IPV6_PACKET(p);
+    }
+    if (p->tcph != NULL) {
+        CLEAR_TCP_PACKET(p);
+    }
+    if (p->udph != NULL) {
+        CLEAR_UDP_PACKET(p);
+    }
+    if (p->sctph != NULL) {
+        CLEAR_SCTP_PACKET(p);
+    }
+    if (p->icmpv4h != NULL) {
+        CLEAR_ICMPV4_PACKET(p);
+    }
+    if (p->icmpv6h != NULL) {
+        CLEAR_ICMPV6_PACKET(p);
+    }
+    p->ppph = NULL;
+    p->pppoesh = NULL;
+    p->pppoedh = NULL;
+    p->greh = NULL;
+    p->payload = NULL;
+    p->payload_len = 0;
+    p->vlan_id[0] = 0;
+    p->vlan_id[1] = 0;
+    p->vlan_idx = 0;
+    p->flow_hash = 0;
+    p->flags &= ~(PKT_WANTS_FLOW | PKT_IS_FRAGMENT);
+    PACKET_RESET_CHECKSUMS(p);
+}
+
+/** \internal
+ *  \brief decode the inner packet of a tunnel over the outer one
+ *
+ *  The outer addresses, ports and vlans are saved in p->tunnel_outer.
+ *  PacketTunnelInPlaceSetup() checked the first inner header, so the
+ *  inner decode doesn't fail.
+ */
+static void PacketDecodeTunnelInPlace(ThreadVars *tv, DecodeThreadVars *dtv, Packet *p)
+{
+    PacketTunnelOuter *outer = p->tunnel_outer;
+    const enum DecodeTunnelProto proto = outer->tunnel_proto;
+
+    COPY_ADDRESS(&p->src, &outer->src);
+    COPY_ADDRESS(&p->dst, &outer->dst);
+    outer->sp = p->sp;
+    outer->dp = p->dp;
+    outer->proto = p->proto;
+    outer->vlan_id[0] = p->vlan_id[0];
+    outer->vlan_id[1] = p->vlan_id[1];
+    outer->vlan_idx = p->vlan_idx;
+
+    PacketTunnelInPlaceReset(p);
+    p->recursion_level++;
+    /* further tunnels in the inner packet use pseudo packets */
+    outer->state = PKT_TUNNEL_INPLACE_DONE;
+
+    int ret = DecodeTunnel(tv, dtv, p, GET_PKT_DATA(p) + outer->offset,
+            outer->len, proto);
+    DEBUG_VALIDATE_BUG_ON(ret != TM_ECODE_OK);
+    (void)ret;
+}
+
 /**
  * \brief Finalize decoding of a packet
  *
@@ -117,6 +200,11 @@ void PacketFree(Packet *p)
  */
 void PacketDecodeFinalize(ThreadVars *tv, DecodeThreadVars *dtv, Packet *p)
 {
+    if (p->tunnel_outer != NULL &&
+            p->tunnel_outer->state == PKT_TUNNEL_INPLACE_PENDING) {
+        PacketDecodeTunnelInPlace(tv, dtv, p);
+    }
+
     if (p->flags & PKT_IS_INVALID) {
         StatsIncr(tv, dtv->counter_invalid);
     }
@@ -334,6 +422,112 @@ Packet *PacketTunnelPktSetup(ThreadVars *tv, DecodeThreadVars *dtv, Packet *pare
     SCReturnPtr(p, "Packet");
 }
 
+/** \internal
+ *  \brief check that the first inner header will decode
+ *
+ *  These are the checks that make DecodeTunnel() fail, so a packet is
+ *  only given up for its inner packet if that decodes. Problems further
+ *  in are left to the inner decoders, the same as for a pseudo packet.
+ *  IPv4 headers with options, VLAN, PPP and Teredo aren't checked here
+ *  and always use a pseudo packet.
+ */
+static bool PacketTunnelInPlaceCheck(const uint8_t *pkt, uint32_t len,
+        enum DecodeTunnelProto proto)
+{
+    /* the IP decoders take a 16 bit length */
+    if (len > USHRT_MAX)
+        return false;
+
+    switch (proto) {
+        case DECODE_TUNNEL_IPV4: {
+            if (len < IPV4_HEADER_LEN || IP_GET_RAW_VER(pkt) != 4)
+                return false;
+            const IPV4Hdr *ip4h = (const IPV4Hdr *)pkt;
+            const uint16_t iplen = SCNtohs(IPV4_GET_RAW_IPLEN(ip4h));
+            return ((IPV4_GET_RAW_HLEN(ip4h) << 2) == IPV4_HEADER_LEN &&
+                    iplen >= IPV4_HEADER_LEN && iplen <= len);
+        }
+        case DECODE_TUNNEL_IPV6: {
+            if (len < IPV6_HEADER_LEN || IP_GET_RAW_VER(pkt) != 6)
+                return false;
+            const IPV6Hdr *ip6h = (const IPV6Hdr *)pkt;
+            return (IPV6_HEADER_LEN + IPV6_GET_RAW_PLEN(ip6h) <= len);
+        }
+        case DECODE_TUNNEL_ETHERNET:
+        case DECODE_TUNNEL_ERSPANI:
+            return (len >= ETHERNET_HEADER_LEN);
+        case DECODE_TUNNEL_ERSPANII: {
+            if (len < sizeof(ErspanHdr) + ETHERNET_HEADER_LEN)
+                return false;
+            const ErspanHdr *ehdr = (const ErspanHdr *)pkt;
+            return ((SCNtohs(ehdr->ver_vlan) >> 12) == 1);
+        }
+        default:
+            return false;
+    }
+}
+
+/**
+ *  \brief Setup in place decoding of a tunnel
+ *
+ *  Instead of copying the inner packet into a pseudo packet, the inner
+ *  data is decoded over the outer layers of the packet itself from
+ *  PacketDecodeFinalize(). This saves a packet from the pool, a copy of
+ *  the data and a trip through the decode queue, at the cost of the outer
+ *  layers: only the inner packet goes through flow tracking, detection
+ *  and logging. What is kept of the outer layer is in p->tunnel_outer.
+ *
+ *  The first inner header is checked here the way DecodeTunnel() would,
+ *  as the outer layers can't be restored once the inner decode started.
+ *  Inner packets that don't pass use a pseudo packet.
+ *
+ *  Only used in IDS mode: in IPS mode the verdict on the outer packet
+ *  has to be based on the tunnel handling.
+ *
+ *  \param p packet from the capture method
+ *  \param pkt inner data, inside the packet data of p
+ *  \param len inner data length
+ *  \param proto protocol of the tunneled packet
+ *
+ *  \retval 1 inner packet will be decoded in place
+ *  \retval 0 in place decoding not possible, use PacketTunnelPktSetup()
+ */
+int PacketTunnelInPlaceSetup(Packet *p, const uint8_t *pkt, uint32_t len,
+        enum DecodeTunnelProto proto)
+{
+    if (!g_tunnel_inplace)
+        return 0;
+
+    /* only the first tunnel in a packet from the capture method. Pseudo
+     * packets don't pass through PacketDecodeFinalize() */
+    if ((p->tunnel_outer != NULL && p->tunnel_outer->state != 0) ||
+            p->root != NULL || IS_TUNNEL_PKT(p) || PKT_IS_PSEUDOPKT(p))
+        return 0;
+
+    if (EngineModeIsIPS())
+        return 0;
+
+    const uint8_t *data = GET_PKT_DATA(p);
+    if (pkt < data || pkt + len > data + GET_PKT_LEN(p))
+        return 0;
+
+    if (!PacketTunnelInPlaceCheck(pkt, len, proto))
+        return 0;
+
+    /* kept with the packet when it's returned to the pool */
+    if (p->tunnel_outer == NULL) {
+        p->tunnel_outer = SCCalloc(1, sizeof(PacketTunnelOuter));
+        if (unlikely(p->tunnel_outer == NULL))
+            return 0;
+    }
+
+    p->tunnel_outer->state = PKT_TUNNEL_INPLACE_PENDING;
+    p->tunnel_outer->tunnel_proto = (uint8_t)proto;
+    p->tunnel_outer->offset = (uint32_t)(pkt - data);
+    p->tunnel_outer->len = len;
+    return 1;
+}
+
 /**
  *  \brief Setup a pseudo packet (reassembled frags)
  *
@@ -513,6 +707,13 @@ void DecodeRegisterPerfCounters(DecodeThreadVars *dtv, ThreadVars *tv)
     dtv->counter_flow_icmp4 = StatsRegisterCounter("flow.icmpv4", tv);
     dtv->counter_flow_icmp6 = StatsRegisterCounter("flow.icmpv6", tv);
 
+    if (NumaIsEnabled()) {
+        dtv->counter_numa_flow_local =
+            StatsRegisterCounter("numa.flow_spare_local", tv);
+        dtv->counter_numa_flow_remote =
+            StatsRegisterCounter("numa.flow_spare_remote", tv);
+    }
+
     dtv->counter_defrag_ipv4_fragments =
         StatsRegisterCounter("defrag.ipv4.fragments", tv);
     dtv->counter_defrag_ipv4_reassembled =
@@ -729,10 +930,28 @@ void CaptureStatsSetup(ThreadVars *tv, CaptureStats *s)
     s->counter_ips_replaced = StatsRegisterCounter("ips.replaced", tv);
 }
 
+void DecodeTunnelConfig(void)
+{
+    int inplace = 0;
+    (void)ConfGetBool("decoder.tunnel.in-place", &inplace);
+
+    g_tunnel_inplace = false;
+    if (inplace) {
+        if (EngineModeIsIPS()) {
+            SCLogWarning(SC_ERR_INVALID_YAML_CONF_ENTRY,
+                    "decoder.tunnel.in-place is not supported in IPS mode");
+        } else {
+            g_tunnel_inplace = true;
+            SCLogConfig("decoding tunnels in place");
+        }
+    }
+}
+
 void DecodeGlobalConfig(void)
 {
     DecodeTeredoConfig();
     DecodeVXLANConfig();
+    DecodeTunnelConfig();
 }
 
 /**
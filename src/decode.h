@@ -294,10 +294,10 @@ typedef struct PacketAlert_ {
 
 typedef struct PacketAlerts_ {
     uint16_t cnt;
-    PacketAlert alerts[PACKET_ALERT_MAX];
     /* single pa used when we're dropping,
      * so we can log it out in the drop log. */
     PacketAlert drop;
+    PacketAlert alerts[PACKET_ALERT_MAX];
 } PacketAlerts;
 
 /** number of decoder events we support per packet. Power of 2 minus 1
@@ -388,6 +388,28 @@ typedef struct PktProfiling_ {
 
 #endif /* PROFILING */
 
+/** in place tunnel decoding state, see PacketTunnelInPlaceSetup() */
+#define PKT_TUNNEL_INPLACE_PENDING  1   /**< inner packet to be decoded */
+#define PKT_TUNNEL_INPLACE_DONE     2   /**< packet holds the inner layers */
+
+/** \brief outer layer of a tunnel decoded in place
+ *
+ *  When a tunnel is decoded in place the inner headers replace the outer
+ *  ones in the Packet. What is kept of the outer layer is stored here. */
+typedef struct PacketTunnelOuter_ {
+    Address src;
+    Address dst;
+    Port sp;
+    Port dp;
+    uint8_t proto;
+    uint8_t state;          /**< PKT_TUNNEL_INPLACE_* */
+    uint8_t tunnel_proto;   /**< enum DecodeTunnelProto of the inner data */
+    uint8_t vlan_idx;
+    uint16_t vlan_id[2];
+    uint32_t offset;        /**< offset of the inner data in the pkt data */
+    uint32_t len;           /**< length of the inner data */
+} PacketTunnelOuter;
+
 /* forward declaration since Packet struct definition requires this */
 struct PacketQueue_;
 
@@ -409,6 +431,12 @@ struct PacketQueue_;
  */
 typedef struct Packet_
 {
+    /* The members are grouped by how often they are used. The members
+     * that decode, flow, stream and detect use and the ones PACKET_REINIT
+     * resets for each packet come first. The alert array, the tunnel mutex
+     * and profiling follow after those. Keep it that way when adding
+     * members. */
+
     /* Addresses, Ports and protocol
      * these are on top so we can use
      * the Packet as a hash key */
@@ -451,59 +479,50 @@ typedef struct Packet_
      * hash size still */
     uint32_t flow_hash;
 
-    struct timeval ts;
+    /* storage: set to pointer to heap and extended via allocation if necessary */
+    uint32_t pktlen;
+    uint8_t *ext_pkt;
 
-    union {
-        /* nfq stuff */
-#ifdef HAVE_NFLOG
-        NFLOGPacketVars nflog_v;
-#endif /* HAVE_NFLOG */
-#ifdef NFQ
-        NFQPacketVars nfq_v;
-#endif /* NFQ */
-#ifdef IPFW
-        IPFWPacketVars ipfw_v;
-#endif /* IPFW */
-#ifdef AF_PACKET
-        AFPPacketVars afp_v;
-#endif
-#ifdef HAVE_NETMAP
-        NetmapPacketVars netmap_v;
-#endif
-#ifdef HAVE_PFRING
-#ifdef HAVE_PF_RING_FLOW_OFFLOAD
-        PfringPacketVars pfring_v;
-#endif
-#endif
-#ifdef WINDIVERT
-        WinDivertPacketVars windivert_v;
-#endif /* WINDIVERT */
+    struct timeval ts;
 
-        /** libpcap vars: shared by Pcap Live mode and Pcap File mode */
-        PcapPacketVars pcap_v;
-    };
+    /* ptr to the payload of the packet
+     * with it's length. */
+    uint8_t *payload;
+    uint16_t payload_len;
 
-    /** The release function for packet structure and data */
-    void (*ReleasePacket)(struct Packet_ *);
-    /** The function triggering bypass the flow in the capture method.
-     * Return 1 for success and 0 on error */
-    int (*BypassPacketsFlow)(struct Packet_ *);
+    /* IPS action to take */
+    uint8_t action;
 
-    /* pkt vars */
-    PktVar *pktvar;
+    uint8_t pkt_src;
 
-    /* header pointers */
-    EthernetHdr *ethh;
+    /** data linktype in host order */
+    int datalink;
 
     /* Checksum for IP packets. */
     int32_t level3_comp_csum;
     /* Check sum for TCP, UDP or ICMP packets */
     int32_t level4_comp_csum;
 
+    /** tenant id for this packet, if any. If 0 then no tenant was assigned. */
+    uint32_t tenant_id;
+
+    /* header pointers */
+    EthernetHdr *ethh;
+
     IPV4Hdr *ip4h;
 
     IPV6Hdr *ip6h;
 
+    TCPHdr *tcph;
+
+    UDPHdr *udph;
+
+    SCTPHdr *sctph;
+
+    ICMPV4Hdr *icmpv4h;
+
+    ICMPV6Hdr *icmpv6h;
+
     /* IPv4 and IPv6 are mutually exclusive */
     union {
         IPV4Vars ip4vars;
@@ -512,6 +531,26 @@ typedef struct Packet_
             IPV6ExtHdrs ip6eh;
         };
     };
+
+    /* tunnel/encapsulation handling */
+    struct Packet_ *root; /* in case of tunnel this is a ptr
+                           * to the 'real' packet, the one we
+                           * need to set the verdict on --
+                           * It should always point to the lowest
+                           * packet in a encapsulated packet */
+
+    /* double linked list ptrs */
+    struct Packet_ *next;
+    struct Packet_ *prev;
+
+    /* The Packet pool from which this packet was allocated. Used when returning
+     * the packet to its owner's stack. If NULL, then allocated with malloc.
+     */
+    struct PktPool_ *pool;
+
+    /** The release function for packet structure and data */
+    void (*ReleasePacket)(struct Packet_ *);
+
     /* Can only be one of TCP, UDP, ICMP at any given time */
     union {
         TCPVars tcpvars;
@@ -522,84 +561,83 @@ typedef struct Packet_
 #define icmpv4vars  l4vars.icmpv4vars
 #define icmpv6vars  l4vars.icmpv6vars
 
-    TCPHdr *tcph;
-
-    UDPHdr *udph;
-
-    SCTPHdr *sctph;
-
-    ICMPV4Hdr *icmpv4h;
-
-    ICMPV6Hdr *icmpv6h;
-
-    PPPHdr *ppph;
-    PPPOESessionHdr *pppoesh;
-    PPPOEDiscoveryHdr *pppoedh;
-
-    GREHdr *greh;
-
-    /* ptr to the payload of the packet
-     * with it's length. */
-    uint8_t *payload;
-    uint16_t payload_len;
-
-    /* IPS action to take */
-    uint8_t action;
-
-    uint8_t pkt_src;
+    struct Host_ *host_src;
+    struct Host_ *host_dst;
 
-    /* storage: set to pointer to heap and extended via allocation if necessary */
-    uint32_t pktlen;
-    uint8_t *ext_pkt;
+    /* pkt vars */
+    PktVar *pktvar;
 
     /* Incoming interface */
     struct LiveDevice_ *livedev;
 
-    PacketAlerts alerts;
-
-    struct Host_ *host_src;
-    struct Host_ *host_dst;
+    /* engine events */
+    PacketEngineEvents events;
 
     /** packet number in the pcap file, matches wireshark */
     uint64_t pcap_cnt;
 
+    /* capture method state, used on release */
+    union {
+        /* nfq stuff */
+#ifdef HAVE_NFLOG
+        NFLOGPacketVars nflog_v;
+#endif /* HAVE_NFLOG */
+#ifdef NFQ
+        NFQPacketVars nfq_v;
+#endif /* NFQ */
+#ifdef IPFW
+        IPFWPacketVars ipfw_v;
+#endif /* IPFW */
+#ifdef AF_PACKET
+        AFPPacketVars afp_v;
+#endif
+#ifdef HAVE_NETMAP
+        NetmapPacketVars netmap_v;
+#endif
+#ifdef HAVE_PFRING
+#ifdef HAVE_PF_RING_FLOW_OFFLOAD
+        PfringPacketVars pfring_v;
+#endif
+#endif
+#ifdef WINDIVERT
+        WinDivertPacketVars windivert_v;
+#endif /* WINDIVERT */
 
-    /* engine events */
-    PacketEngineEvents events;
+        /** libpcap vars: shared by Pcap Live mode and Pcap File mode */
+        PcapPacketVars pcap_v;
+    };
 
     AppLayerDecoderEvents *app_layer_events;
 
-    /* double linked list ptrs */
-    struct Packet_ *next;
-    struct Packet_ *prev;
+    /** The function triggering bypass the flow in the capture method.
+     * Return 1 for success and 0 on error */
+    int (*BypassPacketsFlow)(struct Packet_ *);
 
-    /** data linktype in host order */
-    int datalink;
+    /* less common link and tunnel headers */
+    PPPHdr *ppph;
+    PPPOESessionHdr *pppoesh;
+    PPPOEDiscoveryHdr *pppoedh;
 
-    /* tunnel/encapsulation handling */
-    struct Packet_ *root; /* in case of tunnel this is a ptr
-                           * to the 'real' packet, the one we
-                           * need to set the verdict on --
-                           * It should always point to the lowest
-                           * packet in a encapsulated packet */
+    GREHdr *greh;
 
-    /** mutex to protect access to:
-     *  - tunnel_rtv_cnt
-     *  - tunnel_tpr_cnt
-     */
-    SCMutex tunnel_mutex;
     /* ready to set verdict counter, only set in root */
     uint16_t tunnel_rtv_cnt;
     /* tunnel packet ref count */
     uint16_t tunnel_tpr_cnt;
 
-    /** tenant id for this packet, if any. If 0 then no tenant was assigned. */
-    uint32_t tenant_id;
+    /* outer layer of a tunnel decoded in place. Allocated the first time
+     * the packet is used for it, so only with decoder.tunnel.in-place */
+    PacketTunnelOuter *tunnel_outer;
 
-    /* The Packet pool from which this packet was allocated. Used when returning
-     * the packet to its owner's stack. If NULL, then allocated with malloc.
+    /* the alert count and drop alert are reset for each packet, the alert
+     * array after them is only used for packets that alert */
+    PacketAlerts alerts;
+
+    /** mutex to protect access to:
+     *  - tunnel_rtv_cnt
+     *  - tunnel_tpr_cnt
      */
-    struct PktPool_ *pool;
+    SCMutex tunnel_mutex;
 
 #ifdef PROFILING
     PktProfiling *profile;
@@ -676,6 +714,9 @@ typedef struct DecodeThreadVars_
     uint16_t counter_flow_icmp4;
     uint16_t counter_flow_icmp6;
 
+    uint16_t counter_numa_flow_local;
+    uint16_t counter_numa_flow_remote;
+
     uint16_t counter_engine_events[DECODE_EVENT_MAX];
 
     /* thread data for flow logging api: only used at forced
@@ -793,6 +834,9 @@ void CaptureStatsSetup(ThreadVars *tv, CaptureStats *s);
         (p)->pcap_cnt = 0;                      \
         (p)->tunnel_rtv_cnt = 0;                \
         (p)->tunnel_tpr_cnt = 0;                \
+        if ((p)->tunnel_outer != NULL) {        \
+            (p)->tunnel_outer->state = 0;       \
+        }                                       \
         (p)->events.cnt = 0;                    \
         AppLayerDecoderEventsResetEvents((p)->app_layer_events); \
         (p)->next = NULL;                       \
@@ -818,6 +862,9 @@ void CaptureStatsSetup(ThreadVars *tv, CaptureStats *s);
         }                                       \
         PACKET_FREE_EXTDATA((p));               \
         SCMutexDestroy(&(p)->tunnel_mutex);     \
+        if ((p)->tunnel_outer != NULL) {        \
+            SCFree((p)->tunnel_outer);          \
+        }                                       \
         AppLayerDecoderEventsFreeEvents(&(p)->app_layer_events); \
         PACKET_PROFILING_RESET((p));            \
     } while (0)
@@ -892,6 +939,8 @@ enum DecodeTunnelProto {
 
 Packet *PacketTunnelPktSetup(ThreadVars *tv, DecodeThreadVars *dtv, Packet *parent,
                              const uint8_t *pkt, uint32_t len, enum DecodeTunnelProto proto);
+int PacketTunnelInPlaceSetup(Packet *p, const uint8_t *pkt, uint32_t len,
+        enum DecodeTunnelProto proto);
 Packet *PacketDefragPktSetup(Packet *parent, const uint8_t *pkt, uint32_t len, uint8_t proto);
 void PacketDefragPktSetupParent(Packet *parent);
 void DecodeRegisterPerfCounters(DecodeThreadVars *, ThreadVars *);
@@ -952,6 +1001,7 @@ void AddressDebugPrint(Address *);
 typedef int (*DecoderFunc)(ThreadVars *tv, DecodeThreadVars *dtv, Packet *p,
          const uint8_t *pkt, uint32_t len);
 void DecodeGlobalConfig(void);
+void DecodeTunnelConfig(void);
 void DecodeUnregisterCounters(void);
 
 /** \brief Set the No payload inspection Flag for the packet.
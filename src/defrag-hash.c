@@ -32,6 +32,8 @@ SC_ATOMIC_DECLARE(uint64_t,defrag_memuse);
 SC_ATOMIC_DECLARE(unsigned int,defragtracker_counter);
 SC_ATOMIC_DECLARE(unsigned int,defragtracker_prune_idx);
 
+HASH_TEMPLATE_MEMUSE_FUNCS(Defrag, defrag_memuse, defrag_config.memcap)
+
 static DefragTracker *DefragTrackerGetUsedDefragTracker(void);
 
 /** queue with spare tracker */
@@ -87,11 +89,11 @@ void DefragTrackerMoveToSpare(DefragTracker *h)
 
 static DefragTracker *DefragTrackerAlloc(void)
 {
-    if (!(DEFRAG_CHECK_MEMCAP(sizeof(DefragTracker)))) {
+    if (!(DefragMemuseCheck(sizeof(DefragTracker)))) {
         return NULL;
     }
 
-    (void) SC_ATOMIC_ADD(defrag_memuse, sizeof(DefragTracker));
+    DefragMemuseAdd(sizeof(DefragTracker));
 
     DefragTracker *dt = SCMalloc(sizeof(DefragTracker));
     if (unlikely(dt == NULL))
@@ -114,7 +116,7 @@ static void DefragTrackerFree(DefragTracker *dt)
 
         SCMutexDestroy(&dt->lock);
         SCFree(dt);
-        (void) SC_ATOMIC_SUB(defrag_memuse, sizeof(DefragTracker));
+        DefragMemuseSub(sizeof(DefragTracker));
     }
 }
 
@@ -123,7 +125,7 @@ static void DefragTrackerFree(DefragTracker *dt)
 #define DefragTrackerDecrUsecnt(dt) \
     SC_ATOMIC_SUB((dt)->use_cnt, 1)
 
-static void DefragTrackerInit(DefragTracker *dt, Packet *p)
+static void DefragTrackerInit(DefragTracker *dt, Packet *p, const uint32_t hash)
 {
     /* copy address */
     COPY_ADDRESS(&p->src, &dt->src_addr);
@@ -143,6 +145,7 @@ static void DefragTrackerInit(DefragTracker *dt, Packet *p)
     dt->host_timeout = DefragPolicyGetHostTimeout(p);
     dt->remove = 0;
     dt->seen_last = 0;
+    dt->hfp = hash;
 
     (void) DefragTrackerIncrUsecnt(dt);
 }
@@ -174,6 +177,7 @@ void DefragInitConfig(char quiet)
     SC_ATOMIC_INIT(defragtracker_counter);
     SC_ATOMIC_INIT(defrag_memuse);
     SC_ATOMIC_INIT(defragtracker_prune_idx);
+    DefragMemuseReset();
     SC_ATOMIC_INIT(defrag_config.memcap);
     DefragTrackerQueueInit(&defragtracker_spare_q);
 
@@ -235,7 +239,7 @@ void DefragInitConfig(char quiet)
                 (uintmax_t)sizeof(DefragTrackerHashRow));
         exit(EXIT_FAILURE);
     }
-    defragtracker_hash = SCCalloc(defrag_config.hash_size, sizeof(DefragTrackerHashRow));
+    defragtracker_hash = SCMallocAligned(defrag_config.hash_size * sizeof(DefragTrackerHashRow), CLS);
     if (unlikely(defragtracker_hash == NULL)) {
         SCLogError(SC_ERR_FATAL, "Fatal error encountered in DefragTrackerInitConfig. Exiting...");
         exit(EXIT_FAILURE);
@@ -324,7 +328,7 @@ void DefragHashShutdown(void)
 
             DRLOCK_DESTROY(&defragtracker_hash[u]);
         }
-        SCFree(defragtracker_hash);
+        SCFreeAligned(defragtracker_hash);
         defragtracker_hash = NULL;
     }
     (void) SC_ATOMIC_SUB(defrag_memuse, defrag_config.hash_size * sizeof(DefragTrackerHashRow));
@@ -393,9 +397,9 @@ typedef struct DefragHashKey6_ {
  *  id
  *  vlan_id
  */
-static inline uint32_t DefragHashGetKey(Packet *p)
+static inline uint32_t DefragHashGetHash(Packet *p)
 {
-    uint32_t key;
+    uint32_t hash;
 
     if (p->ip4h != NULL) {
         DefragHashKey4 dhk;
@@ -410,8 +414,7 @@ static inline uint32_t DefragHashGetKey(Packet *p)
         dhk.vlan_id[0] = p->vlan_id[0];
         dhk.vlan_id[1] = p->vlan_id[1];
 
-        uint32_t hash = hashword(dhk.u32, 4, defrag_config.hash_rand);
-        key = hash % defrag_config.hash_size;
+        hash = hashword(dhk.u32, 4, defrag_config.hash_rand);
     } else if (p->ip6h != NULL) {
         DefragHashKey6 dhk;
         if (DefragHashRawAddressIPv6GtU32(p->src.addr_data32, p->dst.addr_data32)) {
@@ -437,12 +440,11 @@ static inline uint32_t DefragHashGetKey(Packet *p)
         dhk.vlan_id[0] = p->vlan_id[0];
         dhk.vlan_id[1] = p->vlan_id[1];
 
-        uint32_t hash = hashword(dhk.u32, 10, defrag_config.hash_rand);
-        key = hash % defrag_config.hash_size;
+        hash = hashword(dhk.u32, 10, defrag_config.hash_rand);
     } else
-        key = 0;
+        hash = 0;
 
-    return key;
+    return hash;
 }
 
 /* Since two or more trackers can have the same hash key, we need to compare
@@ -469,6 +471,26 @@ static inline int DefragTrackerCompare(DefragTracker *t, Packet *p)
     return CMP_DEFRAGTRACKER(t, p, id);
 }
 
+/** lookup match: any tracker for the packet */
+static bool DefragTrackerMatch(const DefragTracker *dt, const void *data)
+{
+    return DefragTrackerCompare((DefragTracker *)dt, (Packet *)data) != 0;
+}
+
+/** get match: skip trackers that are done and wait for the timeout
+ *  code to remove them, so that a new tracker is set up instead */
+static bool DefragTrackerMatchActive(const DefragTracker *dt, const void *data)
+{
+    return !dt->remove && DefragTrackerCompare((DefragTracker *)dt, (Packet *)data) != 0;
+}
+
+/** never prune a tracker that is used by a packets
+ *  we are currently processing in one of the threads */
+#define DefragTrackerEvictable(dt) (SC_ATOMIC_GET((dt)->use_cnt) == 0)
+
+HASH_TEMPLATE_GET_USED_FUNC(DefragTracker, DefragTrackerHashRow, DefragTracker,
+        DRLOCK, lock, DefragTrackerEvictable)
+
 /**
  *  \brief Get a new defrag tracker
  *
@@ -485,7 +507,7 @@ static DefragTracker *DefragTrackerGetNew(Packet *p)
     dt = DefragTrackerDequeue(&defragtracker_spare_q);
     if (dt == NULL) {
         /* If we reached the max memcap, we get a used tracker */
-        if (!(DEFRAG_CHECK_MEMCAP(sizeof(DefragTracker)))) {
+        if (!(DefragMemuseCheck(sizeof(DefragTracker)))) {
             /* declare state of emergency */
             //if (!(SC_ATOMIC_GET(defragtracker_flags) & DEFRAG_EMERGENCY)) {
             //    SC_ATOMIC_OR(defragtracker_flags, DEFRAG_EMERGENCY);
@@ -527,98 +549,36 @@ static DefragTracker *DefragTrackerGetNew(Packet *p)
  * Hash retrieval function for trackers. Looks up the hash bucket containing the
  * tracker pointer. Then compares the packet with the found tracker to see if it is
  * the tracker we need. If it isn't, walk the list until the right tracker is found.
+ * If it isn't in the list, a new tracker is added to the tail of the list.
  *
  * returns a *LOCKED* tracker or NULL
  */
 DefragTracker *DefragGetTrackerFromHash (Packet *p)
 {
-    DefragTracker *dt = NULL;
-
-    /* get the key to our bucket */
-    uint32_t key = DefragHashGetKey(p);
-    /* get our hash bucket and lock it */
-    DefragTrackerHashRow *hb = &defragtracker_hash[key];
+    /* get the hash and our bucket, and lock it */
+    const uint32_t hash = DefragHashGetHash(p);
+    DefragTrackerHashRow *hb = &defragtracker_hash[hash % defrag_config.hash_size];
     DRLOCK_LOCK(hb);
 
-    /* see if the bucket already has a tracker */
-    if (hb->head == NULL) {
-        dt = DefragTrackerGetNew(p);
-        if (dt == NULL) {
-            DRLOCK_UNLOCK(hb);
-            return NULL;
-        }
-
-        /* tracker is locked */
-        hb->head = dt;
-        hb->tail = dt;
-
-        /* got one, now lock, initialize and return */
-        DefragTrackerInit(dt,p);
-
+    DefragTracker *dt = DefragTrackerRowFind(hb, hash, DefragTrackerMatchActive, p);
+    if (dt != NULL) {
+        /* found our tracker, lock & return */
+        SCMutexLock(&dt->lock);
+        (void) DefragTrackerIncrUsecnt(dt);
         DRLOCK_UNLOCK(hb);
         return dt;
     }
 
-    /* ok, we have a tracker in the bucket. Let's find out if it is our tracker */
-    dt = hb->head;
-
-    /* see if this is the tracker we are looking for */
-    if (dt->remove || DefragTrackerCompare(dt, p) == 0) {
-        DefragTracker *pdt = NULL; /* previous tracker */
-
-        while (dt) {
-            pdt = dt;
-            dt = dt->hnext;
-
-            if (dt == NULL) {
-                dt = pdt->hnext = DefragTrackerGetNew(p);
-                if (dt == NULL) {
-                    DRLOCK_UNLOCK(hb);
-                    return NULL;
-                }
-                hb->tail = dt;
-
-                /* tracker is locked */
-
-                dt->hprev = pdt;
-
-                /* initialize and return */
-                DefragTrackerInit(dt,p);
-
-                DRLOCK_UNLOCK(hb);
-                return dt;
-            }
-
-            if (DefragTrackerCompare(dt, p) != 0) {
-                /* we found our tracker, lets put it on top of the
-                 * hash list -- this rewards active trackers */
-                if (dt->hnext) {
-                    dt->hnext->hprev = dt->hprev;
-                }
-                if (dt->hprev) {
-                    dt->hprev->hnext = dt->hnext;
-                }
-                if (dt == hb->tail) {
-                    hb->tail = dt->hprev;
-                }
-
-                dt->hnext = hb->head;
-                dt->hprev = NULL;
-                hb->head->hprev = dt;
-                hb->head = dt;
-
-                /* found our tracker, lock & return */
-                SCMutexLock(&dt->lock);
-                (void) DefragTrackerIncrUsecnt(dt);
-                DRLOCK_UNLOCK(hb);
-                return dt;
-            }
-        }
+    dt = DefragTrackerGetNew(p);
+    if (dt == NULL) {
+        DRLOCK_UNLOCK(hb);
+        return NULL;
     }
 
-    /* lock & return */
-    SCMutexLock(&dt->lock);
-    (void) DefragTrackerIncrUsecnt(dt);
+    /* tracker is locked, initialize, add and return */
+    DefragTrackerInit(dt, p, hash);
+    DefragTrackerRowAppend(hb, dt);
+
     DRLOCK_UNLOCK(hb);
     return dt;
 }
@@ -631,63 +591,17 @@ DefragTracker *DefragGetTrackerFromHash (Packet *p)
  */
 DefragTracker *DefragLookupTrackerFromHash (Packet *p)
 {
-    DefragTracker *dt = NULL;
-
-    /* get the key to our bucket */
-    uint32_t key = DefragHashGetKey(p);
-    /* get our hash bucket and lock it */
-    DefragTrackerHashRow *hb = &defragtracker_hash[key];
+    /* get the hash and our bucket, and lock it */
+    const uint32_t hash = DefragHashGetHash(p);
+    DefragTrackerHashRow *hb = &defragtracker_hash[hash % defrag_config.hash_size];
     DRLOCK_LOCK(hb);
 
-    /* see if the bucket already has a tracker */
-    if (hb->head == NULL) {
-        DRLOCK_UNLOCK(hb);
-        return dt;
-    }
-
-    /* ok, we have a tracker in the bucket. Let's find out if it is our tracker */
-    dt = hb->head;
-
-    /* see if this is the tracker we are looking for */
-    if (DefragTrackerCompare(dt, p) == 0) {
-        while (dt) {
-            dt = dt->hnext;
-
-            if (dt == NULL) {
-                DRLOCK_UNLOCK(hb);
-                return dt;
-            }
-
-            if (DefragTrackerCompare(dt, p) != 0) {
-                /* we found our tracker, lets put it on top of the
-                 * hash list -- this rewards active tracker */
-                if (dt->hnext) {
-                    dt->hnext->hprev = dt->hprev;
-                }
-                if (dt->hprev) {
-                    dt->hprev->hnext = dt->hnext;
-                }
-                if (dt == hb->tail) {
-                    hb->tail = dt->hprev;
-                }
-
-                dt->hnext = hb->head;
-                dt->hprev = NULL;
-                hb->head->hprev = dt;
-                hb->head = dt;
-
-                /* found our tracker, lock & return */
-                SCMutexLock(&dt->lock);
-                (void) DefragTrackerIncrUsecnt(dt);
-                DRLOCK_UNLOCK(hb);
-                return dt;
-            }
-        }
+    DefragTracker *dt = DefragTrackerRowFind(hb, hash, DefragTrackerMatch, p);
+    if (dt != NULL) {
+        /* lock & return */
+        SCMutexLock(&dt->lock);
+        (void) DefragTrackerIncrUsecnt(dt);
     }
-
-    /* lock & return */
-    SCMutexLock(&dt->lock);
-    (void) DefragTrackerIncrUsecnt(dt);
     DRLOCK_UNLOCK(hb);
     return dt;
 }
@@ -705,60 +619,18 @@ DefragTracker *DefragLookupTrackerFromHash (Packet *p)
  */
 static DefragTracker *DefragTrackerGetUsedDefragTracker(void)
 {
-    uint32_t idx = SC_ATOMIC_GET(defragtracker_prune_idx) % defrag_config.hash_size;
-    uint32_t cnt = defrag_config.hash_size;
-
-    while (cnt--) {
-        if (++idx >= defrag_config.hash_size)
-            idx = 0;
-
-        DefragTrackerHashRow *hb = &defragtracker_hash[idx];
-
-        if (DRLOCK_TRYLOCK(hb) != 0)
-            continue;
-
-        DefragTracker *dt = hb->tail;
-        if (dt == NULL) {
-            DRLOCK_UNLOCK(hb);
-            continue;
-        }
-
-        if (SCMutexTrylock(&dt->lock) != 0) {
-            DRLOCK_UNLOCK(hb);
-            continue;
-        }
-
-        /** never prune a tracker that is used by a packets
-         *  we are currently processing in one of the threads */
-        if (SC_ATOMIC_GET(dt->use_cnt) > 0) {
-            DRLOCK_UNLOCK(hb);
-            SCMutexUnlock(&dt->lock);
-            continue;
-        }
-
-        /* remove from the hash */
-        if (dt->hprev != NULL)
-            dt->hprev->hnext = dt->hnext;
-        if (dt->hnext != NULL)
-            dt->hnext->hprev = dt->hprev;
-        if (hb->head == dt)
-            hb->head = dt->hnext;
-        if (hb->tail == dt)
-            hb->tail = dt->hprev;
-
-        dt->hnext = NULL;
-        dt->hprev = NULL;
-        DRLOCK_UNLOCK(hb);
-
-        DefragTrackerClearMemory(dt);
+    uint32_t walked = 0;
+    DefragTracker *dt = DefragTrackerGetUsed(defragtracker_hash, defrag_config.hash_size,
+            SC_ATOMIC_GET(defragtracker_prune_idx), &walked);
+    if (dt == NULL)
+        return NULL;
 
-        SCMutexUnlock(&dt->lock);
+    DefragTrackerClearMemory(dt);
 
-        (void) SC_ATOMIC_ADD(defragtracker_prune_idx, (defrag_config.hash_size - cnt));
-        return dt;
-    }
+    SCMutexUnlock(&dt->lock);
 
-    return NULL;
+    (void) SC_ATOMIC_ADD(defragtracker_prune_idx, walked);
+    return dt;
 }
 
 
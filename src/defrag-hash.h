@@ -26,6 +26,7 @@
 
 #include "decode.h"
 #include "defrag.h"
+#include "util-hash-template.h"
 
 /** Spinlocks or Mutex for the flow buckets. */
 //#define DRLOCK_SPIN
@@ -56,10 +57,10 @@
 #endif
 
 typedef struct DefragTrackerHashRow_ {
-    DRLOCK_TYPE lock;
-    DefragTracker *head;
-    DefragTracker *tail;
-} DefragTrackerHashRow;
+    HASH_TEMPLATE_ROW_FIELDS(DefragTracker, DRLOCK_TYPE)
+} __attribute__((aligned(CLS))) DefragTrackerHashRow;
+
+HASH_TEMPLATE_ROW_FUNCS(DefragTracker, DefragTrackerHashRow, DefragTracker, hnext, hprev)
 
 /** defrag tracker hash table */
 extern DefragTrackerHashRow *defragtracker_hash;
@@ -30,15 +30,7 @@
 #include "util-error.h"
 #include "util-debug.h"
 #include "util-print.h"
-
-DefragTrackerQueue *DefragTrackerQueueInit (DefragTrackerQueue *q)
-{
-    if (q != NULL) {
-        memset(q, 0, sizeof(DefragTrackerQueue));
-        DQLOCK_INIT(q);
-    }
-    return q;
-}
+#include "util-hash-template.h"
 
 DefragTrackerQueue *DefragTrackerQueueNew()
 {
@@ -51,94 +43,5 @@ DefragTrackerQueue *DefragTrackerQueueNew()
     return q;
 }
 
-/**
- *  \brief Destroy a tracker queue
- *
- *  \param q the tracker queue to destroy
- */
-void DefragTrackerQueueDestroy (DefragTrackerQueue *q)
-{
-    DQLOCK_DESTROY(q);
-}
-
-/**
- *  \brief add a tracker to a queue
- *
- *  \param q queue
- *  \param dt tracker
- */
-void DefragTrackerEnqueue (DefragTrackerQueue *q, DefragTracker *dt)
-{
-#ifdef DEBUG
-    BUG_ON(q == NULL || dt == NULL);
-#endif
-
-    DQLOCK_LOCK(q);
-
-    /* more trackers in queue */
-    if (q->top != NULL) {
-        dt->lnext = q->top;
-        q->top->lprev = dt;
-        q->top = dt;
-    /* only tracker */
-    } else {
-        q->top = dt;
-        q->bot = dt;
-    }
-    q->len++;
-#ifdef DBG_PERF
-    if (q->len > q->dbg_maxlen)
-        q->dbg_maxlen = q->len;
-#endif /* DBG_PERF */
-    DQLOCK_UNLOCK(q);
-}
-
-/**
- *  \brief remove a tracker from the queue
- *
- *  \param q queue
- *
- *  \retval dt tracker or NULL if empty list.
- */
-DefragTracker *DefragTrackerDequeue (DefragTrackerQueue *q)
-{
-    DQLOCK_LOCK(q);
-
-    DefragTracker *dt = q->bot;
-    if (dt == NULL) {
-        DQLOCK_UNLOCK(q);
-        return NULL;
-    }
-
-    /* more packets in queue */
-    if (q->bot->lprev != NULL) {
-        q->bot = q->bot->lprev;
-        q->bot->lnext = NULL;
-    /* just the one we remove, so now empty */
-    } else {
-        q->top = NULL;
-        q->bot = NULL;
-    }
-
-#ifdef DEBUG
-    BUG_ON(q->len == 0);
-#endif
-    if (q->len > 0)
-        q->len--;
-
-    dt->lnext = NULL;
-    dt->lprev = NULL;
-
-    DQLOCK_UNLOCK(q);
-    return dt;
-}
-
-uint32_t DefragTrackerQueueLen(DefragTrackerQueue *q)
-{
-    uint32_t len;
-    DQLOCK_LOCK(q);
-    len = q->len;
-    DQLOCK_UNLOCK(q);
-    return len;
-}
+HASH_TEMPLATE_QUEUE_FUNCS(, DefragTracker, DefragTrackerQueue, DefragTracker, lnext, lprev, DQLOCK)
 
@@ -512,6 +512,185 @@ error_remove_tracker:
     return NULL;
 }
 
+/**
+ * \brief Check for the common case of a datagram in two fragments
+ *        arriving in order.
+ *
+ * \param frag_offset offset of the new fragment, which has to be the last
+ *
+ * \retval first the first fragment if the new fragment completes it
+ *         without overlap, NULL otherwise
+ */
+static Frag *
+DefragTwoFragInOrder(DefragTracker *tracker, uint16_t frag_offset,
+        uint8_t more_frags)
+{
+    if (more_frags || frag_offset == 0)
+        return NULL;
+
+    Frag *first = RB_ROOT(&tracker->fragment_tree);
+    if (first == NULL || RB_LEFT(first, rb) != NULL || RB_RIGHT(first, rb) != NULL)
+        return NULL;
+    if (first->offset != 0 || !first->more_frags || first->skip || first->ltrim != 0)
+        return NULL;
+    if (first->data_len != frag_offset)
+        return NULL;
+    return first;
+}
+
+/**
+ * Re-assemble an IPv4 packet from its stored first fragment and the
+ * last fragment in p, without adding the last one to the tracker.
+ */
+static Packet *
+Defrag4ReassembleTwo(DefragTracker *tracker, Frag *first, Packet *p,
+        uint16_t frag_offset, uint16_t data_offset, uint16_t data_len)
+{
+    Packet *rp = NULL;
+    const int fragmentable_offset = first->ip_hdr_offset + first->hlen;
+    const int fragmentable_len = frag_offset + data_len;
+
+    if (first->len < sizeof(IPV4Hdr)) {
+        goto error_remove_tracker;
+    }
+    if (fragmentable_offset + fragmentable_len > (int)MAX_PAYLOAD_SIZE) {
+        SCLogWarning(SC_ERR_REASSEMBLY, "Failed re-assemble "
+                "fragmented packet, exceeds size of packet buffer.");
+        goto error_remove_tracker;
+    }
+
+    rp = PacketDefragPktSetup(p, NULL, 0, IPV4_GET_IPPROTO(p));
+    if (rp == NULL) {
+        SCLogError(SC_ERR_MEM_ALLOC, "Failed to allocate packet for "
+                   "fragmentation re-assembly, dumping fragments.");
+        goto error_remove_tracker;
+    }
+    PKT_SET_SRC(rp, PKT_SRC_DEFRAG);
+    rp->flags |= PKT_REBUILT_FRAGMENT;
+    rp->recursion_level = p->recursion_level;
+
+    if (PacketCopyData(rp, first->pkt, first->len) == -1)
+        goto error_remove_tracker;
+    if (PacketCopyDataOffset(rp, fragmentable_offset + frag_offset,
+                GET_PKT_DATA(p) + data_offset, data_len) == -1)
+        goto error_remove_tracker;
+
+    rp->ip4h = (IPV4Hdr *)(GET_PKT_DATA(rp) + first->ip_hdr_offset);
+    int old = rp->ip4h->ip_len + rp->ip4h->ip_off;
+    rp->ip4h->ip_len = htons(fragmentable_len + first->hlen);
+    rp->ip4h->ip_off = 0;
+    rp->ip4h->ip_csum = FixChecksum(rp->ip4h->ip_csum,
+        old, rp->ip4h->ip_len + rp->ip4h->ip_off);
+    SET_PKT_LEN(rp, fragmentable_offset + fragmentable_len);
+
+    tracker->remove = 1;
+    DefragTrackerFreeFrags(tracker);
+    return rp;
+
+error_remove_tracker:
+    tracker->remove = 1;
+    DefragTrackerFreeFrags(tracker);
+    if (rp != NULL)
+        PacketFreeOrRelease(rp);
+    return NULL;
+}
+
+/**
+ * Re-assemble an IPv6 packet from its stored first fragment and the
+ * last fragment in p, without adding the last one to the tracker.
+ */
+static Packet *
+Defrag6ReassembleTwo(DefragTracker *tracker, Frag *first, Packet *p,
+        uint16_t frag_offset, uint16_t data_offset, uint16_t data_len)
+{
+    Packet *rp = NULL;
+
+    if (first->len < sizeof(IPV6Hdr)) {
+        goto error_remove_tracker;
+    }
+
+    /* fragmentable part starts at the frag header of the first fragment,
+     * the unfragmentable part is the part between the ipv6 header and
+     * the frag header. */
+    const int fragmentable_offset = first->frag_hdr_offset;
+    const int fragmentable_len = frag_offset + data_len;
+    const int unfragmentable_len =
+        (fragmentable_offset - first->ip_hdr_offset) - IPV6_HEADER_LEN;
+    if (unfragmentable_len >= fragmentable_offset)
+        goto error_remove_tracker;
+
+    rp = PacketDefragPktSetup(p, NULL, 0, 0);
+    if (rp == NULL) {
+        SCLogError(SC_ERR_MEM_ALLOC, "Failed to allocate packet for "
+                "fragmentation re-assembly, dumping fragments.");
+        goto error_remove_tracker;
+    }
+    PKT_SET_SRC(rp, PKT_SRC_DEFRAG);
+
+    IPV6FragHdr *frag_hdr = (IPV6FragHdr *)(first->pkt + first->frag_hdr_offset);
+    const uint8_t next_hdr = frag_hdr->ip6fh_nxt;
+
+    if (PacketCopyData(rp, first->pkt, first->frag_hdr_offset) == -1)
+        goto error_remove_tracker;
+    if (PacketCopyDataOffset(rp, first->frag_hdr_offset,
+            first->pkt + first->frag_hdr_offset + sizeof(IPV6FragHdr),
+            first->data_len) == -1)
+        goto error_remove_tracker;
+    if (PacketCopyDataOffset(rp, fragmentable_offset + frag_offset,
+            GET_PKT_DATA(p) + data_offset, data_len) == -1)
+        goto error_remove_tracker;
+
+    rp->ip6h = (IPV6Hdr *)(GET_PKT_DATA(rp) + first->ip_hdr_offset);
+    rp->ip6h->s_ip6_plen = htons(fragmentable_len + unfragmentable_len);
+    if (unfragmentable_len == 0)
+        rp->ip6h->s_ip6_nxt = next_hdr;
+    SET_PKT_LEN(rp, first->ip_hdr_offset + sizeof(IPV6Hdr) +
+            unfragmentable_len + fragmentable_len);
+
+    tracker->remove = 1;
+    DefragTrackerFreeFrags(tracker);
+    return rp;
+
+error_remove_tracker:
+    tracker->remove = 1;
+    DefragTrackerFreeFrags(tracker);
+    if (rp != NULL)
+        PacketFreeOrRelease(rp);
+    return NULL;
+}
+
+/**
+ * \brief Decode a re-assembled packet.
+ *
+ * \retval r the packet, or NULL if decoding failed and it was returned
+ *     to the pool
+ */
+static Packet *
+DefragDecodeReassembled(ThreadVars *tv, DecodeThreadVars *dtv, int af,
+        Packet *p, Packet *r)
+{
+    if (r == NULL || tv == NULL || dtv == NULL)
+        return r;
+
+    int ret;
+    if (af == AF_INET) {
+        StatsIncr(tv, dtv->counter_defrag_ipv4_reassembled);
+        ret = DecodeIPV4(tv, dtv, r, (void *)r->ip4h, IPV4_GET_IPLEN(r));
+    } else {
+        StatsIncr(tv, dtv->counter_defrag_ipv6_reassembled);
+        ret = DecodeIPV6(tv, dtv, r, (uint8_t *)r->ip6h,
+                IPV6_GET_PLEN(r) + IPV6_HEADER_LEN);
+    }
+    if (ret != TM_ECODE_OK) {
+        UNSET_TUNNEL_PKT(r);
+        r->root = NULL;
+        TmqhOutputPacketpool(tv, r);
+        return NULL;
+    }
+    PacketDefragPktSetupParent(p);
+    return r;
+}
+
 /**
  * The RB_TREE compare function for fragments.
  *
@@ -633,6 +812,22 @@ DefragInsertFrag(ThreadVars *tv, DecodeThreadVars *dtv, DefragTracker *tracker,
     tracker->timeout.tv_sec = p->ts.tv_sec + tracker->host_timeout;
     tracker->timeout.tv_usec = p->ts.tv_usec;
 
+    /* Fast path: the last fragment directly follows the only other one.
+     * Nothing to trim, so re-assemble from the packet itself instead of
+     * storing a copy of it in the tracker first. */
+    Frag *first = DefragTwoFragInOrder(tracker, frag_offset, more_frags);
+    if (first != NULL) {
+        tracker->seen_last = 1;
+        if (af == AF_INET) {
+            r = Defrag4ReassembleTwo(tracker, first, p, frag_offset,
+                    data_offset, data_len);
+        } else {
+            r = Defrag6ReassembleTwo(tracker, first, p, frag_offset,
+                    data_offset, data_len);
+        }
+        return DefragDecodeReassembled(tv, dtv, af, p, r);
+    }
+
     Frag *prev = NULL, *next = NULL;
     int overlap = 0;
     ltrim = 0;
@@ -885,37 +1080,11 @@ DefragInsertFrag(ThreadVars *tv, DecodeThreadVars *dtv, DefragTracker *tracker,
     if (tracker->seen_last) {
         if (tracker->af == AF_INET) {
             r = Defrag4Reassemble(tv, tracker, p);
-            if (r != NULL && tv != NULL && dtv != NULL) {
-                StatsIncr(tv, dtv->counter_defrag_ipv4_reassembled);
-                if (DecodeIPV4(tv, dtv, r, (void *)r->ip4h,
-                               IPV4_GET_IPLEN(r)) != TM_ECODE_OK) {
-
-                    UNSET_TUNNEL_PKT(r);
-                    r->root = NULL;
-                    TmqhOutputPacketpool(tv, r);
-                    r = NULL;
-                } else {
-                    PacketDefragPktSetupParent(p);
-                }
-            }
         }
         else if (tracker->af == AF_INET6) {
             r = Defrag6Reassemble(tv, tracker, p);
-            if (r != NULL && tv != NULL && dtv != NULL) {
-                StatsIncr(tv, dtv->counter_defrag_ipv6_reassembled);
-                if (DecodeIPV6(tv, dtv, r, (uint8_t *)r->ip6h,
-                               IPV6_GET_PLEN(r) + IPV6_HEADER_LEN)
-                               != TM_ECODE_OK) {
-
-                    UNSET_TUNNEL_PKT(r);
-                    r->root = NULL;
-                    TmqhOutputPacketpool(tv, r);
-                    r = NULL;
-                } else {
-                    PacketDefragPktSetupParent(p);
-                }
-            }
         }
+        r = DefragDecodeReassembled(tv, dtv, tracker->af, p, r);
     }
 
 
@@ -1296,6 +1465,82 @@ static int DefragInOrderSimpleTest(void)
     PASS;
 }
 
+/**
+ * Two fragments in order, handled by the fast path.
+ */
+static int DefragInOrderTwoFragTest(void)
+{
+    DefragInit();
+
+    Packet *p1 = BuildTestPacket(IPPROTO_ICMP, 13, 0, 1, 'A', 16);
+    FAIL_IF_NULL(p1);
+    Packet *p2 = BuildTestPacket(IPPROTO_ICMP, 13, 2, 0, 'B', 5);
+    FAIL_IF_NULL(p2);
+
+    FAIL_IF(Defrag(NULL, NULL, p1) != NULL);
+    Packet *reassembled = Defrag(NULL, NULL, p2);
+    FAIL_IF_NULL(reassembled);
+    FAIL_IF_NOT(reassembled->flags & PKT_REBUILT_FRAGMENT);
+
+    FAIL_IF(IPV4_GET_HLEN(reassembled) != 20);
+    FAIL_IF(IPV4_GET_IPLEN(reassembled) != 41);
+    FAIL_IF(GET_PKT_LEN(reassembled) != 41);
+    FAIL_IF(IPV4_GET_IPOFFSET(reassembled) != 0);
+    FAIL_IF(IPV4_GET_MF(reassembled) != 0);
+
+    for (int i = 20; i < 20 + 16; i++) {
+        FAIL_IF(GET_PKT_DATA(reassembled)[i] != 'A');
+    }
+    for (int i = 36; i < 36 + 5; i++) {
+        FAIL_IF(GET_PKT_DATA(reassembled)[i] != 'B');
+    }
+
+    /* the tracker is done with */
+    FAIL_IF(Defrag(NULL, NULL, p2) != NULL);
+
+    SCFree(p1);
+    SCFree(p2);
+    SCFree(reassembled);
+
+    DefragDestroy();
+    PASS;
+}
+
+/**
+ * Two IPv6 fragments in order, handled by the fast path.
+ */
+static int IPV6DefragInOrderTwoFragTest(void)
+{
+    DefragInit();
+
+    Packet *p1 = IPV6BuildTestPacket(IPPROTO_ICMPV6, 13, 0, 1, 'A', 16);
+    FAIL_IF_NULL(p1);
+    Packet *p2 = IPV6BuildTestPacket(IPPROTO_ICMPV6, 13, 2, 0, 'B', 5);
+    FAIL_IF_NULL(p2);
+
+    FAIL_IF(Defrag(NULL, NULL, p1) != NULL);
+    Packet *reassembled = Defrag(NULL, NULL, p2);
+    FAIL_IF_NULL(reassembled);
+
+    FAIL_IF(IPV6_GET_PLEN(reassembled) != 21);
+    FAIL_IF(IPV6_GET_NH(reassembled) != IPPROTO_ICMPV6);
+    FAIL_IF(GET_PKT_LEN(reassembled) != 40 + 21);
+
+    for (int i = 40; i < 40 + 16; i++) {
+        FAIL_IF(GET_PKT_DATA(reassembled)[i] != 'A');
+    }
+    for (int i = 56; i < 56 + 5; i++) {
+        FAIL_IF(GET_PKT_DATA(reassembled)[i] != 'B');
+    }
+
+    SCFree(p1);
+    SCFree(p2);
+    SCFree(reassembled);
+
+    DefragDestroy();
+    PASS;
+}
+
 /**
  * Simple fragmented packet in reverse order.
  */
@@ -2485,6 +2730,7 @@ void DefragRegisterTests(void)
 {
 #ifdef UNITTESTS
     UtRegisterTest("DefragInOrderSimpleTest", DefragInOrderSimpleTest);
+    UtRegisterTest("DefragInOrderTwoFragTest", DefragInOrderTwoFragTest);
     UtRegisterTest("DefragReverseSimpleTest", DefragReverseSimpleTest);
     UtRegisterTest("DefragSturgesNovakBsdTest", DefragSturgesNovakBsdTest);
     UtRegisterTest("DefragSturgesNovakLinuxIpv4Test",
@@ -2500,6 +2746,8 @@ void DefragRegisterTests(void)
     UtRegisterTest("DefragIPv4TooLargeTest", DefragIPv4TooLargeTest);
 
     UtRegisterTest("IPV6DefragInOrderSimpleTest", IPV6DefragInOrderSimpleTest);
+    UtRegisterTest("IPV6DefragInOrderTwoFragTest",
+                   IPV6DefragInOrderTwoFragTest);
     UtRegisterTest("IPV6DefragReverseSimpleTest", IPV6DefragReverseSimpleTest);
     UtRegisterTest("IPV6DefragSturgesNovakBsdTest",
                    IPV6DefragSturgesNovakBsdTest);
@@ -101,6 +101,8 @@ typedef struct DefragTracker_ {
 
     uint8_t remove; /**< remove */
 
+    uint32_t hfp; /**< Hash of the tracker key, fingerprint in the hash row. */
+
     Address src_addr; /**< Source address for this tracker. */
     Address dst_addr; /**< Destination address for this tracker. */
 
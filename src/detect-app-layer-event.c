@@ -294,6 +294,14 @@ static int DetectAppLayerEventSetupP2(Signature *s,
     /* We should have set this flag already in SetupP1 */
     s->flags |= SIG_FLAG_APPLAYER;
 
+    /* invalid encodings are only found in MIME bodies that are decoded */
+    const DetectAppLayerEventData *data = (DetectAppLayerEventData *)sm->ctx;
+    if (data->alproto == ALPROTO_SMTP &&
+            (data->event_id == SMTP_DECODER_EVENT_MIME_INVALID_BASE64 ||
+             data->event_id == SMTP_DECODER_EVENT_MIME_INVALID_QP)) {
+        SMTPNeedMimeAnomalies();
+    }
+
     return 0;
 }
 
@@ -762,6 +762,9 @@ void EngineAnalysisRules2(const DetectEngineCtx *de_ctx, const Signature *s)
         if (s->flags & SIG_FLAG_IPONLY) {
             json_array_append_new(js_flags, json_string("ip_only"));
         }
+        if (s->flags & SIG_FLAG_HTTP2) {
+            json_array_append_new(js_flags, json_string("http2"));
+        }
         if (s->flags & SIG_FLAG_REQUIRE_PACKET) {
             json_array_append_new(js_flags, json_string("need_packet"));
         }
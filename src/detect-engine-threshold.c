@@ -62,16 +62,28 @@
 #include "detect-uricontent.h"
 
 #include "util-hash.h"
+#include "util-hash-lookup3.h"
 #include "util-time.h"
 #include "util-error.h"
 #include "util-debug.h"
 
 #include "util-var-name.h"
 #include "tm-threads.h"
+#include "conf.h"
 
 static int host_threshold_id = -1; /**< host storage id for thresholds */
 static int ippair_threshold_id = -1; /**< ip pair storage id for thresholds */
 
+#define THRESHOLD_LOCAL_INTERVAL_DEFAULT    1
+#define THRESHOLD_LOCAL_HASH_SIZE           4096
+#define THRESHOLD_LOCAL_MAX_ENTRIES         65536
+
+/** keep by_src/by_dst/by_both state per detect thread, see
+ *  ThresholdLocalHandlePacket */
+static bool threshold_local = false;
+/** seconds between merges of the thread local state */
+static uint32_t threshold_local_interval = THRESHOLD_LOCAL_INTERVAL_DEFAULT;
+
 int ThresholdHostStorageId(void)
 {
     return host_threshold_id;
@@ -89,6 +101,24 @@ void ThresholdInit(void)
         SCLogError(SC_ERR_HOST_INIT, "Can't initiate IP pair storage for thresholding");
         exit(EXIT_FAILURE);
     }
+
+    int local = 0;
+    if (ConfGetBool("detect.thresholds.thread-local", &local) == 1 && local) {
+        threshold_local = true;
+
+        intmax_t interval = 0;
+        if (ConfGetInt("detect.thresholds.merge-interval", &interval) == 1) {
+            if (interval <= 0 || interval > UINT16_MAX) {
+                SCLogWarning(SC_ERR_INVALID_VALUE, "invalid value for "
+                        "detect.thresholds.merge-interval: %"PRIdMAX", "
+                        "using %d", interval, THRESHOLD_LOCAL_INTERVAL_DEFAULT);
+            } else {
+                threshold_local_interval = (uint32_t)interval;
+            }
+        }
+        SCLogConfig("thresholds: thread local state, merged every %u "
+                "second(s)", threshold_local_interval);
+    }
 }
 
 int ThresholdHostHasThreshold(Host *host)
@@ -592,6 +622,287 @@ static int ThresholdHandlePacketRule(DetectEngineCtx *de_ctx, Packet *p,
     return ret;
 }
 
+/* Thread local threshold state
+ *
+ * With detect.thresholds.thread-local enabled the by_src, by_dst and
+ * by_both thresholds and rate_filters are evaluated against a copy of the
+ * entry that lives in the detect thread. The copy is merged with the
+ * entry in the global host or ippair table once per merge-interval, so the
+ * host and ippair locks are taken once per interval per thread instead of
+ * once per alert. Counts are approximate: other threads only see the
+ * matches of this thread after the next merge.
+ */
+
+typedef struct ThresholdLocalEntry_ {
+    DetectThresholdEntry e;     /**< this thread's view of the entry */
+    Address a;                  /**< host or first address of the pair */
+    Address b;                  /**< second address of the pair */
+    uint32_t hash;
+    uint32_t pending;           /**< matches since the last merge */
+    uint32_t merged;            /**< packet time of the last merge */
+    uint32_t used;              /**< packet time of the last use */
+    bool pair;                  /**< entry belongs to an ippair */
+    bool valid;                 /**< e holds state */
+    bool dirty;                 /**< e changed since the last merge */
+    bool reset;                 /**< count was reset by a threshold match */
+    struct ThresholdLocalEntry_ *next;
+} ThresholdLocalEntry;
+
+typedef struct ThresholdThreadCtx_ {
+    ThresholdLocalEntry *hash[THRESHOLD_LOCAL_HASH_SIZE];
+    uint32_t cnt;
+    uint32_t sweep_ts;
+} ThresholdThreadCtx;
+
+static inline uint32_t ThresholdLocalHash(const Address *a, const Address *b,
+        uint32_t sid, uint32_t gid)
+{
+    uint32_t hash = hashword(a->addr_data32, 4, sid);
+    /* addition keeps the pair hash independent of the direction */
+    if (b != NULL)
+        hash += hashword(b->addr_data32, 4, sid);
+    return hash ^ gid;
+}
+
+static ThresholdLocalEntry *ThresholdLocalLookup(ThresholdThreadCtx *tctx,
+        uint32_t hash, const Address *a, const Address *b, uint32_t sid, uint32_t gid)
+{
+    ThresholdLocalEntry *le = tctx->hash[hash % THRESHOLD_LOCAL_HASH_SIZE];
+    for ( ; le != NULL; le = le->next) {
+        if (le->hash != hash || le->e.sid != sid || le->e.gid != gid)
+            continue;
+        if (b == NULL) {
+            if (!le->pair && CMP_ADDR(&le->a, a))
+                return le;
+        } else if (le->pair) {
+            if ((CMP_ADDR(&le->a, a) && CMP_ADDR(&le->b, b)) ||
+                (CMP_ADDR(&le->a, b) && CMP_ADDR(&le->b, a)))
+                return le;
+        }
+    }
+    return NULL;
+}
+
+/** \internal
+ *  \brief fold the local state into the global entry and refresh the
+ *         local state from it
+ *
+ *  \param ge global entry or NULL if the host/ippair has none
+ *
+ *  \retval new_ge entry the caller has to add to the storage, or NULL
+ */
+static DetectThresholdEntry *ThresholdLocalSync(ThresholdLocalEntry *le,
+        DetectThresholdEntry *ge)
+{
+    DetectThresholdEntry *new_ge = NULL;
+
+    if (le->valid && le->dirty) {
+        if (ge == NULL) {
+            new_ge = SCMalloc(sizeof(*new_ge));
+            if (new_ge != NULL) {
+                *new_ge = le->e;
+                new_ge->next = NULL;
+                ge = new_ge;
+            }
+        } else {
+            if (TIMEVAL_EARLIER(ge->tv1, le->e.tv1)) {
+                /* this thread started a new time window */
+                ge->tv1 = le->e.tv1;
+                ge->current_count = le->pending;
+            } else if (!TIMEVAL_EARLIER(le->e.tv1, ge->tv1)) {
+                if (le->reset)
+                    ge->current_count = le->e.current_count;
+                else
+                    ge->current_count += le->pending;
+            }
+            /* else our matches belong to a window another thread already
+             * closed: drop them */
+
+            if (le->e.tv_timeout > ge->tv_timeout)
+                ge->tv_timeout = le->e.tv_timeout;
+        }
+    }
+
+    if (ge != NULL) {
+        le->e = *ge;
+        le->e.next = NULL;
+        le->valid = true;
+    } else {
+        le->valid = false;
+    }
+    le->pending = 0;
+    le->dirty = false;
+    le->reset = false;
+    return new_ge;
+}
+
+/** \internal
+ *  \brief merge a local entry with the global host or ippair table */
+static void ThresholdLocalMerge(ThresholdLocalEntry *le, uint32_t now)
+{
+    le->merged = now;
+
+    if (le->pair) {
+        IPPair *pair = IPPairGetIPPairFromHash(&le->a, &le->b);
+        if (pair == NULL)
+            return;
+        DetectThresholdEntry *ge = ThresholdIPPairLookupEntry(pair, le->e.sid, le->e.gid);
+        DetectThresholdEntry *new_ge = ThresholdLocalSync(le, ge);
+        if (new_ge != NULL) {
+            new_ge->next = IPPairGetStorageById(pair, ippair_threshold_id);
+            IPPairSetStorageById(pair, ippair_threshold_id, new_ge);
+        }
+        IPPairRelease(pair);
+    } else {
+        Host *h = HostGetHostFromHash(&le->a);
+        if (h == NULL)
+            return;
+        DetectThresholdEntry *ge = ThresholdHostLookupEntry(h, le->e.sid, le->e.gid);
+        DetectThresholdEntry *new_ge = ThresholdLocalSync(le, ge);
+        if (new_ge != NULL) {
+            new_ge->next = HostGetStorageById(h, host_threshold_id);
+            HostSetStorageById(h, host_threshold_id, new_ge);
+        }
+        HostRelease(h);
+    }
+}
+
+/** \internal
+ *  \brief merge all changed entries and drop the ones that were not used
+ *         since the previous sweep */
+static void ThresholdLocalSweep(ThresholdThreadCtx *tctx, uint32_t now)
+{
+    for (uint32_t i = 0; i < THRESHOLD_LOCAL_HASH_SIZE; i++) {
+        ThresholdLocalEntry **prev = &tctx->hash[i];
+        ThresholdLocalEntry *le = *prev;
+        while (le != NULL) {
+            if (le->dirty)
+                ThresholdLocalMerge(le, now);
+
+            if (le->used < tctx->sweep_ts) {
+                *prev = le->next;
+                SCFree(le);
+                tctx->cnt--;
+            } else {
+                prev = &le->next;
+            }
+            le = *prev;
+        }
+    }
+    tctx->sweep_ts = now;
+}
+
+/** \internal
+ *
+ *  \retval -1 no local state could be set up, use the global tables
+ *  \retval ret see PacketAlertThreshold
+ */
+static int ThresholdLocalHandlePacket(ThresholdThreadCtx *tctx, Packet *p,
+        const DetectThresholdData *td, const Signature *s, PacketAlert *pa)
+{
+    const Address *a = NULL;
+    const Address *b = NULL;
+    switch (td->track) {
+        case TRACK_SRC:
+            a = &p->src;
+            break;
+        case TRACK_DST:
+            a = &p->dst;
+            break;
+        case TRACK_BOTH:
+            a = &p->src;
+            b = &p->dst;
+            break;
+        default:
+            return -1;
+    }
+
+    const uint32_t now = (uint32_t)p->ts.tv_sec;
+    if (tctx->sweep_ts == 0) {
+        tctx->sweep_ts = now;
+    } else if (now - tctx->sweep_ts >= threshold_local_interval) {
+        ThresholdLocalSweep(tctx, now);
+    }
+
+    const uint32_t hash = ThresholdLocalHash(a, b, s->id, s->gid);
+    ThresholdLocalEntry *le = ThresholdLocalLookup(tctx, hash, a, b, s->id, s->gid);
+    if (le == NULL) {
+        if (tctx->cnt >= THRESHOLD_LOCAL_MAX_ENTRIES)
+            return -1;
+        le = SCCalloc(1, sizeof(*le));
+        if (unlikely(le == NULL))
+            return -1;
+        le->e.sid = s->id;
+        le->e.gid = s->gid;
+        COPY_ADDRESS(a, &le->a);
+        if (b != NULL) {
+            COPY_ADDRESS(b, &le->b);
+            le->pair = true;
+        }
+        le->hash = hash;
+        le->next = tctx->hash[hash % THRESHOLD_LOCAL_HASH_SIZE];
+        tctx->hash[hash % THRESHOLD_LOCAL_HASH_SIZE] = le;
+        tctx->cnt++;
+
+        /* pick up the state the other threads have merged so far */
+        ThresholdLocalMerge(le, now);
+    } else if (now - le->merged >= threshold_local_interval) {
+        ThresholdLocalMerge(le, now);
+    }
+    le->used = now;
+
+    const struct timeval tv1 = le->e.tv1;
+    const uint32_t cnt = le->e.current_count;
+    DetectThresholdEntry *new_tsh = NULL;
+    int ret = ThresholdHandlePacket(p, le->valid ? &le->e : NULL, &new_tsh,
+            td, s->id, s->gid, pa);
+    if (new_tsh != NULL) {
+        le->e = *new_tsh;
+        SCFree(new_tsh);
+        le->e.current_count = 1;
+        le->e.tv1 = p->ts;
+        le->e.tv_timeout = 0;
+        le->e.next = NULL;
+        le->valid = true;
+        le->dirty = true;
+        le->pending = 1;
+    } else if (le->valid) {
+        le->dirty = true;
+        if (tv1.tv_sec != le->e.tv1.tv_sec || tv1.tv_usec != le->e.tv1.tv_usec) {
+            le->pending = le->e.current_count;
+        } else if (le->e.current_count >= cnt) {
+            le->pending += le->e.current_count - cnt;
+        } else {
+            le->reset = true;
+        }
+    }
+    return ret;
+}
+
+/**
+ * \brief merge the thread local threshold state into the global tables
+ *        and free it
+ *
+ * Needs to be called before the host and ippair tables are shut down.
+ */
+void ThresholdThreadCtxFree(ThresholdThreadCtx *tctx)
+{
+    if (tctx == NULL)
+        return;
+
+    for (uint32_t i = 0; i < THRESHOLD_LOCAL_HASH_SIZE; i++) {
+        ThresholdLocalEntry *le = tctx->hash[i];
+        while (le != NULL) {
+            ThresholdLocalEntry *next = le->next;
+            if (le->dirty)
+                ThresholdLocalMerge(le, le->used);
+            SCFree(le);
+            le = next;
+        }
+    }
+    SCFree(tctx);
+}
+
 /**
  * \brief Make the threshold logic for signatures
  *
@@ -616,7 +927,21 @@ int PacketAlertThreshold(DetectEngineCtx *de_ctx, DetectEngineThreadCtx *det_ctx
 
     if (td->type == TYPE_SUPPRESS) {
         ret = ThresholdHandlePacketSuppress(p,td,s->id,s->gid);
-    } else if (td->track == TRACK_SRC) {
+        SCReturnInt(ret);
+    }
+
+    if (threshold_local && det_ctx != NULL && td->track != TRACK_RULE) {
+        if (det_ctx->ths_tctx == NULL)
+            det_ctx->ths_tctx = SCCalloc(1, sizeof(ThresholdThreadCtx));
+        if (det_ctx->ths_tctx != NULL) {
+            ret = ThresholdLocalHandlePacket(det_ctx->ths_tctx, p, td, s, pa);
+            if (ret >= 0)
+                SCReturnInt(ret);
+            ret = 0;
+        }
+    }
+
+    if (td->track == TRACK_SRC) {
         Host *src = HostGetHostFromHash(&p->src);
         if (src) {
             ret = ThresholdHandlePacketHost(src,p,td,s->id,s->gid,pa);
@@ -715,6 +1040,99 @@ void ThresholdListFree(void *ptr)
     }
 }
 
+#ifdef UNITTESTS
+#include "util-unittest.h"
+#include "util-unittest-helper.h"
+
+/** \test thread local limit state is shared through the host table */
+static int ThresholdLocalTest01(void)
+{
+    ThreadVars th_v;
+    DetectEngineThreadCtx *det_ctx1 = NULL;
+    DetectEngineThreadCtx *det_ctx2 = NULL;
+
+    const bool local = threshold_local;
+    const uint32_t interval = threshold_local_interval;
+    threshold_local = true;
+    threshold_local_interval = 1;
+
+    HostInitConfig(HOST_QUIET);
+    memset(&th_v, 0, sizeof(th_v));
+
+    Packet *p = UTHBuildPacketReal((uint8_t *)"A", 1, IPPROTO_TCP,
+            "1.1.1.1", "2.2.2.2", 1024, 80);
+    FAIL_IF_NULL(p);
+    p->ts.tv_sec = 1000;
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    FAIL_IF_NULL(de_ctx);
+    de_ctx->flags |= DE_QUIET;
+    de_ctx->sig_list = SigInit(de_ctx, "alert tcp any any -> any 80 "
+            "(content:\"A\"; threshold: type limit, track by_dst, "
+            "count 2, seconds 60; sid:1;)");
+    FAIL_IF_NULL(de_ctx->sig_list);
+    SigGroupBuild(de_ctx);
+    DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx1);
+    DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx2);
+
+    /* first thread: limit applies locally */
+    int alerts = 0;
+    for (int i = 0; i < 3; i++) {
+        SigMatchSignatures(&th_v, de_ctx, det_ctx1, p);
+        alerts += PacketAlertCheck(p, 1);
+    }
+    FAIL_IF_NOT(alerts == 2);
+    FAIL_IF_NULL(det_ctx1->ths_tctx);
+    FAIL_IF_NOT(det_ctx1->ths_tctx->cnt == 1);
+
+    /* nothing merged yet */
+    Host *h = HostLookupHostFromHash(&p->dst);
+    FAIL_IF_NULL(h);
+    FAIL_IF_NOT_NULL(ThresholdHostLookupEntry(h, 1, 1));
+    HostRelease(h);
+
+    /* next interval: first thread merges its 3 matches */
+    p->ts.tv_sec++;
+    SigMatchSignatures(&th_v, de_ctx, det_ctx1, p);
+    FAIL_IF(PacketAlertCheck(p, 1));
+    h = HostLookupHostFromHash(&p->dst);
+    FAIL_IF_NULL(h);
+    DetectThresholdEntry *e = ThresholdHostLookupEntry(h, 1, 1);
+    FAIL_IF_NULL(e);
+    FAIL_IF_NOT(e->current_count == 3);
+    HostRelease(h);
+
+    /* second thread picks up the merged state */
+    SigMatchSignatures(&th_v, de_ctx, det_ctx2, p);
+    FAIL_IF(PacketAlertCheck(p, 1));
+
+    /* freeing the thread ctxs merges the pending matches */
+    DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx1);
+    DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx2);
+    h = HostLookupHostFromHash(&p->dst);
+    FAIL_IF_NULL(h);
+    e = ThresholdHostLookupEntry(h, 1, 1);
+    FAIL_IF_NULL(e);
+    FAIL_IF_NOT(e->current_count == 5);
+    HostRelease(h);
+
+    DetectEngineCtxFree(de_ctx);
+    UTHFreePackets(&p, 1);
+    HostShutdown();
+
+    threshold_local = local;
+    threshold_local_interval = interval;
+    PASS;
+}
+#endif /* UNITTESTS */
+
+void ThresholdRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("ThresholdLocalTest01", ThresholdLocalTest01);
+#endif /* UNITTESTS */
+}
+
 /**
  * @}
  */
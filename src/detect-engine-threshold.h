@@ -45,9 +45,12 @@ int PacketAlertThreshold(DetectEngineCtx *, DetectEngineThreadCtx *,
 void ThresholdHashInit(DetectEngineCtx *);
 void ThresholdHashRealloc(DetectEngineCtx *);
 void ThresholdContextDestroy(DetectEngineCtx *);
+void ThresholdThreadCtxFree(struct ThresholdThreadCtx_ *);
 
 int ThresholdHostTimeoutCheck(Host *, struct timeval *);
 int ThresholdIPPairTimeoutCheck(IPPair *, struct timeval *);
 void ThresholdListFree(void *ptr);
 
+void ThresholdRegisterTests(void);
+
 #endif /* __DETECT_ENGINE_THRESHOLD_H__ */
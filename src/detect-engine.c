@@ -75,6 +75,7 @@
 #include "util-device.h"
 #include "util-var-name.h"
 #include "util-profiling.h"
+#include "util-numa.h"
 
 #include "tm-threads.h"
 #include "runmodes.h"
@@ -542,7 +543,7 @@ int DetectEngineAppInspectionEngine2Signature(DetectEngineCtx *de_ctx, Signature
 
         if (t->alproto == ALPROTO_UNKNOWN) {
             /* special case, inspect engine applies to all protocols */
-        } else if (s->alproto != ALPROTO_UNKNOWN && s->alproto != t->alproto)
+        } else if (s->alproto != ALPROTO_UNKNOWN && !SignatureAppProtoMatches(s, t->alproto))
             goto next;
 
         if (s->flags & SIG_FLAG_TOSERVER && !(s->flags & SIG_FLAG_TOCLIENT)) {
@@ -1104,6 +1105,51 @@ void InspectionBufferSetup(InspectionBuffer *buffer, const uint8_t *data, const
     buffer->len = 0;
 }
 
+/**
+ * \brief setup the buffer for data kept in multiple segments
+ *
+ * Data that is contiguous in memory from offset to end is inspected in
+ * place. Otherwise the segments are gathered into the buffer's memory,
+ * up to the first missing segment.
+ *
+ * \param GetSegment callback returning the contiguous data at an offset
+ * \param ctx passed to GetSegment
+ * \param offset offset of the first byte to inspect
+ * \param end offset after the last byte to inspect
+ */
+void InspectionBufferSetupSegments(InspectionBuffer *buffer,
+        InspectionBufferSegmentFunc GetSegment, const void *ctx,
+        uint64_t offset, uint64_t end)
+{
+    const uint8_t *data = NULL;
+    uint32_t data_len = 0;
+
+    if (GetSegment(ctx, offset, &data, &data_len) == 0 ||
+        offset + data_len >= end || end - offset > UINT32_MAX)
+    {
+        InspectionBufferSetup(buffer, data, data_len);
+        return;
+    }
+
+    const uint32_t total = (uint32_t)(end - offset);
+    InspectionBufferCheckAndExpand(buffer, total);
+    if (buffer->size < total) {
+        InspectionBufferSetup(buffer, data, data_len);
+        return;
+    }
+
+    uint32_t len = 0;
+    do {
+        data_len = MIN(data_len, total - len);
+        memcpy(buffer->buf + len, data, data_len);
+        len += data_len;
+        offset += data_len;
+    } while (len < total && GetSegment(ctx, offset, &data, &data_len) == 1 &&
+             data_len > 0);
+
+    InspectionBufferSetup(buffer, buffer->buf, len);
+}
+
 void InspectionBufferFree(InspectionBuffer *buffer)
 {
     if (buffer->buf != NULL) {
@@ -1805,7 +1851,11 @@ static int DetectEngineReloadThreads(DetectEngineCtx *new_de_ctx)
             old_det_ctx[i] = FlowWorkerGetDetectCtxPtr(SC_ATOMIC_GET(s->slot_data));
             detect_tvs[i] = tv;
 
+            /* allocate on the NUMA node of the detect thread, not ours */
+            NumaPolicy policy;
+            NumaSetPreferred(tv->numa_node, &policy);
             new_det_ctx[i] = DetectEngineThreadCtxInitForReload(tv, new_de_ctx, 1);
+            NumaResetPreferred(&policy);
             if (new_det_ctx[i] == NULL) {
                 SCLogError(SC_ERR_LIVE_RULE_SWAP, "Detect engine thread init "
                            "failure in live rule swap.  Let's get out of here");
@@ -2861,6 +2911,9 @@ static void DetectEngineThreadCtxFree(DetectEngineThreadCtx *det_ctx)
     SCProfilingSghThreadCleanup(det_ctx);
 #endif
 
+    ThresholdThreadCtxFree(det_ctx->ths_tctx);
+    det_ctx->ths_tctx = NULL;
+
     DetectEngineIPOnlyThreadDeinit(&det_ctx->io_ctx);
 
     /** \todo get rid of this static */
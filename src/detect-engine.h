@@ -30,6 +30,13 @@
 
 void InspectionBufferInit(InspectionBuffer *buffer, uint32_t initial_size);
 void InspectionBufferSetup(InspectionBuffer *buffer, const uint8_t *data, const uint32_t data_len);
+/** get the contiguous data at an offset of data kept in segments.
+ *  Returns 1 if data was set, 0 otherwise. */
+typedef int (*InspectionBufferSegmentFunc)(const void *ctx, uint64_t offset,
+        const uint8_t **data, uint32_t *data_len);
+void InspectionBufferSetupSegments(InspectionBuffer *buffer,
+        InspectionBufferSegmentFunc GetSegment, const void *ctx,
+        uint64_t offset, uint64_t end);
 void InspectionBufferFree(InspectionBuffer *buffer);
 void InspectionBufferCheckAndExpand(InspectionBuffer *buffer, uint32_t min_size);
 void InspectionBufferCopy(InspectionBuffer *buffer, uint8_t *buf, uint32_t buf_len);
@@ -39,6 +39,9 @@
 
 #include "app-layer-parser.h"
 #include "app-layer-htp.h"
+#include "app-layer-http2.h"
+#include "rust.h"
+#include "app-layer-htp-body.h"
 #include "app-layer-smtp.h"
 
 #include "flow.h"
@@ -64,6 +67,10 @@ static InspectionBuffer *HttpServerBodyGetDataCallback(DetectEngineThreadCtx *de
         const DetectEngineTransforms *transforms,
         Flow *f, const uint8_t flow_flags,
         void *txv, const int list_id);
+static InspectionBuffer *Http2ServerBodyGetDataCallback(DetectEngineThreadCtx *det_ctx,
+        const DetectEngineTransforms *transforms,
+        Flow *f, const uint8_t flow_flags,
+        void *txv, const int list_id);
 
 /* file API */
 static int DetectEngineInspectFiledata(
@@ -97,6 +104,10 @@ void DetectFiledataRegister(void)
             PrefilterGenericMpmRegister,
             HttpServerBodyGetDataCallback,
             ALPROTO_HTTP, HTP_RESPONSE_BODY);
+    DetectAppLayerMpmRegister2("file_data", SIG_FLAG_TOCLIENT, 2,
+            PrefilterGenericMpmRegister,
+            Http2ServerBodyGetDataCallback,
+            ALPROTO_HTTP2, HTTP2_PROGRESS_COMPLETE);
     DetectAppLayerMpmRegister2("file_data", SIG_FLAG_TOSERVER, 2,
             PrefilterMpmFiledataRegister, NULL,
             ALPROTO_SMB, 0);
@@ -107,6 +118,9 @@ void DetectFiledataRegister(void)
     DetectAppLayerInspectEngineRegister2("file_data",
             ALPROTO_HTTP, SIG_FLAG_TOCLIENT, HTP_RESPONSE_BODY,
             DetectEngineInspectBufferGeneric, HttpServerBodyGetDataCallback);
+    DetectAppLayerInspectEngineRegister2("file_data",
+            ALPROTO_HTTP2, SIG_FLAG_TOCLIENT, HTTP2_PROGRESS_COMPLETE,
+            DetectEngineInspectBufferGeneric, Http2ServerBodyGetDataCallback);
     DetectAppLayerInspectEngineRegister2("file_data",
             ALPROTO_SMTP, SIG_FLAG_TOSERVER, 0,
             DetectEngineInspectFiledata, NULL);
@@ -167,7 +181,8 @@ static int DetectFiledataSetup (DetectEngineCtx *de_ctx, Signature *s, const cha
 
     if (!DetectProtoContainsProto(&s->proto, IPPROTO_TCP) ||
         (s->alproto != ALPROTO_UNKNOWN && s->alproto != ALPROTO_HTTP &&
-        s->alproto != ALPROTO_SMTP && s->alproto != ALPROTO_SMB)) {
+        s->alproto != ALPROTO_HTTP2 && s->alproto != ALPROTO_SMTP &&
+        s->alproto != ALPROTO_SMB)) {
         SCLogError(SC_ERR_CONFLICTING_RULE_KEYWORDS, "rule contains conflicting keywords.");
         return -1;
     }
@@ -199,6 +214,9 @@ static void DetectFiledataSetupCallback(const DetectEngineCtx *de_ctx,
     if (s->alproto == ALPROTO_HTTP || s->alproto == ALPROTO_UNKNOWN) {
         AppLayerHtpEnableResponseBodyCallback();
     }
+    if (s->alproto == ALPROTO_SMTP || s->alproto == ALPROTO_UNKNOWN) {
+        SMTPNeedFileInspection();
+    }
 
 
     /* server body needs to be inspected in sync with stream if possible */
@@ -297,26 +315,38 @@ static InspectionBuffer *HttpServerBodyGetDataCallback(DetectEngineThreadCtx *de
         }
     }
 
-    const uint8_t *data;
-    uint32_t data_len;
-
-    StreamingBufferGetDataAtOffset(body->sb,
-            &data, &data_len, offset);
-    InspectionBufferSetup(buffer, data, data_len);
+    /* zero copy bodies are inspected in place where contiguous */
+    InspectionBufferSetupSegments(buffer, HtpBodyGetDataAtOffset, body,
+            offset, body->content_len_so_far);
     buffer->inspect_offset = offset;
 
+    const uint8_t *data = buffer->inspect;
+    const uint32_t data_len = buffer->inspect_len;
+
     /* built-in 'transformation' */
-    if (htp_state->cfg->swf_decompression_enabled) {
+    if (htp_state->cfg->swf_decompression_enabled && data != NULL) {
         int swf_file_type = FileIsSwfFile(data, data_len);
         if (swf_file_type == FILE_SWF_ZLIB_COMPRESSION ||
             swf_file_type == FILE_SWF_LZMA_COMPRESSION)
         {
-            (void)FileSwfDecompression(data, data_len,
-                                       det_ctx,
-                                       buffer,
-                                       htp_state->cfg->swf_compression_type,
-                                       htp_state->cfg->swf_decompress_depth,
-                                       htp_state->cfg->swf_compress_depth);
+            /* decompression writes to the buffer memory, so gathered
+             * data needs a copy of its own first */
+            uint8_t *copy = NULL;
+            if (data == buffer->buf) {
+                copy = SCMalloc(data_len);
+                if (copy != NULL)
+                    memcpy(copy, data, data_len);
+            }
+            if (data != buffer->buf || copy != NULL) {
+                (void)FileSwfDecompression(copy ? copy : data, data_len,
+                                           det_ctx,
+                                           buffer,
+                                           htp_state->cfg->swf_compression_type,
+                                           htp_state->cfg->swf_decompress_depth,
+                                           htp_state->cfg->swf_compress_depth);
+            }
+            if (copy != NULL)
+                SCFree(copy);
         }
     }
 
@@ -328,6 +358,30 @@ static InspectionBuffer *HttpServerBodyGetDataCallback(DetectEngineThreadCtx *de
     SCReturnPtr(buffer, "InspectionBuffer");
 }
 
+/* HTTP/2 based detection */
+
+static InspectionBuffer *Http2ServerBodyGetDataCallback(DetectEngineThreadCtx *det_ctx,
+        const DetectEngineTransforms *transforms,
+        Flow *f, const uint8_t flow_flags,
+        void *txv, const int list_id)
+{
+    InspectionBuffer *buffer = InspectionBufferGet(det_ctx, list_id);
+    if (buffer->inspect == NULL) {
+        const uint8_t *b = NULL;
+        uint32_t b_len = 0;
+
+        if (rs_http2_tx_get_body(txv, STREAM_TOCLIENT, &b, &b_len) != 1)
+            return NULL;
+        if (b == NULL || b_len == 0)
+            return NULL;
+
+        InspectionBufferSetup(buffer, b, b_len);
+        InspectionBufferApplyTransforms(buffer, transforms);
+    }
+
+    return buffer;
+}
+
 /* file API based inspection */
 
 static InspectionBuffer *FiledataGetDataCallback(DetectEngineThreadCtx *det_ctx,
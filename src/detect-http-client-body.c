@@ -55,6 +55,9 @@
 #include "app-layer.h"
 #include "app-layer-parser.h"
 #include "app-layer-htp.h"
+#include "app-layer-http2.h"
+#include "rust.h"
+#include "app-layer-htp-body.h"
 #include "detect-http-client-body.h"
 #include "stream-tcp.h"
 
@@ -73,6 +76,27 @@ static InspectionBuffer *HttpClientBodyGetDataCallback(
         Flow *f, const uint8_t flow_flags,
         void *txv, const int list_id);
 
+static InspectionBuffer *GetData2(DetectEngineThreadCtx *det_ctx,
+        const DetectEngineTransforms *transforms, Flow *_f,
+        const uint8_t _flow_flags, void *txv, const int list_id)
+{
+    InspectionBuffer *buffer = InspectionBufferGet(det_ctx, list_id);
+    if (buffer->inspect == NULL) {
+        const uint8_t *b = NULL;
+        uint32_t b_len = 0;
+
+        if (rs_http2_tx_get_body(txv, STREAM_TOSERVER, &b, &b_len) != 1)
+            return NULL;
+        if (b == NULL || b_len == 0)
+            return NULL;
+
+        InspectionBufferSetup(buffer, b, b_len);
+        InspectionBufferApplyTransforms(buffer, transforms);
+    }
+
+    return buffer;
+}
+
 /**
  * \brief Registers the keyword handlers for the "http_client_body" keyword.
  */
@@ -107,6 +131,14 @@ void DetectHttpClientBodyRegister(void)
             PrefilterGenericMpmRegister, HttpClientBodyGetDataCallback,
             ALPROTO_HTTP, HTP_REQUEST_BODY);
 
+    DetectAppLayerInspectEngineRegister2("http_client_body", ALPROTO_HTTP2,
+            SIG_FLAG_TOSERVER, HTTP2_PROGRESS_COMPLETE,
+            DetectEngineInspectBufferGeneric, GetData2);
+
+    DetectAppLayerMpmRegister2("http_client_body", SIG_FLAG_TOSERVER, 2,
+            PrefilterGenericMpmRegister, GetData2, ALPROTO_HTTP2,
+            HTTP2_PROGRESS_COMPLETE);
+
     DetectBufferTypeSetDescriptionByName("http_client_body",
             "http request body");
 
@@ -252,12 +284,9 @@ static InspectionBuffer *HttpClientBodyGetDataCallback(DetectEngineThreadCtx *de
         }
     }
 
-    const uint8_t *data;
-    uint32_t data_len;
-
-    StreamingBufferGetDataAtOffset(body->sb,
-            &data, &data_len, offset);
-    InspectionBufferSetup(buffer, data, data_len);
+    /* zero copy bodies are inspected in place where contiguous */
+    InspectionBufferSetupSegments(buffer, HtpBodyGetDataAtOffset, body,
+            offset, body->content_len_so_far);
     buffer->inspect_offset = offset;
 
     /* move inspected tracker to end of the data. HtpBodyPrune will consider
@@ -52,6 +52,8 @@
 #include "app-layer-parser.h"
 
 #include "app-layer-htp.h"
+#include "app-layer-http2.h"
+#include "rust.h"
 #include "detect-http-header.h"
 #include "detect-http-header-common.h"
 
@@ -400,6 +402,48 @@ static int DetectHttpHeaderSetupSticky(DetectEngineCtx *de_ctx, Signature *s, co
     return 0;
 }
 
+static InspectionBuffer *GetRequestData2(DetectEngineThreadCtx *det_ctx,
+        const DetectEngineTransforms *transforms, Flow *_f,
+        const uint8_t _flow_flags, void *txv, const int list_id)
+{
+    InspectionBuffer *buffer = InspectionBufferGet(det_ctx, list_id);
+    if (buffer->inspect == NULL) {
+        const uint8_t *b = NULL;
+        uint32_t b_len = 0;
+
+        if (rs_http2_tx_get_headers(txv, STREAM_TOSERVER, &b, &b_len) != 1)
+            return NULL;
+        if (b == NULL || b_len == 0)
+            return NULL;
+
+        InspectionBufferSetup(buffer, b, b_len);
+        InspectionBufferApplyTransforms(buffer, transforms);
+    }
+
+    return buffer;
+}
+
+static InspectionBuffer *GetResponseData2(DetectEngineThreadCtx *det_ctx,
+        const DetectEngineTransforms *transforms, Flow *_f,
+        const uint8_t _flow_flags, void *txv, const int list_id)
+{
+    InspectionBuffer *buffer = InspectionBufferGet(det_ctx, list_id);
+    if (buffer->inspect == NULL) {
+        const uint8_t *b = NULL;
+        uint32_t b_len = 0;
+
+        if (rs_http2_tx_get_headers(txv, STREAM_TOCLIENT, &b, &b_len) != 1)
+            return NULL;
+        if (b == NULL || b_len == 0)
+            return NULL;
+
+        InspectionBufferSetup(buffer, b, b_len);
+        InspectionBufferApplyTransforms(buffer, transforms);
+    }
+
+    return buffer;
+}
+
 /**
  * \brief Registers the keyword handlers for the "http_header" keyword.
  */
@@ -439,6 +483,22 @@ void DetectHttpHeaderRegister(void)
             PrefilterMpmHttpHeaderResponseRegister, NULL, ALPROTO_HTTP,
             0); /* not used, registered twice: HEADERS/TRAILER */
 
+    DetectAppLayerInspectEngineRegister2("http_header", ALPROTO_HTTP2,
+            SIG_FLAG_TOSERVER, HTTP2_PROGRESS_HEADERS,
+            DetectEngineInspectBufferGeneric, GetRequestData2);
+
+    DetectAppLayerMpmRegister2("http_header", SIG_FLAG_TOSERVER, 2,
+            PrefilterGenericMpmRegister, GetRequestData2, ALPROTO_HTTP2,
+            HTTP2_PROGRESS_HEADERS);
+
+    DetectAppLayerInspectEngineRegister2("http_header", ALPROTO_HTTP2,
+            SIG_FLAG_TOCLIENT, HTTP2_PROGRESS_HEADERS,
+            DetectEngineInspectBufferGeneric, GetResponseData2);
+
+    DetectAppLayerMpmRegister2("http_header", SIG_FLAG_TOCLIENT, 2,
+            PrefilterGenericMpmRegister, GetResponseData2, ALPROTO_HTTP2,
+            HTTP2_PROGRESS_HEADERS);
+
     DetectBufferTypeSetDescriptionByName("http_header",
             "http headers");
 
@@ -59,6 +59,8 @@
 #include "app-layer-parser.h"
 
 #include "app-layer-htp.h"
+#include "app-layer-http2.h"
+#include "rust.h"
 #include "detect-http-stat-code.h"
 #include "stream-tcp-private.h"
 #include "stream-tcp.h"
@@ -73,6 +75,27 @@ static InspectionBuffer *GetData(DetectEngineThreadCtx *det_ctx,
         const DetectEngineTransforms *transforms, Flow *_f,
         const uint8_t _flow_flags, void *txv, const int list_id);
 
+static InspectionBuffer *GetData2(DetectEngineThreadCtx *det_ctx,
+        const DetectEngineTransforms *transforms, Flow *_f,
+        const uint8_t _flow_flags, void *txv, const int list_id)
+{
+    InspectionBuffer *buffer = InspectionBufferGet(det_ctx, list_id);
+    if (buffer->inspect == NULL) {
+        const uint8_t *b = NULL;
+        uint32_t b_len = 0;
+
+        if (rs_http2_tx_get_header_value(txv, STREAM_TOCLIENT, ":status", &b, &b_len) != 1)
+            return NULL;
+        if (b == NULL || b_len == 0)
+            return NULL;
+
+        InspectionBufferSetup(buffer, b, b_len);
+        InspectionBufferApplyTransforms(buffer, transforms);
+    }
+
+    return buffer;
+}
+
 /**
  * \brief Registration function for keyword: http_stat_code
  */
@@ -104,6 +127,14 @@ void DetectHttpStatCodeRegister (void)
             PrefilterGenericMpmRegister, GetData, ALPROTO_HTTP,
             HTP_RESPONSE_LINE);
 
+    DetectAppLayerInspectEngineRegister2("http_stat_code", ALPROTO_HTTP2,
+            SIG_FLAG_TOCLIENT, HTTP2_PROGRESS_HEADERS,
+            DetectEngineInspectBufferGeneric, GetData2);
+
+    DetectAppLayerMpmRegister2("http_stat_code", SIG_FLAG_TOCLIENT, 4,
+            PrefilterGenericMpmRegister, GetData2, ALPROTO_HTTP2,
+            HTTP2_PROGRESS_HEADERS);
+
     DetectBufferTypeSetDescriptionByName("http_stat_code",
             "http response status code");
 
@@ -54,6 +54,8 @@
 #include "app-layer.h"
 
 #include "app-layer-htp.h"
+#include "app-layer-http2.h"
+#include "rust.h"
 #include "detect-http-uri.h"
 #include "detect-uricontent.h"
 #include "stream-tcp.h"
@@ -82,6 +84,33 @@ static int DetectHttpRawUriSetupSticky(DetectEngineCtx *de_ctx, Signature *s, co
 static int g_http_raw_uri_buffer_id = 0;
 static int g_http_uri_buffer_id = 0;
 
+/** \internal
+ *  \brief get the raw uri of a HTTP/2 request, i.e. its :path
+ *
+ *  The :path isn't normalized like libhtp does for HTTP/1, so it's only
+ *  used for http_raw_uri.
+ */
+static InspectionBuffer *GetRawData2(DetectEngineThreadCtx *det_ctx,
+        const DetectEngineTransforms *transforms, Flow *_f,
+        const uint8_t _flow_flags, void *txv, const int list_id)
+{
+    InspectionBuffer *buffer = InspectionBufferGet(det_ctx, list_id);
+    if (buffer->inspect == NULL) {
+        const uint8_t *b = NULL;
+        uint32_t b_len = 0;
+
+        if (rs_http2_tx_get_header_value(txv, STREAM_TOSERVER, ":path", &b, &b_len) != 1)
+            return NULL;
+        if (b == NULL || b_len == 0)
+            return NULL;
+
+        InspectionBufferSetup(buffer, b, b_len);
+        InspectionBufferApplyTransforms(buffer, transforms);
+    }
+
+    return buffer;
+}
+
 /**
  * \brief Registration function for keywords: http_uri and http.uri
  */
@@ -148,6 +177,14 @@ void DetectHttpUriRegister (void)
             PrefilterGenericMpmRegister, GetRawData, ALPROTO_HTTP,
             HTP_REQUEST_LINE);
 
+    DetectAppLayerInspectEngineRegister2("http_raw_uri", ALPROTO_HTTP2,
+            SIG_FLAG_TOSERVER, HTTP2_PROGRESS_HEADERS,
+            DetectEngineInspectBufferGeneric, GetRawData2);
+
+    DetectAppLayerMpmRegister2("http_raw_uri", SIG_FLAG_TOSERVER, 2,
+            PrefilterGenericMpmRegister, GetRawData2, ALPROTO_HTTP2,
+            HTTP2_PROGRESS_HEADERS);
+
     DetectBufferTypeSetDescriptionByName("http_raw_uri",
             "raw http uri");
 
@@ -59,6 +59,7 @@
 #include "app-layer-protos.h"
 #include "app-layer-parser.h"
 #include "app-layer-htp.h"
+#include "app-layer-smtp.h"
 
 #include "util-classification-config.h"
 #include "util-unittest.h"
@@ -163,7 +164,7 @@ int DetectEngineContentModifierBufferSetup(DetectEngineCtx *de_ctx,
                    sigmatch_table[sm_type].name);
         goto end;
     }
-    if (s->alproto != ALPROTO_UNKNOWN && s->alproto != alproto) {
+    if (s->alproto != ALPROTO_UNKNOWN && !AppProtoEquals(alproto, s->alproto)) {
         SCLogError(SC_ERR_CONFLICTING_RULE_KEYWORDS, "rule contains conflicting "
                    "alprotos set");
         goto end;
@@ -217,7 +218,8 @@ int DetectEngineContentModifierBufferSetup(DetectEngineCtx *de_ctx,
             }
         }
     }
-    s->alproto = alproto;
+    if (s->alproto == ALPROTO_UNKNOWN)
+        s->alproto = alproto;
     s->flags |= SIG_FLAG_APPLAYER;
 
     /* transfer the sm from the pmatch list to sm_list */
@@ -1464,6 +1466,12 @@ int DetectSignatureSetAppProto(Signature *s, AppProto alproto)
         return -1;
     }
 
+    /* HTTP keywords can be used in HTTP/2 rules */
+    if (s->alproto != ALPROTO_UNKNOWN && s->alproto != alproto &&
+            AppProtoEquals(alproto, s->alproto)) {
+        return 0;
+    }
+
     if (s->alproto != ALPROTO_UNKNOWN && s->alproto != alproto) {
         SCLogError(SC_ERR_CONFLICTING_RULE_KEYWORDS,
             "can't set rule app proto to %s: already set to %s",
@@ -1656,12 +1664,24 @@ static int SigValidate(DetectEngineCtx *de_ctx, Signature *s)
     } bufdir[nlists];
     memset(&bufdir, 0, nlists * sizeof(struct BufferVsDir));
 
+    /* HTTP rules apply to HTTP/2 only if all their buffers can be inspected
+     * in HTTP/2. Otherwise a rule would match HTTP/2 w/o inspecting the
+     * buffers that have no HTTP/2 engine. */
+    bool http2 = true;
     int x;
     for (x = 0; x < nlists; x++) {
         if (s->init_data->smlists[x]) {
+            bool app_engine = false;
+            bool http2_engine = false;
             const DetectEngineAppInspectionEngine *app = de_ctx->app_inspect_engines;
             for ( ; app != NULL; app = app->next) {
-                if (app->sm_list == x && ((s->alproto == app->alproto) || s->alproto == 0)) {
+                if (app->sm_list != x)
+                    continue;
+                app_engine = true;
+                http2_engine |= (app->alproto == ALPROTO_HTTP2 ||
+                        app->alproto == ALPROTO_UNKNOWN);
+
+                if ((s->alproto == app->alproto) || s->alproto == 0) {
                     SCLogDebug("engine %s dir %d alproto %d",
                             DetectBufferTypeGetNameById(de_ctx, app->sm_list),
                             app->dir, app->alproto);
@@ -1670,6 +1690,15 @@ static int SigValidate(DetectEngineCtx *de_ctx, Signature *s)
                     bufdir[x].tc += (app->dir == 1);
                 }
             }
+            if (app_engine && !http2_engine) {
+                if (s->alproto == ALPROTO_HTTP2) {
+                    SCLogError(SC_ERR_INVALID_SIGNATURE, "rule %u uses buffer %s "
+                            "that is not supported for http2", s->id,
+                            DetectBufferTypeGetNameById(de_ctx, x));
+                    SCReturnInt(0);
+                }
+                http2 = false;
+            }
 
             if (DetectBufferRunValidateCallback(de_ctx, x, s, &de_ctx->sigerror) == FALSE) {
                 SCReturnInt(0);
@@ -1677,6 +1706,10 @@ static int SigValidate(DetectEngineCtx *de_ctx, Signature *s)
         }
     }
 
+    if (s->alproto == ALPROTO_HTTP && http2) {
+        s->flags |= SIG_FLAG_HTTP2;
+    }
+
     int ts_excl = 0;
     int tc_excl = 0;
     int dir_amb = 0;
@@ -1840,6 +1873,9 @@ static int SigValidate(DetectEngineCtx *de_ctx, Signature *s)
         if (s->alproto == ALPROTO_HTTP) {
             AppLayerHtpNeedFileInspection();
         }
+        if (s->alproto == ALPROTO_SMTP || s->alproto == ALPROTO_UNKNOWN) {
+            SMTPNeedFileInspection();
+        }
     }
 
     SCReturnInt(1);
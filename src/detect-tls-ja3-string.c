@@ -133,15 +133,15 @@ static InspectionBuffer *GetData(DetectEngineThreadCtx *det_ctx,
 {
     InspectionBuffer *buffer = InspectionBufferGet(det_ctx, list_id);
     if (buffer->inspect == NULL) {
-        const SSLState *ssl_state = (SSLState *)f->alstate;
+        SSLState *ssl_state = (SSLState *)f->alstate;
 
-        if (ssl_state->client_connp.ja3_str == NULL ||
-                ssl_state->client_connp.ja3_str->data == NULL) {
+        const JA3Buffer *ja3_str = SSLStateGetJA3String(&ssl_state->client_connp);
+        if (ja3_str == NULL || ja3_str->data == NULL) {
             return NULL;
         }
 
-        const uint32_t data_len = strlen(ssl_state->client_connp.ja3_str->data);
-        const uint8_t *data = (uint8_t *)ssl_state->client_connp.ja3_str->data;
+        const uint32_t data_len = ja3_str->used;
+        const uint8_t *data = (uint8_t *)ja3_str->data;
 
         InspectionBufferSetup(buffer, data, data_len);
         InspectionBufferApplyTransforms(buffer, transforms);
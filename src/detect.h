@@ -218,7 +218,7 @@ typedef struct DetectPort_ {
 #define SIG_FLAG_APPLAYER               BIT_U32(6)  /**< signature applies to app layer instead of packets */
 #define SIG_FLAG_IPONLY                 BIT_U32(7)  /**< ip only signature */
 
-// vacancy
+#define SIG_FLAG_HTTP2                  BIT_U32(8)  /**< http signature also applies to HTTP/2 flows */
 
 #define SIG_FLAG_REQUIRE_PACKET         BIT_U32(9)  /**< signature is requiring packet match */
 #define SIG_FLAG_REQUIRE_STREAM         BIT_U32(10) /**< signature is requiring stream match */
@@ -594,6 +594,20 @@ typedef struct Signature_ {
     struct Signature_ *next;
 } Signature;
 
+/**
+ * \brief Check if a signature applies to a flow's app layer protocol.
+ *
+ * HTTP signatures only apply to HTTP/2 flows if all their buffers can be
+ * inspected in HTTP/2, see SIG_FLAG_HTTP2.
+ */
+static inline bool SignatureAppProtoMatches(const Signature *s, AppProto alproto)
+{
+    if (s->alproto == alproto)
+        return true;
+    return (s->alproto == ALPROTO_HTTP && alproto == ALPROTO_HTTP2 &&
+            (s->flags & SIG_FLAG_HTTP2));
+}
+
 enum DetectBufferMpmType {
     DETECT_BUFFER_MPM_TYPE_PKT,
     DETECT_BUFFER_MPM_TYPE_APP,
@@ -1048,6 +1062,10 @@ typedef struct DetectEngineThreadCtx_ {
 
     int inspect_list; /**< list we're currently inspecting, DETECT_SM_LIST_* */
 
+    /** thread local threshold state, NULL unless
+     *  detect.thresholds.thread-local is enabled */
+    struct ThresholdThreadCtx_ *ths_tctx;
+
     struct {
         InspectionBuffer *buffers;
         uint32_t buffers_size;          /**< in number of elements */
@@ -411,6 +411,38 @@ void FlowSetupPacket(Packet *p)
     p->flow_hash = FlowGetHash(p);
 }
 
+/**
+ *  \brief prefetch the hash bucket the flow of a packet lives in
+ *
+ *  The flow hash is set up by the decoder, so this can be done well before
+ *  the packet reaches FlowGetFlowFromHash. Used by the autofp "flow-ring"
+ *  input handler.
+ */
+void FlowPrefetchBucket(const Packet *p)
+{
+    if (!(p->flags & PKT_WANTS_FLOW))
+        return;
+    const FlowBucket *fb = &flow_hash[p->flow_hash % flow_config.hash_size];
+    __builtin_prefetch(fb, 1);
+}
+
+/**
+ *  \brief prefetch the first flow in the hash bucket of a packet
+ *
+ *  Meant to be called some time after FlowPrefetchBucket, so the bucket
+ *  itself is cached by now. The bucket is read without its lock: the
+ *  pointer is only used as a hint and never dereferenced here.
+ */
+void FlowPrefetchFlow(const Packet *p)
+{
+    if (!(p->flags & PKT_WANTS_FLOW))
+        return;
+    FlowBucket *fb = &flow_hash[p->flow_hash % flow_config.hash_size];
+    Flow *f = __atomic_load_n(&fb->head, __ATOMIC_RELAXED);
+    if (f != NULL)
+        __builtin_prefetch(f, 1);
+}
+
 int TcpSessionPacketSsnReuse(const Packet *p, const Flow *f, void *tcp_ssn);
 
 static inline int FlowCompare(Flow *f, const Packet *p)
@@ -478,6 +510,44 @@ static inline void FlowUpdateCounter(ThreadVars *tv, DecodeThreadVars *dtv,
 #endif
 }
 
+/** \internal
+ *  \brief get a flow from the spare queues
+ *
+ *  With NUMA awareness the spare queue of the node of the calling thread
+ *  is tried first. Only when it is empty a flow is taken from another node.
+ *
+ *  \retval f *unlocked* flow or NULL if all spare queues are empty
+ */
+static Flow *FlowSpareGet(ThreadVars *tv, DecodeThreadVars *dtv)
+{
+    if (!NumaIsEnabled())
+        return FlowDequeue(&flow_spare_q);
+
+    const int thread_node = NumaThreadNode();
+    const int local = thread_node < 0 ? 0 : thread_node;
+
+    Flow *f = FlowDequeue(FlowSpareQueue(local));
+    if (f != NULL) {
+        if (tv != NULL && dtv != NULL && thread_node >= 0) {
+            StatsIncr(tv, dtv->counter_numa_flow_local);
+        }
+        return f;
+    }
+
+    for (int node = 0; node < NumaNodeCount(); node++) {
+        if (node == local)
+            continue;
+        f = FlowDequeue(FlowSpareQueue(node));
+        if (f != NULL) {
+            if (tv != NULL && dtv != NULL && thread_node >= 0) {
+                StatsIncr(tv, dtv->counter_numa_flow_remote);
+            }
+            return f;
+        }
+    }
+    return NULL;
+}
+
 /**
  *  \brief Get a new flow
  *
@@ -498,7 +568,7 @@ static Flow *FlowGetNew(ThreadVars *tv, DecodeThreadVars *dtv, const Packet *p)
     }
 
     /* get a flow from the spare queue */
-    f = FlowDequeue(&flow_spare_q);
+    f = FlowSpareGet(tv, dtv);
     if (f == NULL) {
         /* If we reached the max memcap, we get a used flow */
         if (!(FLOW_CHECK_MEMCAP(sizeof(Flow) + FlowStorageSize()))) {
@@ -535,6 +605,9 @@ static Flow *FlowGetNew(ThreadVars *tv, DecodeThreadVars *dtv, const Packet *p)
                 }
                 return NULL;
             }
+            /* allocated by this thread, so on its node */
+            if (NumaThreadNode() > 0)
+                f->numa_node = (uint8_t)NumaThreadNode();
 
             /* flow is initialized but *unlocked* */
         }
@@ -753,7 +826,7 @@ Flow *FlowGetFromFlowKey(FlowKey *key, struct timespec *ttime, const uint32_t ha
     }
 
     /* No existing flow so let's get one new */
-    f = FlowDequeue(&flow_spare_q);
+    f = FlowSpareGet(NULL, NULL);
     if (f == NULL) {
         /* now see if we can alloc a new flow */
         f = FlowAlloc();
@@ -28,6 +28,7 @@
 #include "flow-queue.h"
 
 #include "util-atomic.h"
+#include "util-numa.h"
 
 /* global flow flags */
 
@@ -89,6 +90,8 @@ extern FlowProtoFreeFunc flow_freefuncs[FLOW_PROTO_MAX];
 
 /** spare/unused/prealloced flows live here */
 extern FlowQueue flow_spare_q;
+/** spare flows of the NUMA nodes other than node 0. Index 0 is not used. */
+extern FlowQueue flow_spare_node_q[NUMA_NODES_MAX];
 
 /** queue to pass flows to cleanup/log thread(s) */
 extern FlowQueue flow_recycle_q;
@@ -99,5 +102,13 @@ extern FlowConfig flow_config;
 /** flow memuse counter (atomic), for enforcing memcap limit */
 SC_ATOMIC_EXTERN(uint64_t, flow_memuse);
 
+/** \brief get the spare queue of a NUMA node
+ *
+ *  Node 0, and all flows when NUMA awareness is off, use flow_spare_q. */
+static inline FlowQueue *FlowSpareQueue(int node)
+{
+    return node > 0 ? &flow_spare_node_q[node] : &flow_spare_q;
+}
+
 #endif /* __FLOW_PRIVATE_H__ */
 
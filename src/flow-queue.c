@@ -32,6 +32,7 @@
 #include "util-error.h"
 #include "util-debug.h"
 #include "util-print.h"
+#include "util-hash-template.h"
 
 FlowQueue *FlowQueueNew()
 {
@@ -44,96 +45,7 @@ FlowQueue *FlowQueueNew()
     return q;
 }
 
-FlowQueue *FlowQueueInit (FlowQueue *q)
-{
-    if (q != NULL) {
-        memset(q, 0, sizeof(FlowQueue));
-        FQLOCK_INIT(q);
-    }
-    return q;
-}
-
-/**
- *  \brief Destroy a flow queue
- *
- *  \param q the flow queue to destroy
- */
-void FlowQueueDestroy (FlowQueue *q)
-{
-    FQLOCK_DESTROY(q);
-}
-
-/**
- *  \brief add a flow to a queue
- *
- *  \param q queue
- *  \param f flow
- */
-void FlowEnqueue (FlowQueue *q, Flow *f)
-{
-#ifdef DEBUG
-    BUG_ON(q == NULL || f == NULL);
-#endif
-
-    FQLOCK_LOCK(q);
-
-    /* more flows in queue */
-    if (q->top != NULL) {
-        f->lnext = q->top;
-        q->top->lprev = f;
-        q->top = f;
-    /* only flow */
-    } else {
-        q->top = f;
-        q->bot = f;
-    }
-    q->len++;
-#ifdef DBG_PERF
-    if (q->len > q->dbg_maxlen)
-        q->dbg_maxlen = q->len;
-#endif /* DBG_PERF */
-    FQLOCK_UNLOCK(q);
-}
-
-/**
- *  \brief remove a flow from the queue
- *
- *  \param q queue
- *
- *  \retval f flow or NULL if empty list.
- */
-Flow *FlowDequeue (FlowQueue *q)
-{
-    FQLOCK_LOCK(q);
-
-    Flow *f = q->bot;
-    if (f == NULL) {
-        FQLOCK_UNLOCK(q);
-        return NULL;
-    }
-
-    /* more packets in queue */
-    if (q->bot->lprev != NULL) {
-        q->bot = q->bot->lprev;
-        q->bot->lnext = NULL;
-    /* just the one we remove, so now empty */
-    } else {
-        q->top = NULL;
-        q->bot = NULL;
-    }
-
-#ifdef DEBUG
-    BUG_ON(q->len == 0);
-#endif
-    if (q->len > 0)
-        q->len--;
-
-    f->lnext = NULL;
-    f->lprev = NULL;
-
-    FQLOCK_UNLOCK(q);
-    return f;
-}
+HASH_TEMPLATE_QUEUE_FUNCS(, Flow, FlowQueue, Flow, lnext, lprev, FQLOCK)
 
 /**
  *  \brief Transfer a flow from a queue to the spare queue
@@ -145,24 +57,22 @@ Flow *FlowDequeue (FlowQueue *q)
  */
 void FlowMoveToSpare(Flow *f)
 {
-    /* now put it in spare */
-    FQLOCK_LOCK(&flow_spare_q);
+    /* now put it in spare, of the node the flow was allocated on */
+    FlowQueue *q = FlowSpareQueue(f->numa_node);
+    FQLOCK_LOCK(q);
 
     /* add to new queue (append) */
-    f->lprev = flow_spare_q.bot;
+    f->lprev = q->bot;
     if (f->lprev != NULL)
         f->lprev->lnext = f;
     f->lnext = NULL;
-    flow_spare_q.bot = f;
-    if (flow_spare_q.top == NULL)
-        flow_spare_q.top = f;
+    q->bot = f;
+    if (q->top == NULL)
+        q->top = f;
 
-    flow_spare_q.len++;
-#ifdef DBG_PERF
-    if (flow_spare_q.len > flow_spare_q.dbg_maxlen)
-        flow_spare_q.dbg_maxlen = flow_spare_q.len;
-#endif /* DBG_PERF */
+    q->len++;
+    HASH_TEMPLATE_QUEUE_DBG_MAXLEN(q);
 
-    FQLOCK_UNLOCK(&flow_spare_q);
+    FQLOCK_UNLOCK(q);
 }
 
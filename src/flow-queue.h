@@ -78,6 +78,7 @@ void FlowQueueDestroy (FlowQueue *);
 
 void FlowEnqueue (FlowQueue *, Flow *);
 Flow *FlowDequeue (FlowQueue *);
+uint32_t FlowQueueLen(FlowQueue *);
 
 void FlowMoveToSpare(Flow *);
 
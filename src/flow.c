@@ -92,6 +92,8 @@ FlowProtoFreeFunc flow_freefuncs[FLOW_PROTO_MAX];
 
 /** spare/unused/prealloced flows live here */
 FlowQueue flow_spare_q;
+/** spare flows of the NUMA nodes other than node 0 */
+FlowQueue flow_spare_node_q[NUMA_NODES_MAX];
 
 FlowConfig flow_config;
 
@@ -148,10 +150,38 @@ void FlowCleanupAppLayer(Flow *f)
     return;
 }
 
+/** \internal
+ *  \brief number of spare flows to keep for a NUMA node
+ *
+ *  The prealloc setting is split evenly over the nodes. */
+static uint32_t FlowSparePrealloc(int node)
+{
+    const uint32_t nodes = (uint32_t)NumaNodeCount();
+    uint32_t prealloc = flow_config.prealloc / nodes;
+    if (node == 0)
+        prealloc += flow_config.prealloc % nodes;
+    return prealloc;
+}
+
+/** \brief get the number of spare flows of all NUMA nodes */
+uint32_t FlowSpareGetCount(void)
+{
+    uint32_t len = 0;
+
+    for (int node = 0; node < NumaNodeCount(); node++) {
+        FlowQueue *q = FlowSpareQueue(node);
+        FQLOCK_LOCK(q);
+        len += q->len;
+        FQLOCK_UNLOCK(q);
+    }
+    return len;
+}
+
 /** \brief Make sure we have enough spare flows. 
  *
  *  Enforce the prealloc parameter, so keep at least prealloc flows in the
- *  spare queue and free flows going over the limit.
+ *  spare queue and free flows going over the limit. With NUMA awareness
+ *  each node has its own spare queue, holding its share of prealloc.
  *
  *  \retval 1 if the queue was properly updated (or if it already was in good shape)
  *  \retval 0 otherwise.
@@ -159,34 +189,46 @@ void FlowCleanupAppLayer(Flow *f)
 int FlowUpdateSpareFlows(void)
 {
     SCEnter();
-    uint32_t toalloc = 0, tofree = 0, len;
-
-    FQLOCK_LOCK(&flow_spare_q);
-    len = flow_spare_q.len;
-    FQLOCK_UNLOCK(&flow_spare_q);
-
-    if (len < flow_config.prealloc) {
-        toalloc = flow_config.prealloc - len;
-
-        uint32_t i;
-        for (i = 0; i < toalloc; i++) {
-            Flow *f = FlowAlloc();
-            if (f == NULL)
-                return 0;
-
-            FlowEnqueue(&flow_spare_q,f);
-        }
-    } else if (len > flow_config.prealloc) {
-        tofree = len - flow_config.prealloc;
+    const int nodes = NumaNodeCount();
+
+    for (int node = 0; node < nodes; node++) {
+        FlowQueue *q = FlowSpareQueue(node);
+        const uint32_t prealloc = FlowSparePrealloc(node);
+        uint32_t len;
+
+        FQLOCK_LOCK(q);
+        len = q->len;
+        FQLOCK_UNLOCK(q);
+
+        if (len < prealloc) {
+            uint32_t toalloc = prealloc - len;
+
+            NumaPolicy policy;
+            NumaSetPreferred(node, &policy);
+            uint32_t i;
+            for (i = 0; i < toalloc; i++) {
+                Flow *f = FlowAlloc();
+                if (f == NULL) {
+                    NumaResetPreferred(&policy);
+                    return 0;
+                }
+
+                f->numa_node = (uint8_t)node;
+                FlowEnqueue(q, f);
+            }
+            NumaResetPreferred(&policy);
+        } else if (len > prealloc) {
+            uint32_t tofree = len - prealloc;
 
-        uint32_t i;
-        for (i = 0; i < tofree; i++) {
-            /* FlowDequeue locks the queue */
-            Flow *f = FlowDequeue(&flow_spare_q);
-            if (f == NULL)
-                return 1;
+            uint32_t i;
+            for (i = 0; i < tofree; i++) {
+                /* FlowDequeue locks the queue */
+                Flow *f = FlowDequeue(q);
+                if (f == NULL)
+                    break;
 
-            FlowFree(f);
+                FlowFree(f);
+            }
         }
     }
 
@@ -537,6 +579,9 @@ void FlowInitConfig(char quiet)
     SC_ATOMIC_INIT(flow_prune_idx);
     SC_ATOMIC_INIT(flow_config.memcap);
     FlowQueueInit(&flow_spare_q);
+    for (int node = 1; node < NUMA_NODES_MAX; node++) {
+        FlowQueueInit(&flow_spare_node_q[node]);
+    }
     FlowQueueInit(&flow_recycle_q);
 
     /* set defaults */
@@ -642,28 +687,34 @@ void FlowInitConfig(char quiet)
                   (uintmax_t)sizeof(FlowBucket));
     }
 
-    /* pre allocate flows */
-    for (i = 0; i < flow_config.prealloc; i++) {
-        if (!(FLOW_CHECK_MEMCAP(sizeof(Flow) + FlowStorageSize()))) {
-            SCLogError(SC_ERR_FLOW_INIT, "preallocating flows failed: "
-                    "max flow memcap reached. Memcap %"PRIu64", "
-                    "Memuse %"PRIu64".", SC_ATOMIC_GET(flow_config.memcap),
-                    ((uint64_t)SC_ATOMIC_GET(flow_memuse) + (uint64_t)sizeof(Flow)));
-            exit(EXIT_FAILURE);
-        }
+    /* pre allocate flows, on each NUMA node its share */
+    for (int node = 0; node < NumaNodeCount(); node++) {
+        NumaPolicy policy;
+        NumaSetPreferred(node, &policy);
+        for (i = 0; i < FlowSparePrealloc(node); i++) {
+            if (!(FLOW_CHECK_MEMCAP(sizeof(Flow) + FlowStorageSize()))) {
+                SCLogError(SC_ERR_FLOW_INIT, "preallocating flows failed: "
+                        "max flow memcap reached. Memcap %"PRIu64", "
+                        "Memuse %"PRIu64".", SC_ATOMIC_GET(flow_config.memcap),
+                        ((uint64_t)SC_ATOMIC_GET(flow_memuse) + (uint64_t)sizeof(Flow)));
+                exit(EXIT_FAILURE);
+            }
 
-        Flow *f = FlowAlloc();
-        if (f == NULL) {
-            SCLogError(SC_ERR_FLOW_INIT, "preallocating flow failed: %s", strerror(errno));
-            exit(EXIT_FAILURE);
-        }
+            Flow *f = FlowAlloc();
+            if (f == NULL) {
+                SCLogError(SC_ERR_FLOW_INIT, "preallocating flow failed: %s", strerror(errno));
+                exit(EXIT_FAILURE);
+            }
 
-        FlowEnqueue(&flow_spare_q,f);
+            f->numa_node = (uint8_t)node;
+            FlowEnqueue(FlowSpareQueue(node), f);
+        }
+        NumaResetPreferred(&policy);
     }
 
     if (quiet == FALSE) {
         SCLogConfig("preallocated %" PRIu32 " flows of size %" PRIuMAX "",
-                flow_spare_q.len, (uintmax_t)(sizeof(Flow) + + FlowStorageSize()));
+                FlowSpareGetCount(), (uintmax_t)(sizeof(Flow) + + FlowStorageSize()));
         SCLogConfig("flow memory usage: %"PRIu64" bytes, maximum: %"PRIu64,
                 SC_ATOMIC_GET(flow_memuse), SC_ATOMIC_GET(flow_config.memcap));
     }
@@ -693,6 +744,11 @@ void FlowShutdown(void)
     while((f = FlowDequeue(&flow_spare_q))) {
         FlowFree(f);
     }
+    for (int node = 1; node < NUMA_NODES_MAX; node++) {
+        while((f = FlowDequeue(&flow_spare_node_q[node]))) {
+            FlowFree(f);
+        }
+    }
     while((f = FlowDequeue(&flow_recycle_q))) {
         FlowFree(f);
     }
@@ -721,6 +777,9 @@ void FlowShutdown(void)
     }
     (void) SC_ATOMIC_SUB(flow_memuse, flow_config.hash_size * sizeof(FlowBucket));
     FlowQueueDestroy(&flow_spare_q);
+    for (int node = 1; node < NUMA_NODES_MAX; node++) {
+        FlowQueueDestroy(&flow_spare_node_q[node]);
+    }
     FlowQueueDestroy(&flow_recycle_q);
 
     SC_ATOMIC_DESTROY(flow_config.memcap);
@@ -1354,6 +1413,35 @@ static int FlowTest09 (void)
     return result;
 }
 
+/**
+ *  \test flows return to the spare queue of the NUMA node they were
+ *        allocated on
+ */
+static int FlowTest10 (void)
+{
+    FlowInitConfig(FLOW_QUIET);
+    uint32_t spare = flow_spare_q.len;
+
+    Flow *f = FlowAlloc();
+    FAIL_IF_NULL(f);
+    f->numa_node = 2;
+    FlowMoveToSpare(f);
+    FAIL_IF_NOT(flow_spare_q.len == spare);
+    FAIL_IF_NOT(flow_spare_node_q[2].len == 1);
+    FAIL_IF_NOT(FlowSpareGetCount() == spare);
+
+    FAIL_IF_NOT(FlowDequeue(FlowSpareQueue(2)) == f);
+    FlowFree(f);
+
+    f = FlowAlloc();
+    FAIL_IF_NULL(f);
+    FlowMoveToSpare(f);
+    FAIL_IF_NOT(flow_spare_q.len == spare + 1);
+
+    FlowShutdown();
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 /**
@@ -1371,6 +1459,7 @@ void FlowRegisterTests (void)
                    FlowTest08);
     UtRegisterTest("FlowTest09 -- Test flow Allocations when it reach memcap",
                    FlowTest09);
+    UtRegisterTest("FlowTest10 -- Test NUMA node spare queues", FlowTest10);
 
     FlowMgrRegisterTests();
     RegisterFlowStorageTests();
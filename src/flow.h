@@ -362,6 +362,8 @@ typedef struct Flow_
     uint8_t recursion_level;
     uint16_t vlan_id[2];
     uint8_t vlan_idx;
+    /** NUMA node the flow memory was allocated on, see FlowSpareQueue() */
+    uint8_t numa_node;
 
     /** Incoming interface */
     struct LiveDevice_ *livedev;
@@ -536,6 +538,7 @@ void FlowUpdateQueue(Flow *);
 struct FlowQueue_;
 
 int FlowUpdateSpareFlows(void);
+uint32_t FlowSpareGetCount(void);
 
 static inline void FlowSetNoPacketInspectionFlag(Flow *);
 static inline void FlowSetNoPayloadInspectionFlag(Flow *);
@@ -30,15 +30,7 @@
 #include "util-error.h"
 #include "util-debug.h"
 #include "util-print.h"
-
-HostQueue *HostQueueInit (HostQueue *q)
-{
-    if (q != NULL) {
-        memset(q, 0, sizeof(HostQueue));
-        HQLOCK_INIT(q);
-    }
-    return q;
-}
+#include "util-hash-template.h"
 
 HostQueue *HostQueueNew()
 {
@@ -51,94 +43,5 @@ HostQueue *HostQueueNew()
     return q;
 }
 
-/**
- *  \brief Destroy a host queue
- *
- *  \param q the host queue to destroy
- */
-void HostQueueDestroy (HostQueue *q)
-{
-    HQLOCK_DESTROY(q);
-}
-
-/**
- *  \brief add a host to a queue
- *
- *  \param q queue
- *  \param h host
- */
-void HostEnqueue (HostQueue *q, Host *h)
-{
-#ifdef DEBUG
-    BUG_ON(q == NULL || h == NULL);
-#endif
-
-    HQLOCK_LOCK(q);
-
-    /* more hosts in queue */
-    if (q->top != NULL) {
-        h->lnext = q->top;
-        q->top->lprev = h;
-        q->top = h;
-    /* only host */
-    } else {
-        q->top = h;
-        q->bot = h;
-    }
-    q->len++;
-#ifdef DBG_PERF
-    if (q->len > q->dbg_maxlen)
-        q->dbg_maxlen = q->len;
-#endif /* DBG_PERF */
-    HQLOCK_UNLOCK(q);
-}
-
-/**
- *  \brief remove a host from the queue
- *
- *  \param q queue
- *
- *  \retval h host or NULL if empty list.
- */
-Host *HostDequeue (HostQueue *q)
-{
-    HQLOCK_LOCK(q);
-
-    Host *h = q->bot;
-    if (h == NULL) {
-        HQLOCK_UNLOCK(q);
-        return NULL;
-    }
-
-    /* more packets in queue */
-    if (q->bot->lprev != NULL) {
-        q->bot = q->bot->lprev;
-        q->bot->lnext = NULL;
-    /* just the one we remove, so now empty */
-    } else {
-        q->top = NULL;
-        q->bot = NULL;
-    }
-
-#ifdef DEBUG
-    BUG_ON(q->len == 0);
-#endif
-    if (q->len > 0)
-        q->len--;
-
-    h->lnext = NULL;
-    h->lprev = NULL;
-
-    HQLOCK_UNLOCK(q);
-    return h;
-}
-
-uint32_t HostQueueLen(HostQueue *q)
-{
-    uint32_t len;
-    HQLOCK_LOCK(q);
-    len = q->len;
-    HQLOCK_UNLOCK(q);
-    return len;
-}
+HASH_TEMPLATE_QUEUE_FUNCS(, Host, HostQueue, Host, lnext, lprev, HQLOCK)
 
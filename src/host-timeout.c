@@ -32,6 +32,8 @@
 
 #include "reputation.h"
 
+#include "app-layer-detect-proto-cache.h"
+
 uint32_t HostGetSpareCount(void)
 {
     return HostSpareQueueGetSize();
@@ -56,6 +58,7 @@ static int HostHostTimedOut(Host *h, struct timeval *ts)
     int tags = 0;
     int thresholds = 0;
     int vars = 0;
+    int alproto_cache = 0;
 
     /** never prune a host that is used by a packet
      *  we are currently processing in one of the threads */
@@ -79,8 +82,12 @@ static int HostHostTimedOut(Host *h, struct timeval *ts)
     if (HostHasHostBits(h) && HostBitsTimedoutCheck(h, ts) == 0) {
         vars = 1;
     }
+    if (AppLayerProtoDetectCacheHostHasEntries(h) &&
+            AppLayerProtoDetectCacheTimeoutCheck(h, ts) == 0) {
+        alproto_cache = 1;
+    }
 
-    if (tags || thresholds || vars)
+    if (tags || thresholds || vars || alproto_cache)
         return 0;
 
     SCLogDebug("host %p timed out", h);
@@ -114,17 +121,7 @@ static uint32_t HostHashRowTimeout(HostHashRow *hb, Host *h, struct timeval *ts)
          * ready to be discarded. */
         if (HostHostTimedOut(h, ts) == 1) {
             /* remove from the hash */
-            if (h->hprev != NULL)
-                h->hprev->hnext = h->hnext;
-            if (h->hnext != NULL)
-                h->hnext->hprev = h->hprev;
-            if (hb->head == h)
-                hb->head = h->hnext;
-            if (hb->tail == h)
-                hb->tail = h->hprev;
-
-            h->hnext = NULL;
-            h->hprev = NULL;
+            HostRowRemove(hb, h);
 
             HostClearMemory (h);
 
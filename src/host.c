@@ -42,6 +42,7 @@
 #include "detect-engine-threshold.h"
 
 #include "util-hash-lookup3.h"
+#include "util-unittest.h"
 
 static Host *HostGetUsedHost(void);
 
@@ -55,6 +56,8 @@ SC_ATOMIC_DECLARE(uint64_t,host_memuse);
 SC_ATOMIC_DECLARE(uint32_t,host_counter);
 SC_ATOMIC_DECLARE(uint32_t,host_prune_idx);
 
+HASH_TEMPLATE_MEMUSE_FUNCS(Host, host_memuse, host_config.memcap)
+
 /** size of the host object. Maybe updated in HostInitConfig to include
  *  the storage APIs additions. */
 static uint16_t g_host_size = sizeof(Host);
@@ -109,10 +112,10 @@ void HostMoveToSpare(Host *h)
 
 Host *HostAlloc(void)
 {
-    if (!(HOST_CHECK_MEMCAP(g_host_size))) {
+    if (!(HostMemuseCheck(g_host_size))) {
         return NULL;
     }
-    (void) SC_ATOMIC_ADD(host_memuse, g_host_size);
+    HostMemuseAdd(g_host_size);
 
     Host *h = SCMalloc(g_host_size);
     if (unlikely(h == NULL))
@@ -136,7 +139,7 @@ void HostFree(Host *h)
         SC_ATOMIC_DESTROY(h->use_cnt);
         SCMutexDestroy(&h->m);
         SCFree(h);
-        (void) SC_ATOMIC_SUB(host_memuse, g_host_size);
+        HostMemuseSub(g_host_size);
     }
 }
 
@@ -183,6 +186,7 @@ void HostInitConfig(char quiet)
     SC_ATOMIC_INIT(host_counter);
     SC_ATOMIC_INIT(host_memuse);
     SC_ATOMIC_INIT(host_prune_idx);
+    HostMemuseReset();
     SC_ATOMIC_INIT(host_config.memcap);
     HostQueueInit(&host_spare_q);
 
@@ -366,16 +370,7 @@ void HostCleanup(void)
                 } else {
                     Host *n = h->hnext;
                     /* remove from the hash */
-                    if (h->hprev != NULL)
-                        h->hprev->hnext = h->hnext;
-                    if (h->hnext != NULL)
-                        h->hnext->hprev = h->hprev;
-                    if (hb->head == h)
-                        hb->head = h->hnext;
-                    if (hb->tail == h)
-                        hb->tail = h->hprev;
-                    h->hnext = NULL;
-                    h->hprev = NULL;
+                    HostRowRemove(hb, h);
                     HostClearMemory(h);
                     HostMoveToSpare(h);
                     h = n;
@@ -388,26 +383,27 @@ void HostCleanup(void)
     return;
 }
 
-/* calculate the hash key for this packet
+/* calculate the hash for this address
  *
  * we're using:
  *  hash_rand -- set at init time
  *  source address
+ *
+ * The full hash is used as fingerprint of the host in its hash row, the
+ * row itself is the hash modulo the hash size.
  */
-static inline uint32_t HostGetKey(Address *a)
+static inline uint32_t HostGetHash(Address *a)
 {
-    uint32_t key;
+    uint32_t hash;
 
     if (a->family == AF_INET) {
-        uint32_t hash = hashword(&a->addr_data32[0], 1, host_config.hash_rand);
-        key = hash % host_config.hash_size;
+        hash = hashword(&a->addr_data32[0], 1, host_config.hash_rand);
     } else if (a->family == AF_INET6) {
-        uint32_t hash = hashword(a->addr_data32, 4, host_config.hash_rand);
-        key = hash % host_config.hash_size;
+        hash = hashword(a->addr_data32, 4, host_config.hash_rand);
     } else
-        key = 0;
+        hash = 0;
 
-    return key;
+    return hash;
 }
 
 /* Since two or more hosts can have the same hash key, we need to compare
@@ -415,11 +411,18 @@ static inline uint32_t HostGetKey(Address *a)
 #define CMP_HOST(h,a) \
     (CMP_ADDR(&(h)->a, (a)))
 
-static inline int HostCompare(Host *h, Address *a)
+static bool HostMatch(const Host *h, const void *key)
 {
+    const Address *a = key;
     return CMP_HOST(h, a);
 }
 
+/** never prune a host that is used by a packets
+ *  we are currently processing in one of the threads */
+#define HostEvictable(h) (SC_ATOMIC_GET((h)->use_cnt) == 0)
+
+HASH_TEMPLATE_GET_USED_FUNC(Host, HostHashRow, Host, HRLOCK, m, HostEvictable)
+
 /**
  *  \brief Get a new host
  *
@@ -436,7 +439,7 @@ static Host *HostGetNew(Address *a)
     h = HostDequeue(&host_spare_q);
     if (h == NULL) {
         /* If we reached the max memcap, we get a used host */
-        if (!(HOST_CHECK_MEMCAP(g_host_size))) {
+        if (!(HostMemuseCheck(g_host_size))) {
             /* declare state of emergency */
             //if (!(SC_ATOMIC_GET(host_flags) & HOST_EMERGENCY)) {
             //    SC_ATOMIC_OR(host_flags, HOST_EMERGENCY);
@@ -473,9 +476,10 @@ static Host *HostGetNew(Address *a)
     return h;
 }
 
-static void HostInit(Host *h, Address *a)
+static void HostInit(Host *h, Address *a, const uint32_t hash)
 {
     COPY_ADDRESS(a, &h->a);
+    h->hfp = hash;
     (void) HostIncrUsecnt(h);
 }
 
@@ -501,98 +505,36 @@ void HostUnlock(Host *h)
  * Hash retrieval function for hosts. Looks up the hash bucket containing the
  * host pointer. Then compares the packet with the found host to see if it is
  * the host we need. If it isn't, walk the list until the right host is found.
+ * If it isn't in the list, a new host is added to the tail of the list.
  *
  * returns a *LOCKED* host or NULL
  */
 Host *HostGetHostFromHash (Address *a)
 {
-    Host *h = NULL;
-
-    /* get the key to our bucket */
-    uint32_t key = HostGetKey(a);
-    /* get our hash bucket and lock it */
-    HostHashRow *hb = &host_hash[key];
+    /* get the hash and our bucket, and lock it */
+    const uint32_t hash = HostGetHash(a);
+    HostHashRow *hb = &host_hash[hash % host_config.hash_size];
     HRLOCK_LOCK(hb);
 
-    /* see if the bucket already has a host */
-    if (hb->head == NULL) {
-        h = HostGetNew(a);
-        if (h == NULL) {
-            HRLOCK_UNLOCK(hb);
-            return NULL;
-        }
-
-        /* host is locked */
-        hb->head = h;
-        hb->tail = h;
-
-        /* got one, now lock, initialize and return */
-        HostInit(h,a);
-
+    Host *h = HostRowFind(hb, hash, HostMatch, a);
+    if (h != NULL) {
+        /* found our host, lock & return */
+        SCMutexLock(&h->m);
+        (void) HostIncrUsecnt(h);
         HRLOCK_UNLOCK(hb);
         return h;
     }
 
-    /* ok, we have a host in the bucket. Let's find out if it is our host */
-    h = hb->head;
-
-    /* see if this is the host we are looking for */
-    if (HostCompare(h, a) == 0) {
-        Host *ph = NULL; /* previous host */
-
-        while (h) {
-            ph = h;
-            h = h->hnext;
-
-            if (h == NULL) {
-                h = ph->hnext = HostGetNew(a);
-                if (h == NULL) {
-                    HRLOCK_UNLOCK(hb);
-                    return NULL;
-                }
-                hb->tail = h;
-
-                /* host is locked */
-
-                h->hprev = ph;
-
-                /* initialize and return */
-                HostInit(h,a);
-
-                HRLOCK_UNLOCK(hb);
-                return h;
-            }
-
-            if (HostCompare(h, a) != 0) {
-                /* we found our host, lets put it on top of the
-                 * hash list -- this rewards active hosts */
-                if (h->hnext) {
-                    h->hnext->hprev = h->hprev;
-                }
-                if (h->hprev) {
-                    h->hprev->hnext = h->hnext;
-                }
-                if (h == hb->tail) {
-                    hb->tail = h->hprev;
-                }
-
-                h->hnext = hb->head;
-                h->hprev = NULL;
-                hb->head->hprev = h;
-                hb->head = h;
-
-                /* found our host, lock & return */
-                SCMutexLock(&h->m);
-                (void) HostIncrUsecnt(h);
-                HRLOCK_UNLOCK(hb);
-                return h;
-            }
-        }
+    h = HostGetNew(a);
+    if (h == NULL) {
+        HRLOCK_UNLOCK(hb);
+        return NULL;
     }
 
-    /* lock & return */
-    SCMutexLock(&h->m);
-    (void) HostIncrUsecnt(h);
+    /* host is locked, initialize, add and return */
+    HostInit(h, a, hash);
+    HostRowAppend(hb, h);
+
     HRLOCK_UNLOCK(hb);
     return h;
 }
@@ -605,63 +547,17 @@ Host *HostGetHostFromHash (Address *a)
  */
 Host *HostLookupHostFromHash (Address *a)
 {
-    Host *h = NULL;
-
-    /* get the key to our bucket */
-    uint32_t key = HostGetKey(a);
-    /* get our hash bucket and lock it */
-    HostHashRow *hb = &host_hash[key];
+    /* get the hash and our bucket, and lock it */
+    const uint32_t hash = HostGetHash(a);
+    HostHashRow *hb = &host_hash[hash % host_config.hash_size];
     HRLOCK_LOCK(hb);
 
-    /* see if the bucket already has a host */
-    if (hb->head == NULL) {
-        HRLOCK_UNLOCK(hb);
-        return h;
-    }
-
-    /* ok, we have a host in the bucket. Let's find out if it is our host */
-    h = hb->head;
-
-    /* see if this is the host we are looking for */
-    if (HostCompare(h, a) == 0) {
-        while (h) {
-            h = h->hnext;
-
-            if (h == NULL) {
-                HRLOCK_UNLOCK(hb);
-                return h;
-            }
-
-            if (HostCompare(h, a) != 0) {
-                /* we found our host, lets put it on top of the
-                 * hash list -- this rewards active hosts */
-                if (h->hnext) {
-                    h->hnext->hprev = h->hprev;
-                }
-                if (h->hprev) {
-                    h->hprev->hnext = h->hnext;
-                }
-                if (h == hb->tail) {
-                    hb->tail = h->hprev;
-                }
-
-                h->hnext = hb->head;
-                h->hprev = NULL;
-                hb->head->hprev = h;
-                hb->head = h;
-
-                /* found our host, lock & return */
-                SCMutexLock(&h->m);
-                (void) HostIncrUsecnt(h);
-                HRLOCK_UNLOCK(hb);
-                return h;
-            }
-        }
+    Host *h = HostRowFind(hb, hash, HostMatch, a);
+    if (h != NULL) {
+        /* lock & return */
+        SCMutexLock(&h->m);
+        (void) HostIncrUsecnt(h);
     }
-
-    /* lock & return */
-    SCMutexLock(&h->m);
-    (void) HostIncrUsecnt(h);
     HRLOCK_UNLOCK(hb);
     return h;
 }
@@ -679,64 +575,161 @@ Host *HostLookupHostFromHash (Address *a)
  */
 static Host *HostGetUsedHost(void)
 {
-    uint32_t idx = SC_ATOMIC_GET(host_prune_idx) % host_config.hash_size;
-    uint32_t cnt = host_config.hash_size;
+    uint32_t walked = 0;
+    Host *h = HostGetUsed(host_hash, host_config.hash_size,
+            SC_ATOMIC_GET(host_prune_idx), &walked);
+    if (h == NULL)
+        return NULL;
 
-    while (cnt--) {
-        if (++idx >= host_config.hash_size)
-            idx = 0;
+    HostClearMemory (h);
 
-        HostHashRow *hb = &host_hash[idx];
+    SCMutexUnlock(&h->m);
 
-        if (HRLOCK_TRYLOCK(hb) != 0)
-            continue;
+    (void) SC_ATOMIC_ADD(host_prune_idx, walked);
+    return h;
+}
 
-        Host *h = hb->tail;
-        if (h == NULL) {
-            HRLOCK_UNLOCK(hb);
-            continue;
-        }
+#ifdef UNITTESTS
+static void HostTestCheckRow(const HostHashRow *hb, int *ok)
+{
+    const Host *prev = NULL;
+    const Host *h;
+    for (h = hb->head; h != NULL; prev = h, h = h->hnext) {
+        if (h->hprev != prev)
+            *ok = 0;
+    }
+    if (hb->tail != prev || hb->head_fp != (hb->head ? hb->head->hfp : 0))
+        *ok = 0;
+}
 
-        if (SCMutexTrylock(&h->m) != 0) {
-            HRLOCK_UNLOCK(hb);
-            continue;
-        }
+static bool HostTestMatch(const Host *h, const void *key)
+{
+    return h->a.addr_data32[0] == *(const uint32_t *)key;
+}
 
-        /** never prune a host that is used by a packets
-         *  we are currently processing in one of the threads */
-        if (SC_ATOMIC_GET(h->use_cnt) > 0) {
-            HRLOCK_UNLOCK(hb);
-            SCMutexUnlock(&h->m);
-            continue;
+/** \test hash template rows: append, find with move to front, remove and
+ *        the eviction walk */
+static int HostTemplateTest01(void)
+{
+    HostHashRow rows[4];
+    Host hosts[40];
+    int ok = 1;
+    uint32_t i;
+
+    memset(rows, 0, sizeof(rows));
+    memset(hosts, 0, sizeof(hosts));
+    for (i = 0; i < 4; i++)
+        HRLOCK_INIT(&rows[i]);
+    for (i = 0; i < 40; i++) {
+        SCMutexInit(&hosts[i].m, NULL);
+        hosts[i].a.addr_data32[0] = i;
+        /* fingerprints collide within a row */
+        hosts[i].hfp = (i * 7) & 3;
+        HostRowAppend(&rows[i % 4], &hosts[i]);
+        HostTestCheckRow(&rows[i % 4], &ok);
+    }
+    FAIL_IF_NOT(ok);
+
+    for (i = 0; i < 200; i++) {
+        uint32_t key = (i * 13) % 45;
+        Host *h = HostRowFind(&rows[key % 4], (key * 7) & 3, HostTestMatch, &key);
+        if (key < 40) {
+            FAIL_IF(h != &hosts[key]);
+            FAIL_IF(rows[key % 4].head != h);
+        } else {
+            FAIL_IF_NOT_NULL(h);
         }
-
-        /* remove from the hash */
-        if (h->hprev != NULL)
-            h->hprev->hnext = h->hnext;
-        if (h->hnext != NULL)
-            h->hnext->hprev = h->hprev;
-        if (hb->head == h)
-            hb->head = h->hnext;
-        if (hb->tail == h)
-            hb->tail = h->hprev;
-
-        h->hnext = NULL;
-        h->hprev = NULL;
-        HRLOCK_UNLOCK(hb);
-
-        HostClearMemory (h);
-
-        SCMutexUnlock(&h->m);
-
-        (void) SC_ATOMIC_ADD(host_prune_idx, (host_config.hash_size - cnt));
-        return h;
+        HostTestCheckRow(&rows[key % 4], &ok);
     }
+    FAIL_IF_NOT(ok);
+
+    /* middle, head and tail */
+    HostRowRemove(&rows[1], &hosts[17]);
+    HostTestCheckRow(&rows[1], &ok);
+    HostRowRemove(&rows[1], rows[1].head);
+    HostTestCheckRow(&rows[1], &ok);
+    HostRowRemove(&rows[1], rows[1].tail);
+    HostTestCheckRow(&rows[1], &ok);
+    FAIL_IF_NOT(ok);
+
+    /* only the tail of row 2 can be evicted */
+    for (i = 0; i < 40; i++)
+        SC_ATOMIC_SET(hosts[i].use_cnt, 1);
+    Host *tail = rows[2].tail;
+    SC_ATOMIC_SET(tail->use_cnt, 0);
+    uint32_t walked = 0;
+    Host *h = HostGetUsed(rows, 4, 0, &walked);
+    FAIL_IF(h != tail);
+    FAIL_IF(walked != 2);
+    SCMutexUnlock(&h->m);
+    HostTestCheckRow(&rows[2], &ok);
+    FAIL_IF_NOT(ok);
+    FAIL_IF_NOT_NULL(HostGetUsed(rows, 4, 0, &walked));
+
+    for (i = 0; i < 40; i++)
+        SCMutexDestroy(&hosts[i].m);
+    for (i = 0; i < 4; i++)
+        HRLOCK_DESTROY(&rows[i]);
+    PASS;
+}
 
+static void *HostTemplateTestThread(void *arg)
+{
+    HostMemuseAdd(100);
     return NULL;
 }
 
+/** \test batched memuse accounting, including the credit of an exiting
+ *        thread being returned */
+static int HostTemplateTest02(void)
+{
+    uint64_t memuse = SC_ATOMIC_GET(host_memuse);
+    uint64_t memcap = SC_ATOMIC_GET(host_config.memcap);
+    pthread_t thread;
+
+    SC_ATOMIC_SET(host_memuse, 0);
+    SC_ATOMIC_SET(host_config.memcap, 1024 * 1024);
+    HostMemuseReset();
+
+    FAIL_IF(pthread_create(&thread, NULL, HostTemplateTestThread, NULL) != 0);
+    FAIL_IF(pthread_join(thread, NULL) != 0);
+    FAIL_IF(SC_ATOMIC_GET(host_memuse) != 100);
+
+    /* the batch covers the following adds and subs */
+    HostMemuseReset();
+    SC_ATOMIC_SET(host_memuse, 0);
+    FAIL_IF_NOT(HostMemuseCheck(100));
+    HostMemuseAdd(100);
+    uint64_t batched = SC_ATOMIC_GET(host_memuse);
+    FAIL_IF(batched < 100);
+    int i;
+    for (i = 0; i < 100; i++)
+        HostMemuseAdd(100);
+    for (i = 0; i < 101; i++)
+        HostMemuseSub(100);
+    FAIL_IF(SC_ATOMIC_GET(host_memuse) > batched);
+
+    /* close to the memcap there is no batching */
+    HostMemuseReset();
+    SC_ATOMIC_SET(host_memuse, SC_ATOMIC_GET(host_config.memcap) - 1000);
+    FAIL_IF_NOT(HostMemuseCheck(1000));
+    HostMemuseAdd(1000);
+    FAIL_IF(SC_ATOMIC_GET(host_memuse) != SC_ATOMIC_GET(host_config.memcap));
+    FAIL_IF(HostMemuseCheck(1));
+
+    HostMemuseReset();
+    SC_ATOMIC_SET(host_memuse, memuse);
+    SC_ATOMIC_SET(host_config.memcap, memcap);
+    PASS;
+}
+#endif /* UNITTESTS */
+
 void HostRegisterUnittests(void)
 {
     RegisterHostStorageTests();
+#ifdef UNITTESTS
+    UtRegisterTest("HostTemplateTest01", HostTemplateTest01);
+    UtRegisterTest("HostTemplateTest02", HostTemplateTest02);
+#endif
 }
 
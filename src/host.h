@@ -26,6 +26,7 @@
 
 #include "decode.h"
 #include "util-storage.h"
+#include "util-hash-template.h"
 
 /** Spinlocks or Mutex for the flow buckets. */
 //#define HRLOCK_SPIN
@@ -62,6 +63,9 @@ typedef struct Host_ {
     /** host address -- ipv4 or ipv6 */
     Address a;
 
+    /** hash of the address, used as fingerprint in the hash row */
+    uint32_t hfp;
+
     /** use cnt, reference counter */
     SC_ATOMIC_DECLARE(unsigned int, use_cnt);
 
@@ -81,11 +85,11 @@ typedef struct Host_ {
 } Host;
 
 typedef struct HostHashRow_ {
-    HRLOCK_TYPE lock;
-    Host *head;
-    Host *tail;
+    HASH_TEMPLATE_ROW_FIELDS(Host, HRLOCK_TYPE)
 } __attribute__((aligned(CLS))) HostHashRow;
 
+HASH_TEMPLATE_ROW_FUNCS(Host, HostHashRow, Host, hnext, hprev)
+
 /** host hash table */
 extern HostHashRow *host_hash;
 
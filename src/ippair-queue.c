@@ -30,15 +30,7 @@
 #include "util-error.h"
 #include "util-debug.h"
 #include "util-print.h"
-
-IPPairQueue *IPPairQueueInit (IPPairQueue *q)
-{
-    if (q != NULL) {
-        memset(q, 0, sizeof(IPPairQueue));
-        HQLOCK_INIT(q);
-    }
-    return q;
-}
+#include "util-hash-template.h"
 
 IPPairQueue *IPPairQueueNew()
 {
@@ -51,93 +43,4 @@ IPPairQueue *IPPairQueueNew()
     return q;
 }
 
-/**
- *  \brief Destroy a ippair queue
- *
- *  \param q the ippair queue to destroy
- */
-void IPPairQueueDestroy (IPPairQueue *q)
-{
-    HQLOCK_DESTROY(q);
-}
-
-/**
- *  \brief add a ippair to a queue
- *
- *  \param q queue
- *  \param h ippair
- */
-void IPPairEnqueue (IPPairQueue *q, IPPair *h)
-{
-#ifdef DEBUG
-    BUG_ON(q == NULL || h == NULL);
-#endif
-
-    HQLOCK_LOCK(q);
-
-    /* more ippairs in queue */
-    if (q->top != NULL) {
-        h->lnext = q->top;
-        q->top->lprev = h;
-        q->top = h;
-    /* only ippair */
-    } else {
-        q->top = h;
-        q->bot = h;
-    }
-    q->len++;
-#ifdef DBG_PERF
-    if (q->len > q->dbg_maxlen)
-        q->dbg_maxlen = q->len;
-#endif /* DBG_PERF */
-    HQLOCK_UNLOCK(q);
-}
-
-/**
- *  \brief remove a ippair from the queue
- *
- *  \param q queue
- *
- *  \retval h ippair or NULL if empty list.
- */
-IPPair *IPPairDequeue (IPPairQueue *q)
-{
-    HQLOCK_LOCK(q);
-
-    IPPair *h = q->bot;
-    if (h == NULL) {
-        HQLOCK_UNLOCK(q);
-        return NULL;
-    }
-
-    /* more packets in queue */
-    if (q->bot->lprev != NULL) {
-        q->bot = q->bot->lprev;
-        q->bot->lnext = NULL;
-    /* just the one we remove, so now empty */
-    } else {
-        q->top = NULL;
-        q->bot = NULL;
-    }
-
-#ifdef DEBUG
-    BUG_ON(q->len == 0);
-#endif
-    if (q->len > 0)
-        q->len--;
-
-    h->lnext = NULL;
-    h->lprev = NULL;
-
-    HQLOCK_UNLOCK(q);
-    return h;
-}
-
-uint32_t IPPairQueueLen(IPPairQueue *q)
-{
-    uint32_t len;
-    HQLOCK_LOCK(q);
-    len = q->len;
-    HQLOCK_UNLOCK(q);
-    return len;
-}
+HASH_TEMPLATE_QUEUE_FUNCS(, IPPair, IPPairQueue, IPPair, lnext, lprev, HQLOCK)
@@ -100,17 +100,7 @@ static uint32_t IPPairHashRowTimeout(IPPairHashRow *hb, IPPair *h, struct timeva
          * ready to be discarded. */
         if (IPPairTimedOut(h, ts) == 1) {
             /* remove from the hash */
-            if (h->hprev != NULL)
-                h->hprev->hnext = h->hnext;
-            if (h->hnext != NULL)
-                h->hnext->hprev = h->hprev;
-            if (hb->head == h)
-                hb->head = h->hnext;
-            if (hb->tail == h)
-                hb->tail = h->hprev;
-
-            h->hnext = NULL;
-            h->hprev = NULL;
+            IPPairRowRemove(hb, h);
 
             IPPairClearMemory (h);
 
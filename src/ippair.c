@@ -53,6 +53,8 @@ SC_ATOMIC_DECLARE(uint64_t,ippair_memuse);
 SC_ATOMIC_DECLARE(uint32_t,ippair_counter);
 SC_ATOMIC_DECLARE(uint32_t,ippair_prune_idx);
 
+HASH_TEMPLATE_MEMUSE_FUNCS(IPPair, ippair_memuse, ippair_config.memcap)
+
 /** size of the ippair object. Maybe updated in IPPairInitConfig to include
  *  the storage APIs additions. */
 static uint16_t g_ippair_size = sizeof(IPPair);
@@ -107,11 +109,11 @@ void IPPairMoveToSpare(IPPair *h)
 
 IPPair *IPPairAlloc(void)
 {
-    if (!(IPPAIR_CHECK_MEMCAP(g_ippair_size))) {
+    if (!(IPPairMemuseCheck(g_ippair_size))) {
         return NULL;
     }
 
-    (void) SC_ATOMIC_ADD(ippair_memuse, g_ippair_size);
+    IPPairMemuseAdd(g_ippair_size);
 
     IPPair *h = SCMalloc(g_ippair_size);
     if (unlikely(h == NULL))
@@ -135,7 +137,7 @@ void IPPairFree(IPPair *h)
         SC_ATOMIC_DESTROY(h->use_cnt);
         SCMutexDestroy(&h->m);
         SCFree(h);
-        (void) SC_ATOMIC_SUB(ippair_memuse, g_ippair_size);
+        IPPairMemuseSub(g_ippair_size);
     }
 }
 
@@ -178,6 +180,7 @@ void IPPairInitConfig(char quiet)
     SC_ATOMIC_INIT(ippair_counter);
     SC_ATOMIC_INIT(ippair_memuse);
     SC_ATOMIC_INIT(ippair_prune_idx);
+    IPPairMemuseReset();
     SC_ATOMIC_INIT(ippair_config.memcap);
     IPPairQueueInit(&ippair_spare_q);
 
@@ -361,16 +364,7 @@ void IPPairCleanup(void)
                 } else {
                     IPPair *n = h->hnext;
                     /* remove from the hash */
-                    if (h->hprev != NULL)
-                        h->hprev->hnext = h->hnext;
-                    if (h->hnext != NULL)
-                        h->hnext->hprev = h->hprev;
-                    if (hb->head == h)
-                        hb->head = h->hnext;
-                    if (hb->tail == h)
-                        hb->tail = h->hprev;
-                    h->hnext = NULL;
-                    h->hprev = NULL;
+                    IPPairRowRemove(hb, h);
                     IPPairClearMemory(h);
                     IPPairMoveToSpare(h);
                     h = n;
@@ -408,21 +402,23 @@ static inline int IPPairHashRawAddressIPv6GtU32(const uint32_t *a, const uint32_
     return 0;
 }
 
-/* calculate the hash key for this packet
+/* calculate the hash for this address pair
  *
  * we're using:
  *  hash_rand -- set at init time
  *  source address
+ *
+ * The full hash is used as fingerprint of the ippair in its hash row, the
+ * row itself is the hash modulo the hash size.
  */
-static uint32_t IPPairGetKey(Address *a, Address *b)
+static uint32_t IPPairGetHash(Address *a, Address *b)
 {
-    uint32_t key;
+    uint32_t hash;
 
     if (a->family == AF_INET) {
         uint32_t addrs[2] = { MIN(a->addr_data32[0], b->addr_data32[0]),
                               MAX(a->addr_data32[0], b->addr_data32[0]) };
-        uint32_t hash = hashword(addrs, 2, ippair_config.hash_rand);
-        key = hash % ippair_config.hash_size;
+        hash = hashword(addrs, 2, ippair_config.hash_rand);
     } else if (a->family == AF_INET6) {
         uint32_t addrs[8];
         if (IPPairHashRawAddressIPv6GtU32(&a->addr_data32[0],&b->addr_data32[0])) {
@@ -444,12 +440,11 @@ static uint32_t IPPairGetKey(Address *a, Address *b)
             addrs[6] = b->addr_data32[2];
             addrs[7] = b->addr_data32[3];
         }
-        uint32_t hash = hashword(addrs, 8, ippair_config.hash_rand);
-        key = hash % ippair_config.hash_size;
+        hash = hashword(addrs, 8, ippair_config.hash_rand);
     } else
-        key = 0;
+        hash = 0;
 
-    return key;
+    return hash;
 }
 
 /* Since two or more ippairs can have the same hash key, we need to compare
@@ -463,6 +458,23 @@ static inline int IPPairCompare(IPPair *p, Address *a, Address *b)
     return 0;
 }
 
+typedef struct IPPairKey_ {
+    Address *a;
+    Address *b;
+} IPPairKey;
+
+static bool IPPairMatch(const IPPair *h, const void *data)
+{
+    const IPPairKey *k = data;
+    return IPPairCompare((IPPair *)h, k->a, k->b) != 0;
+}
+
+/** never prune a ippair that is used by a packets
+ *  we are currently processing in one of the threads */
+#define IPPairEvictable(h) (SC_ATOMIC_GET((h)->use_cnt) == 0)
+
+HASH_TEMPLATE_GET_USED_FUNC(IPPair, IPPairHashRow, IPPair, HRLOCK, m, IPPairEvictable)
+
 /**
  *  \brief Get a new ippair
  *
@@ -479,7 +491,7 @@ static IPPair *IPPairGetNew(Address *a, Address *b)
     h = IPPairDequeue(&ippair_spare_q);
     if (h == NULL) {
         /* If we reached the max memcap, we get a used ippair */
-        if (!(IPPAIR_CHECK_MEMCAP(g_ippair_size))) {
+        if (!(IPPairMemuseCheck(g_ippair_size))) {
             /* declare state of emergency */
             //if (!(SC_ATOMIC_GET(ippair_flags) & IPPAIR_EMERGENCY)) {
             //    SC_ATOMIC_OR(ippair_flags, IPPAIR_EMERGENCY);
@@ -516,10 +528,11 @@ static IPPair *IPPairGetNew(Address *a, Address *b)
     return h;
 }
 
-static void IPPairInit(IPPair *h, Address *a, Address *b)
+static void IPPairInit(IPPair *h, Address *a, Address *b, const uint32_t hash)
 {
     COPY_ADDRESS(a, &h->a[0]);
     COPY_ADDRESS(b, &h->a[1]);
+    h->hfp = hash;
     (void) IPPairIncrUsecnt(h);
 }
 
@@ -544,98 +557,37 @@ void IPPairUnlock(IPPair *h)
  * Hash retrieval function for ippairs. Looks up the hash bucket containing the
  * ippair pointer. Then compares the packet with the found ippair to see if it is
  * the ippair we need. If it isn't, walk the list until the right ippair is found.
+ * If it isn't in the list, a new ippair is added to the tail of the list.
  *
  * returns a *LOCKED* ippair or NULL
  */
 IPPair *IPPairGetIPPairFromHash (Address *a, Address *b)
 {
-    IPPair *h = NULL;
-
-    /* get the key to our bucket */
-    uint32_t key = IPPairGetKey(a, b);
-    /* get our hash bucket and lock it */
-    IPPairHashRow *hb = &ippair_hash[key];
+    /* get the hash and our bucket, and lock it */
+    const uint32_t hash = IPPairGetHash(a, b);
+    IPPairHashRow *hb = &ippair_hash[hash % ippair_config.hash_size];
     HRLOCK_LOCK(hb);
 
-    /* see if the bucket already has a ippair */
-    if (hb->head == NULL) {
-        h = IPPairGetNew(a,b);
-        if (h == NULL) {
-            HRLOCK_UNLOCK(hb);
-            return NULL;
-        }
-
-        /* ippair is locked */
-        hb->head = h;
-        hb->tail = h;
-
-        /* got one, now lock, initialize and return */
-        IPPairInit(h,a,b);
-
+    const IPPairKey k = { a, b };
+    IPPair *h = IPPairRowFind(hb, hash, IPPairMatch, &k);
+    if (h != NULL) {
+        /* found our ippair, lock & return */
+        SCMutexLock(&h->m);
+        (void) IPPairIncrUsecnt(h);
         HRLOCK_UNLOCK(hb);
         return h;
     }
 
-    /* ok, we have a ippair in the bucket. Let's find out if it is our ippair */
-    h = hb->head;
-
-    /* see if this is the ippair we are looking for */
-    if (IPPairCompare(h, a, b) == 0) {
-        IPPair *ph = NULL; /* previous ippair */
-
-        while (h) {
-            ph = h;
-            h = h->hnext;
-
-            if (h == NULL) {
-                h = ph->hnext = IPPairGetNew(a,b);
-                if (h == NULL) {
-                    HRLOCK_UNLOCK(hb);
-                    return NULL;
-                }
-                hb->tail = h;
-
-                /* ippair is locked */
-
-                h->hprev = ph;
-
-                /* initialize and return */
-                IPPairInit(h,a,b);
-
-                HRLOCK_UNLOCK(hb);
-                return h;
-            }
-
-            if (IPPairCompare(h, a, b) != 0) {
-                /* we found our ippair, lets put it on top of the
-                 * hash list -- this rewards active ippairs */
-                if (h->hnext) {
-                    h->hnext->hprev = h->hprev;
-                }
-                if (h->hprev) {
-                    h->hprev->hnext = h->hnext;
-                }
-                if (h == hb->tail) {
-                    hb->tail = h->hprev;
-                }
-
-                h->hnext = hb->head;
-                h->hprev = NULL;
-                hb->head->hprev = h;
-                hb->head = h;
-
-                /* found our ippair, lock & return */
-                SCMutexLock(&h->m);
-                (void) IPPairIncrUsecnt(h);
-                HRLOCK_UNLOCK(hb);
-                return h;
-            }
-        }
+    h = IPPairGetNew(a,b);
+    if (h == NULL) {
+        HRLOCK_UNLOCK(hb);
+        return NULL;
     }
 
-    /* lock & return */
-    SCMutexLock(&h->m);
-    (void) IPPairIncrUsecnt(h);
+    /* ippair is locked, initialize, add and return */
+    IPPairInit(h, a, b, hash);
+    IPPairRowAppend(hb, h);
+
     HRLOCK_UNLOCK(hb);
     return h;
 }
@@ -648,63 +600,18 @@ IPPair *IPPairGetIPPairFromHash (Address *a, Address *b)
  */
 IPPair *IPPairLookupIPPairFromHash (Address *a, Address *b)
 {
-    IPPair *h = NULL;
-
-    /* get the key to our bucket */
-    uint32_t key = IPPairGetKey(a, b);
-    /* get our hash bucket and lock it */
-    IPPairHashRow *hb = &ippair_hash[key];
+    /* get the hash and our bucket, and lock it */
+    const uint32_t hash = IPPairGetHash(a, b);
+    IPPairHashRow *hb = &ippair_hash[hash % ippair_config.hash_size];
     HRLOCK_LOCK(hb);
 
-    /* see if the bucket already has a ippair */
-    if (hb->head == NULL) {
-        HRLOCK_UNLOCK(hb);
-        return h;
-    }
-
-    /* ok, we have a ippair in the bucket. Let's find out if it is our ippair */
-    h = hb->head;
-
-    /* see if this is the ippair we are looking for */
-    if (IPPairCompare(h, a, b) == 0) {
-        while (h) {
-            h = h->hnext;
-
-            if (h == NULL) {
-                HRLOCK_UNLOCK(hb);
-                return h;
-            }
-
-            if (IPPairCompare(h, a, b) != 0) {
-                /* we found our ippair, lets put it on top of the
-                 * hash list -- this rewards active ippairs */
-                if (h->hnext) {
-                    h->hnext->hprev = h->hprev;
-                }
-                if (h->hprev) {
-                    h->hprev->hnext = h->hnext;
-                }
-                if (h == hb->tail) {
-                    hb->tail = h->hprev;
-                }
-
-                h->hnext = hb->head;
-                h->hprev = NULL;
-                hb->head->hprev = h;
-                hb->head = h;
-
-                /* found our ippair, lock & return */
-                SCMutexLock(&h->m);
-                (void) IPPairIncrUsecnt(h);
-                HRLOCK_UNLOCK(hb);
-                return h;
-            }
-        }
+    const IPPairKey k = { a, b };
+    IPPair *h = IPPairRowFind(hb, hash, IPPairMatch, &k);
+    if (h != NULL) {
+        /* lock & return */
+        SCMutexLock(&h->m);
+        (void) IPPairIncrUsecnt(h);
     }
-
-    /* lock & return */
-    SCMutexLock(&h->m);
-    (void) IPPairIncrUsecnt(h);
     HRLOCK_UNLOCK(hb);
     return h;
 }
@@ -722,60 +629,18 @@ IPPair *IPPairLookupIPPairFromHash (Address *a, Address *b)
  */
 static IPPair *IPPairGetUsedIPPair(void)
 {
-    uint32_t idx = SC_ATOMIC_GET(ippair_prune_idx) % ippair_config.hash_size;
-    uint32_t cnt = ippair_config.hash_size;
-
-    while (cnt--) {
-        if (++idx >= ippair_config.hash_size)
-            idx = 0;
-
-        IPPairHashRow *hb = &ippair_hash[idx];
-
-        if (HRLOCK_TRYLOCK(hb) != 0)
-            continue;
-
-        IPPair *h = hb->tail;
-        if (h == NULL) {
-            HRLOCK_UNLOCK(hb);
-            continue;
-        }
-
-        if (SCMutexTrylock(&h->m) != 0) {
-            HRLOCK_UNLOCK(hb);
-            continue;
-        }
-
-        /** never prune a ippair that is used by a packets
-         *  we are currently processing in one of the threads */
-        if (SC_ATOMIC_GET(h->use_cnt) > 0) {
-            HRLOCK_UNLOCK(hb);
-            SCMutexUnlock(&h->m);
-            continue;
-        }
-
-        /* remove from the hash */
-        if (h->hprev != NULL)
-            h->hprev->hnext = h->hnext;
-        if (h->hnext != NULL)
-            h->hnext->hprev = h->hprev;
-        if (hb->head == h)
-            hb->head = h->hnext;
-        if (hb->tail == h)
-            hb->tail = h->hprev;
-
-        h->hnext = NULL;
-        h->hprev = NULL;
-        HRLOCK_UNLOCK(hb);
-
-        IPPairClearMemory (h);
+    uint32_t walked = 0;
+    IPPair *h = IPPairGetUsed(ippair_hash, ippair_config.hash_size,
+            SC_ATOMIC_GET(ippair_prune_idx), &walked);
+    if (h == NULL)
+        return NULL;
 
-        SCMutexUnlock(&h->m);
+    IPPairClearMemory (h);
 
-        (void) SC_ATOMIC_ADD(ippair_prune_idx, (ippair_config.hash_size - cnt));
-        return h;
-    }
+    SCMutexUnlock(&h->m);
 
-    return NULL;
+    (void) SC_ATOMIC_ADD(ippair_prune_idx, walked);
+    return h;
 }
 
 void IPPairRegisterUnittests(void)
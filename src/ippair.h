@@ -26,6 +26,7 @@
 
 #include "decode.h"
 #include "util-storage.h"
+#include "util-hash-template.h"
 
 /** Spinlocks or Mutex for the flow buckets. */
 //#define HRLOCK_SPIN
@@ -62,6 +63,9 @@ typedef struct IPPair_ {
     /** ippair addresses -- ipv4 or ipv6 */
     Address a[2];
 
+    /** hash of the addresses, used as fingerprint in the hash row */
+    uint32_t hfp;
+
     /** use cnt, reference counter */
     SC_ATOMIC_DECLARE(unsigned int, use_cnt);
 
@@ -78,11 +82,11 @@ typedef struct IPPair_ {
 } IPPair;
 
 typedef struct IPPairHashRow_ {
-    HRLOCK_TYPE lock;
-    IPPair *head;
-    IPPair *tail;
+    HASH_TEMPLATE_ROW_FIELDS(IPPair, HRLOCK_TYPE)
 } __attribute__((aligned(CLS))) IPPairHashRow;
 
+HASH_TEMPLATE_ROW_FUNCS(IPPair, IPPairHashRow, IPPair, hnext, hprev)
+
 /** ippair hash table */
 extern IPPairHashRow *ippair_hash;
 
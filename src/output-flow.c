@@ -26,11 +26,15 @@
 #include "suricata-common.h"
 #include "tm-modules.h"
 #include "output-flow.h"
+#include "output-sampler.h"
 #include "util-profiling.h"
 #include "util-validate.h"
 
 typedef struct OutputLoggerThreadStore_ {
     void *thread_data;
+    /** counters for records left out by the sampler */
+    uint16_t sampled_id;
+    uint16_t limited_id;
     struct OutputLoggerThreadStore_ *next;
 } OutputLoggerThreadStore;
 
@@ -109,10 +113,23 @@ TmEcode OutputFlowLog(ThreadVars *tv, void *thread_data, Flow *f)
         DEBUG_VALIDATE_BUG_ON(logger->LogFunc == NULL);
 
         SCLogDebug("logger %p", logger);
+        if (logger->output_ctx != NULL && logger->output_ctx->sampler != NULL) {
+            enum OutputSamplerResult r = OutputSamplerCheck(
+                    logger->output_ctx->sampler, f, &f->lastts);
+            if (r != OUTPUT_SAMPLER_PASS) {
+                if (tv != NULL) {
+                    StatsIncr(tv, r == OUTPUT_SAMPLER_SAMPLED ?
+                            store->sampled_id : store->limited_id);
+                }
+                goto next_logger;
+            }
+        }
+
         //PACKET_PROFILING_LOGGER_START(p, logger->module_id);
         logger->LogFunc(tv, store->thread_data, f);
         //PACKET_PROFILING_LOGGER_END(p, logger->module_id);
 
+next_logger:
         logger = logger->next;
         store = store->next;
 
@@ -149,6 +166,13 @@ TmEcode OutputFlowLogThreadInit(ThreadVars *tv, void *initdata, void **data)
                 /* store thread handle */
                 ts->thread_data = retptr;
 
+                const OutputSampler *sampler = logger->output_ctx ?
+                    logger->output_ctx->sampler : NULL;
+                if (sampler != NULL && tv != NULL) {
+                    ts->sampled_id = StatsRegisterCounter(sampler->sampled_name, tv);
+                    ts->limited_id = StatsRegisterCounter(sampler->limited_name, tv);
+                }
+
                 if (td->store == NULL) {
                     td->store = ts;
                 } else {
@@ -90,6 +90,13 @@ TmEcode JsonLogThreadInit(ThreadVars *t, const void *initdata, void **data)
     }
 
     thread->ctx = ((OutputCtx *)initdata)->data;
+    thread->file_ctx = LogFileEnsureExists(thread->ctx->file_ctx, t->id);
+    if (thread->file_ctx == NULL) {
+        MemBufferFree(thread->buffer);
+        SCFree(thread);
+        return TM_ECODE_FAILED;
+    }
+
     *data = (void *)thread;
     return TM_ECODE_OK;
 }
@@ -54,6 +54,7 @@ typedef struct LogDHCPFileCtx_ {
 
 typedef struct LogDHCPLogThread_ {
     LogDHCPFileCtx *dhcplog_ctx;
+    LogFileCtx     *file_ctx;
     uint32_t        count;
     MemBuffer      *buffer;
 } LogDHCPLogThread;
@@ -76,7 +77,7 @@ static int JsonDHCPLogger(ThreadVars *tv, void *thread_data,
     json_object_set_new(js, "dhcp", dhcp_js);
 
     MemBufferReset(thread->buffer);
-    OutputJSONBuffer(js, thread->dhcplog_ctx->file_ctx, &thread->buffer);
+    OutputJSONBuffer(js, thread->file_ctx, &thread->buffer);
     json_decref(js);
 
     return TM_ECODE_OK;
@@ -144,6 +145,14 @@ static TmEcode JsonDHCPLogThreadInit(ThreadVars *t, const void *initdata, void *
     }
 
     thread->dhcplog_ctx = ((OutputCtx *)initdata)->data;
+
+    thread->file_ctx = LogFileEnsureExists(thread->dhcplog_ctx->file_ctx, t->id);
+    if (thread->file_ctx == NULL) {
+        MemBufferFree(thread->buffer);
+        SCFree(thread);
+        return TM_ECODE_FAILED;
+    }
+
     *data = (void *)thread;
 
     return TM_ECODE_OK;
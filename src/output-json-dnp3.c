@@ -52,6 +52,7 @@ typedef struct LogDNP3FileCtx_ {
 
 typedef struct LogDNP3LogThread_ {
     LogDNP3FileCtx *dnp3log_ctx;
+    LogFileCtx     *file_ctx;
     MemBuffer      *buffer;
 } LogDNP3LogThread;
 
@@ -319,7 +320,7 @@ static int JsonDNP3LoggerToServer(ThreadVars *tv, void *thread_data,
         json_t *dnp3js = JsonDNP3LogRequest(tx);
         if (dnp3js != NULL) {
             json_object_set_new(js, "dnp3", dnp3js);
-            OutputJSONBuffer(js, thread->dnp3log_ctx->file_ctx, &buffer);
+            OutputJSONBuffer(js, thread->file_ctx, &buffer);
         }
         json_decref(js);
     }
@@ -348,7 +349,7 @@ static int JsonDNP3LoggerToClient(ThreadVars *tv, void *thread_data,
         json_t *dnp3js = JsonDNP3LogResponse(tx);
         if (dnp3js != NULL) {
             json_object_set_new(js, "dnp3", dnp3js);
-            OutputJSONBuffer(js, thread->dnp3log_ctx->file_ctx, &buffer);
+            OutputJSONBuffer(js, thread->file_ctx, &buffer);
         }
         json_decref(js);
     }
@@ -416,6 +417,14 @@ static TmEcode JsonDNP3LogThreadInit(ThreadVars *t, const void *initdata, void *
     }
 
     thread->dnp3log_ctx = ((OutputCtx *)initdata)->data;
+
+    thread->file_ctx = LogFileEnsureExists(thread->dnp3log_ctx->file_ctx, t->id);
+    if (thread->file_ctx == NULL) {
+        MemBufferFree(thread->buffer);
+        SCFree(thread);
+        return TM_ECODE_FAILED;
+    }
+
     *data = (void *)thread;
 
     return TM_ECODE_OK;
@@ -265,6 +265,7 @@ typedef struct LogDnsFileCtx_ {
 
 typedef struct LogDnsLogThread_ {
     LogDnsFileCtx *dnslog_ctx;
+    LogFileCtx    *file_ctx;
     /** LogFileCtx has the pointer to the file and a mutex to allow multithreading */
     uint32_t dns_cnt;
 
@@ -320,7 +321,7 @@ static int JsonDnsLoggerToServer(ThreadVars *tv, void *thread_data,
         }
         json_object_set_new(js, "dns", dns);
         MemBufferReset(td->buffer);
-        OutputJSONBuffer(js, td->dnslog_ctx->file_ctx, &td->buffer);
+        OutputJSONBuffer(js, td->file_ctx, &td->buffer);
         json_decref(js);
     }
 
@@ -351,7 +352,7 @@ static int JsonDnsLoggerToClient(ThreadVars *tv, void *thread_data,
         if (answer != NULL) {
             json_object_set_new(js, "dns", answer);
             MemBufferReset(td->buffer);
-            OutputJSONBuffer(js, td->dnslog_ctx->file_ctx, &td->buffer);
+            OutputJSONBuffer(js, td->file_ctx, &td->buffer);
         }
     } else {
         /* Log answers. */
@@ -363,7 +364,7 @@ static int JsonDnsLoggerToClient(ThreadVars *tv, void *thread_data,
             }
             json_object_set_new(js, "dns", answer);
             MemBufferReset(td->buffer);
-            OutputJSONBuffer(js, td->dnslog_ctx->file_ctx, &td->buffer);
+            OutputJSONBuffer(js, td->file_ctx, &td->buffer);
             json_object_del(js, "dns");
         }
         /* Log authorities. */
@@ -375,7 +376,7 @@ static int JsonDnsLoggerToClient(ThreadVars *tv, void *thread_data,
             }
             json_object_set_new(js, "dns", answer);
             MemBufferReset(td->buffer);
-            OutputJSONBuffer(js, td->dnslog_ctx->file_ctx, &td->buffer);
+            OutputJSONBuffer(js, td->file_ctx, &td->buffer);
             json_object_del(js, "dns");
         }
     }
@@ -408,6 +409,13 @@ static TmEcode LogDnsLogThreadInit(ThreadVars *t, const void *initdata, void **d
     /* Use the Ouptut Context (file pointer and mutex) */
     aft->dnslog_ctx= ((OutputCtx *)initdata)->data;
 
+    aft->file_ctx = LogFileEnsureExists(aft->dnslog_ctx->file_ctx, t->id);
+    if (aft->file_ctx == NULL) {
+        MemBufferFree(aft->buffer);
+        SCFree(aft);
+        return TM_ECODE_FAILED;
+    }
+
     *data = (void *)aft;
     return TM_ECODE_OK;
 }
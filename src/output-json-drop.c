@@ -68,6 +68,7 @@ typedef struct JsonDropOutputCtx_ {
 
 typedef struct JsonDropLogThread_ {
     JsonDropOutputCtx *drop_ctx;
+    LogFileCtx *file_ctx;
     MemBuffer *buffer;
 } JsonDropLogThread;
 
@@ -172,7 +173,7 @@ static int DropLogJSON (JsonDropLogThread *aft, const Packet *p)
         }
     }
 
-    OutputJSONBuffer(js, aft->drop_ctx->file_ctx, &aft->buffer);
+    OutputJSONBuffer(js, aft->file_ctx, &aft->buffer);
     json_object_del(js, "drop");
     json_object_clear(js);
     json_decref(js);
@@ -203,6 +204,13 @@ static TmEcode JsonDropLogThreadInit(ThreadVars *t, const void *initdata, void *
     /** Use the Ouptut Context (file pointer and mutex) */
     aft->drop_ctx = ((OutputCtx *)initdata)->data;
 
+    aft->file_ctx = LogFileEnsureExists(aft->drop_ctx->file_ctx, t->id);
+    if (aft->file_ctx == NULL) {
+        MemBufferFree(aft->buffer);
+        SCFree(aft);
+        return TM_ECODE_FAILED;
+    }
+
     *data = (void *)aft;
     return TM_ECODE_OK;
 }
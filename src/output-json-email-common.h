@@ -33,6 +33,7 @@ typedef struct OutputJsonEmailCtx_ {
 
 typedef struct JsonEmailLogThread_ {
     OutputJsonEmailCtx *emaillog_ctx;
+    LogFileCtx *file_ctx;
     MemBuffer *buffer;
 } JsonEmailLogThread;
 
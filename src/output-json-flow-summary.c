@@ -0,0 +1,377 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Implements the EVE flow-summary logger.
+ *
+ * Instead of a record per transaction, each repeating the tuple, timestamps
+ * and flow_id, the flow-summary logger emits a single "flow_summary" record
+ * per flow when the flow ends. It combines the flow record with the http,
+ * dns, tls and fileinfo details of the flow's transactions.
+ *
+ * The transaction details are collected as the transactions complete by tx
+ * and file loggers registered under the same "eve-log.flow-summary" name,
+ * and kept in flow storage until the flow logger emits the record.
+ */
+
+#include "suricata-common.h"
+#include "debug.h"
+#include "conf.h"
+
+#include "threads.h"
+#include "threadvars.h"
+#include "tm-threads.h"
+
+#include "util-debug.h"
+#include "util-buffer.h"
+#include "util-logopenfile.h"
+
+#include "app-layer-parser.h"
+#include "app-layer-ssl.h"
+#include "flow-storage.h"
+
+#include "output.h"
+#include "output-json.h"
+#include "output-json-flow.h"
+#include "output-json-http.h"
+#include "output-json-dns.h"
+#include "output-json-tls.h"
+#include "output-json-file.h"
+#include "output-json-flow-summary.h"
+
+#define MODULE_NAME "JsonFlowSummaryLog"
+
+/** default max number of transaction entries kept per flow */
+#define FLOW_SUMMARY_DEFAULT_MAX_ENTRIES    64
+
+typedef struct FlowSummaryCtx_ {
+    LogFileCtx *file_ctx;
+    OutputJsonCommonSettings cfg;
+    uint32_t max_entries;
+} FlowSummaryCtx;
+
+typedef struct FlowSummaryThread_ {
+    FlowSummaryCtx *ctx;
+    LogFileCtx *file_ctx;
+    MemBuffer *buffer;
+} FlowSummaryThread;
+
+/** per flow summary, kept in flow storage */
+typedef struct FlowSummary_ {
+    /** object holding an array of entries per record type */
+    json_t *js;
+    uint32_t entries;
+    /** entries not kept because of max-entries */
+    uint32_t dropped;
+} FlowSummary;
+
+static int g_flow_summary_id = -1;
+
+static void FlowSummaryFree(void *ptr)
+{
+    FlowSummary *fs = ptr;
+    if (fs->js != NULL)
+        json_decref(fs->js);
+    SCFree(fs);
+}
+
+/** \internal
+ *  \brief add an entry to the flow's summary, takes ownership of the entry
+ */
+static void FlowSummaryAdd(const FlowSummaryCtx *ctx, Flow *f,
+        const char *type, json_t *entry)
+{
+    FlowSummary *fs = FlowGetStorageById(f, g_flow_summary_id);
+    if (fs == NULL) {
+        fs = SCCalloc(1, sizeof(*fs));
+        if (unlikely(fs == NULL)) {
+            json_decref(entry);
+            return;
+        }
+        fs->js = json_object();
+        if (unlikely(fs->js == NULL)) {
+            SCFree(fs);
+            json_decref(entry);
+            return;
+        }
+        FlowSetStorageById(f, g_flow_summary_id, fs);
+    }
+
+    if (fs->entries >= ctx->max_entries) {
+        fs->dropped++;
+        json_decref(entry);
+        return;
+    }
+
+    json_t *list = json_object_get(fs->js, type);
+    if (list == NULL) {
+        list = json_array();
+        if (unlikely(list == NULL)) {
+            json_decref(entry);
+            return;
+        }
+        json_object_set_new(fs->js, type, list);
+    }
+    json_array_append_new(list, entry);
+    fs->entries++;
+}
+
+static int JsonFlowSummaryLogger(ThreadVars *tv, void *thread_data, Flow *f)
+{
+    SCEnter();
+    FlowSummaryThread *aft = (FlowSummaryThread *)thread_data;
+
+    MemBufferReset(aft->buffer);
+
+    json_t *js = JsonFlowCreateHeader(f, "flow_summary");
+    if (unlikely(js == NULL))
+        SCReturnInt(TM_ECODE_OK);
+
+    JsonFlowAddRecord(&aft->ctx->cfg, js, f);
+
+    FlowSummary *fs = FlowGetStorageById(f, g_flow_summary_id);
+    if (fs != NULL) {
+        json_object_update(js, fs->js);
+        if (fs->dropped > 0) {
+            json_object_set_new(js, "summary_dropped",
+                    json_integer(fs->dropped));
+        }
+    }
+
+    OutputJSONBuffer(js, aft->file_ctx, &aft->buffer);
+    json_decref(js);
+
+    SCReturnInt(TM_ECODE_OK);
+}
+
+static int JsonFlowSummaryHttpLogger(ThreadVars *tv, void *thread_data,
+        const Packet *p, Flow *f, void *state, void *tx, uint64_t tx_id)
+{
+    FlowSummaryThread *aft = (FlowSummaryThread *)thread_data;
+
+    json_t *hjs = JsonHttpAddMetadata(f, tx_id);
+    if (hjs != NULL) {
+        FlowSummaryAdd(aft->ctx, f, "http", hjs);
+    }
+    return TM_ECODE_OK;
+}
+
+static int JsonFlowSummaryDnsLogger(ThreadVars *tv, void *thread_data,
+        const Packet *p, Flow *f, void *state, void *tx, uint64_t tx_id)
+{
+    FlowSummaryThread *aft = (FlowSummaryThread *)thread_data;
+
+    json_t *djs = json_object();
+    if (unlikely(djs == NULL))
+        return TM_ECODE_OK;
+
+    json_t *query = JsonDNSLogQuery(tx, tx_id);
+    if (query != NULL) {
+        json_object_set_new(djs, "query", query);
+    }
+    json_t *answer = JsonDNSLogAnswer(tx, tx_id);
+    if (answer != NULL) {
+        json_object_set_new(djs, "answer", answer);
+    }
+    FlowSummaryAdd(aft->ctx, f, "dns", djs);
+    return TM_ECODE_OK;
+}
+
+static int JsonFlowSummaryTlsLogger(ThreadVars *tv, void *thread_data,
+        const Packet *p, Flow *f, void *state, void *tx, uint64_t tx_id)
+{
+    FlowSummaryThread *aft = (FlowSummaryThread *)thread_data;
+    SSLState *ssl_state = (SSLState *)state;
+
+    if (unlikely(ssl_state == NULL))
+        return TM_ECODE_OK;
+
+    json_t *tjs = json_object();
+    if (unlikely(tjs == NULL))
+        return TM_ECODE_OK;
+
+    JsonTlsLogJSONBasic(tjs, ssl_state);
+    FlowSummaryAdd(aft->ctx, f, "tls", tjs);
+    return TM_ECODE_OK;
+}
+
+static int JsonFlowSummaryFileLogger(ThreadVars *tv, void *thread_data,
+        const Packet *p, const File *ff, uint8_t dir)
+{
+    FlowSummaryThread *aft = (FlowSummaryThread *)thread_data;
+
+    if (p->flow == NULL)
+        return TM_ECODE_OK;
+
+    json_t *js = JsonBuildFileInfoRecord(p, ff,
+            ff->flags & FILE_STORED ? true : false, dir, NULL);
+    if (unlikely(js == NULL))
+        return TM_ECODE_OK;
+
+    /* keep the file details, the flow details are in the summary itself */
+    json_t *fjs = json_object_get(js, "fileinfo");
+    if (fjs != NULL) {
+        FlowSummaryAdd(aft->ctx, p->flow, "fileinfo", json_incref(fjs));
+    }
+    json_decref(js);
+    return TM_ECODE_OK;
+}
+
+static void OutputFlowSummaryLogDeinitSub(OutputCtx *output_ctx)
+{
+    FlowSummaryCtx *ctx = output_ctx->data;
+    SCFree(ctx);
+    SCFree(output_ctx);
+}
+
+static OutputInitResult OutputFlowSummaryLogInitSub(ConfNode *conf,
+        OutputCtx *parent_ctx)
+{
+    OutputInitResult result = { NULL, false };
+    OutputJsonCtx *ojc = parent_ctx->data;
+
+    FlowSummaryCtx *ctx = SCCalloc(1, sizeof(FlowSummaryCtx));
+    if (unlikely(ctx == NULL))
+        return result;
+
+    OutputCtx *output_ctx = SCCalloc(1, sizeof(OutputCtx));
+    if (unlikely(output_ctx == NULL)) {
+        SCFree(ctx);
+        return result;
+    }
+
+    ctx->file_ctx = ojc->file_ctx;
+    ctx->cfg = ojc->cfg;
+    ctx->max_entries = FLOW_SUMMARY_DEFAULT_MAX_ENTRIES;
+
+    intmax_t max_entries;
+    if (conf != NULL && ConfGetChildValueInt(conf, "max-entries", &max_entries)) {
+        if (max_entries <= 0 || max_entries > UINT32_MAX) {
+            SCLogError(SC_ERR_INVALID_ARGUMENT, "invalid value for "
+                    "flow-summary.max-entries: %"PRIdMAX, max_entries);
+            SCFree(ctx);
+            SCFree(output_ctx);
+            return result;
+        }
+        ctx->max_entries = (uint32_t)max_entries;
+    }
+
+    output_ctx->data = ctx;
+    output_ctx->DeInit = OutputFlowSummaryLogDeinitSub;
+
+    AppLayerParserRegisterLogger(IPPROTO_TCP, ALPROTO_HTTP);
+    AppLayerParserRegisterLogger(IPPROTO_UDP, ALPROTO_DNS);
+    AppLayerParserRegisterLogger(IPPROTO_TCP, ALPROTO_DNS);
+    AppLayerParserRegisterLogger(IPPROTO_TCP, ALPROTO_TLS);
+
+    result.ctx = output_ctx;
+    result.ok = true;
+    return result;
+}
+
+/** \internal
+ *  \brief thread init for the loggers collecting transaction entries,
+ *         these don't write out anything themselves
+ */
+static TmEcode JsonFlowSummaryTxThreadInit(ThreadVars *t, const void *initdata,
+        void **data)
+{
+    if (initdata == NULL) {
+        SCLogDebug("Error getting context for EveLogFlowSummary. \"initdata\" argument NULL");
+        return TM_ECODE_FAILED;
+    }
+
+    FlowSummaryThread *aft = SCCalloc(1, sizeof(FlowSummaryThread));
+    if (unlikely(aft == NULL))
+        return TM_ECODE_FAILED;
+
+    aft->ctx = ((OutputCtx *)initdata)->data;
+
+    *data = (void *)aft;
+    return TM_ECODE_OK;
+}
+
+static TmEcode JsonFlowSummaryThreadInit(ThreadVars *t, const void *initdata,
+        void **data)
+{
+    if (JsonFlowSummaryTxThreadInit(t, initdata, data) != TM_ECODE_OK)
+        return TM_ECODE_FAILED;
+
+    FlowSummaryThread *aft = *data;
+    aft->buffer = MemBufferCreateNew(JSON_OUTPUT_BUFFER_SIZE);
+    if (aft->buffer == NULL) {
+        SCFree(aft);
+        return TM_ECODE_FAILED;
+    }
+
+    aft->file_ctx = LogFileEnsureExists(aft->ctx->file_ctx, t->id);
+    if (aft->file_ctx == NULL) {
+        MemBufferFree(aft->buffer);
+        SCFree(aft);
+        return TM_ECODE_FAILED;
+    }
+    return TM_ECODE_OK;
+}
+
+static TmEcode JsonFlowSummaryThreadDeinit(ThreadVars *t, void *data)
+{
+    FlowSummaryThread *aft = (FlowSummaryThread *)data;
+    if (aft == NULL) {
+        return TM_ECODE_OK;
+    }
+
+    if (aft->buffer != NULL)
+        MemBufferFree(aft->buffer);
+    /* clear memory */
+    memset(aft, 0, sizeof(FlowSummaryThread));
+
+    SCFree(aft);
+    return TM_ECODE_OK;
+}
+
+void JsonFlowSummaryLogRegister(void)
+{
+    g_flow_summary_id = FlowStorageRegister("flow-summary", sizeof(void *),
+            NULL, FlowSummaryFree);
+
+    /* the summary record is written when the flow ends */
+    OutputRegisterFlowSubModule(LOGGER_JSON_FLOW_SUMMARY, "eve-log",
+        MODULE_NAME, "eve-log.flow-summary", OutputFlowSummaryLogInitSub,
+        JsonFlowSummaryLogger, JsonFlowSummaryThreadInit,
+        JsonFlowSummaryThreadDeinit, NULL);
+
+    /* collectors for the transactions and files of the flow */
+    OutputRegisterTxSubModule(LOGGER_JSON_FLOW_SUMMARY, "eve-log",
+        MODULE_NAME, "eve-log.flow-summary", OutputFlowSummaryLogInitSub,
+        ALPROTO_HTTP, JsonFlowSummaryHttpLogger, JsonFlowSummaryTxThreadInit,
+        JsonFlowSummaryThreadDeinit, NULL);
+    OutputRegisterTxSubModuleWithProgress(LOGGER_JSON_FLOW_SUMMARY, "eve-log",
+        MODULE_NAME, "eve-log.flow-summary", OutputFlowSummaryLogInitSub,
+        ALPROTO_DNS, JsonFlowSummaryDnsLogger, 1, 1,
+        JsonFlowSummaryTxThreadInit, JsonFlowSummaryThreadDeinit, NULL);
+    OutputRegisterTxSubModuleWithProgress(LOGGER_JSON_FLOW_SUMMARY, "eve-log",
+        MODULE_NAME, "eve-log.flow-summary", OutputFlowSummaryLogInitSub,
+        ALPROTO_TLS, JsonFlowSummaryTlsLogger, TLS_HANDSHAKE_DONE,
+        TLS_HANDSHAKE_DONE, JsonFlowSummaryTxThreadInit,
+        JsonFlowSummaryThreadDeinit, NULL);
+    OutputRegisterFileSubModule(LOGGER_JSON_FLOW_SUMMARY, "eve-log",
+        MODULE_NAME, "eve-log.flow-summary", OutputFlowSummaryLogInitSub,
+        JsonFlowSummaryFileLogger, JsonFlowSummaryTxThreadInit,
+        JsonFlowSummaryThreadDeinit, NULL);
+}
@@ -58,11 +58,15 @@ typedef struct LogJsonFileCtx_ {
 
 typedef struct JsonFlowLogThread_ {
     LogJsonFileCtx *flowlog_ctx;
+    LogFileCtx     *file_ctx;
     /** LogFileCtx has the pointer to the file and a mutex to allow multithreading */
     MemBuffer *buffer;
 } JsonFlowLogThread;
 
-static json_t *CreateJSONHeaderFromFlow(const Flow *f, const char *event_type)
+/** \brief create the header of a flow record: timestamp, flow_id,
+ *         interface, event type, vlan and tuple
+ */
+json_t *JsonFlowCreateHeader(const Flow *f, const char *event_type)
 {
     char timebuf[64];
     char srcip[46] = {0}, dstip[46] = {0};
@@ -236,10 +240,11 @@ void JsonAddFlow(Flow *f, json_t *js, json_t *hjs)
     json_object_set_new(hjs, "start", json_string(timebuf1));
 }
 
-/* JSON format logging */
-static void JsonFlowLogJSON(JsonFlowLogThread *aft, json_t *js, Flow *f)
+/** \brief add the end of flow details to a flow record: counters,
+ *         timestamps, end state and reason, and tcp session info
+ */
+void JsonFlowAddRecord(const OutputJsonCommonSettings *cfg, json_t *js, Flow *f)
 {
-    LogJsonFileCtx *flow_ctx = aft->flowlog_ctx;
     json_t *hjs = json_object();
     if (hjs == NULL) {
         return;
@@ -305,7 +310,7 @@ static void JsonFlowLogJSON(JsonFlowLogThread *aft, json_t *js, Flow *f)
 
     json_object_set_new(js, "flow", hjs);
 
-    JsonAddCommonOptions(&flow_ctx->cfg, NULL, f, js);
+    JsonAddCommonOptions(cfg, NULL, f, js);
 
     /* TCP */
     if (f->proto == IPPROTO_TCP) {
@@ -390,13 +395,13 @@ static int JsonFlowLogger(ThreadVars *tv, void *thread_data, Flow *f)
     /* reset */
     MemBufferReset(jhl->buffer);
 
-    json_t *js = CreateJSONHeaderFromFlow(f, "flow");
+    json_t *js = JsonFlowCreateHeader(f, "flow");
     if (unlikely(js == NULL))
         return TM_ECODE_OK;
 
-    JsonFlowLogJSON(jhl, js, f);
+    JsonFlowAddRecord(&jhl->flowlog_ctx->cfg, js, f);
 
-    OutputJSONBuffer(js, jhl->flowlog_ctx->file_ctx, &jhl->buffer);
+    OutputJSONBuffer(js, jhl->file_ctx, &jhl->buffer);
     json_object_del(js, "http");
 
     json_object_clear(js);
@@ -507,6 +512,13 @@ static TmEcode JsonFlowLogThreadInit(ThreadVars *t, const void *initdata, void *
         return TM_ECODE_FAILED;
     }
 
+    aft->file_ctx = LogFileEnsureExists(aft->flowlog_ctx->file_ctx, t->id);
+    if (aft->file_ctx == NULL) {
+        MemBufferFree(aft->buffer);
+        SCFree(aft);
+        return TM_ECODE_FAILED;
+    }
+
     *data = (void *)aft;
     return TM_ECODE_OK;
 }
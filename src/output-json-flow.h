@@ -24,7 +24,11 @@
 #ifndef __OUTPUT_JSON_FLOW_H__
 #define __OUTPUT_JSON_FLOW_H__
 
+#include "output-json.h"
+
 void JsonFlowLogRegister(void);
 void JsonAddFlow(Flow *f, json_t *js, json_t *hjs);
+json_t *JsonFlowCreateHeader(const Flow *f, const char *event_type);
+void JsonFlowAddRecord(const OutputJsonCommonSettings *cfg, json_t *js, Flow *f);
 
 #endif /* __OUTPUT_JSON_FLOW_H__ */
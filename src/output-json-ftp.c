@@ -56,6 +56,7 @@ typedef struct LogFTPFileCtx_ {
 
 typedef struct LogFTPLogThread_ {
     LogFTPFileCtx *ftplog_ctx;
+    LogFileCtx    *file_ctx;
     uint32_t            count;
     MemBuffer          *buffer;
 } LogFTPLogThread;
@@ -174,7 +175,7 @@ static int JsonFTPLogger(ThreadVars *tv, void *thread_data,
         }
 
         MemBufferReset(thread->buffer);
-        OutputJSONBuffer(js, thread->ftplog_ctx->file_ctx, &thread->buffer);
+        OutputJSONBuffer(js, thread->file_ctx, &thread->buffer);
 
         json_object_clear(js);
         json_decref(js);
@@ -241,6 +242,14 @@ static TmEcode JsonFTPLogThreadInit(ThreadVars *t, const void *initdata, void **
     }
 
     thread->ftplog_ctx = ((OutputCtx *)initdata)->data;
+
+    thread->file_ctx = LogFileEnsureExists(thread->ftplog_ctx->file_ctx, t->id);
+    if (thread->file_ctx == NULL) {
+        MemBufferFree(thread->buffer);
+        SCFree(thread);
+        return TM_ECODE_FAILED;
+    }
+
     *data = (void *)thread;
 
     return TM_ECODE_OK;
@@ -40,6 +40,7 @@
 
 #include "output.h"
 #include "app-layer-htp.h"
+#include "app-layer-htp-body.h"
 #include "app-layer-htp-file.h"
 #include "app-layer-htp-xff.h"
 #include "app-layer.h"
@@ -66,6 +67,7 @@ typedef struct LogHttpFileCtx_ {
 
 typedef struct JsonHttpLogThread_ {
     LogHttpFileCtx *httplog_ctx;
+    LogFileCtx     *file_ctx;
     /** LogFileCtx has the pointer to the file and a mutex to allow multithreading */
     uint32_t uri_cnt;
 
@@ -416,25 +418,24 @@ static void JsonHttpLogJSONHeaders(json_t *js, uint32_t direction, htp_tx_t *tx)
 
 static void BodyPrintableBuffer(json_t *js, HtpBody *body, const char *key)
 {
-    if (body->sb != NULL && body->sb->buf != NULL) {
-        uint32_t offset = 0;
-        const uint8_t *body_data;
-        uint32_t body_data_len;
-        uint64_t body_offset;
-
-        if (StreamingBufferGetData(body->sb, &body_data,
-                                   &body_data_len, &body_offset) == 0) {
-            return;
-        }
+    uint32_t offset = 0;
+    const uint8_t *body_data;
+    uint32_t body_data_len;
+    uint8_t *gathered = NULL;
 
-        uint8_t printable_buf[body_data_len + 1];
-        PrintStringsToBuffer(printable_buf, &offset,
-                             sizeof(printable_buf),
-                             body_data, body_data_len);
-        if (offset > 0) {
-            json_object_set_new(js, key, json_string((char *)printable_buf));
-        }
+    if (HtpBodyGetBufferedData(body, &body_data, &body_data_len, &gathered) == 0) {
+        return;
     }
+
+    uint8_t printable_buf[body_data_len + 1];
+    PrintStringsToBuffer(printable_buf, &offset,
+                         sizeof(printable_buf),
+                         body_data, body_data_len);
+    if (offset > 0) {
+        json_object_set_new(js, key, json_string((char *)printable_buf));
+    }
+    if (gathered != NULL)
+        SCFree(gathered);
 }
 
 void JsonHttpLogJSONBodyPrintable(json_t *js, Flow *f, uint64_t tx_id)
@@ -454,22 +455,21 @@ void JsonHttpLogJSONBodyPrintable(json_t *js, Flow *f, uint64_t tx_id)
 
 static void BodyBase64Buffer(json_t *js, HtpBody *body, const char *key)
 {
-    if (body->sb != NULL && body->sb->buf != NULL) {
-        const uint8_t *body_data;
-        uint32_t body_data_len;
-        uint64_t body_offset;
-
-        if (StreamingBufferGetData(body->sb, &body_data,
-                                   &body_data_len, &body_offset) == 0) {
-            return;
-        }
+    const uint8_t *body_data;
+    uint32_t body_data_len;
+    uint8_t *gathered = NULL;
 
-        unsigned long len = body_data_len * 2 + 1;
-        uint8_t encoded[len];
-        if (Base64Encode(body_data, body_data_len, encoded, &len) == SC_BASE64_OK) {
-            json_object_set_new(js, key, json_string((char *)encoded));
-        }
+    if (HtpBodyGetBufferedData(body, &body_data, &body_data_len, &gathered) == 0) {
+        return;
+    }
+
+    unsigned long len = body_data_len * 2 + 1;
+    uint8_t encoded[len];
+    if (Base64Encode(body_data, body_data_len, encoded, &len) == SC_BASE64_OK) {
+        json_object_set_new(js, key, json_string((char *)encoded));
     }
+    if (gathered != NULL)
+        SCFree(gathered);
 }
 
 void JsonHttpLogJSONBodyBase64(json_t *js, Flow *f, uint64_t tx_id)
@@ -553,7 +553,7 @@ static int JsonHttpLogger(ThreadVars *tv, void *thread_data, const Packet *p, Fl
         }
     }
 
-    OutputJSONBuffer(js, jhl->httplog_ctx->file_ctx, &jhl->buffer);
+    OutputJSONBuffer(js, jhl->file_ctx, &jhl->buffer);
     json_object_del(js, "http");
 
     json_object_clear(js);
@@ -784,6 +784,13 @@ static TmEcode JsonHttpLogThreadInit(ThreadVars *t, const void *initdata, void *
         return TM_ECODE_FAILED;
     }
 
+    aft->file_ctx = LogFileEnsureExists(aft->httplog_ctx->file_ctx, t->id);
+    if (aft->file_ctx == NULL) {
+        MemBufferFree(aft->buffer);
+        SCFree(aft);
+        return TM_ECODE_FAILED;
+    }
+
     *data = (void *)aft;
     return TM_ECODE_OK;
 }
@@ -56,6 +56,7 @@ typedef struct LogIKEv2FileCtx_ {
 
 typedef struct LogIKEv2LogThread_ {
     LogIKEv2FileCtx *ikev2log_ctx;
+    LogFileCtx      *file_ctx;
     MemBuffer          *buffer;
 } LogIKEv2LogThread;
 
@@ -80,7 +81,7 @@ static int JsonIKEv2Logger(ThreadVars *tv, void *thread_data,
     json_object_set_new(js, "ikev2", ikev2js);
 
     MemBufferReset(thread->buffer);
-    OutputJSONBuffer(js, thread->ikev2log_ctx->file_ctx, &thread->buffer);
+    OutputJSONBuffer(js, thread->file_ctx, &thread->buffer);
 
     json_decref(js);
     return TM_ECODE_OK;
@@ -147,6 +148,14 @@ static TmEcode JsonIKEv2LogThreadInit(ThreadVars *t, const void *initdata, void
     }
 
     thread->ikev2log_ctx = ((OutputCtx *)initdata)->data;
+
+    thread->file_ctx = LogFileEnsureExists(thread->ikev2log_ctx->file_ctx, t->id);
+    if (thread->file_ctx == NULL) {
+        MemBufferFree(thread->buffer);
+        SCFree(thread);
+        return TM_ECODE_FAILED;
+    }
+
     *data = (void *)thread;
 
     return TM_ECODE_OK;
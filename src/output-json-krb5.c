@@ -56,6 +56,7 @@ typedef struct LogKRB5FileCtx_ {
 
 typedef struct LogKRB5LogThread_ {
     LogKRB5FileCtx *krb5log_ctx;
+    LogFileCtx     *file_ctx;
     MemBuffer          *buffer;
 } LogKRB5LogThread;
 
@@ -80,7 +81,7 @@ static int JsonKRB5Logger(ThreadVars *tv, void *thread_data,
     json_object_set_new(js, "krb5", krb5js);
 
     MemBufferReset(thread->buffer);
-    OutputJSONBuffer(js, thread->krb5log_ctx->file_ctx, &thread->buffer);
+    OutputJSONBuffer(js, thread->file_ctx, &thread->buffer);
 
     json_decref(js);
     return TM_ECODE_OK;
@@ -148,6 +149,14 @@ static TmEcode JsonKRB5LogThreadInit(ThreadVars *t, const void *initdata, void *
     }
 
     thread->krb5log_ctx = ((OutputCtx *)initdata)->data;
+
+    thread->file_ctx = LogFileEnsureExists(thread->krb5log_ctx->file_ctx, t->id);
+    if (thread->file_ctx == NULL) {
+        MemBufferFree(thread->buffer);
+        SCFree(thread);
+        return TM_ECODE_FAILED;
+    }
+
     *data = (void *)thread;
 
     return TM_ECODE_OK;
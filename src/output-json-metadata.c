@@ -130,7 +130,12 @@ static TmEcode JsonMetadataLogThreadInit(ThreadVars *t, const void *initdata, vo
 
     /** Use the Output Context (file pointer and mutex) */
     MetadataJsonOutputCtx *json_output_ctx = ((OutputCtx *)initdata)->data;
-    aft->file_ctx = json_output_ctx->file_ctx;
+    aft->file_ctx = LogFileEnsureExists(json_output_ctx->file_ctx, t->id);
+    if (aft->file_ctx == NULL) {
+        MemBufferFree(aft->json_buffer);
+        SCFree(aft);
+        return TM_ECODE_FAILED;
+    }
     aft->json_output_ctx = json_output_ctx;
 
     *data = (void *)aft;
@@ -56,6 +56,7 @@ typedef struct LogJsonFileCtx_ {
 
 typedef struct JsonNetFlowLogThread_ {
     LogJsonFileCtx *flowlog_ctx;
+    LogFileCtx     *file_ctx;
     /** LogFileCtx has the pointer to the file and a mutex to allow multithreading */
 
     MemBuffer *buffer;
@@ -305,7 +306,7 @@ static int JsonNetFlowLogger(ThreadVars *tv, void *thread_data, Flow *f)
         return TM_ECODE_OK;
     JsonNetFlowLogJSONToServer(jhl, js, f);
     JsonAddCommonOptions(&netflow_ctx->cfg, NULL, f, js);
-    OutputJSONBuffer(js, jhl->flowlog_ctx->file_ctx, &jhl->buffer);
+    OutputJSONBuffer(js, jhl->file_ctx, &jhl->buffer);
     json_object_del(js, "netflow");
     json_object_clear(js);
     json_decref(js);
@@ -319,7 +320,7 @@ static int JsonNetFlowLogger(ThreadVars *tv, void *thread_data, Flow *f)
             return TM_ECODE_OK;
         JsonNetFlowLogJSONToClient(jhl, js, f);
         JsonAddCommonOptions(&netflow_ctx->cfg, NULL, f, js);
-        OutputJSONBuffer(js, jhl->flowlog_ctx->file_ctx, &jhl->buffer);
+        OutputJSONBuffer(js, jhl->file_ctx, &jhl->buffer);
         json_object_del(js, "netflow");
         json_object_clear(js);
         json_decref(js);
@@ -429,6 +430,13 @@ static TmEcode JsonNetFlowLogThreadInit(ThreadVars *t, const void *initdata, voi
         return TM_ECODE_FAILED;
     }
 
+    aft->file_ctx = LogFileEnsureExists(aft->flowlog_ctx->file_ctx, t->id);
+    if (aft->file_ctx == NULL) {
+        MemBufferFree(aft->buffer);
+        SCFree(aft);
+        return TM_ECODE_FAILED;
+    }
+
     *data = (void *)aft;
     return TM_ECODE_OK;
 }
@@ -103,7 +103,7 @@ static int JsonNFSLogger(ThreadVars *tv, void *thread_data,
     json_object_set_new(js, "nfs", nfsjs);
 
     MemBufferReset(thread->buffer);
-    OutputJSONBuffer(js, thread->ctx->file_ctx, &thread->buffer);
+    OutputJSONBuffer(js, thread->file_ctx, &thread->buffer);
 
     json_decref(js);
     return TM_ECODE_OK;
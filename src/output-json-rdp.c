@@ -50,6 +50,7 @@ typedef struct LogRdpFileCtx_ {
 
 typedef struct LogRdpLogThread_ {
     LogRdpFileCtx *rdplog_ctx;
+    LogFileCtx    *file_ctx;
     uint32_t         count;
     MemBuffer       *buffer;
 } LogRdpLogThread;
@@ -71,7 +72,7 @@ static int JsonRdpLogger(ThreadVars *tv, void *thread_data,
     json_object_set_new(js, "rdp", rdp_js);
 
     MemBufferReset(thread->buffer);
-    OutputJSONBuffer(js, thread->rdplog_ctx->file_ctx, &thread->buffer);
+    OutputJSONBuffer(js, thread->file_ctx, &thread->buffer);
     json_decref(js);
 
     return TM_ECODE_OK;
@@ -136,6 +137,14 @@ static TmEcode JsonRdpLogThreadInit(ThreadVars *t, const void *initdata, void **
     }
 
     thread->rdplog_ctx = ((OutputCtx *)initdata)->data;
+
+    thread->file_ctx = LogFileEnsureExists(thread->rdplog_ctx->file_ctx, t->id);
+    if (thread->file_ctx == NULL) {
+        MemBufferFree(thread->buffer);
+        SCFree(thread);
+        return TM_ECODE_FAILED;
+    }
+
     *data = (void *)thread;
 
     return TM_ECODE_OK;
@@ -53,6 +53,7 @@ typedef struct LogRFBFileCtx_ {
 
 typedef struct LogRFBLogThread_ {
     LogRFBFileCtx *rfblog_ctx;
+    LogFileCtx    *file_ctx;
     uint32_t            count;
     MemBuffer          *buffer;
 } LogRFBLogThread;
@@ -87,7 +88,7 @@ static int JsonRFBLogger(ThreadVars *tv, void *thread_data,
     json_object_set_new(js, "rfb", rfb_js);
 
     MemBufferReset(thread->buffer);
-    OutputJSONBuffer(js, thread->rfblog_ctx->file_ctx, &thread->buffer);
+    OutputJSONBuffer(js, thread->file_ctx, &thread->buffer);
     json_decref(js);
 
     return TM_ECODE_OK;
@@ -150,6 +151,14 @@ static TmEcode JsonRFBLogThreadInit(ThreadVars *t, const void *initdata, void **
     }
 
     thread->rfblog_ctx = ((OutputCtx *)initdata)->data;
+
+    thread->file_ctx = LogFileEnsureExists(thread->rfblog_ctx->file_ctx, t->id);
+    if (thread->file_ctx == NULL) {
+        MemBufferFree(thread->buffer);
+        SCFree(thread);
+        return TM_ECODE_FAILED;
+    }
+
     *data = (void *)thread;
 
     return TM_ECODE_OK;
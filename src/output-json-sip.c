@@ -56,6 +56,7 @@ typedef struct LogSIPFileCtx_ {
 
 typedef struct LogSIPLogThread_ {
     LogSIPFileCtx *siplog_ctx;
+    LogFileCtx    *file_ctx;
     MemBuffer          *buffer;
 } LogSIPLogThread;
 
@@ -93,7 +94,7 @@ static int JsonSIPLogger(ThreadVars *tv, void *thread_data,
     json_object_set_new(js, "sip", sipjs);
 
     MemBufferReset(thread->buffer);
-    OutputJSONBuffer(js, thread->siplog_ctx->file_ctx, &thread->buffer);
+    OutputJSONBuffer(js, thread->file_ctx, &thread->buffer);
 
     json_decref(js);
     return TM_ECODE_OK;
@@ -162,6 +163,14 @@ static TmEcode JsonSIPLogThreadInit(ThreadVars *t, const void *initdata, void **
     }
 
     thread->siplog_ctx = ((OutputCtx *)initdata)->data;
+
+    thread->file_ctx = LogFileEnsureExists(thread->siplog_ctx->file_ctx, t->id);
+    if (thread->file_ctx == NULL) {
+        MemBufferFree(thread->buffer);
+        SCFree(thread);
+        return TM_ECODE_FAILED;
+    }
+
     *data = (void *)thread;
 
     return TM_ECODE_OK;
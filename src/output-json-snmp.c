@@ -56,6 +56,7 @@ typedef struct LogSNMPFileCtx_ {
 
 typedef struct LogSNMPLogThread_ {
     LogSNMPFileCtx *snmplog_ctx;
+    LogFileCtx     *file_ctx;
     MemBuffer          *buffer;
 } LogSNMPLogThread;
 
@@ -80,7 +81,7 @@ static int JsonSNMPLogger(ThreadVars *tv, void *thread_data,
     json_object_set_new(js, "snmp", snmpjs);
 
     MemBufferReset(thread->buffer);
-    OutputJSONBuffer(js, thread->snmplog_ctx->file_ctx, &thread->buffer);
+    OutputJSONBuffer(js, thread->file_ctx, &thread->buffer);
 
     json_decref(js);
     return TM_ECODE_OK;
@@ -147,6 +148,14 @@ static TmEcode JsonSNMPLogThreadInit(ThreadVars *t, const void *initdata, void *
     }
 
     thread->snmplog_ctx = ((OutputCtx *)initdata)->data;
+
+    thread->file_ctx = LogFileEnsureExists(thread->snmplog_ctx->file_ctx, t->id);
+    if (thread->file_ctx == NULL) {
+        MemBufferFree(thread->buffer);
+        SCFree(thread);
+        return TM_ECODE_FAILED;
+    }
+
     *data = (void *)thread;
 
     return TM_ECODE_OK;
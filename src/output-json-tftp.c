@@ -57,6 +57,7 @@ typedef struct LogTFTPFileCtx_ {
 
 typedef struct LogTFTPLogThread_ {
     LogTFTPFileCtx *tftplog_ctx;
+    LogFileCtx     *file_ctx;
     uint32_t            count;
     MemBuffer          *buffer;
 } LogTFTPLogThread;
@@ -79,7 +80,7 @@ static int JsonTFTPLogger(ThreadVars *tv, void *thread_data,
     json_object_set_new(js, "tftp", tftpjs);
 
     MemBufferReset(thread->buffer);
-    OutputJSONBuffer(js, thread->tftplog_ctx->file_ctx, &thread->buffer);
+    OutputJSONBuffer(js, thread->file_ctx, &thread->buffer);
 
     json_decref(js);
     return TM_ECODE_OK;
@@ -145,6 +146,14 @@ static TmEcode JsonTFTPLogThreadInit(ThreadVars *t, const void *initdata, void *
     }
 
     thread->tftplog_ctx = ((OutputCtx *)initdata)->data;
+
+    thread->file_ctx = LogFileEnsureExists(thread->tftplog_ctx->file_ctx, t->id);
+    if (thread->file_ctx == NULL) {
+        MemBufferFree(thread->buffer);
+        SCFree(thread);
+        return TM_ECODE_FAILED;
+    }
+
     *data = (void *)thread;
 
     return TM_ECODE_OK;
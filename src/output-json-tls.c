@@ -107,6 +107,7 @@ typedef struct OutputTlsCtx_ {
 
 typedef struct JsonTlsLogThread_ {
     OutputTlsCtx *tlslog_ctx;
+    LogFileCtx *file_ctx;
     MemBuffer *buffer;
 } JsonTlsLogThread;
 
@@ -205,10 +206,9 @@ static void JsonTlsLogJa3Hash(json_t *js, SSLState *ssl_state)
 
 static void JsonTlsLogJa3String(json_t *js, SSLState *ssl_state)
 {
-    if ((ssl_state->client_connp.ja3_str != NULL) &&
-            ssl_state->client_connp.ja3_str->data != NULL) {
-        json_object_set_new(js, "string",
-                            json_string(ssl_state->client_connp.ja3_str->data));
+    const JA3Buffer *ja3_str = SSLStateGetJA3String(&ssl_state->client_connp);
+    if (ja3_str != NULL && ja3_str->data != NULL) {
+        json_object_set_new(js, "string", json_string(ja3_str->data));
     }
 }
 
@@ -234,10 +234,9 @@ static void JsonTlsLogJa3SHash(json_t *js, SSLState *ssl_state)
 
 static void JsonTlsLogJa3SString(json_t *js, SSLState *ssl_state)
 {
-    if ((ssl_state->server_connp.ja3_str != NULL) &&
-            ssl_state->server_connp.ja3_str->data != NULL) {
-        json_object_set_new(js, "string",
-                            json_string(ssl_state->server_connp.ja3_str->data));
+    const JA3Buffer *ja3_str = SSLStateGetJA3String(&ssl_state->server_connp);
+    if (ja3_str != NULL && ja3_str->data != NULL) {
+        json_object_set_new(js, "string", json_string(ja3_str->data));
     }
 }
 
@@ -449,7 +448,7 @@ static int JsonTlsLogger(ThreadVars *tv, void *thread_data, const Packet *p,
 
     json_object_set_new(js, "tls", tjs);
 
-    OutputJSONBuffer(js, tls_ctx->file_ctx, &aft->buffer);
+    OutputJSONBuffer(js, aft->file_ctx, &aft->buffer);
     json_object_clear(js);
     json_decref(js);
 
@@ -480,6 +479,13 @@ static TmEcode JsonTlsLogThreadInit(ThreadVars *t, const void *initdata, void **
         return TM_ECODE_FAILED;
     }
 
+    aft->file_ctx = LogFileEnsureExists(aft->tlslog_ctx->file_ctx, t->id);
+    if (aft->file_ctx == NULL) {
+        MemBufferFree(aft->buffer);
+        SCFree(aft);
+        return TM_ECODE_FAILED;
+    }
+
     *data = (void *)aft;
     return TM_ECODE_OK;
 }
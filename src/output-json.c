@@ -60,6 +60,7 @@
 #include "util-device.h"
 #include "util-validate.h"
 #include "util-crypt.h"
+#include "util-cbor.h"
 
 #include "flow-var.h"
 #include "flow-bit.h"
@@ -67,6 +68,7 @@
 #include "source-pcap-file.h"
 
 #define DEFAULT_LOG_FILENAME "eve.json"
+#define DEFAULT_CBOR_LOG_FILENAME "eve.cbor"
 #define DEFAULT_ALERT_SYSLOG_FACILITY_STR       "local0"
 #define DEFAULT_ALERT_SYSLOG_FACILITY           LOG_LOCAL0
 #define DEFAULT_ALERT_SYSLOG_LEVEL              LOG_INFO
@@ -806,6 +808,12 @@ int OutputJSONMemBufferCallback(const char *str, size_t size, void *data)
     return 0;
 }
 
+/**
+ *  \brief serialize a record and write it to the log file
+ *
+ *  \retval 0 ok
+ *  \retval -1 record couldn't be serialized and was dropped
+ */
 int OutputJSONBuffer(json_t *js, LogFileCtx *file_ctx, MemBuffer **buffer)
 {
     if (file_ctx->sensor_name) {
@@ -817,6 +825,20 @@ int OutputJSONBuffer(json_t *js, LogFileCtx *file_ctx, MemBuffer **buffer)
         json_object_set_new(js, "pcap_filename", json_string(PcapFileGetFilename()));
     }
 
+    if (file_ctx->format == LOGFILE_FORMAT_CBOR) {
+        if (CBOREncodeJsonRecord(js, buffer, JSON_OUTPUT_BUFFER_SIZE) != 0) {
+            SCLogDebug("CBOR encoding failed, dropping event");
+            /* reported with the other dropped events at shutdown */
+            SCMutexLock(&file_ctx->fp_mutex);
+            file_ctx->dropped++;
+            SCMutexUnlock(&file_ctx->fp_mutex);
+            return -1;
+        }
+
+        LogFileWrite(file_ctx, *buffer);
+        return 0;
+    }
+
     if (file_ctx->prefix) {
         MemBufferWriteRaw((*buffer), file_ctx->prefix, file_ctx->prefix_len);
     }
@@ -829,7 +851,7 @@ int OutputJSONBuffer(json_t *js, LogFileCtx *file_ctx, MemBuffer **buffer)
     int r = json_dump_callback(js, OutputJSONMemBufferCallback, &wrapper,
             file_ctx->json_flags);
     if (r != 0)
-        return TM_ECODE_OK;
+        return -1;
 
     LogFileWrite(file_ctx, *buffer);
     return 0;
@@ -924,8 +946,32 @@ OutputInitResult OutputJsonInitCtx(ConfNode *conf)
             }
         }
 
+        const char *format_s = ConfNodeLookupChildValue(conf, "format");
+        if (format_s != NULL) {
+            if (strcmp(format_s, "json") == 0) {
+                json_ctx->file_ctx->format = LOGFILE_FORMAT_JSON;
+            } else if (strcmp(format_s, "cbor") == 0) {
+                if (json_ctx->json_out != LOGFILE_TYPE_FILE &&
+                    json_ctx->json_out != LOGFILE_TYPE_UNIX_DGRAM &&
+                    json_ctx->json_out != LOGFILE_TYPE_UNIX_STREAM) {
+                    SCLogError(SC_ERR_INVALID_ARGUMENT,
+                            "eve-log format cbor is only supported for "
+                            "regular files and unix sockets");
+                    exit(EXIT_FAILURE);
+                }
+                json_ctx->file_ctx->format = LOGFILE_FORMAT_CBOR;
+            } else {
+                SCLogError(SC_ERR_INVALID_ARGUMENT,
+                           "Invalid eve-log format: %s", format_s);
+                exit(EXIT_FAILURE);
+            }
+        }
+
         const char *prefix = ConfNodeLookupChildValue(conf, "prefix");
-        if (prefix != NULL)
+        if (prefix != NULL && json_ctx->file_ctx->format == LOGFILE_FORMAT_CBOR) {
+            SCLogWarning(SC_ERR_INVALID_ARGUMENT,
+                    "eve-log prefix is ignored with format cbor");
+        } else if (prefix != NULL)
         {
             SCLogInfo("Using prefix '%s' for JSON messages", prefix);
             json_ctx->file_ctx->prefix = SCStrdup(prefix);
@@ -942,7 +988,16 @@ OutputInitResult OutputJsonInitCtx(ConfNode *conf)
             json_ctx->json_out == LOGFILE_TYPE_UNIX_DGRAM ||
             json_ctx->json_out == LOGFILE_TYPE_UNIX_STREAM)
         {
-            if (SCConfLogOpenGeneric(conf, json_ctx->file_ctx, DEFAULT_LOG_FILENAME, 1) < 0) {
+            /* Each thread writes to its own file if threaded is set. */
+            const char *threaded = ConfNodeLookupChildValue(conf, "threaded");
+            if (threaded != NULL && ConfValIsTrue(threaded)) {
+                json_ctx->file_ctx->threaded = true;
+            }
+
+            const char *default_filename =
+                json_ctx->file_ctx->format == LOGFILE_FORMAT_CBOR ?
+                DEFAULT_CBOR_LOG_FILENAME : DEFAULT_LOG_FILENAME;
+            if (SCConfLogOpenGeneric(conf, json_ctx->file_ctx, default_filename, 1) < 0) {
                 LogFileFreeCtx(json_ctx->file_ctx);
                 SCFree(json_ctx);
                 SCFree(output_ctx);
@@ -1074,10 +1129,11 @@ static void OutputJsonDeInitCtx(OutputCtx *output_ctx)
 {
     OutputJsonCtx *json_ctx = (OutputJsonCtx *)output_ctx->data;
     LogFileCtx *logfile_ctx = json_ctx->file_ctx;
-    if (logfile_ctx->dropped) {
+    const uint64_t dropped = LogFileGetDropped(logfile_ctx);
+    if (dropped) {
         SCLogWarning(SC_WARN_EVENT_DROPPED,
                 "%"PRIu64" events were dropped due to slow or "
-                "disconnected socket", logfile_ctx->dropped);
+                "disconnected socket or encoding errors", dropped);
     }
     if (json_ctx->xff_cfg != NULL) {
         SCFree(json_ctx->xff_cfg);
@@ -0,0 +1,423 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Sampling and rate limiting of logger output.
+ *
+ * A sampler is set up from the "sampling" section of an eve-log type and
+ * consulted by the tx and flow logger dispatch before the logger is called,
+ * so records that are left out cost no record building at all.
+ *
+ * - flows: log the records of 1 in N flows. Flows are selected by their
+ *   hash, so all records of a flow are either logged or not.
+ * - rate/burst: token bucket limiting the records per second of the logger.
+ * - src-rate/src-burst: token bucket limiting the records per second per
+ *   flow source address. Addresses are hashed into a fixed size set
+ *   associative table. When all buckets of a set are in use, the least
+ *   recently used one is taken over with the tokens it has left, so a
+ *   collision never hands out a fresh burst.
+ *
+ * Time is taken from the packets, so the result is the same for each run
+ * over the same pcap.
+ */
+
+#include "suricata-common.h"
+#include "conf.h"
+#include "conf-yaml-loader.h"
+#include "flow.h"
+#include "util-debug.h"
+#include "util-hash-lookup3.h"
+#include "util-unittest.h"
+#include "output-sampler.h"
+
+/** tokens per record */
+#define OUTPUT_SAMPLER_TOKEN        1000000ULL
+/** number of sets of the per source address table */
+#define OUTPUT_SAMPLER_SRC_SETS     1024
+
+/** all samplers, freed at shutdown */
+static OutputSampler *sampler_list = NULL;
+
+static int OutputSamplerParseU32(ConfNode *conf, const char *name,
+        uint32_t *val)
+{
+    intmax_t v;
+    if (!ConfGetChildValueInt(conf, name, &v))
+        return 0;
+    if (v < 0 || v > UINT32_MAX) {
+        SCLogError(SC_ERR_INVALID_ARGUMENT, "invalid value for "
+                "sampling.%s: %"PRIdMAX, name, v);
+        return -1;
+    }
+    *val = (uint32_t)v;
+    return 1;
+}
+
+static void OutputSamplerFree(OutputSampler *sampler)
+{
+    if (sampler->src_sets != NULL) {
+        for (int i = 0; i < OUTPUT_SAMPLER_SRC_SETS; i++)
+            SCSpinDestroy(&sampler->src_sets[i].lock);
+        SCFree(sampler->src_sets);
+    }
+    if (sampler->sampled_name != NULL)
+        SCFree(sampler->sampled_name);
+    if (sampler->limited_name != NULL)
+        SCFree(sampler->limited_name);
+    SCSpinDestroy(&sampler->lock);
+    SCFree(sampler);
+}
+
+/**
+ *  \brief set up a sampler from the "sampling" section of a logger config
+ *
+ *  \param conf logger config node, may be NULL
+ *  \param name logger name, used for the counters
+ *
+ *  \retval sampler or NULL if the logger has no (valid) sampling config
+ */
+OutputSampler *OutputSamplerSetup(ConfNode *conf, const char *name)
+{
+    if (conf == NULL)
+        return NULL;
+    ConfNode *node = ConfNodeLookupChild(conf, "sampling");
+    if (node == NULL)
+        return NULL;
+
+    OutputSampler *sampler = SCCalloc(1, sizeof(*sampler));
+    if (unlikely(sampler == NULL))
+        return NULL;
+    SCSpinInit(&sampler->lock, 0);
+
+    if (OutputSamplerParseU32(node, "flows", &sampler->flow_rate) < 0 ||
+            OutputSamplerParseU32(node, "rate", &sampler->rate) < 0 ||
+            OutputSamplerParseU32(node, "src-rate", &sampler->src_rate) < 0)
+        goto error;
+
+    sampler->burst = sampler->rate;
+    if (OutputSamplerParseU32(node, "burst", &sampler->burst) < 0)
+        goto error;
+    sampler->src_burst = sampler->src_rate;
+    if (OutputSamplerParseU32(node, "src-burst", &sampler->src_burst) < 0)
+        goto error;
+
+    if ((sampler->rate && sampler->burst == 0) ||
+            (sampler->src_rate && sampler->src_burst == 0)) {
+        SCLogError(SC_ERR_INVALID_ARGUMENT, "%s: sampling burst can't be 0",
+                name);
+        goto error;
+    }
+
+    if (sampler->src_rate) {
+        sampler->src_sets = SCCalloc(OUTPUT_SAMPLER_SRC_SETS,
+                sizeof(OutputSamplerSrcSet));
+        if (unlikely(sampler->src_sets == NULL))
+            goto error;
+        for (int i = 0; i < OUTPUT_SAMPLER_SRC_SETS; i++)
+            SCSpinInit(&sampler->src_sets[i].lock, 0);
+    }
+    sampler->bucket.tokens = (uint64_t)sampler->burst * OUTPUT_SAMPLER_TOKEN;
+
+    char cnt_name[256];
+    snprintf(cnt_name, sizeof(cnt_name), "output.%s.sampled", name);
+    sampler->sampled_name = SCStrdup(cnt_name);
+    snprintf(cnt_name, sizeof(cnt_name), "output.%s.rate_limited", name);
+    sampler->limited_name = SCStrdup(cnt_name);
+    if (sampler->sampled_name == NULL || sampler->limited_name == NULL)
+        goto error;
+
+    SCLogConfig("%s: logging 1 in %u flows, rate %u/s (burst %u), "
+            "per source rate %u/s (burst %u)", name,
+            sampler->flow_rate ? sampler->flow_rate : 1,
+            sampler->rate, sampler->burst,
+            sampler->src_rate, sampler->src_burst);
+
+    sampler->next = sampler_list;
+    sampler_list = sampler;
+    return sampler;
+
+error:
+    OutputSamplerFree(sampler);
+    return NULL;
+}
+
+/** \internal
+ *  \brief refill the bucket and take a token from it
+ *  \retval 1 token taken
+ *  \retval 0 bucket is empty
+ */
+static int OutputSamplerTake(OutputSamplerBucket *b, uint32_t rate,
+        uint32_t burst, uint64_t now)
+{
+    const uint64_t full = (uint64_t)burst * OUTPUT_SAMPLER_TOKEN;
+
+    if (now > b->last) {
+        const uint64_t elapsed = now - b->last;
+        /* a token per second is a token per OUTPUT_SAMPLER_TOKEN usec, so
+         * 'rate' tokens per usec in token units */
+        if (elapsed >= full / rate) {
+            b->tokens = full;
+        } else {
+            b->tokens = MIN(full, b->tokens + elapsed * rate);
+        }
+        b->last = now;
+    }
+    if (b->tokens >= OUTPUT_SAMPLER_TOKEN) {
+        b->tokens -= OUTPUT_SAMPLER_TOKEN;
+        return 1;
+    }
+    return 0;
+}
+
+/** \internal
+ *  \brief take a token from the bucket of the flow source address
+ *  \retval 1 token taken
+ *  \retval 0 bucket is empty
+ */
+static int OutputSamplerTakeSrc(OutputSampler *sampler, const Flow *f,
+        uint64_t now)
+{
+    const uint32_t key = hashword(f->src.addr_data32, 4, 0);
+    OutputSamplerSrcSet *set = &sampler->src_sets[key % OUTPUT_SAMPLER_SRC_SETS];
+    OutputSamplerBucket *b = NULL;
+
+    SCSpinLock(&set->lock);
+    for (int i = 0; i < OUTPUT_SAMPLER_SRC_WAYS; i++) {
+        OutputSamplerBucket *w = &set->ways[i];
+        if (w->last == 0) {
+            /* buckets are used in order, so the source isn't in the set */
+            b = w;
+            break;
+        }
+        if (w->key == key) {
+            b = w;
+            break;
+        }
+        if (b == NULL || w->last < b->last)
+            b = w;
+    }
+    if (b->last == 0) {
+        b->tokens = (uint64_t)sampler->src_burst * OUTPUT_SAMPLER_TOKEN;
+        b->last = now;
+    }
+    /* taking over the least recently used bucket keeps its tokens. If it
+     * was idle long enough, the refill makes it full again */
+    b->key = key;
+    const int r = OutputSamplerTake(b, sampler->src_rate, sampler->src_burst, now);
+    SCSpinUnlock(&set->lock);
+    return r;
+}
+
+/**
+ *  \brief check if a record of the flow should be logged
+ *
+ *  \param sampler sampler of the logger
+ *  \param f flow the record is about
+ *  \param ts current (packet) time
+ */
+enum OutputSamplerResult OutputSamplerCheck(OutputSampler *sampler,
+        const Flow *f, const struct timeval *ts)
+{
+    if (sampler->flow_rate > 1 && f->flow_hash % sampler->flow_rate != 0)
+        return OUTPUT_SAMPLER_SAMPLED;
+
+    if (sampler->rate == 0 && sampler->src_rate == 0)
+        return OUTPUT_SAMPLER_PASS;
+
+    const uint64_t now = (uint64_t)ts->tv_sec * 1000000ULL + ts->tv_usec;
+    enum OutputSamplerResult r = OUTPUT_SAMPLER_PASS;
+
+    if (sampler->src_rate) {
+        if (!OutputSamplerTakeSrc(sampler, f, now))
+            r = OUTPUT_SAMPLER_LIMITED;
+    }
+    if (r == OUTPUT_SAMPLER_PASS && sampler->rate) {
+        SCSpinLock(&sampler->lock);
+        if (!OutputSamplerTake(&sampler->bucket, sampler->rate,
+                    sampler->burst, now))
+            r = OUTPUT_SAMPLER_LIMITED;
+        SCSpinUnlock(&sampler->lock);
+    }
+    return r;
+}
+
+void OutputSamplerFreeAll(void)
+{
+    while (sampler_list != NULL) {
+        OutputSampler *next = sampler_list->next;
+        OutputSamplerFree(sampler_list);
+        sampler_list = next;
+    }
+}
+
+#ifdef UNITTESTS
+
+static OutputSampler *OutputSamplerTestSetup(const char *sampling)
+{
+    char config[512];
+    snprintf(config, sizeof(config),
+            "%%YAML 1.1\n"
+            "---\n"
+            "dns:\n"
+            "  sampling:\n"
+            "%s", sampling);
+
+    ConfCreateContextBackup();
+    ConfInit();
+    ConfYamlLoadString(config, strlen(config));
+    OutputSampler *sampler = OutputSamplerSetup(ConfGetNode("dns"), "dns");
+    ConfDeInit();
+    ConfRestoreContextBackup();
+    return sampler;
+}
+
+/** \test 1 in N flow selection is stable per flow */
+static int OutputSamplerTest01(void)
+{
+    OutputSampler *sampler = OutputSamplerTestSetup("    flows: 4\n");
+    FAIL_IF_NULL(sampler);
+
+    Flow f;
+    memset(&f, 0, sizeof(f));
+    struct timeval ts = { 1, 0 };
+
+    int logged = 0;
+    for (uint32_t i = 0; i < 100; i++) {
+        f.flow_hash = i;
+        enum OutputSamplerResult r = OutputSamplerCheck(sampler, &f, &ts);
+        FAIL_IF(r != OutputSamplerCheck(sampler, &f, &ts));
+        if (r == OUTPUT_SAMPLER_PASS)
+            logged++;
+        else
+            FAIL_IF(r != OUTPUT_SAMPLER_SAMPLED);
+    }
+    FAIL_IF(logged != 25);
+
+    OutputSamplerFreeAll();
+    PASS;
+}
+
+/** \test rate limit lets a burst through, then refills over time */
+static int OutputSamplerTest02(void)
+{
+    OutputSampler *sampler = OutputSamplerTestSetup(
+            "    rate: 10\n"
+            "    burst: 5\n");
+    FAIL_IF_NULL(sampler);
+
+    Flow f;
+    memset(&f, 0, sizeof(f));
+    struct timeval ts = { 100, 0 };
+
+    for (int i = 0; i < 5; i++) {
+        FAIL_IF(OutputSamplerCheck(sampler, &f, &ts) != OUTPUT_SAMPLER_PASS);
+    }
+    FAIL_IF(OutputSamplerCheck(sampler, &f, &ts) != OUTPUT_SAMPLER_LIMITED);
+
+    /* 10/s: a token every 100ms */
+    ts.tv_usec = 50000;
+    FAIL_IF(OutputSamplerCheck(sampler, &f, &ts) != OUTPUT_SAMPLER_LIMITED);
+    ts.tv_usec = 100000;
+    FAIL_IF(OutputSamplerCheck(sampler, &f, &ts) != OUTPUT_SAMPLER_PASS);
+    FAIL_IF(OutputSamplerCheck(sampler, &f, &ts) != OUTPUT_SAMPLER_LIMITED);
+
+    /* a long pause refills up to the burst size only */
+    ts.tv_sec = 200;
+    for (int i = 0; i < 5; i++) {
+        FAIL_IF(OutputSamplerCheck(sampler, &f, &ts) != OUTPUT_SAMPLER_PASS);
+    }
+    FAIL_IF(OutputSamplerCheck(sampler, &f, &ts) != OUTPUT_SAMPLER_LIMITED);
+
+    OutputSamplerFreeAll();
+    PASS;
+}
+
+/** \test per source limit doesn't affect other sources */
+static int OutputSamplerTest03(void)
+{
+    OutputSampler *sampler = OutputSamplerTestSetup("    src-rate: 2\n");
+    FAIL_IF_NULL(sampler);
+
+    Flow f1, f2;
+    memset(&f1, 0, sizeof(f1));
+    memset(&f2, 0, sizeof(f2));
+    f1.src.addr_data32[0] = 0x0a000001;
+    f2.src.addr_data32[0] = 0x0a000002;
+    struct timeval ts = { 100, 0 };
+
+    FAIL_IF(OutputSamplerCheck(sampler, &f1, &ts) != OUTPUT_SAMPLER_PASS);
+    FAIL_IF(OutputSamplerCheck(sampler, &f1, &ts) != OUTPUT_SAMPLER_PASS);
+    FAIL_IF(OutputSamplerCheck(sampler, &f1, &ts) != OUTPUT_SAMPLER_LIMITED);
+    FAIL_IF(OutputSamplerCheck(sampler, &f2, &ts) != OUTPUT_SAMPLER_PASS);
+
+    OutputSamplerFreeAll();
+    PASS;
+}
+
+/** \test sources sharing a set don't get a fresh burst from a collision */
+static int OutputSamplerTest04(void)
+{
+    OutputSampler *sampler = OutputSamplerTestSetup("    src-rate: 1\n");
+    FAIL_IF_NULL(sampler);
+
+    /* find more sources mapping to the same set than it has buckets */
+    Flow f[OUTPUT_SAMPLER_SRC_WAYS + 1];
+    memset(&f, 0, sizeof(f));
+    uint32_t set = 0;
+    int n = 0;
+    for (uint32_t a = 1; n < OUTPUT_SAMPLER_SRC_WAYS + 1; a++) {
+        f[n].src.addr_data32[0] = a;
+        uint32_t s = hashword(f[n].src.addr_data32, 4, 0) % OUTPUT_SAMPLER_SRC_SETS;
+        if (n == 0)
+            set = s;
+        if (s == set)
+            n++;
+    }
+    struct timeval ts = { 100, 0 };
+
+    for (int i = 0; i < OUTPUT_SAMPLER_SRC_WAYS; i++) {
+        FAIL_IF(OutputSamplerCheck(sampler, &f[i], &ts) != OUTPUT_SAMPLER_PASS);
+        FAIL_IF(OutputSamplerCheck(sampler, &f[i], &ts) != OUTPUT_SAMPLER_LIMITED);
+    }
+    /* all buckets are in use: the new source takes over the empty least
+     * recently used bucket */
+    FAIL_IF(OutputSamplerCheck(sampler, &f[OUTPUT_SAMPLER_SRC_WAYS], &ts) !=
+            OUTPUT_SAMPLER_LIMITED);
+
+    /* a second later all buckets have a token again */
+    ts.tv_sec++;
+    FAIL_IF(OutputSamplerCheck(sampler, &f[OUTPUT_SAMPLER_SRC_WAYS], &ts) !=
+            OUTPUT_SAMPLER_PASS);
+    FAIL_IF(OutputSamplerCheck(sampler, &f[1], &ts) != OUTPUT_SAMPLER_PASS);
+
+    OutputSamplerFreeAll();
+    PASS;
+}
+
+#endif /* UNITTESTS */
+
+void OutputSamplerRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("OutputSamplerTest01", OutputSamplerTest01);
+    UtRegisterTest("OutputSamplerTest02", OutputSamplerTest02);
+    UtRegisterTest("OutputSamplerTest03", OutputSamplerTest03);
+    UtRegisterTest("OutputSamplerTest04", OutputSamplerTest04);
+#endif
+}
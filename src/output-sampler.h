@@ -0,0 +1,85 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Sampling and rate limiting of logger output.
+ */
+
+#ifndef __OUTPUT_SAMPLER_H__
+#define __OUTPUT_SAMPLER_H__
+
+#include "conf.h"
+#include "flow.h"
+
+/** result of OutputSamplerCheck */
+enum OutputSamplerResult {
+    OUTPUT_SAMPLER_PASS = 0,    /**< record should be logged */
+    OUTPUT_SAMPLER_SAMPLED,     /**< flow not part of the sample */
+    OUTPUT_SAMPLER_LIMITED,     /**< rate limit exceeded */
+};
+
+/** token bucket, tokens are kept in millionths of a record */
+typedef struct OutputSamplerBucket_ {
+    uint64_t tokens;
+    /** time of the last refill in usec */
+    uint64_t last;
+    /** hash of the source address using the bucket */
+    uint32_t key;
+} OutputSamplerBucket;
+
+/** buckets per set of the per source address table */
+#define OUTPUT_SAMPLER_SRC_WAYS     4
+
+/** set of the per source address table, with its own lock */
+typedef struct OutputSamplerSrcSet_ {
+    SCSpinlock lock;
+    OutputSamplerBucket ways[OUTPUT_SAMPLER_SRC_WAYS];
+} OutputSamplerSrcSet;
+
+typedef struct OutputSampler_ {
+    /** log 1 in flow_rate flows, selected by flow hash. 0 logs all flows */
+    uint32_t flow_rate;
+    /** max records per second and burst size for the logger, 0 for
+     *  no limit */
+    uint32_t rate;
+    uint32_t burst;
+    /** max records per second and burst size per source address, 0 for
+     *  no limit */
+    uint32_t src_rate;
+    uint32_t src_burst;
+
+    /** protects bucket, the src_sets have a lock each */
+    SCSpinlock lock;
+    OutputSamplerBucket bucket;
+    OutputSamplerSrcSet *src_sets;
+
+    /** counter names: "<name>.sampled" and "<name>.rate_limited" */
+    char *sampled_name;
+    char *limited_name;
+
+    struct OutputSampler_ *next;
+} OutputSampler;
+
+OutputSampler *OutputSamplerSetup(ConfNode *conf, const char *name);
+enum OutputSamplerResult OutputSamplerCheck(OutputSampler *sampler,
+        const Flow *f, const struct timeval *ts);
+void OutputSamplerFreeAll(void);
+void OutputSamplerRegisterTests(void);
+
+#endif /* __OUTPUT_SAMPLER_H__ */
@@ -26,6 +26,7 @@
 #include "suricata-common.h"
 #include "tm-modules.h"
 #include "output.h"
+#include "output-sampler.h"
 #include "output-tx.h"
 #include "app-layer.h"
 #include "app-layer-parser.h"
@@ -34,6 +35,9 @@
 
 typedef struct OutputLoggerThreadStore_ {
     void *thread_data;
+    /** counters for records left out by the sampler */
+    uint16_t sampled_id;
+    uint16_t limited_id;
     struct OutputLoggerThreadStore_ *next;
 } OutputLoggerThreadStore;
 
@@ -268,6 +272,21 @@ static TmEcode OutputTxLog(ThreadVars *tv, Packet *p, void *thread_data)
                     }
                 }
 
+                if (logger->output_ctx != NULL && logger->output_ctx->sampler != NULL) {
+                    enum OutputSamplerResult r = OutputSamplerCheck(
+                            logger->output_ctx->sampler, f, &p->ts);
+                    if (r != OUTPUT_SAMPLER_PASS) {
+                        SCLogDebug("tx_id %"PRIu64" not logged: %s", tx_id,
+                                r == OUTPUT_SAMPLER_SAMPLED ? "sampled" : "rate limited");
+                        if (tv != NULL) {
+                            StatsIncr(tv, r == OUTPUT_SAMPLER_SAMPLED ?
+                                    store->sampled_id : store->limited_id);
+                        }
+                        tx_logged |= (1<<logger->logger_id);
+                        goto next_logger;
+                    }
+                }
+
                 SCLogDebug("Logging tx_id %"PRIu64" to logger %d", tx_id, logger->logger_id);
                 PACKET_PROFILING_LOGGER_START(p, logger->logger_id);
                 logger->LogFunc(tv, store->thread_data, p, f, alstate, tx, tx_id);
@@ -346,6 +365,13 @@ static TmEcode OutputTxLogThreadInit(ThreadVars *tv, const void *initdata, void
                     /* store thread handle */
                     ts->thread_data = retptr;
 
+                    const OutputSampler *sampler = logger->output_ctx ?
+                        logger->output_ctx->sampler : NULL;
+                    if (sampler != NULL && tv != NULL) {
+                        ts->sampled_id = StatsRegisterCounter(sampler->sampled_name, tv);
+                        ts->limited_id = StatsRegisterCounter(sampler->limited_name, tv);
+                    }
+
                     if (td->store[alproto] == NULL) {
                         td->store[alproto] = ts;
                     } else {
@@ -47,6 +47,7 @@
 #include "output-json-alert.h"
 #include "output-json-anomaly.h"
 #include "output-json-flow.h"
+#include "output-json-flow-summary.h"
 #include "output-json-netflow.h"
 #include "log-cf-common.h"
 #include "log-droplog.h"
@@ -1133,6 +1134,7 @@ void OutputRegisterLoggers(void)
     /* flow/netflow */
     JsonFlowLogRegister();
     JsonNetFlowLogRegister();
+    JsonFlowSummaryLogRegister();
     /* json stats */
     JsonStatsLogRegister();
 
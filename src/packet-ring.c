@@ -0,0 +1,332 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Bounded lock-free packet rings, used by the "flow-ring" queue handler
+ * to pass packets from the capture threads to the autofp workers without
+ * taking a lock per packet.
+ *
+ * The indexes are free running 32 bit counters, the slot is found by
+ * masking them with the (power of 2) ring size.
+ */
+
+#include "suricata-common.h"
+#include "decode.h"
+#include "packet-ring.h"
+#include "util-unittest.h"
+
+#define PACKET_RING_MIN_SIZE 64
+
+PacketRing *PacketRingAlloc(uint32_t size)
+{
+    uint32_t rsize = PACKET_RING_MIN_SIZE;
+    while (rsize < size && rsize < (1U << 31))
+        rsize <<= 1;
+
+    PacketRing *r = NULL;
+    if (posix_memalign((void **)&r, CLS, sizeof(*r)) != 0)
+        return NULL;
+    memset(r, 0, sizeof(*r));
+
+    r->slots = SCCalloc(rsize, sizeof(Packet *));
+    if (r->slots == NULL) {
+        free(r);
+        return NULL;
+    }
+    r->size = rsize;
+    r->mask = rsize - 1;
+    return r;
+}
+
+void PacketRingFree(PacketRing *r)
+{
+    if (r == NULL)
+        return;
+    SCFree(r->slots);
+    free(r);
+}
+
+/**
+ *  \brief add up to n packets to the ring. Producer side only.
+ *
+ *  \retval cnt number of packets added. Less than n if the ring is full.
+ */
+uint32_t PacketRingEnqueueBatch(PacketRing *r, Packet **pkts, uint32_t n)
+{
+    const uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);
+    uint32_t space = r->size - (tail - r->head_cache);
+    if (space < n) {
+        r->head_cache = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        space = r->size - (tail - r->head_cache);
+        if (space == 0)
+            return 0;
+        if (n > space)
+            n = space;
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        r->slots[(tail + i) & r->mask] = pkts[i];
+    }
+    __atomic_store_n(&r->tail, tail + n, __ATOMIC_RELEASE);
+    return n;
+}
+
+/** \internal
+ *  \brief copy up to n packets out of the ring without releasing
+ *         their slots to the producer */
+static uint32_t PacketRingPeek(PacketRing *r, Packet **pkts, uint32_t n)
+{
+    const uint32_t head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+    uint32_t avail = r->tail_cache - head;
+    if (avail < n) {
+        r->tail_cache = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+        avail = r->tail_cache - head;
+        if (avail == 0)
+            return 0;
+        if (n > avail)
+            n = avail;
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        pkts[i] = r->slots[(head + i) & r->mask];
+    }
+    return n;
+}
+
+/** \internal
+ *  \brief hand n slots back to the producer */
+static inline void PacketRingConsume(PacketRing *r, uint32_t n)
+{
+    const uint32_t head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+    __atomic_store_n(&r->head, head + n, __ATOMIC_RELEASE);
+}
+
+/**
+ *  \brief take up to n packets from the ring. Consumer side only.
+ *
+ *  \retval cnt number of packets returned in pkts
+ */
+uint32_t PacketRingDequeueBatch(PacketRing *r, Packet **pkts, uint32_t n)
+{
+    n = PacketRingPeek(r, pkts, n);
+    if (n > 0)
+        PacketRingConsume(r, n);
+    return n;
+}
+
+/** \brief number of packets in the ring. Safe to call from any thread. */
+uint32_t PacketRingLen(PacketRing *r)
+{
+    /* load head first: tail only moves forward, so the result can't
+     * underflow */
+    const uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    const uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    return tail - head;
+}
+
+PacketRingSet *PacketRingSetAlloc(void)
+{
+    PacketRingSet *rs = SCCalloc(1, sizeof(*rs));
+    return rs;
+}
+
+void PacketRingSetFree(PacketRingSet *rs)
+{
+    if (rs == NULL)
+        return;
+    for (uint16_t i = 0; i < rs->cnt; i++) {
+        PacketRingFree(rs->rings[i]);
+    }
+    SCFree(rs->rings);
+    SCFree(rs);
+}
+
+/**
+ *  \brief add a ring for a new writer
+ *
+ *  Called during thread setup, before the reader of the set runs.
+ *
+ *  \retval r the writer's ring or NULL on error
+ */
+PacketRing *PacketRingSetAddRing(PacketRingSet *rs, uint32_t size)
+{
+    if (rs->cnt == UINT16_MAX)
+        return NULL;
+
+    PacketRing *r = PacketRingAlloc(size);
+    if (r == NULL)
+        return NULL;
+
+    PacketRing **ptmp = SCRealloc(rs->rings, (rs->cnt + 1) * sizeof(PacketRing *));
+    if (ptmp == NULL) {
+        PacketRingFree(r);
+        return NULL;
+    }
+    rs->rings = ptmp;
+    rs->rings[rs->cnt++] = r;
+    return r;
+}
+
+/**
+ *  \brief get the next packet for the reader of the set
+ *
+ *  Packets are handed out from the local batch. When it is empty the
+ *  rings are polled round robin, starting after the ring that filled the
+ *  previous batch so that a busy writer can't starve the others.
+ *
+ *  \retval p packet or NULL if all rings are empty
+ */
+Packet *PacketRingSetDequeue(PacketRingSet *rs)
+{
+    if (rs->batch_idx < rs->batch_cnt) {
+        Packet *p = rs->batch[rs->batch_idx];
+        __atomic_store_n(&rs->batch_idx, rs->batch_idx + 1, __ATOMIC_RELEASE);
+        return p;
+    }
+
+    for (uint16_t i = 0; i < rs->cnt; i++) {
+        uint16_t idx = rs->next++;
+        if (rs->next >= rs->cnt)
+            rs->next = 0;
+
+        PacketRing *r = rs->rings[idx];
+        uint32_t n = PacketRingPeek(r, rs->batch, PACKET_RING_BATCH_SIZE);
+        if (n == 0)
+            continue;
+
+        /* publish the batch before releasing the ring slots, so that
+         * PacketRingSetLen never misses these packets */
+        __atomic_store_n(&rs->batch_idx, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&rs->batch_cnt, n, __ATOMIC_RELAXED);
+        PacketRingConsume(r, n);
+        return rs->batch[0];
+    }
+    return NULL;
+}
+
+/**
+ *  \brief number of packets queued in the set, including the ones in
+ *         the reader's batch. Safe to call from any thread.
+ */
+uint32_t PacketRingSetLen(PacketRingSet *rs)
+{
+    uint32_t len = 0;
+    for (uint16_t i = 0; i < rs->cnt; i++) {
+        len += PacketRingLen(rs->rings[i]);
+    }
+    const uint32_t cnt = __atomic_load_n(&rs->batch_cnt, __ATOMIC_ACQUIRE);
+    const uint32_t idx = __atomic_load_n(&rs->batch_idx, __ATOMIC_ACQUIRE);
+    if (cnt > idx)
+        len += cnt - idx;
+    return len;
+}
+
+#ifdef UNITTESTS
+
+#define RING_TEST_PKT(i) ((Packet *)(uintptr_t)((i) + 1))
+
+/** \test batch enqueue/dequeue, wrap around and a full ring */
+static int PacketRingTest01(void)
+{
+    Packet *pkts[256];
+    Packet *out[256];
+    for (uint32_t i = 0; i < 256; i++)
+        pkts[i] = RING_TEST_PKT(i);
+
+    PacketRing *r = PacketRingAlloc(100);
+    FAIL_IF_NULL(r);
+    FAIL_IF_NOT(r->size == 128);
+
+    FAIL_IF_NOT(PacketRingDequeueBatch(r, out, 8) == 0);
+    FAIL_IF_NOT(PacketRingEnqueueBatch(r, pkts, 100) == 100);
+    FAIL_IF_NOT(PacketRingLen(r) == 100);
+    FAIL_IF_NOT(PacketRingDequeueBatch(r, out, 60) == 60);
+    for (uint32_t i = 0; i < 60; i++)
+        FAIL_IF_NOT(out[i] == RING_TEST_PKT(i));
+
+    /* wraps around the end of the slot array */
+    FAIL_IF_NOT(PacketRingEnqueueBatch(r, pkts + 100, 80) == 80);
+    FAIL_IF_NOT(PacketRingLen(r) == 120);
+
+    /* only 8 slots left */
+    FAIL_IF_NOT(PacketRingEnqueueBatch(r, pkts + 180, 10) == 8);
+    FAIL_IF_NOT(PacketRingLen(r) == 128);
+    FAIL_IF_NOT(PacketRingEnqueueBatch(r, pkts + 188, 1) == 0);
+
+    FAIL_IF_NOT(PacketRingDequeueBatch(r, out, 256) == 128);
+    for (uint32_t i = 0; i < 128; i++)
+        FAIL_IF_NOT(out[i] == RING_TEST_PKT(i + 60));
+    FAIL_IF_NOT(PacketRingLen(r) == 0);
+
+    PacketRingFree(r);
+    PASS;
+}
+
+/** \test ring set drains all writers and accounts for its batch */
+static int PacketRingTest02(void)
+{
+    Packet *pkts[80];
+    for (uint32_t i = 0; i < 80; i++)
+        pkts[i] = RING_TEST_PKT(i);
+
+    PacketRingSet *rs = PacketRingSetAlloc();
+    FAIL_IF_NULL(rs);
+    PacketRing *r1 = PacketRingSetAddRing(rs, 64);
+    FAIL_IF_NULL(r1);
+    PacketRing *r2 = PacketRingSetAddRing(rs, 64);
+    FAIL_IF_NULL(r2);
+    FAIL_IF_NOT(rs->cnt == 2);
+
+    FAIL_IF_NOT(PacketRingSetDequeue(rs) == NULL);
+    FAIL_IF_NOT(PacketRingEnqueueBatch(r1, pkts, 40) == 40);
+    FAIL_IF_NOT(PacketRingEnqueueBatch(r2, pkts + 40, 40) == 40);
+    FAIL_IF_NOT(PacketRingSetLen(rs) == 80);
+
+    /* first batch comes from r1 */
+    FAIL_IF_NOT(PacketRingSetDequeue(rs) == RING_TEST_PKT(0));
+    FAIL_IF_NOT(PacketRingLen(r1) == 40 - PACKET_RING_BATCH_SIZE);
+    FAIL_IF_NOT(PacketRingSetLen(rs) == 79);
+
+    /* rest of the batch can be looked at without dequeuing it */
+    FAIL_IF_NOT(PacketRingSetPeek(rs, 0) == RING_TEST_PKT(1));
+    FAIL_IF_NOT(PacketRingSetPeek(rs, PACKET_RING_BATCH_SIZE - 2) ==
+            RING_TEST_PKT(PACKET_RING_BATCH_SIZE - 1));
+    FAIL_IF_NOT(PacketRingSetPeek(rs, PACKET_RING_BATCH_SIZE - 1) == NULL);
+    FAIL_IF_NOT(PacketRingSetLen(rs) == 79);
+
+    uint64_t seen = 1;
+    Packet *p;
+    while ((p = PacketRingSetDequeue(rs)) != NULL)
+        seen++;
+    FAIL_IF_NOT(seen == 80);
+    FAIL_IF_NOT(PacketRingSetLen(rs) == 0);
+
+    PacketRingSetFree(rs);
+    PASS;
+}
+
+#endif /* UNITTESTS */
+
+void PacketRingRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("PacketRingTest01", PacketRingTest01);
+    UtRegisterTest("PacketRingTest02", PacketRingTest02);
+#endif /* UNITTESTS */
+}
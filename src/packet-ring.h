@@ -0,0 +1,104 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Bounded lock-free single producer, single consumer packet ring and
+ * a set of such rings that together act as a multi producer queue with
+ * a single reader.
+ */
+
+#ifndef __PACKET_RING_H__
+#define __PACKET_RING_H__
+
+#include "decode.h"
+
+/** number of packets the reader pulls from a ring in one go */
+#define PACKET_RING_BATCH_SIZE 32
+
+/** \brief SPSC ring of packet pointers
+ *
+ *  head is only written by the consumer, tail only by the producer. Both
+ *  sides keep a cached copy of the other side's index so that the shared
+ *  cache line is only touched when the cached view says the ring is
+ *  empty (consumer) or full (producer).
+ */
+typedef struct PacketRing_ {
+    /* consumer side */
+    uint32_t head __attribute__((aligned(CLS)));
+    uint32_t tail_cache;
+
+    /* producer side */
+    uint32_t tail __attribute__((aligned(CLS)));
+    uint32_t head_cache;
+
+    /* read only after setup */
+    uint32_t size __attribute__((aligned(CLS)));
+    uint32_t mask;
+    Packet **slots;
+} PacketRing;
+
+/** \brief set of SPSC rings feeding a single reader
+ *
+ *  Each writer thread gets its own ring, so every ring has exactly one
+ *  producer and the set as a whole behaves like a MPSC queue. The reader
+ *  drains the rings round robin in batches of PACKET_RING_BATCH_SIZE.
+ */
+typedef struct PacketRingSet_ {
+    PacketRing **rings;
+    uint16_t cnt;
+    uint16_t next;
+
+    /** set by the reader while it waits on the queue's condition */
+    int sleeping;
+    /** reader's adaptive spin budget before it goes to sleep */
+    uint32_t spin_limit;
+
+    /** packets taken from the rings, but not yet handed out */
+    uint32_t batch_idx;
+    uint32_t batch_cnt;
+    Packet *batch[PACKET_RING_BATCH_SIZE];
+} PacketRingSet;
+
+PacketRing *PacketRingAlloc(uint32_t size);
+void PacketRingFree(PacketRing *r);
+uint32_t PacketRingEnqueueBatch(PacketRing *r, Packet **pkts, uint32_t n);
+uint32_t PacketRingDequeueBatch(PacketRing *r, Packet **pkts, uint32_t n);
+uint32_t PacketRingLen(PacketRing *r);
+
+PacketRingSet *PacketRingSetAlloc(void);
+void PacketRingSetFree(PacketRingSet *rs);
+PacketRing *PacketRingSetAddRing(PacketRingSet *rs, uint32_t size);
+Packet *PacketRingSetDequeue(PacketRingSet *rs);
+uint32_t PacketRingSetLen(PacketRingSet *rs);
+
+/**
+ *  \brief look at the packet n places after the one PacketRingSetDequeue
+ *         returned last. Reader side only.
+ *
+ *  \retval p packet or NULL if it is not in the reader's batch
+ */
+static inline Packet *PacketRingSetPeek(const PacketRingSet *rs, uint32_t n)
+{
+    const uint32_t idx = rs->batch_idx + n;
+    return idx < rs->batch_cnt ? rs->batch[idx] : NULL;
+}
+
+void PacketRingRegisterTests(void);
+
+#endif /* __PACKET_RING_H__ */
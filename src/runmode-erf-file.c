@@ -30,6 +30,7 @@
 #include "util-affinity.h"
 
 #include "util-runmodes.h"
+#include "tmqh-flow.h"
 
 const char *RunModeErfFileGetDefaultMode(void)
 {
@@ -154,7 +155,7 @@ int RunModeErfFileAutoFp(void)
     ThreadVars *tv =
         TmThreadCreatePacketHandler(thread_name_autofp,
                                     "packetpool", "packetpool",
-                                    queues, "flow",
+                                    queues, TmqhFlowGetAutofpHandlerName(),
                                     "pktacqloop");
     SCFree(queues);
 
@@ -197,7 +198,7 @@ int RunModeErfFileAutoFp(void)
 
         ThreadVars *tv_detect_ncpu =
             TmThreadCreatePacketHandler(tname,
-                                        qname, "flow",
+                                        qname, TmqhFlowGetAutofpHandlerName(),
                                         "packetpool", "packetpool",
                                         "varslot");
         if (tv_detect_ncpu == NULL) {
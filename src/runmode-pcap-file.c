@@ -31,6 +31,7 @@
 #include "util-affinity.h"
 
 #include "util-runmodes.h"
+#include "tmqh-flow.h"
 
 const char *RunModeFilePcapGetDefaultMode(void)
 {
@@ -179,7 +180,7 @@ int RunModeFilePcapAutoFp(void)
     ThreadVars *tv_receivepcap =
         TmThreadCreatePacketHandler(tname,
                                     "packetpool", "packetpool",
-                                    queues, "flow",
+                                    queues, TmqhFlowGetAutofpHandlerName(),
                                     "pktacqloop");
     SCFree(queues);
 
@@ -217,7 +218,7 @@ int RunModeFilePcapAutoFp(void)
 
         ThreadVars *tv_detect_ncpu =
             TmThreadCreatePacketHandler(tname,
-                                        qname, "flow",
+                                        qname, TmqhFlowGetAutofpHandlerName(),
                                         "packetpool", "packetpool",
                                         "varslot");
         if (tv_detect_ncpu == NULL) {
@@ -38,6 +38,7 @@
 #include "detect-engine-dcepayload.h"
 #include "detect-engine-state.h"
 #include "detect-engine-tag.h"
+#include "detect-engine-threshold.h"
 #include "detect-engine-modbus.h"
 #include "detect-fast-pattern.h"
 #include "flow.h"
@@ -87,12 +88,19 @@
 #include "util-spm.h"
 #include "util-hash.h"
 #include "util-hashlist.h"
+#include "util-thash.h"
 #include "util-bloomfilter.h"
 #include "util-bloomfilter-counting.h"
 #include "util-pool.h"
 #include "util-byte.h"
 #include "util-proto-name.h"
 #include "util-memrchr.h"
+#include "util-checksum.h"
+#include "util-cbor.h"
+#include "util-log-redis.h"
+#include "output-sampler.h"
+#include "util-ja3.h"
+#include "util-base64.h"
 
 #include "util-mpm-ac.h"
 #include "util-mpm-hs.h"
@@ -102,6 +110,7 @@
 #include "conf.h"
 #include "conf-yaml-loader.h"
 #include "tmqh-flow.h"
+#include "packet-ring.h"
 #include "defrag.h"
 #include "detect-engine-siggroup.h"
 
@@ -136,6 +145,7 @@ static void RegisterUnittests(void)
     SigTableRegisterTests();
     HashTableRegisterTests();
     HashListTableRegisterTests();
+    THashRegisterTests();
     BloomFilterRegisterTests();
     BloomFilterCountingRegisterTests();
     PoolRegisterTests();
@@ -165,6 +175,7 @@ static void RegisterUnittests(void)
     ConfRegisterTests();
     ConfYamlRegisterTests();
     TmqhFlowRegisterTests();
+    PacketRingRegisterTests();
     FlowRegisterTests();
     HostRegisterUnittests();
     IPPairRegisterUnittests();
@@ -190,6 +201,7 @@ static void RegisterUnittests(void)
     MemcmpRegisterTests();
     DetectEngineInspectModbusRegisterTests();
     DetectEngineRegisterTests();
+    ThresholdRegisterTests();
     SCLogRegisterTests();
     MagicRegisterTests();
     UtilMiscRegisterTests();
@@ -198,7 +210,15 @@ static void RegisterUnittests(void)
     DetectPortTests();
     SCAtomicRegisterTests();
     MemrchrRegisterTests();
+    ChecksumRegisterTests();
+    CBORRegisterTests();
+#ifdef HAVE_LIBHIREDIS
+    SCLogRedisRegisterTests();
+#endif
+    OutputSamplerRegisterTests();
+    Ja3RegisterTests();
     AppLayerUnittestsRegister();
+    Base64RegisterTests();
     MimeDecRegisterTests();
     StreamingBufferRegisterTests();
 #ifdef OS_WIN32
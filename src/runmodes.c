@@ -38,8 +38,10 @@
 #include "runmodes.h"
 #include "util-unittest.h"
 #include "util-misc.h"
+#include "util-log-redis.h"
 
 #include "output.h"
+#include "output-sampler.h"
 
 #include "alert-fastlog.h"
 #include "alert-prelude.h"
@@ -390,6 +392,9 @@ void RunModeDispatch(int runmode, const char *custom_mode)
             BypassedFlowManagerThreadSpawn();
         }
         StatsSpawnThreads();
+#ifdef HAVE_LIBHIREDIS
+        SCLogRedisFlushThreadSpawn();
+#endif
     }
 }
 
@@ -522,6 +527,7 @@ bool IsRunModeOffline(enum RunModes run_mode_to_check)
 void RunModeShutDown(void)
 {
     RunOutputFreeList();
+    OutputSamplerFreeAll();
 
     OutputPacketShutdown();
     OutputTxShutdown();
@@ -639,6 +645,10 @@ static void RunModeInitializeEveOutput(ConfNode *conf, OutputCtx *parent_ctx)
             }
         }
 
+        /* one sampler shared by all loggers of this type */
+        OutputSampler *sampler = OutputSamplerSetup(sub_output_config,
+                type->val);
+
         /* Now setup all registers logger of this name. */
         OutputModule *sub_module;
         TAILQ_FOREACH(sub_module, &output_modules, entries) {
@@ -661,6 +671,7 @@ static void RunModeInitializeEveOutput(ConfNode *conf, OutputCtx *parent_ctx)
                 if (!result.ok || result.ctx == NULL) {
                     continue;
                 }
+                result.ctx->sampler = sampler;
 
                 AddOutputToFreeList(sub_module, result.ctx);
                 SetupOutput(sub_module->name, sub_module,
@@ -31,6 +31,16 @@
 #include "util-print.h"
 #include "util-validate.h"
 
+/** \brief release the stream buffer once reassembly is done. If the
+ *         app-layer still references data in it, it is kept until the
+ *         session is cleared. */
+static void StreamTcpClearStreamBuffer(TcpStream *stream)
+{
+    if (!stream->app_hold) {
+        StreamingBufferClear(&stream->sb);
+    }
+}
+
 static void StreamTcpRemoveSegmentFromStream(TcpStream *stream, TcpSegment *seg);
 
 static int check_overlap_different_data = 0;
@@ -762,6 +772,12 @@ static inline uint64_t GetLeftEdge(TcpSession *ssn, TcpStream *stream)
         SCLogDebug("stream:%p left_edge %"PRIu64, stream, left_edge);
     }
 
+    /* keep data the app-layer references directly */
+    if (stream->app_hold && stream->app_hold_offset < left_edge) {
+        left_edge = stream->app_hold_offset;
+        SCLogDebug("stream:%p left_edge %"PRIu64" (app hold)", stream, left_edge);
+    }
+
     if (left_edge > 0) {
         /* we know left edge based on the progress values now,
          * lets adjust it to make sure in-use segments still have
@@ -826,7 +842,7 @@ void StreamTcpPruneSession(Flow *f, uint8_t flags)
         SCLogDebug("ssn %p / stream %p: reassembly depth reached, "
                  "STREAMTCP_STREAM_FLAG_NOREASSEMBLY set", ssn, stream);
         StreamTcpReturnStreamSegments(stream);
-        StreamingBufferClear(&stream->sb);
+        StreamTcpClearStreamBuffer(stream);
         return;
 
     } else if (((ssn->flags & STREAMTCP_FLAG_APP_LAYER_DISABLED) ||
@@ -837,7 +853,7 @@ void StreamTcpPruneSession(Flow *f, uint8_t flags)
                  "STREAMTCP_STREAM_FLAG_NOREASSEMBLY set", ssn, stream);
         stream->flags |= STREAMTCP_STREAM_FLAG_NOREASSEMBLY;
         StreamTcpReturnStreamSegments(stream);
-        StreamingBufferClear(&stream->sb);
+        StreamTcpClearStreamBuffer(stream);
         return;
     }
 
@@ -118,6 +118,9 @@ typedef struct TcpStream_ {
     uint32_t min_inspect_depth;     /**< min inspect size set by the app layer, to make sure enough data
                                      *   remains available for inspection together with app layer buffers */
     uint32_t data_required;         /**< data required from STREAM_APP_PROGRESS before calling app-layer again */
+    uint64_t app_hold_offset;       /**< absolute offset of the oldest data the app-layer still references
+                                     *   directly in TcpStream::sb. Only valid if app_hold is set. */
+    bool app_hold;                  /**< app-layer references data in TcpStream::sb */
 
     StreamingBuffer sb;
     struct TCPSEG seg_tree;         /**< red black tree of TCP segments. Data is stored in TcpStream::sb */
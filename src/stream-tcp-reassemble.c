@@ -1891,6 +1891,62 @@ void StreamTcpReassemblySetMinInspectDepth(TcpSession *ssn, int direction, uint3
     }
 }
 
+/**
+ *  \brief set the offset of the oldest stream data the app-layer still
+ *         references
+ *
+ *  Data at and beyond the offset is not pruned from the stream, so that
+ *  the app-layer can point into the stream buffer instead of copying.
+ *
+ *  \param offset absolute stream offset
+ */
+void StreamTcpReassemblySetAppHold(TcpSession *ssn, int direction, uint64_t offset)
+{
+#ifdef DEBUG
+    BUG_ON(ssn == NULL);
+#endif
+
+    if (ssn != NULL) {
+        if (direction == STREAM_TOSERVER) {
+            ssn->client.app_hold_offset = offset;
+            ssn->client.app_hold = true;
+            SCLogDebug("ssn %p: set client.app_hold_offset to %"PRIu64, ssn, offset);
+        } else {
+            ssn->server.app_hold_offset = offset;
+            ssn->server.app_hold = true;
+            SCLogDebug("ssn %p: set server.app_hold_offset to %"PRIu64, ssn, offset);
+        }
+    }
+}
+
+/**
+ *  \brief clear the app-layer hold of a direction, see
+ *         StreamTcpReassemblySetAppHold()
+ */
+void StreamTcpReassemblyClearAppHold(TcpSession *ssn, int direction)
+{
+    if (ssn != NULL) {
+        TcpStream *stream = (direction == STREAM_TOSERVER) ? &ssn->client : &ssn->server;
+        stream->app_hold = false;
+        stream->app_hold_offset = 0;
+        SCLogDebug("ssn %p: cleared %s app hold", ssn,
+                direction == STREAM_TOSERVER ? "client" : "server");
+    }
+}
+
+/**
+ *  \brief get the reassembly buffer of a direction
+ *
+ *  The buffer can be slid or grown by the stream engine, so users keep
+ *  absolute offsets into it and not pointers.
+ */
+const StreamingBuffer *StreamTcpReassemblyGetStreamingBuffer(const TcpSession *ssn, int direction)
+{
+    if (ssn == NULL)
+        return NULL;
+    return (direction == STREAM_TOSERVER) ? &ssn->client.sb : &ssn->server.sb;
+}
+
 #ifdef UNITTESTS
 /** unit tests and it's support functions below */
 
@@ -129,6 +129,9 @@ int StreamTcpCheckStreamContents(uint8_t *, uint16_t , TcpStream *);
 
 bool StreamReassembleRawHasDataReady(TcpSession *ssn, Packet *p);
 void StreamTcpReassemblySetMinInspectDepth(TcpSession *ssn, int direction, uint32_t depth);
+void StreamTcpReassemblySetAppHold(TcpSession *ssn, int direction, uint64_t offset);
+void StreamTcpReassemblyClearAppHold(TcpSession *ssn, int direction);
+const StreamingBuffer *StreamTcpReassemblyGetStreamingBuffer(const TcpSession *ssn, int direction);
 
 static inline bool STREAM_LASTACK_GT_BASESEQ(const TcpStream *stream)
 {
@@ -453,6 +453,7 @@ typedef enum {
     LOGGER_JSON_RFB,
     LOGGER_JSON_TEMPLATE,
     LOGGER_JSON_RDP,
+    LOGGER_JSON_FLOW_SUMMARY,
 
     LOGGER_ALERT_DEBUG,
     LOGGER_ALERT_FAST,
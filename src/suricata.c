@@ -49,6 +49,7 @@
 #include "util-atomic.h"
 #include "util-spm.h"
 #include "util-cpu.h"
+#include "util-numa.h"
 #include "util-action.h"
 #include "util-pidfile.h"
 #include "util-ioctl.h"
@@ -316,6 +317,7 @@ static void SignalHandlerSigHup(/*@unused@*/ int sig)
 void GlobalsInitPreConfig(void)
 {
     TimeInit();
+    ChecksumSumInit();
     SupportFastPatternForSigMatchTypes();
     SCThresholdConfGlobalInit();
 }
@@ -732,12 +734,18 @@ static void PrintBuildInfo(void)
 
     /* SIMD stuff */
     memset(features, 0x00, sizeof(features));
+#if defined(__AVX2__)
+    strlcat(features, "AVX2 ", sizeof(features));
+#endif
 #if defined(__SSE4_2__)
     strlcat(features, "SSE_4_2 ", sizeof(features));
 #endif
 #if defined(__SSE4_1__)
     strlcat(features, "SSE_4_1 ", sizeof(features));
 #endif
+#if defined(__SSSE3__)
+    strlcat(features, "SSSE_3 ", sizeof(features));
+#endif
 #if defined(__SSE3__)
     strlcat(features, "SSE_3 ", sizeof(features));
 #endif
@@ -2558,6 +2566,8 @@ int PostConfLoadedSetup(SCInstance *suri)
 
     CoredumpLoadConfig();
 
+    NumaInit();
+
     DecodeGlobalConfig();
 
     LiveDeviceFinalize();
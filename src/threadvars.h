@@ -74,6 +74,7 @@ typedef struct ThreadVars_ {
 
     uint16_t cpu_affinity; /** cpu or core number to set affinity to */
     int thread_priority; /** priority (real time) for this thread. Look at threads.h */
+    int numa_node; /** NUMA node the thread is bound to, -1 if none */
 
 
     /** TmModule::flags for each module part of this thread */
@@ -84,6 +84,10 @@ typedef struct OutputCtx_ {
     void (*DeInit)(struct OutputCtx_ *);
 
     TAILQ_HEAD(, OutputModule_) submodules;
+
+    /** Optional sampling and rate limiting of the records, set up from
+     *  the "sampling" section of the logger config. */
+    struct OutputSampler_ *sampler;
 } OutputCtx;
 
 TmModule *TmModuleGetByName(const char *name);
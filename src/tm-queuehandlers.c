@@ -48,6 +48,7 @@ void TmqhSetup (void)
 /** \brief Clean up registration time allocs */
 void TmqhCleanup(void)
 {
+    TmqhFlowCleanup();
 }
 
 int TmqhNameToID(const char *name)
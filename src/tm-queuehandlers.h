@@ -29,6 +29,7 @@ enum {
     TMQH_SIMPLE,
     TMQH_PACKETPOOL,
     TMQH_FLOW,
+    TMQH_FLOW_RING,
 
     TMQH_SIZE,
 };
@@ -26,6 +26,7 @@
 #include "suricata.h"
 #include "threads.h"
 #include "tm-queues.h"
+#include "packet-ring.h"
 #include "util-debug.h"
 
 static TAILQ_HEAD(TmqList_, Tmq_) tmq_list = TAILQ_HEAD_INITIALIZER(tmq_list);
@@ -89,6 +90,12 @@ void TmqResetQueues(void)
         if (tmq->pq) {
             PacketQueueFree(tmq->pq);
         }
+        if (tmq->rings) {
+            PacketRingSetFree(tmq->rings);
+        }
+        if (tmq->load) {
+            SCFreeAligned(tmq->load);
+        }
         SCFree(tmq);
     }
     tmq_id = 0;
@@ -33,6 +33,10 @@ typedef struct Tmq_ {
     uint16_t reader_cnt;
     uint16_t writer_cnt;
     PacketQueue *pq;
+    /** per writer lock-free rings, used by the "flow-ring" handler */
+    struct PacketRingSet_ *rings;
+    /** worker load, used by the "load" autofp scheduler */
+    struct TmqhFlowQueueLoad_ *load;
     TAILQ_ENTRY(Tmq_) next;
 } Tmq;
 
@@ -34,10 +34,12 @@
 #include "tm-queuehandlers.h"
 #include "tm-threads.h"
 #include "tmqh-packetpool.h"
+#include "tmqh-flow.h"
 #include "threads.h"
 #include "util-debug.h"
 #include "util-privs.h"
 #include "util-cpu.h"
+#include "util-numa.h"
 #include "util-optimize.h"
 #include "util-profiling.h"
 #include "util-signal.h"
@@ -890,6 +892,7 @@ TmEcode TmThreadSetupOptions(ThreadVars *tv)
     }
 #endif
 
+    NumaThreadSetup(tv);
     return TM_ECODE_OK;
 }
 
@@ -928,6 +931,7 @@ ThreadVars *TmThreadCreate(const char *name, const char *inq_name, const char *i
     SCMutexInit(&tv->perf_public_ctx.m, NULL);
 
     strlcpy(tv->name, name, sizeof(tv->name));
+    tv->numa_node = -1;
 
     /* default state for every newly created thread */
     TmThreadsSetFlag(tv, THV_PAUSE);
@@ -1198,6 +1202,9 @@ static bool ThreadStillHasPackets(ThreadVars *tv)
         if (len != 0) {
             return true;
         }
+        if (TmqhFlowRingQueueLen(tv->inq) != 0) {
+            return true;
+        }
     }
 
     if (tv->stream_pq != NULL) {
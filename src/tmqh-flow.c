@@ -33,12 +33,20 @@
 #include "threads.h"
 #include "threadvars.h"
 #include "tmqh-flow.h"
+#include "packet-ring.h"
+#include "flow-hash.h"
+#include "flow-private.h"
 
 #include "tm-queuehandlers.h"
+#include "tm-threads.h"
 
 #include "conf.h"
+#include "counters.h"
+#include "util-cpu.h"
 #include "util-unittest.h"
 
+extern int max_pending_packets;
+
 Packet *TmqhInputFlow(ThreadVars *t);
 void TmqhOutputFlowHash(ThreadVars *t, Packet *p);
 void TmqhOutputFlowIPPair(ThreadVars *t, Packet *p);
@@ -46,6 +54,41 @@ void *TmqhOutputFlowSetupCtx(const char *queue_str);
 void TmqhOutputFlowFreeCtx(void *ctx);
 void TmqhFlowRegisterTests(void);
 
+Packet *TmqhInputFlowRing(ThreadVars *t);
+void TmqhOutputFlowRingHash(ThreadVars *t, Packet *p);
+void TmqhOutputFlowRingIPPair(ThreadVars *t, Packet *p);
+void *TmqhOutputFlowRingSetupCtx(const char *queue_str);
+
+void TmqhOutputFlowLoad(ThreadVars *t, Packet *p);
+void TmqhOutputFlowRingLoad(ThreadVars *t, Packet *p);
+
+/** bounds of the adaptive spin of the "flow-ring" reader */
+#define FLOW_RING_SPIN_MIN  16
+#define FLOW_RING_SPIN_MAX  4096
+
+/** use the lock-free rings for the autofp queues */
+static bool autofp_use_rings = false;
+
+/** "load" scheduler: per queue load accounting and flow steering */
+static bool autofp_load_balance = false;
+
+/** number of steering table buckets, must be a power of 2 */
+#define FLOW_STEER_BUCKETS      (1 << 18)
+/** seconds on top of the flow timeout for the flow manager to evict
+ *  a timed out flow */
+#define FLOW_STEER_EVICT_SLACK  30
+/** writer packets between two samples of the worker load */
+#define FLOW_LOAD_SAMPLE_PKTS   1024
+/** worker packets between two updates of its load counters */
+#define FLOW_LOAD_STATS_PKTS    1024
+/** queue depth equivalent of a fully busy worker */
+#define FLOW_LOAD_BUSY_WEIGHT   64
+
+/** steering table shared by all writers. Each bucket holds the queue
+ *  id + 1 in the upper 16 bits and the time of its last packet in
+ *  seconds in the lower 32 bits. 0 means unused. */
+static uint64_t *flow_steer_table = NULL;
+
 void TmqhFlowRegister(void)
 {
     tmqh_table[TMQH_FLOW].name = "flow";
@@ -54,14 +97,19 @@ void TmqhFlowRegister(void)
     tmqh_table[TMQH_FLOW].OutHandlerCtxFree = TmqhOutputFlowFreeCtx;
     tmqh_table[TMQH_FLOW].RegisterTests = TmqhFlowRegisterTests;
 
+    tmqh_table[TMQH_FLOW_RING].name = "flow-ring";
+    tmqh_table[TMQH_FLOW_RING].InHandler = TmqhInputFlowRing;
+    tmqh_table[TMQH_FLOW_RING].OutHandlerCtxSetup = TmqhOutputFlowRingSetupCtx;
+    tmqh_table[TMQH_FLOW_RING].OutHandlerCtxFree = TmqhOutputFlowFreeCtx;
+
     const char *scheduler = NULL;
     if (ConfGet("autofp-scheduler", &scheduler) == 1) {
         if (strcasecmp(scheduler, "round-robin") == 0) {
             SCLogNotice("using flow hash instead of round robin");
             tmqh_table[TMQH_FLOW].OutHandler = TmqhOutputFlowHash;
-        } else if (strcasecmp(scheduler, "active-packets") == 0) {
-            SCLogNotice("using flow hash instead of active packets");
-            tmqh_table[TMQH_FLOW].OutHandler = TmqhOutputFlowHash;
+        } else if (strcasecmp(scheduler, "active-packets") == 0 ||
+                   strcasecmp(scheduler, "load") == 0) {
+            tmqh_table[TMQH_FLOW].OutHandler = TmqhOutputFlowLoad;
         } else if (strcasecmp(scheduler, "hash") == 0) {
             tmqh_table[TMQH_FLOW].OutHandler = TmqhOutputFlowHash;
         } else if (strcasecmp(scheduler, "ippair") == 0) {
@@ -76,9 +124,56 @@ void TmqhFlowRegister(void)
         tmqh_table[TMQH_FLOW].OutHandler = TmqhOutputFlowHash;
     }
 
+    if (tmqh_table[TMQH_FLOW].OutHandler == TmqhOutputFlowIPPair)
+        tmqh_table[TMQH_FLOW_RING].OutHandler = TmqhOutputFlowRingIPPair;
+    else if (tmqh_table[TMQH_FLOW].OutHandler == TmqhOutputFlowLoad)
+        tmqh_table[TMQH_FLOW_RING].OutHandler = TmqhOutputFlowRingLoad;
+    else
+        tmqh_table[TMQH_FLOW_RING].OutHandler = TmqhOutputFlowRingHash;
+
+    if (tmqh_table[TMQH_FLOW].OutHandler == TmqhOutputFlowLoad) {
+        flow_steer_table = SCCalloc(FLOW_STEER_BUCKETS, sizeof(uint64_t));
+        if (flow_steer_table == NULL) {
+            FatalError(SC_ERR_MEM_ALLOC, "failed to alloc autofp steering table");
+        }
+        autofp_load_balance = true;
+    }
+
+    const char *queue = NULL;
+    if (ConfGet("autofp-queue", &queue) == 1) {
+        if (strcasecmp(queue, "ring") == 0) {
+            autofp_use_rings = true;
+        } else if (strcasecmp(queue, "locked") == 0) {
+            autofp_use_rings = false;
+        } else {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "Invalid entry \"%s\" "
+                       "for autofp-queue in conf.  Killing engine.",
+                       queue);
+            exit(EXIT_FAILURE);
+        }
+    }
+
     return;
 }
 
+void TmqhFlowCleanup(void)
+{
+    if (flow_steer_table != NULL) {
+        SCFree(flow_steer_table);
+        flow_steer_table = NULL;
+    }
+    autofp_load_balance = false;
+}
+
+/**
+ *  \brief get the name of the queue handler the autofp runmodes should
+ *         use between the capture threads and the workers
+ */
+const char *TmqhFlowGetAutofpHandlerName(void)
+{
+    return autofp_use_rings ? "flow-ring" : "flow";
+}
+
 void TmqhFlowPrintAutofpHandler(void)
 {
 #define PRINT_IF_FUNC(f, msg)                       \
@@ -87,12 +182,61 @@ void TmqhFlowPrintAutofpHandler(void)
 
     PRINT_IF_FUNC(TmqhOutputFlowHash, "Hash");
     PRINT_IF_FUNC(TmqhOutputFlowIPPair, "IPPair");
+    PRINT_IF_FUNC(TmqhOutputFlowLoad, "Load");
 
 #undef PRINT_IF_FUNC
+
+    if (autofp_use_rings)
+        SCLogConfig("AutoFP mode using lock-free packet rings");
+}
+
+/** \internal
+ *  \brief account the time since the worker's last packet as busy and
+ *         mark the start of the wait for the next one */
+static inline uint64_t FlowLoadEnter(TmqhFlowQueueLoad *load)
+{
+    uint64_t now = UtilCpuGetTicks();
+    if (load->last_exit != 0) {
+        uint64_t busy = now - load->last_exit;
+        load->win_busy += busy;
+        __atomic_store_n(&load->busy_ticks, load->busy_ticks + busy, __ATOMIC_RELAXED);
+    }
+    return now;
+}
+
+/** \internal
+ *  \brief account the wait as idle and update the worker's load
+ *         counters every FLOW_LOAD_STATS_PKTS packets */
+static inline void FlowLoadExit(ThreadVars *tv, TmqhFlowQueueLoad *load,
+        uint64_t enter, const Packet *p)
+{
+    uint64_t now = UtilCpuGetTicks();
+    uint64_t idle = now - enter;
+    load->win_idle += idle;
+    __atomic_store_n(&load->idle_ticks, load->idle_ticks + idle, __ATOMIC_RELAXED);
+    load->last_exit = now;
+
+    if (p == NULL || ++load->win_pkts < FLOW_LOAD_STATS_PKTS)
+        return;
+
+    uint64_t total = load->win_busy + load->win_idle;
+    if (total > 0) {
+        StatsSetUI64(tv, load->cnt_busy, (load->win_busy * 1000) / total);
+    }
+    uint32_t depth = tv->inq->pq->len + TmqhFlowRingQueueLen(tv->inq);
+    StatsSetUI64(tv, load->cnt_depth, depth);
+    StatsSetUI64(tv, load->cnt_imbalance,
+            __atomic_load_n(&load->imbalance, __ATOMIC_RELAXED));
+    StatsSetUI64(tv, load->cnt_steered,
+            __atomic_load_n(&load->steered, __ATOMIC_RELAXED));
+
+    load->win_busy = 0;
+    load->win_idle = 0;
+    load->win_pkts = 0;
 }
 
 /* same as 'simple' */
-Packet *TmqhInputFlow(ThreadVars *tv)
+static Packet *FlowInput(ThreadVars *tv)
 {
     PacketQueue *q = tv->inq->pq;
 
@@ -115,7 +259,37 @@ Packet *TmqhInputFlow(ThreadVars *tv)
     }
 }
 
-static int StoreQueueId(TmqhFlowCtx *ctx, char *name)
+Packet *TmqhInputFlow(ThreadVars *tv)
+{
+    TmqhFlowQueueLoad *load = tv->inq->load;
+    if (load == NULL)
+        return FlowInput(tv);
+
+    uint64_t enter = FlowLoadEnter(load);
+    Packet *p = FlowInput(tv);
+    FlowLoadExit(tv, load, enter, p);
+    return p;
+}
+
+/**
+ * \brief register the load counters of an autofp worker
+ *
+ * Only registers counters if the thread reads from a queue fed by the
+ * "load" scheduler.
+ */
+void TmqhFlowRegisterThreadCounters(ThreadVars *tv)
+{
+    if (tv->inq == NULL || tv->inq->load == NULL)
+        return;
+
+    TmqhFlowQueueLoad *load = tv->inq->load;
+    load->cnt_busy = StatsRegisterCounter("autofp.busy_permille", tv);
+    load->cnt_depth = StatsRegisterCounter("autofp.queue_depth", tv);
+    load->cnt_imbalance = StatsRegisterCounter("autofp.load_vs_avg_permille", tv);
+    load->cnt_steered = StatsRegisterCounter("autofp.flows_steered", tv);
+}
+
+static int StoreQueueId(TmqhFlowCtx *ctx, char *name, bool ring)
 {
     void *ptmp;
     Tmq *tmq = TmqGetQueueByName(name);
@@ -147,9 +321,56 @@ static int StoreQueueId(TmqhFlowCtx *ctx, char *name)
     }
     ctx->queues[ctx->size - 1].q = tmq->pq;
 
+    if (ring) {
+        /* one ring per writer thread and queue, so each ring has a
+         * single producer */
+        if (tmq->rings == NULL) {
+            tmq->rings = PacketRingSetAlloc();
+            if (tmq->rings == NULL)
+                return -1;
+            tmq->rings->spin_limit = FLOW_RING_SPIN_MIN;
+        }
+        PacketRing *r = PacketRingSetAddRing(tmq->rings, max_pending_packets);
+        if (r == NULL)
+            return -1;
+        ctx->queues[ctx->size - 1].rs = tmq->rings;
+        ctx->queues[ctx->size - 1].ring = r;
+    }
+
+    if (autofp_load_balance) {
+        if (tmq->load == NULL) {
+            tmq->load = SCMallocAligned(sizeof(TmqhFlowQueueLoad), CLS);
+            if (tmq->load == NULL)
+                return -1;
+            memset(tmq->load, 0, sizeof(TmqhFlowQueueLoad));
+        }
+        ctx->queues[ctx->size - 1].load = tmq->load;
+    }
+
     return 0;
 }
 
+/** \internal
+ *  \brief get the time a steering bucket stays pinned to its queue
+ *
+ *  A flow can resume after any idle time shorter than its timeout and
+ *  it stays in the flow hash until the flow manager evicts it. Its
+ *  packets have to reach the same worker until then, so the bucket is
+ *  pinned for the largest configured flow timeout.
+ */
+static uint32_t FlowSteerTimeout(void)
+{
+    uint32_t timeout = 0;
+    for (int i = 0; i < FLOW_PROTO_MAX; i++) {
+        const FlowProtoTimeout *t = &flow_timeouts_normal[i];
+        timeout = MAX(timeout, t->new_timeout);
+        timeout = MAX(timeout, t->est_timeout);
+        timeout = MAX(timeout, t->closed_timeout);
+        timeout = MAX(timeout, t->bypassed_timeout);
+    }
+    return timeout + FLOW_STEER_EVICT_SLACK;
+}
+
 /**
  * \brief setup the queue handlers ctx
  *
@@ -157,10 +378,11 @@ static int StoreQueueId(TmqhFlowCtx *ctx, char *name)
  * and sets the ctx up to devide flows over these queue's.
  *
  * \param queue_str comma separated string with output queue names
+ * \param ring set up a lock-free ring to each of the queues
  *
  * \retval ctx queues handlers ctx or NULL in error
  */
-void *TmqhOutputFlowSetupCtx(const char *queue_str)
+static void *FlowSetupCtx(const char *queue_str, bool ring)
 {
     if (queue_str == NULL || strlen(queue_str) == 0)
         return NULL;
@@ -184,12 +406,12 @@ void *TmqhOutputFlowSetupCtx(const char *queue_str)
         if (comma != NULL) {
             *comma = '\0';
             char *qname = tstr;
-            int r = StoreQueueId(ctx,qname);
+            int r = StoreQueueId(ctx,qname,ring);
             if (r < 0)
                 goto error;
         } else {
             char *qname = tstr;
-            int r = StoreQueueId(ctx,qname);
+            int r = StoreQueueId(ctx,qname,ring);
             if (r < 0)
                 goto error;
         }
@@ -197,6 +419,9 @@ void *TmqhOutputFlowSetupCtx(const char *queue_str)
     } while (tstr != NULL);
 
     SCFree(str);
+
+    if (autofp_load_balance)
+        ctx->steer_timeout = FlowSteerTimeout();
     return (void *)ctx;
 
 error:
@@ -206,6 +431,16 @@ error:
     return NULL;
 }
 
+void *TmqhOutputFlowSetupCtx(const char *queue_str)
+{
+    return FlowSetupCtx(queue_str, false);
+}
+
+void *TmqhOutputFlowRingSetupCtx(const char *queue_str)
+{
+    return FlowSetupCtx(queue_str, true);
+}
+
 void TmqhOutputFlowFreeCtx(void *ctx)
 {
     TmqhFlowCtx *fctx = (TmqhFlowCtx *)ctx;
@@ -218,12 +453,10 @@ void TmqhOutputFlowFreeCtx(void *ctx)
     return;
 }
 
-void TmqhOutputFlowHash(ThreadVars *tv, Packet *p)
+static inline int16_t FlowHashQueueId(TmqhFlowCtx *ctx, const Packet *p)
 {
     int16_t qid = 0;
 
-    TmqhFlowCtx *ctx = (TmqhFlowCtx *)tv->outctx;
-
     if (p->flags & PKT_WANTS_FLOW) {
         uint32_t hash = p->flow_hash;
         qid = hash % ctx->size;
@@ -233,6 +466,13 @@ void TmqhOutputFlowHash(ThreadVars *tv, Packet *p)
         if (ctx->last == ctx->size)
             ctx->last = 0;
     }
+    return qid;
+}
+
+void TmqhOutputFlowHash(ThreadVars *tv, Packet *p)
+{
+    TmqhFlowCtx *ctx = (TmqhFlowCtx *)tv->outctx;
+    int16_t qid = FlowHashQueueId(ctx, p);
 
     PacketQueue *q = ctx->queues[qid].q;
     SCMutexLock(&q->mutex_q);
@@ -243,20 +483,11 @@ void TmqhOutputFlowHash(ThreadVars *tv, Packet *p)
     return;
 }
 
-/**
- * \brief select the queue to output based on IP address pair.
- *
- * \param tv thread vars.
- * \param p packet.
- */
-void TmqhOutputFlowIPPair(ThreadVars *tv, Packet *p)
+static inline int16_t FlowIPPairQueueId(TmqhFlowCtx *ctx, const Packet *p)
 {
-    int16_t qid = 0;
     uint32_t addr_hash = 0;
     int i;
 
-    TmqhFlowCtx *ctx = (TmqhFlowCtx *)tv->outctx;
-
     if (p->src.family == AF_INET6) {
         for (i = 0; i < 4; i++) {
             addr_hash += p->src.addr_data32[i] + p->dst.addr_data32[i];
@@ -267,7 +498,133 @@ void TmqhOutputFlowIPPair(ThreadVars *tv, Packet *p)
 
     /* we don't have to worry about possible overflow, since
      * ctx->size will be lesser than 2 ** 31 for sure */
-    qid = addr_hash % ctx->size;
+    return addr_hash % ctx->size;
+}
+
+/** \internal
+ *  \brief sample the busy ratio of all workers and publish how each of
+ *         them compares to the average */
+static void FlowLoadSample(TmqhFlowCtx *ctx)
+{
+    uint64_t sum = 0;
+
+    for (uint16_t i = 0; i < ctx->size; i++) {
+        TmqhFlowMode *m = &ctx->queues[i];
+        uint64_t busy = __atomic_load_n(&m->load->busy_ticks, __ATOMIC_RELAXED);
+        uint64_t idle = __atomic_load_n(&m->load->idle_ticks, __ATOMIC_RELAXED);
+        uint64_t dbusy = busy - m->last_busy;
+        uint64_t didle = idle - m->last_idle;
+        m->last_busy = busy;
+        m->last_idle = idle;
+
+        if (dbusy + didle > 0)
+            m->busy_permille = (uint32_t)((dbusy * 1000) / (dbusy + didle));
+        sum += m->busy_permille;
+    }
+
+    uint64_t avg = sum / ctx->size;
+    for (uint16_t i = 0; i < ctx->size; i++) {
+        TmqhFlowMode *m = &ctx->queues[i];
+        uint32_t v = avg ? (uint32_t)((m->busy_permille * 1000) / avg) : 1000;
+        __atomic_store_n(&m->load->imbalance, v, __ATOMIC_RELAXED);
+    }
+}
+
+/** \internal
+ *  \brief find the queue with the lowest load. The load of a queue is its
+ *         depth plus the worker's busy ratio scaled to
+ *         FLOW_LOAD_BUSY_WEIGHT packets. */
+static int16_t FlowLoadLeastLoaded(TmqhFlowCtx *ctx)
+{
+    int16_t qid = 0;
+    uint64_t min = UINT64_MAX;
+
+    for (uint16_t i = 0; i < ctx->size; i++) {
+        TmqhFlowMode *m = &ctx->queues[i];
+        uint64_t depth = m->q->len;
+        if (m->rs != NULL)
+            depth += PacketRingSetLen(m->rs);
+
+        uint64_t score = depth + (m->busy_permille * FLOW_LOAD_BUSY_WEIGHT) / 1000;
+        if (score < min) {
+            min = score;
+            qid = i;
+        }
+    }
+    return qid;
+}
+
+/** \internal
+ *  \brief select the queue for the "load" scheduler
+ *
+ *  The capture threads don't see the flow, so flows are tracked in a
+ *  steering table indexed by the flow hash. A bucket keeps its queue until
+ *  it has seen no packet for longer than the largest flow timeout, so a
+ *  flow that is still in the flow hash stays on its worker. Unused or
+ *  expired buckets, i.e. new flows, are assigned to the least loaded
+ *  queue.
+ */
+static int16_t FlowLoadQueueId(TmqhFlowCtx *ctx, const Packet *p)
+{
+    if (++ctx->pkts >= FLOW_LOAD_SAMPLE_PKTS) {
+        ctx->pkts = 0;
+        FlowLoadSample(ctx);
+    }
+
+    if (!(p->flags & PKT_WANTS_FLOW))
+        return FlowLoadLeastLoaded(ctx);
+
+    uint64_t *bucket = &flow_steer_table[p->flow_hash & (FLOW_STEER_BUCKETS - 1)];
+    const uint32_t now = (uint32_t)p->ts.tv_sec;
+    uint64_t v = __atomic_load_n(bucket, __ATOMIC_RELAXED);
+
+    while (1) {
+        uint16_t stored = (uint16_t)(v >> 48);
+        uint32_t last = (uint32_t)v;
+        if (stored != 0 && stored <= ctx->size &&
+                (uint32_t)(now - last) <= ctx->steer_timeout) {
+            /* only write the bucket once per second */
+            if (last != now) {
+                uint64_t nv = ((uint64_t)stored << 48) | now;
+                __atomic_compare_exchange_n(bucket, &v, nv, false,
+                        __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+            }
+            return stored - 1;
+        }
+
+        int16_t qid = FlowLoadLeastLoaded(ctx);
+        uint64_t nv = ((uint64_t)(qid + 1) << 48) | now;
+        if (__atomic_compare_exchange_n(bucket, &v, nv, false,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            __atomic_add_fetch(&ctx->queues[qid].load->steered, 1, __ATOMIC_RELAXED);
+            return qid;
+        }
+        /* another writer claimed the bucket, v now holds its value */
+    }
+}
+
+void TmqhOutputFlowLoad(ThreadVars *tv, Packet *p)
+{
+    TmqhFlowCtx *ctx = (TmqhFlowCtx *)tv->outctx;
+    int16_t qid = FlowLoadQueueId(ctx, p);
+
+    PacketQueue *q = ctx->queues[qid].q;
+    SCMutexLock(&q->mutex_q);
+    PacketEnqueue(q, p);
+    SCCondSignal(&q->cond_q);
+    SCMutexUnlock(&q->mutex_q);
+}
+
+/**
+ * \brief select the queue to output based on IP address pair.
+ *
+ * \param tv thread vars.
+ * \param p packet.
+ */
+void TmqhOutputFlowIPPair(ThreadVars *tv, Packet *p)
+{
+    TmqhFlowCtx *ctx = (TmqhFlowCtx *)tv->outctx;
+    int16_t qid = FlowIPPairQueueId(ctx, p);
 
     PacketQueue *q = ctx->queues[qid].q;
     SCMutexLock(&q->mutex_q);
@@ -278,6 +635,191 @@ void TmqhOutputFlowIPPair(ThreadVars *tv, Packet *p)
     return;
 }
 
+static inline void FlowRingPause(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+/**
+ * \brief put a packet on the writer's ring to a queue, waking up the
+ *        reader if it went to sleep.
+ */
+static inline void FlowRingEnqueue(TmqhFlowMode *m, Packet *p)
+{
+    while (PacketRingEnqueueBatch(m->ring, &p, 1) == 0) {
+        /* ring full: the worker is behind. Make sure it is awake and
+         * give it some time. */
+        SCMutexLock(&m->q->mutex_q);
+        SCCondSignal(&m->q->cond_q);
+        SCMutexUnlock(&m->q->mutex_q);
+        SleepUsec(1);
+    }
+
+    /* pairs with the fence in TmqhInputFlowRing: either the reader sees
+     * our packet before sleeping, or we see it sleeping */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&m->rs->sleeping, __ATOMIC_RELAXED)) {
+        SCMutexLock(&m->q->mutex_q);
+        SCCondSignal(&m->q->cond_q);
+        SCMutexUnlock(&m->q->mutex_q);
+    }
+}
+
+void TmqhOutputFlowRingHash(ThreadVars *tv, Packet *p)
+{
+    TmqhFlowCtx *ctx = (TmqhFlowCtx *)tv->outctx;
+    int16_t qid = FlowHashQueueId(ctx, p);
+    FlowRingEnqueue(&ctx->queues[qid], p);
+}
+
+void TmqhOutputFlowRingIPPair(ThreadVars *tv, Packet *p)
+{
+    TmqhFlowCtx *ctx = (TmqhFlowCtx *)tv->outctx;
+    int16_t qid = FlowIPPairQueueId(ctx, p);
+    FlowRingEnqueue(&ctx->queues[qid], p);
+}
+
+void TmqhOutputFlowRingLoad(ThreadVars *tv, Packet *p)
+{
+    TmqhFlowCtx *ctx = (TmqhFlowCtx *)tv->outctx;
+    int16_t qid = FlowLoadQueueId(ctx, p);
+    FlowRingEnqueue(&ctx->queues[qid], p);
+}
+
+/** number of packets the flow bucket prefetch runs ahead of the packet
+ *  handed to the flow worker */
+#define FLOW_RING_PREFETCH_AHEAD 4
+
+/**
+ * \brief get a packet from the rings and prefetch the flow lookup of the
+ *        packets behind it in the batch
+ *
+ * The decoder already computed the flow hashes, so the flow buckets can
+ * be loaded while the flow worker is busy with earlier packets. Buckets
+ * are prefetched FLOW_RING_PREFETCH_AHEAD packets ahead. The first flow
+ * of the next packet's bucket, which by then should be cached, is
+ * prefetched one packet ahead.
+ *
+ * This only applies to the autofp runmodes, the only users of the
+ * "flow-ring" queues. In workers mode the capture method hands the flow
+ * worker one packet at a time and no prefetching is done.
+ */
+static inline Packet *FlowRingDequeue(PacketRingSet *rs)
+{
+    Packet *p = PacketRingSetDequeue(rs);
+    if (p == NULL)
+        return NULL;
+
+    Packet *n;
+    if (rs->batch_idx == 1) {
+        /* p starts a new batch: fill the pipeline */
+        FlowPrefetchBucket(p);
+        for (uint32_t i = 0; i < FLOW_RING_PREFETCH_AHEAD; i++) {
+            if ((n = PacketRingSetPeek(rs, i)) == NULL)
+                break;
+            FlowPrefetchBucket(n);
+        }
+    } else if ((n = PacketRingSetPeek(rs, FLOW_RING_PREFETCH_AHEAD - 1)) != NULL) {
+        FlowPrefetchBucket(n);
+    }
+    if ((n = PacketRingSetPeek(rs, 0)) != NULL)
+        FlowPrefetchFlow(n);
+    return p;
+}
+
+/**
+ * \brief input handler for the "flow-ring" queues
+ *
+ * Packets come from the per writer rings. The locked queue is still
+ * checked first, as injected and flow timeout pseudo packets are added
+ * to it directly.
+ *
+ * If all rings are empty the reader spins for a while before it goes to
+ * sleep on the queue's condition. The spin budget doubles each time
+ * spinning found a packet and halves each time the reader had to sleep.
+ */
+static Packet *FlowRingInput(ThreadVars *tv)
+{
+    PacketQueue *q = tv->inq->pq;
+    PacketRingSet *rs = tv->inq->rings;
+    Packet *p = NULL;
+
+    /* no writer set up a ring to us */
+    if (unlikely(rs == NULL))
+        return FlowInput(tv);
+
+    StatsSyncCountersIfSignalled(tv);
+
+    /* unlocked read is only a hint, it's checked again under the lock */
+    if (q->len > 0) {
+        SCMutexLock(&q->mutex_q);
+        if (q->len > 0)
+            p = PacketDequeue(q);
+        SCMutexUnlock(&q->mutex_q);
+        if (p != NULL)
+            return p;
+    }
+
+    p = FlowRingDequeue(rs);
+    if (p != NULL)
+        return p;
+
+    for (uint32_t i = 0; i < rs->spin_limit; i++) {
+        FlowRingPause();
+        p = FlowRingDequeue(rs);
+        if (p != NULL) {
+            if (rs->spin_limit < FLOW_RING_SPIN_MAX)
+                rs->spin_limit <<= 1;
+            return p;
+        }
+    }
+    if (rs->spin_limit > FLOW_RING_SPIN_MIN)
+        rs->spin_limit >>= 1;
+
+    SCMutexLock(&q->mutex_q);
+    __atomic_store_n(&rs->sleeping, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (q->len == 0 && PacketRingSetLen(rs) == 0) {
+        SCCondWait(&q->cond_q, &q->mutex_q);
+    }
+    __atomic_store_n(&rs->sleeping, 0, __ATOMIC_RELAXED);
+
+    if (q->len > 0)
+        p = PacketDequeue(q);
+    SCMutexUnlock(&q->mutex_q);
+
+    if (p == NULL)
+        p = FlowRingDequeue(rs);
+    /* return NULL if we have no pkt. Should only happen on signals. */
+    return p;
+}
+
+Packet *TmqhInputFlowRing(ThreadVars *tv)
+{
+    TmqhFlowQueueLoad *load = tv->inq->load;
+    if (load == NULL)
+        return FlowRingInput(tv);
+
+    uint64_t enter = FlowLoadEnter(load);
+    Packet *p = FlowRingInput(tv);
+    FlowLoadExit(tv, load, enter, p);
+    return p;
+}
+
+/**
+ * \brief number of packets waiting in the rings of a queue
+ */
+uint32_t TmqhFlowRingQueueLen(Tmq *tmq)
+{
+    if (tmq->rings == NULL)
+        return 0;
+    return PacketRingSetLen(tmq->rings);
+}
+
 #ifdef UNITTESTS
 
 static int TmqhOutputFlowSetupCtxTest01(void)
@@ -376,6 +918,156 @@ static int TmqhOutputFlowSetupCtxTest03(void)
     PASS;
 }
 
+/** \test each writer gets its own ring to every queue */
+static int TmqhOutputFlowRingSetupCtxTest04(void)
+{
+    TmqResetQueues();
+
+    TmqhFlowCtx *fctx1 = TmqhOutputFlowRingSetupCtx("queue1,queue2");
+    FAIL_IF_NULL(fctx1);
+    TmqhFlowCtx *fctx2 = TmqhOutputFlowRingSetupCtx("queue1,queue2");
+    FAIL_IF_NULL(fctx2);
+
+    Tmq *tmq1 = TmqGetQueueByName("queue1");
+    FAIL_IF_NULL(tmq1);
+    Tmq *tmq2 = TmqGetQueueByName("queue2");
+    FAIL_IF_NULL(tmq2);
+    FAIL_IF_NULL(tmq1->rings);
+    FAIL_IF_NULL(tmq2->rings);
+    FAIL_IF_NOT(tmq1->rings->cnt == 2);
+    FAIL_IF_NOT(tmq2->rings->cnt == 2);
+    FAIL_IF_NOT(tmq1->writer_cnt == 2);
+
+    FAIL_IF_NOT(fctx1->queues[0].rs == tmq1->rings);
+    FAIL_IF_NOT(fctx2->queues[1].rs == tmq2->rings);
+    FAIL_IF_NOT(fctx1->queues[0].ring != fctx2->queues[0].ring);
+    FAIL_IF_NOT(fctx1->queues[0].ring->size >= (uint32_t)max_pending_packets);
+
+    Packet *p = (Packet *)fctx1;
+    FlowRingEnqueue(&fctx2->queues[1], p);
+    FAIL_IF_NOT(TmqhFlowRingQueueLen(tmq1) == 0);
+    FAIL_IF_NOT(TmqhFlowRingQueueLen(tmq2) == 1);
+    FAIL_IF_NOT(PacketRingSetDequeue(tmq2->rings) == p);
+    FAIL_IF_NOT(TmqhFlowRingQueueLen(tmq2) == 0);
+
+    TmqhOutputFlowFreeCtx(fctx1);
+    TmqhOutputFlowFreeCtx(fctx2);
+    TmqResetQueues();
+    PASS;
+}
+
+/** \test load scheduler steers new flows to the least loaded queue and
+ *        keeps existing flows on their queue */
+static int TmqhOutputFlowLoadTest05(void)
+{
+    uint64_t *prev_table = flow_steer_table;
+    bool prev_load = autofp_load_balance;
+
+    TmqResetQueues();
+    flow_steer_table = SCCalloc(FLOW_STEER_BUCKETS, sizeof(uint64_t));
+    FAIL_IF_NULL(flow_steer_table);
+    autofp_load_balance = true;
+
+    TmqhFlowCtx *ctx = TmqhOutputFlowSetupCtx("queue1,queue2,queue3");
+    FAIL_IF_NULL(ctx);
+    FAIL_IF_NULL(ctx->queues[0].load);
+    FAIL_IF_NULL(ctx->queues[2].load);
+
+    /* first worker fully busy, the others idle */
+    ctx->queues[0].load->busy_ticks = 1000;
+    ctx->queues[1].load->idle_ticks = 1000;
+    ctx->queues[2].load->idle_ticks = 1000;
+    FlowLoadSample(ctx);
+    FAIL_IF_NOT(ctx->queues[0].busy_permille == 1000);
+    FAIL_IF_NOT(ctx->queues[1].busy_permille == 0);
+    FAIL_IF_NOT(ctx->queues[0].load->imbalance == 3003);
+
+    Packet *p = PacketGetFromAlloc();
+    FAIL_IF_NULL(p);
+    p->flags |= PKT_WANTS_FLOW;
+    p->flow_hash = 1;
+    p->ts.tv_sec = 100;
+
+    FAIL_IF_NOT(FlowLoadQueueId(ctx, p) == 1);
+    FAIL_IF_NOT(ctx->queues[1].load->steered == 1);
+
+    /* the flow sticks to its queue even if that gets busy */
+    ctx->queues[1].busy_permille = 1000;
+    p->ts.tv_sec = 110;
+    FAIL_IF_NOT(FlowLoadQueueId(ctx, p) == 1);
+    FAIL_IF_NOT(ctx->queues[1].load->steered == 1);
+
+    /* a new flow goes to the idle queue */
+    p->flow_hash = 2;
+    FAIL_IF_NOT(FlowLoadQueueId(ctx, p) == 2);
+
+    /* an expired bucket is assigned again */
+    p->flow_hash = 1;
+    p->ts.tv_sec = 110 + ctx->steer_timeout + 1;
+    FAIL_IF_NOT(FlowLoadQueueId(ctx, p) == 2);
+
+    PacketFree(p);
+    TmqhOutputFlowFreeCtx(ctx);
+    TmqResetQueues();
+    SCFree(flow_steer_table);
+    flow_steer_table = prev_table;
+    autofp_load_balance = prev_load;
+    PASS;
+}
+
+/** \test load scheduler keeps a flow that resumes after a long idle time,
+ *        but within its timeout, on its queue */
+static int TmqhOutputFlowLoadTest06(void)
+{
+    uint64_t *prev_table = flow_steer_table;
+    bool prev_load = autofp_load_balance;
+    FlowProtoTimeout prev_timeouts[FLOW_PROTO_MAX];
+    memcpy(prev_timeouts, flow_timeouts_normal, sizeof(prev_timeouts));
+
+    memset(flow_timeouts_normal, 0, sizeof(prev_timeouts));
+    flow_timeouts_normal[FLOW_PROTO_DEFAULT].est_timeout = 300;
+    flow_timeouts_normal[FLOW_PROTO_TCP].new_timeout = 30;
+    flow_timeouts_normal[FLOW_PROTO_TCP].est_timeout = 3600;
+
+    TmqResetQueues();
+    flow_steer_table = SCCalloc(FLOW_STEER_BUCKETS, sizeof(uint64_t));
+    FAIL_IF_NULL(flow_steer_table);
+    autofp_load_balance = true;
+
+    TmqhFlowCtx *ctx = TmqhOutputFlowSetupCtx("queue1,queue2");
+    FAIL_IF_NULL(ctx);
+    FAIL_IF_NOT(ctx->steer_timeout == 3600 + FLOW_STEER_EVICT_SLACK);
+
+    Packet *p = PacketGetFromAlloc();
+    FAIL_IF_NULL(p);
+    p->flags |= PKT_WANTS_FLOW;
+    p->flow_hash = 1;
+    p->ts.tv_sec = 100;
+
+    ctx->queues[1].busy_permille = 1000;
+    FAIL_IF_NOT(FlowLoadQueueId(ctx, p) == 0);
+
+    /* the flow resumes after 50 minutes with its worker the busiest */
+    ctx->queues[0].busy_permille = 1000;
+    ctx->queues[1].busy_permille = 0;
+    p->ts.tv_sec = 100 + 3000;
+    FAIL_IF_NOT(FlowLoadQueueId(ctx, p) == 0);
+    FAIL_IF_NOT(ctx->queues[1].load->steered == 0);
+
+    /* once the flow is evicted the bucket is assigned again */
+    p->ts.tv_sec = 100 + 3000 + ctx->steer_timeout + 1;
+    FAIL_IF_NOT(FlowLoadQueueId(ctx, p) == 1);
+
+    PacketFree(p);
+    TmqhOutputFlowFreeCtx(ctx);
+    TmqResetQueues();
+    SCFree(flow_steer_table);
+    flow_steer_table = prev_table;
+    autofp_load_balance = prev_load;
+    memcpy(flow_timeouts_normal, prev_timeouts, sizeof(prev_timeouts));
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 void TmqhFlowRegisterTests(void)
@@ -387,6 +1079,10 @@ void TmqhFlowRegisterTests(void)
                    TmqhOutputFlowSetupCtxTest02);
     UtRegisterTest("TmqhOutputFlowSetupCtxTest03",
                    TmqhOutputFlowSetupCtxTest03);
+    UtRegisterTest("TmqhOutputFlowRingSetupCtxTest04",
+                   TmqhOutputFlowRingSetupCtxTest04);
+    UtRegisterTest("TmqhOutputFlowLoadTest05", TmqhOutputFlowLoadTest05);
+    UtRegisterTest("TmqhOutputFlowLoadTest06", TmqhOutputFlowLoadTest06);
 #endif
 
     return;
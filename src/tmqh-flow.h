@@ -24,8 +24,46 @@
 #ifndef __TMQH_FLOW_H__
 #define __TMQH_FLOW_H__
 
+#include "tm-queues.h"
+
+/** \brief load of a worker queue, used by the "load" autofp scheduler
+ *
+ *  The worker accounts the time it spends waiting for packets in its
+ *  input handler as idle and the rest as busy. The writers sample these
+ *  to steer new flows to the least loaded worker.
+ */
+typedef struct TmqhFlowQueueLoad_ {
+    /* written by the worker */
+    uint64_t busy_ticks __attribute__((aligned(CLS)));
+    uint64_t idle_ticks;
+
+    /* worker private */
+    uint64_t last_exit;
+    uint64_t win_busy;
+    uint64_t win_idle;
+    uint32_t win_pkts;
+    uint16_t cnt_busy;
+    uint16_t cnt_depth;
+    uint16_t cnt_imbalance;
+    uint16_t cnt_steered;
+
+    /* written by the writers */
+    uint32_t imbalance __attribute__((aligned(CLS)));
+    uint64_t steered;
+} TmqhFlowQueueLoad;
+
 typedef struct TmqhFlowMode_ {
     PacketQueue *q;
+    /* "flow-ring" only: this writer's ring to the queue */
+    struct PacketRing_ *ring;
+    struct PacketRingSet_ *rs;
+
+    /* "load" scheduler only: the queue's load and this writer's
+     * last sample of it */
+    TmqhFlowQueueLoad *load;
+    uint64_t last_busy;
+    uint64_t last_idle;
+    uint32_t busy_permille;
 } TmqhFlowMode;
 
 /** \brief Ctx for the flow queue handler
@@ -34,13 +72,21 @@ typedef struct TmqhFlowMode_ {
 typedef struct TmqhFlowCtx_ {
     uint16_t size;
     uint16_t last;
+    /** packets since the last load sample */
+    uint32_t pkts;
+    /** seconds a steering bucket stays pinned to its queue */
+    uint32_t steer_timeout;
 
     TmqhFlowMode *queues;
 } TmqhFlowCtx;
 
 void TmqhFlowRegister (void);
+void TmqhFlowCleanup(void);
 void TmqhFlowRegisterTests(void);
 
 void TmqhFlowPrintAutofpHandler(void);
+const char *TmqhFlowGetAutofpHandlerName(void);
+uint32_t TmqhFlowRingQueueLen(Tmq *tmq);
+void TmqhFlowRegisterThreadCounters(struct ThreadVars_ *tv);
 
 #endif /* __TMQH_FLOW_H__ */
@@ -0,0 +1,318 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * CBOR (RFC 7049) encoding of jansson objects.
+ *
+ * The encoder walks the json_t tree built by the EVE loggers and writes
+ * it out in the binary CBOR representation, so that the same record
+ * building code can produce both JSON text and CBOR output. Only
+ * definite length items are produced:
+ *
+ * - object  -> map (major type 5), keys as text strings
+ * - array   -> array (major type 4)
+ * - string  -> text string (major type 3)
+ * - integer -> unsigned (major type 0) or negative (major type 1) integer
+ * - real    -> IEEE 754 double precision float (0xfb)
+ * - true, false, null -> simple values 0xf5, 0xf4, 0xf6
+ */
+
+#include "suricata-common.h"
+#include "util-buffer.h"
+#include "util-cbor.h"
+#include "util-unittest.h"
+
+#define CBOR_MAJOR_UINT     0
+#define CBOR_MAJOR_NINT     1
+#define CBOR_MAJOR_TEXT     3
+#define CBOR_MAJOR_ARRAY    4
+#define CBOR_MAJOR_MAP      5
+
+#define CBOR_FALSE          0xf4
+#define CBOR_TRUE           0xf5
+#define CBOR_NULL           0xf6
+#define CBOR_FLOAT64        0xfb
+
+/** nesting limit, EVE records are nowhere near this deep */
+#define CBOR_MAX_DEPTH      64
+
+/** \internal
+ *  \brief make sure 'len' more bytes fit in the buffer
+ *
+ *  MemBufferWriteRaw always reserves a byte for a trailing NUL, so
+ *  we need to have strictly more space than 'len'.
+ */
+static int CBORReserve(MemBuffer **buffer, uint32_t len, uint32_t expand_by)
+{
+    if (MEMBUFFER_OFFSET(*buffer) + len >= MEMBUFFER_SIZE(*buffer)) {
+        uint32_t grow = MAX(expand_by, len + 1);
+        if (MemBufferExpand(buffer, grow) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+static int CBORWriteRaw(MemBuffer **buffer, const uint8_t *data, uint32_t len,
+        uint32_t expand_by)
+{
+    if (CBORReserve(buffer, len, expand_by) < 0)
+        return -1;
+    MemBufferWriteRaw((*buffer), data, len);
+    return 0;
+}
+
+/** \internal
+ *  \brief write the initial byte and argument of a data item
+ */
+static int CBORWriteHead(MemBuffer **buffer, uint8_t major, uint64_t val,
+        uint32_t expand_by)
+{
+    uint8_t head[9];
+    uint32_t len;
+
+    major <<= 5;
+    if (val < 24) {
+        head[0] = major | (uint8_t)val;
+        len = 1;
+    } else if (val <= UINT8_MAX) {
+        head[0] = major | 24;
+        head[1] = (uint8_t)val;
+        len = 2;
+    } else if (val <= UINT16_MAX) {
+        head[0] = major | 25;
+        head[1] = (uint8_t)(val >> 8);
+        head[2] = (uint8_t)val;
+        len = 3;
+    } else if (val <= UINT32_MAX) {
+        head[0] = major | 26;
+        head[1] = (uint8_t)(val >> 24);
+        head[2] = (uint8_t)(val >> 16);
+        head[3] = (uint8_t)(val >> 8);
+        head[4] = (uint8_t)val;
+        len = 5;
+    } else {
+        head[0] = major | 27;
+        for (int i = 0; i < 8; i++) {
+            head[1 + i] = (uint8_t)(val >> (56 - (i * 8)));
+        }
+        len = 9;
+    }
+    return CBORWriteRaw(buffer, head, len, expand_by);
+}
+
+static int CBORWriteText(MemBuffer **buffer, const char *str, size_t len,
+        uint32_t expand_by)
+{
+    if (len > UINT32_MAX)
+        return -1;
+    if (CBORWriteHead(buffer, CBOR_MAJOR_TEXT, len, expand_by) < 0)
+        return -1;
+    return CBORWriteRaw(buffer, (const uint8_t *)str, (uint32_t)len, expand_by);
+}
+
+static int CBORWriteDouble(MemBuffer **buffer, double d, uint32_t expand_by)
+{
+    uint64_t bits;
+    uint8_t out[9];
+
+    memcpy(&bits, &d, sizeof(bits));
+    out[0] = CBOR_FLOAT64;
+    for (int i = 0; i < 8; i++) {
+        out[1 + i] = (uint8_t)(bits >> (56 - (i * 8)));
+    }
+    return CBORWriteRaw(buffer, out, sizeof(out), expand_by);
+}
+
+static int CBOREncodeValue(const json_t *js, MemBuffer **buffer,
+        uint32_t expand_by, int depth)
+{
+    if (depth > CBOR_MAX_DEPTH)
+        return -1;
+
+    switch (json_typeof(js)) {
+        case JSON_OBJECT: {
+            const char *key;
+            json_t *value;
+
+            if (CBORWriteHead(buffer, CBOR_MAJOR_MAP,
+                        json_object_size(js), expand_by) < 0)
+                return -1;
+            json_object_foreach((json_t *)js, key, value) {
+                if (CBORWriteText(buffer, key, strlen(key), expand_by) < 0)
+                    return -1;
+                if (CBOREncodeValue(value, buffer, expand_by, depth + 1) < 0)
+                    return -1;
+            }
+            return 0;
+        }
+        case JSON_ARRAY: {
+            size_t idx;
+            json_t *value;
+
+            if (CBORWriteHead(buffer, CBOR_MAJOR_ARRAY,
+                        json_array_size(js), expand_by) < 0)
+                return -1;
+            json_array_foreach(js, idx, value) {
+                if (CBOREncodeValue(value, buffer, expand_by, depth + 1) < 0)
+                    return -1;
+            }
+            return 0;
+        }
+        case JSON_STRING:
+            return CBORWriteText(buffer, json_string_value(js),
+                    json_string_length(js), expand_by);
+        case JSON_INTEGER: {
+            json_int_t i = json_integer_value(js);
+            if (i >= 0)
+                return CBORWriteHead(buffer, CBOR_MAJOR_UINT, (uint64_t)i,
+                        expand_by);
+            /* negative integers are encoded as -1 - n */
+            return CBORWriteHead(buffer, CBOR_MAJOR_NINT,
+                    (uint64_t)(-(i + 1)), expand_by);
+        }
+        case JSON_REAL:
+            return CBORWriteDouble(buffer, json_real_value(js), expand_by);
+        case JSON_TRUE: {
+            const uint8_t b = CBOR_TRUE;
+            return CBORWriteRaw(buffer, &b, 1, expand_by);
+        }
+        case JSON_FALSE: {
+            const uint8_t b = CBOR_FALSE;
+            return CBORWriteRaw(buffer, &b, 1, expand_by);
+        }
+        case JSON_NULL: {
+            const uint8_t b = CBOR_NULL;
+            return CBORWriteRaw(buffer, &b, 1, expand_by);
+        }
+    }
+    return -1;
+}
+
+/**
+ *  \brief encode a json object as CBOR, appending to the buffer
+ *
+ *  \param js json object to encode
+ *  \param buffer buffer to append to, may be reallocated
+ *  \param expand_by minimal size to grow the buffer by if it's full
+ *
+ *  \retval 0 ok
+ *  \retval -1 error, buffer content is undefined
+ */
+int CBOREncodeJson(const json_t *js, MemBuffer **buffer, uint32_t expand_by)
+{
+    if (js == NULL)
+        return -1;
+    return CBOREncodeValue(js, buffer, expand_by, 0);
+}
+
+/**
+ *  \brief encode a json object as a length-prefixed CBOR record
+ *
+ *  The record is preceded by its length as a 32 bit big endian
+ *  unsigned integer, so that a reader can split a stream of records
+ *  without having to decode them.
+ *
+ *  \retval 0 ok
+ *  \retval -1 error, buffer content is undefined
+ */
+int CBOREncodeJsonRecord(const json_t *js, MemBuffer **buffer, uint32_t expand_by)
+{
+    const uint8_t placeholder[CBOR_RECORD_PREFIX_LEN] = { 0, 0, 0, 0 };
+    const uint32_t start = MEMBUFFER_OFFSET(*buffer);
+
+    if (CBORWriteRaw(buffer, placeholder, sizeof(placeholder), expand_by) < 0)
+        return -1;
+    if (CBOREncodeJson(js, buffer, expand_by) < 0)
+        return -1;
+
+    const uint32_t len = MEMBUFFER_OFFSET(*buffer) - start - CBOR_RECORD_PREFIX_LEN;
+    uint8_t *prefix = MEMBUFFER_BUFFER(*buffer) + start;
+    prefix[0] = (uint8_t)(len >> 24);
+    prefix[1] = (uint8_t)(len >> 16);
+    prefix[2] = (uint8_t)(len >> 8);
+    prefix[3] = (uint8_t)len;
+    return 0;
+}
+
+#ifdef UNITTESTS
+
+static int CBORTest01(void)
+{
+    MemBuffer *buffer = MemBufferCreateNew(8);
+    FAIL_IF_NULL(buffer);
+    json_t *js = json_object();
+    FAIL_IF_NULL(js);
+    json_object_set_new(js, "a", json_integer(1));
+    json_object_set_new(js, "b", json_integer(-500));
+    json_object_set_new(js, "c", json_string("xyz"));
+    json_object_set_new(js, "d", json_true());
+
+    FAIL_IF(CBOREncodeJson(js, &buffer, 8) != 0);
+
+    const uint8_t expected[] = {
+        0xa4,
+        0x61, 'a', 0x01,
+        0x61, 'b', 0x39, 0x01, 0xf3,
+        0x61, 'c', 0x63, 'x', 'y', 'z',
+        0x61, 'd', 0xf5,
+    };
+    FAIL_IF(MEMBUFFER_OFFSET(buffer) != sizeof(expected));
+    FAIL_IF(memcmp(MEMBUFFER_BUFFER(buffer), expected, sizeof(expected)) != 0);
+
+    json_decref(js);
+    MemBufferFree(buffer);
+    PASS;
+}
+
+static int CBORTest02(void)
+{
+    MemBuffer *buffer = MemBufferCreateNew(4);
+    FAIL_IF_NULL(buffer);
+    json_t *js = json_array();
+    FAIL_IF_NULL(js);
+    json_array_append_new(js, json_integer(4294967296LL));
+    json_array_append_new(js, json_real(1.5));
+    json_array_append_new(js, json_null());
+
+    FAIL_IF(CBOREncodeJsonRecord(js, &buffer, 4) != 0);
+
+    const uint8_t expected[] = {
+        0x00, 0x00, 0x00, 0x14,
+        0x83,
+        0x1b, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+        0xfb, 0x3f, 0xf8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0xf6,
+    };
+    FAIL_IF(MEMBUFFER_OFFSET(buffer) != sizeof(expected));
+    FAIL_IF(memcmp(MEMBUFFER_BUFFER(buffer), expected, sizeof(expected)) != 0);
+
+    json_decref(js);
+    MemBufferFree(buffer);
+    PASS;
+}
+
+#endif /* UNITTESTS */
+
+void CBORRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("CBORTest01", CBORTest01);
+    UtRegisterTest("CBORTest02", CBORTest02);
+#endif
+}
@@ -0,0 +1,38 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * CBOR (RFC 7049) encoding of jansson objects.
+ */
+
+#ifndef __UTIL_CBOR_H__
+#define __UTIL_CBOR_H__
+
+#include "util-buffer.h"
+
+/** size of the big endian record length written in front of each
+ *  length-prefixed record */
+#define CBOR_RECORD_PREFIX_LEN  4
+
+int CBOREncodeJson(const json_t *js, MemBuffer **buffer, uint32_t expand_by);
+int CBOREncodeJsonRecord(const json_t *js, MemBuffer **buffer, uint32_t expand_by);
+
+void CBORRegisterTests(void);
+
+#endif /* __UTIL_CBOR_H__ */
@@ -0,0 +1,179 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * One's complement sum over a buffer, the bulk of the work of the IP, TCP,
+ * UDP and ICMP checksums. AVX2 and SSE2 implementations are used when the
+ * build targets them. On x86 builds that don't target AVX2, an AVX2 variant
+ * is compiled in as well and used if ChecksumSumInit() finds that the CPU
+ * supports it.
+ *
+ * The sum is taken over 16 bit words in host byte order. As the one's
+ * complement sum is byte order independent, the folded result can be
+ * added to the other parts of the checksum as is.
+ */
+
+#ifndef __UTIL_CHECKSUM_SUM_H__
+#define __UTIL_CHECKSUM_SUM_H__
+
+#if !defined(__AVX2__) && defined(__SSE2__) && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define CHECKSUM_SUM_AVX2_DISPATCH 1
+#endif
+
+#if defined(__AVX2__) || defined(CHECKSUM_SUM_AVX2_DISPATCH)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static inline uint16_t ChecksumSum16(const uint16_t *, uint16_t);
+
+void ChecksumSumInit(void);
+
+#ifdef CHECKSUM_SUM_AVX2_DISPATCH
+/** set by ChecksumSumInit() if the CPU supports AVX2 */
+extern int checksum_sum_avx2;
+uint64_t ChecksumSum16AVX2(const uint16_t *pkt, uint16_t len);
+
+/** below this length the call isn't worth it */
+#define CHECKSUM_SUM_AVX2_MIN_LEN 128
+#endif
+
+/** \internal
+ *  \brief sum of the scalar tail of a buffer */
+static inline uint64_t ChecksumSum16Scalar(const uint16_t *pkt, uint16_t len)
+{
+    uint16_t pad = 0;
+    uint64_t csum = 0;
+
+    while (len >= 32) {
+        csum += pkt[0] + pkt[1] + pkt[2] + pkt[3] + pkt[4] + pkt[5] + pkt[6] +
+            pkt[7] + pkt[8] + pkt[9] + pkt[10] + pkt[11] + pkt[12] + pkt[13] +
+            pkt[14] + pkt[15];
+        len -= 32;
+        pkt += 16;
+    }
+
+    while (len >= 8) {
+        csum += pkt[0] + pkt[1] + pkt[2] + pkt[3];
+        len -= 8;
+        pkt += 4;
+    }
+
+    while (len > 1) {
+        csum += pkt[0];
+        pkt += 1;
+        len -= 2;
+    }
+
+    if (len == 1) {
+        *(uint8_t *)(&pad) = (*(uint8_t *)pkt);
+        csum += pad;
+    }
+    return csum;
+}
+
+#if defined(__AVX2__) || defined(CHECKSUM_SUM_AVX2_DISPATCH)
+/** \internal
+ *  \brief sum of the 32 byte blocks of a buffer, pkt and len are advanced
+ *         past them. Each 32 bit lane gets at most 2 words per round, with
+ *         len limited to 64k this can't overflow. */
+#if defined(CHECKSUM_SUM_AVX2_DISPATCH)
+__attribute__((target("avx2")))
+#endif
+static inline uint64_t ChecksumSum16BlocksAVX2(const uint16_t **ppkt, uint16_t *plen)
+{
+    const uint16_t *pkt = *ppkt;
+    uint16_t len = *plen;
+    uint64_t csum = 0;
+
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+    while (len >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)pkt);
+        acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(v, zero));
+        acc = _mm256_add_epi32(acc, _mm256_unpackhi_epi16(v, zero));
+        pkt += 16;
+        len -= 32;
+    }
+
+    uint32_t lanes[8];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    for (int i = 0; i < 8; i++)
+        csum += lanes[i];
+
+    *ppkt = pkt;
+    *plen = len;
+    return csum;
+}
+#endif
+
+/**
+ * \brief one's complement sum of a buffer
+ *
+ * \param pkt pointer to the data, no alignment required
+ * \param len length of the data in bytes. An odd last byte is padded
+ *            with a zero byte.
+ *
+ * \retval sum folded to 16 bits, not inverted
+ */
+static inline uint16_t ChecksumSum16(const uint16_t *pkt, uint16_t len)
+{
+    uint64_t csum = 0;
+
+#if defined(__AVX2__)
+    if (len >= 32) {
+        csum += ChecksumSum16BlocksAVX2(&pkt, &len);
+    }
+#elif defined(__SSE2__)
+#ifdef CHECKSUM_SUM_AVX2_DISPATCH
+    if (checksum_sum_avx2 && len >= CHECKSUM_SUM_AVX2_MIN_LEN) {
+        csum = ChecksumSum16AVX2(pkt, len);
+        len = 0;
+    }
+#endif
+    /* each 32 bit lane gets at most 2 words per round. With len limited
+     * to 64k this can't overflow. */
+    if (len >= 16) {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = zero;
+        do {
+            __m128i v = _mm_loadu_si128((const __m128i *)pkt);
+            acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(v, zero));
+            acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(v, zero));
+            pkt += 8;
+            len -= 16;
+        } while (len >= 16);
+
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, acc);
+        csum += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+#endif
+    csum += ChecksumSum16Scalar(pkt, len);
+
+    csum = (csum >> 32) + (csum & 0xFFFFFFFF);
+    csum = (csum >> 16) + (csum & 0x0000FFFF);
+    csum = (csum >> 16) + (csum & 0x0000FFFF);
+    csum += (csum >> 16);
+    return (uint16_t)csum;
+}
+
+#endif /* __UTIL_CHECKSUM_SUM_H__ */
@@ -26,6 +26,8 @@
 #include "suricata-common.h"
 
 #include "util-checksum.h"
+#include "util-checksum-sum.h"
+#include "util-unittest.h"
 
 int ReCalculateChecksum(Packet *p)
 {
@@ -91,3 +93,96 @@ int ChecksumAutoModeCheck(uint64_t thread_count,
     }
     return 0;
 }
+
+#ifdef CHECKSUM_SUM_AVX2_DISPATCH
+int checksum_sum_avx2 = 0;
+
+/** \brief unfolded one's complement sum using AVX2, only to be called if
+ *         checksum_sum_avx2 is set */
+__attribute__((target("avx2")))
+uint64_t ChecksumSum16AVX2(const uint16_t *pkt, uint16_t len)
+{
+    uint64_t csum = ChecksumSum16BlocksAVX2(&pkt, &len);
+    return csum + ChecksumSum16Scalar(pkt, len);
+}
+#endif
+
+/**
+ *  \brief pick the ChecksumSum16() implementation for this CPU
+ */
+void ChecksumSumInit(void)
+{
+#ifdef CHECKSUM_SUM_AVX2_DISPATCH
+    __builtin_cpu_init();
+    checksum_sum_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+#endif
+}
+
+#ifdef UNITTESTS
+static uint16_t ChecksumTestSumScalar(const uint16_t *pkt, uint16_t len)
+{
+    uint64_t csum = ChecksumSum16Scalar(pkt, len);
+    csum = (csum >> 32) + (csum & 0xFFFFFFFF);
+    csum = (csum >> 16) + (csum & 0x0000FFFF);
+    csum = (csum >> 16) + (csum & 0x0000FFFF);
+    csum += (csum >> 16);
+    return (uint16_t)csum;
+}
+
+static int ChecksumTestCompare(const uint8_t *buf)
+{
+    uint16_t offset, len;
+    for (offset = 0; offset < 4; offset++) {
+        for (len = 0; len <= 1500; len += (len < 256) ? 1 : 37) {
+            const uint16_t *pkt = (const uint16_t *)(buf + offset);
+            if (ChecksumSum16(pkt, len) != ChecksumTestSumScalar(pkt, len))
+                return 0;
+        }
+    }
+    /* largest length, to cover the lane overflow limits */
+    if (ChecksumSum16((const uint16_t *)(buf + 1), 65535) !=
+            ChecksumTestSumScalar((const uint16_t *)(buf + 1), 65535))
+        return 0;
+    return 1;
+}
+
+/** \test ChecksumSum16() against the scalar sum over odd lengths and
+ *        unaligned offsets, with all bytes 0xff and with random data */
+static int ChecksumSumTest01(void)
+{
+    uint8_t *buf = SCMalloc(65536 + 4);
+    FAIL_IF_NULL(buf);
+
+    memset(buf, 0xff, 65536 + 4);
+    FAIL_IF_NOT(ChecksumTestCompare(buf));
+
+    uint32_t i;
+    uint32_t x = 0x12345678;
+    for (i = 0; i < 65536 + 4; i++) {
+        x = x * 1103515245 + 12345;
+        buf[i] = (uint8_t)(x >> 16);
+    }
+    FAIL_IF_NOT(ChecksumTestCompare(buf));
+
+#ifdef CHECKSUM_SUM_AVX2_DISPATCH
+    /* the other implementation, if this CPU has it */
+    int avx2 = checksum_sum_avx2;
+    if (__builtin_cpu_supports("avx2")) {
+        checksum_sum_avx2 = !avx2;
+        int r = ChecksumTestCompare(buf);
+        checksum_sum_avx2 = avx2;
+        FAIL_IF_NOT(r);
+    }
+#endif
+
+    SCFree(buf);
+    PASS;
+}
+#endif /* UNITTESTS */
+
+void ChecksumRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("ChecksumSumTest01", ChecksumSumTest01);
+#endif
+}
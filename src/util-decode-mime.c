@@ -1442,18 +1442,30 @@ static int ProcessQuotedPrintableBodyLine(const uint8_t *buf, uint32_t len,
 
         c = *(buf + offset);
 
-        /* Copy over normal character */
+        /* Copy over the run of normal characters up to the next escape,
+         * but no more than fits before the chunk has to be flushed */
         if (c != '=') {
-            state->data_chunk[state->data_chunk_len] = c;
-            state->data_chunk_len++;
-            entity->decoded_body_len += 1;
+            const uint8_t *esc = memchr(buf + offset, '=', remaining);
+            uint32_t run = esc ? (uint32_t)(esc - (buf + offset)) : remaining;
+            uint32_t room = DATA_CHUNK_SIZE - state->data_chunk_len;
+            room = room > EOL_LEN ? room - EOL_LEN : 1;
+            if (run > room)
+                run = room;
+
+            memcpy(state->data_chunk + state->data_chunk_len, buf + offset, run);
+            state->data_chunk_len += run;
+            entity->decoded_body_len += run;
 
             /* Add CRLF sequence if end of line */
-            if (remaining == 1) {
+            if (run == remaining) {
                 memcpy(state->data_chunk + state->data_chunk_len, CRLF, EOL_LEN);
                 state->data_chunk_len += EOL_LEN;
                 entity->decoded_body_len += EOL_LEN;
             }
+
+            /* Account for the run, the last character is counted below */
+            remaining -= run - 1;
+            offset += run - 1;
         } else if (remaining > 1) {
             /* If last character handle as soft line break by ignoring,
                        otherwise process as escaped '=' character */
@@ -1523,6 +1535,42 @@ static int ProcessQuotedPrintableBodyLine(const uint8_t *buf, uint32_t len,
     return ret;
 }
 
+/**
+ * \brief Checks whether the body of an entity has a consumer according to
+ * the body flags of the parser state
+ *
+ * \param state The current parser state
+ * \param entity The entity of which the body starts
+ *
+ * \return 1 if the body needs to be processed, 0 if it can be skipped
+ */
+static int BodyIsNeeded(const MimeDecParseState *state,
+        const MimeDecEntity *entity)
+{
+    MimeDecConfig *mdcfg = MimeDecGetConfig();
+
+    if (entity->ctnt_flags & CTNT_IS_ATTACHMENT) {
+        if (state->body_flags & MIME_DEC_BODY_ATTACHMENT)
+            return 1;
+    } else {
+        if (state->body_flags & MIME_DEC_BODY_INLINE)
+            return 1;
+
+        /* Same conditions as the URL extraction in ProcessDecodedDataChunk */
+        if ((state->body_flags & MIME_DEC_BODY_URLS) && mdcfg != NULL &&
+                mdcfg->extract_urls &&
+                (entity->ctnt_flags & (CTNT_IS_TEXT | CTNT_IS_MSG | CTNT_IS_HTML)))
+            return 1;
+    }
+
+    /* Invalid encodings are only found while decoding */
+    if ((state->body_flags & MIME_DEC_BODY_ANOMALY) &&
+            (entity->ctnt_flags & (CTNT_IS_BASE64 | CTNT_IS_QP)))
+        return 1;
+
+    return 0;
+}
+
 /**
  * \brief Processes a body line by base64-decoding (if applicable) and passing to
  * the data chunk processing callback function
@@ -1545,8 +1593,20 @@ static int ProcessBodyLine(const uint8_t *buf, uint32_t len,
     /* Track length */
     entity->body_len += len + 2; /* With CRLF */
 
-    /* Process base-64 content if enabled */
     MimeDecConfig *mdcfg = MimeDecGetConfig();
+
+    /* Nobody needs this body, so only keep track of long encoded lines */
+    if (state->body_skip) {
+        if (len > MAX_ENC_LINE_LEN && mdcfg != NULL &&
+                ((mdcfg->decode_base64 && (entity->ctnt_flags & CTNT_IS_BASE64)) ||
+                 (mdcfg->decode_quoted_printable && (entity->ctnt_flags & CTNT_IS_QP)))) {
+            entity->anomaly_flags |= ANOM_LONG_ENC_LINE;
+            state->msg->anomaly_flags |= ANOM_LONG_ENC_LINE;
+        }
+        return ret;
+    }
+
+    /* Process base-64 content if enabled */
     if (mdcfg != NULL && mdcfg->decode_base64 &&
             (entity->ctnt_flags & CTNT_IS_BASE64)) {
 
@@ -1757,6 +1817,7 @@ static int FindMimeHeader(const uint8_t *buf, uint32_t blen,
         /* Flag beginning of body */
         state->body_begin = 1;
         state->body_end = 0;
+        state->body_skip = !BodyIsNeeded(state, state->stack->top->data);
 
         ret = ProcessBodyLine(buf, blen, state);
         if (ret != MIME_DEC_OK) {
@@ -2060,6 +2121,7 @@ static int ProcessMimeHeaders(const uint8_t *buf, uint32_t len,
         /* Flag beginning of body */
         state->body_begin = 1;
         state->body_end = 0;
+        state->body_skip = !BodyIsNeeded(state, entity);
     }
 
     return ret;
@@ -2101,15 +2163,19 @@ static int ProcessBodyComplete(MimeDecParseState *state)
     }
 #endif
 
-    /* Invoke pre-processor and callback with remaining data */
-    ret = ProcessDecodedDataChunk(state->data_chunk, state->data_chunk_len, state);
-    if (ret != MIME_DEC_OK) {
-        SCLogDebug("Error: ProcessDecodedDataChunk() function failed");
+    /* Invoke pre-processor and callback with remaining data, a skipped body
+     * never reached the callback so it isn't closed either */
+    if (!state->body_skip) {
+        ret = ProcessDecodedDataChunk(state->data_chunk, state->data_chunk_len, state);
+        if (ret != MIME_DEC_OK) {
+            SCLogDebug("Error: ProcessDecodedDataChunk() function failed");
+        }
     }
 
     /* Now reset */
     state->body_begin = 0;
     state->body_end = 0;
+    state->body_skip = 0;
 
     return ret;
 }
@@ -2473,6 +2539,7 @@ MimeDecParseState * MimeDecInitParser(void *data,
     state->state_flag = HEADER_READY;
     state->data = data;
     state->DataChunkProcessorFunc = DataChunkProcessorFunc;
+    state->body_flags = MIME_DEC_BODY_ALL;
 
     return state;
 }
@@ -3142,6 +3209,67 @@ static int MimeDecParseLongFilename02(void)
     PASS;
 }
 
+/* Test that only the bodies with a consumer are decoded */
+static int MimeDecParseSkipBodyTest01(void)
+{
+    const char *lines[] = {
+        "From: Sender1",
+        "Content-Type: multipart/mixed; boundary=\"XX\"",
+        "",
+        "--XX",
+        "Content-Type: text/plain",
+        "",
+        "click on http://www.test.com/malware.exe?",
+        "--XX",
+        "Content-Type: application/octet-stream",
+        "Content-Transfer-Encoding: base64",
+        "Content-Disposition: attachment; filename=\"a.txt\"",
+        "",
+        "bGluZTEKbGluZTIK",
+        "--XX--",
+    };
+    uint32_t line_count = 0;
+
+    MimeDecGetConfig()->decode_base64 = 1;
+    MimeDecGetConfig()->decode_quoted_printable = 1;
+    MimeDecGetConfig()->extract_urls = 1;
+
+    /* Init parser, only attachments have a consumer */
+    MimeDecParseState *state = MimeDecInitParser(&line_count,
+            TestDataChunkCallback);
+    FAIL_IF_NULL(state);
+    state->body_flags = MIME_DEC_BODY_ATTACHMENT;
+
+    for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+        FAIL_IF_NOT(MIME_DEC_OK == MimeDecParseLine((uint8_t *)lines[i],
+                    strlen(lines[i]), 1, state));
+    }
+    FAIL_IF_NOT(MIME_DEC_OK == MimeDecParseComplete(state));
+
+    MimeDecEntity *msg = state->msg;
+    FAIL_IF_NULL(msg->child);
+
+    /* text part is skipped, so no URLs */
+    MimeDecEntity *text = msg->child;
+    FAIL_IF_NOT(text->ctnt_flags & CTNT_IS_TEXT);
+    FAIL_IF_NOT(text->body_len > 0);
+    FAIL_IF_NOT_NULL(text->url_list);
+
+    /* attachment is decoded and passed to the callback */
+    MimeDecEntity *att = text->next;
+    FAIL_IF_NULL(att);
+    FAIL_IF_NOT(att->ctnt_flags & CTNT_IS_ATTACHMENT);
+    FAIL_IF_NOT(att->decoded_body_len == 12);
+    FAIL_IF_NOT(line_count == 2);
+
+    MimeDecFreeEntity(msg);
+
+    /* De Init parser */
+    MimeDecDeInitParser(state);
+
+    PASS;
+}
+
 #endif /* UNITTESTS */
 
 void MimeDecRegisterTests(void)
@@ -3157,5 +3285,6 @@ void MimeDecRegisterTests(void)
     UtRegisterTest("MimeIsIpv6HostTest01", MimeIsIpv6HostTest01);
     UtRegisterTest("MimeDecParseLongFilename01", MimeDecParseLongFilename01);
     UtRegisterTest("MimeDecParseLongFilename02", MimeDecParseLongFilename02);
+    UtRegisterTest("MimeDecParseSkipBodyTest01", MimeDecParseSkipBodyTest01);
 #endif /* UNITTESTS */
 }
@@ -62,6 +62,16 @@
 #define ANOM_LONG_BOUNDARY     128  /* Boundary too long */
 #define ANOM_LONG_FILENAME     256  /* filename truncated */
 
+/* Body Flags: which entity bodies have a consumer. Bodies without one are
+ * not decoded, not scanned for URLs and not passed to the data chunk
+ * callback, the parser only looks for the next boundary. */
+#define MIME_DEC_BODY_ATTACHMENT  1  /* attachments go to the callback */
+#define MIME_DEC_BODY_INLINE      2  /* other bodies go to the callback */
+#define MIME_DEC_BODY_URLS        4  /* text bodies are scanned for URLs */
+#define MIME_DEC_BODY_ANOMALY     8  /* encoded bodies are checked for invalid
+                                      * base64 and quoted-printable data */
+#define MIME_DEC_BODY_ALL        15
+
 /* Publicly exposed size constants */
 #define DATA_CHUNK_SIZE  3072  /* Should be divisible by 3 */
 #define LINEREM_SIZE      256
@@ -207,6 +217,8 @@ typedef struct MimeDecParseState {
     int body_begin;  /**< Currently at beginning of body */
     int body_end;  /**< Currently at end of body */
     uint8_t current_line_delimiter_len; /**< Length of line delimiter */
+    uint8_t body_flags;  /**< Bodies that have a consumer (MIME_DEC_BODY_*) */
+    uint8_t body_skip;  /**< Current body has no consumer and is skipped */
     void *data;  /**< Pointer to data specific to the caller */
     int (*DataChunkProcessorFunc) (const uint8_t *chunk, uint32_t len,
             struct MimeDecParseState *state);  /**< Data chunk processing function callback */
@@ -0,0 +1,397 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Templates for the bucket locked hash tables of the engine: hosts, ip
+ * pairs, defrag trackers and thash, and for the spare queues they and
+ * the flow engine use.
+ *
+ * All of these tables share the same design: an array of rows, each with
+ * its own lock and a doubly linked chain of entries, a locked queue of
+ * spare entries, a memcap and an eviction walk over the rows when the
+ * memcap is reached. The macros in this file generate the code for these
+ * parts, so that it only exists once.
+ *
+ * Entries need the following fields:
+ * - hnext/hprev (names configurable): hash chain pointers
+ * - lnext/lprev (names configurable): queue pointers
+ * - uint32_t hfp: the full hash of the key, the fingerprint
+ *
+ * Rows are declared with HASH_TEMPLATE_ROW_FIELDS and hold the fingerprint
+ * of the chain head, so a lookup that misses a row with a single entry
+ * doesn't have to touch the entry at all.
+ *
+ * The flow hash is out of scope: its lookup handles TCP session reuse,
+ * the next_ts timeout hints and emergency mode, which don't fit the
+ * generic row functions. Only its spare queue uses the queue template.
+ */
+
+#ifndef __UTIL_HASH_TEMPLATE_H__
+#define __UTIL_HASH_TEMPLATE_H__
+
+#include "util-validate.h"
+
+/** \brief row fields: lock, chain head and tail, head fingerprint */
+#define HASH_TEMPLATE_ROW_FIELDS(T, LOCKTYPE)                               \
+    LOCKTYPE lock;                                                          \
+    T *head;                                                                \
+    T *tail;                                                                \
+    uint32_t head_fp;
+
+/**
+ * \brief generate the spare queue functions
+ *
+ * Generates PrefixQueueInit, PrefixQueueDestroy, PrefixEnqueue,
+ * PrefixDequeue and PrefixQueueLen for queue type Q of entries T, using
+ * the LK_INIT, LK_DESTROY, LK_LOCK and LK_UNLOCK lock macros.
+ *
+ * Entries are added at the top and removed from the bottom.
+ */
+#define HASH_TEMPLATE_QUEUE_FUNCS(SCOPE, Prefix, Q, T, lnext, lprev, LK)    \
+SCOPE Q *Prefix##QueueInit(Q *q)                                            \
+{                                                                           \
+    if (q != NULL) {                                                        \
+        memset(q, 0, sizeof(Q));                                            \
+        LK##_INIT(q);                                                       \
+    }                                                                       \
+    return q;                                                               \
+}                                                                           \
+                                                                            \
+SCOPE void Prefix##QueueDestroy(Q *q)                                       \
+{                                                                           \
+    LK##_DESTROY(q);                                                        \
+}                                                                           \
+                                                                            \
+SCOPE void Prefix##Enqueue(Q *q, T *h)                                      \
+{                                                                           \
+    DEBUG_VALIDATE_BUG_ON(q == NULL || h == NULL);                          \
+                                                                            \
+    LK##_LOCK(q);                                                           \
+    if (q->top != NULL) {                                                   \
+        h->lnext = q->top;                                                  \
+        q->top->lprev = h;                                                  \
+        q->top = h;                                                         \
+    } else {                                                                \
+        q->top = h;                                                         \
+        q->bot = h;                                                         \
+    }                                                                       \
+    q->len++;                                                               \
+    HASH_TEMPLATE_QUEUE_DBG_MAXLEN(q);                                      \
+    LK##_UNLOCK(q);                                                         \
+}                                                                           \
+                                                                            \
+SCOPE T *Prefix##Dequeue(Q *q)                                              \
+{                                                                           \
+    LK##_LOCK(q);                                                           \
+    T *h = q->bot;                                                          \
+    if (h == NULL) {                                                        \
+        LK##_UNLOCK(q);                                                     \
+        return NULL;                                                        \
+    }                                                                       \
+    if (q->bot->lprev != NULL) {                                            \
+        q->bot = q->bot->lprev;                                             \
+        q->bot->lnext = NULL;                                               \
+    } else {                                                                \
+        q->top = NULL;                                                      \
+        q->bot = NULL;                                                      \
+    }                                                                       \
+    DEBUG_VALIDATE_BUG_ON(q->len == 0);                                     \
+    if (q->len > 0)                                                         \
+        q->len--;                                                           \
+    h->lnext = NULL;                                                        \
+    h->lprev = NULL;                                                        \
+    LK##_UNLOCK(q);                                                         \
+    return h;                                                               \
+}                                                                           \
+                                                                            \
+SCOPE uint32_t Prefix##QueueLen(Q *q)                                       \
+{                                                                           \
+    LK##_LOCK(q);                                                           \
+    uint32_t len = q->len;                                                  \
+    LK##_UNLOCK(q);                                                         \
+    return len;                                                             \
+}
+
+#ifdef DBG_PERF
+#define HASH_TEMPLATE_QUEUE_DBG_MAXLEN(q)                                   \
+    if ((q)->len > (q)->dbg_maxlen)                                         \
+        (q)->dbg_maxlen = (q)->len
+#else
+#define HASH_TEMPLATE_QUEUE_DBG_MAXLEN(q)
+#endif
+
+/**
+ * \brief generate the row (hash chain) functions
+ *
+ * All of these need to be called with the row locked.
+ *
+ * - PrefixRowAppend: add an entry at the tail of the chain
+ * - PrefixRowRemove: unlink an entry from the chain
+ * - PrefixRowMoveToFront: move an entry to the head, which rewards
+ *   active entries and makes the tail the least recently used one
+ * - PrefixRowFind: find the entry for which Match returns true,
+ *   comparing fingerprints first. A match is moved to the front.
+ */
+#define HASH_TEMPLATE_ROW_FUNCS(Prefix, Row, T, hnext, hprev)               \
+static inline void Prefix##RowSetHead(Row *hb, T *h)                        \
+{                                                                           \
+    hb->head = h;                                                           \
+    hb->head_fp = h ? h->hfp : 0;                                           \
+}                                                                           \
+                                                                            \
+static inline void Prefix##RowAppend(Row *hb, T *h)                         \
+{                                                                           \
+    h->hnext = NULL;                                                        \
+    h->hprev = hb->tail;                                                    \
+    if (hb->tail != NULL)                                                   \
+        hb->tail->hnext = h;                                                \
+    else                                                                    \
+        Prefix##RowSetHead(hb, h);                                          \
+    hb->tail = h;                                                           \
+}                                                                           \
+                                                                            \
+static inline void Prefix##RowRemove(Row *hb, T *h)                         \
+{                                                                           \
+    if (h->hprev != NULL)                                                   \
+        h->hprev->hnext = h->hnext;                                         \
+    if (h->hnext != NULL)                                                   \
+        h->hnext->hprev = h->hprev;                                         \
+    if (hb->head == h)                                                      \
+        Prefix##RowSetHead(hb, h->hnext);                                   \
+    if (hb->tail == h)                                                      \
+        hb->tail = h->hprev;                                                \
+    h->hnext = NULL;                                                        \
+    h->hprev = NULL;                                                        \
+}                                                                           \
+                                                                            \
+static inline void Prefix##RowMoveToFront(Row *hb, T *h)                    \
+{                                                                           \
+    if (hb->head == h)                                                      \
+        return;                                                             \
+    h->hprev->hnext = h->hnext;                                             \
+    if (h->hnext != NULL)                                                   \
+        h->hnext->hprev = h->hprev;                                         \
+    if (hb->tail == h)                                                      \
+        hb->tail = h->hprev;                                                \
+    h->hnext = hb->head;                                                    \
+    h->hprev = NULL;                                                        \
+    hb->head->hprev = h;                                                    \
+    Prefix##RowSetHead(hb, h);                                              \
+}                                                                           \
+                                                                            \
+static inline T *Prefix##RowFind(Row *hb, const uint32_t fp,                \
+        bool (*Match)(const T *, const void *), const void *key)            \
+{                                                                           \
+    T *h = hb->head;                                                        \
+    if (h == NULL)                                                          \
+        return NULL;                                                        \
+    if (hb->head_fp == fp && Match(h, key))                                 \
+        return h;                                                           \
+    for (h = h->hnext; h != NULL; h = h->hnext) {                           \
+        if (h->hfp == fp && Match(h, key)) {                                \
+            Prefix##RowMoveToFront(hb, h);                                  \
+            return h;                                                       \
+        }                                                                   \
+    }                                                                       \
+    return NULL;                                                            \
+}
+
+/**
+ * \brief generate the eviction walk
+ *
+ * Generates PrefixGetUsed(array, size, start, walked), which is used when
+ * the spare queue is empty and the memcap is reached. Starting after row
+ * start it tries the tail, the least recently used entry, of each row.
+ * Rows and entries that are locked by someone else are skipped. Evictable
+ * is called with the entry locked and decides if it can be taken, which
+ * makes the policy pluggable per table.
+ *
+ * The callers keep a "prune_idx" and pass it as start, and add walked to
+ * it afterwards, so that the next walk continues where this one stopped
+ * instead of clearing out the top of the hash over and over.
+ *
+ * \retval h entry, removed from the hash and still *LOCKED*, or NULL
+ */
+#define HASH_TEMPLATE_GET_USED_FUNC(Prefix, Row, T, RL, elock, Evictable)   \
+static T *Prefix##GetUsed(Row *array, const uint32_t size,                  \
+        const uint32_t start, uint32_t *walked)                             \
+{                                                                           \
+    uint32_t idx = start % size;                                            \
+    uint32_t cnt = size;                                                    \
+                                                                            \
+    while (cnt--) {                                                         \
+        if (++idx >= size)                                                  \
+            idx = 0;                                                        \
+                                                                            \
+        Row *hb = &array[idx];                                              \
+        if (RL##_TRYLOCK(hb) != 0)                                          \
+            continue;                                                       \
+                                                                            \
+        T *h = hb->tail;                                                    \
+        if (h == NULL) {                                                    \
+            RL##_UNLOCK(hb);                                                \
+            continue;                                                       \
+        }                                                                   \
+        if (SCMutexTrylock(&h->elock) != 0) {                               \
+            RL##_UNLOCK(hb);                                                \
+            continue;                                                       \
+        }                                                                   \
+        if (!(Evictable(h))) {                                              \
+            RL##_UNLOCK(hb);                                                \
+            SCMutexUnlock(&h->elock);                                       \
+            continue;                                                       \
+        }                                                                   \
+                                                                            \
+        Prefix##RowRemove(hb, h);                                           \
+        RL##_UNLOCK(hb);                                                    \
+        *walked = size - cnt;                                               \
+        return h;                                                           \
+    }                                                                       \
+                                                                            \
+    return NULL;                                                            \
+}
+
+/** memory a thread reserves from a table's memuse in one go */
+#define HASH_TEMPLATE_MEMUSE_BATCH (64 * 1024)
+
+/**
+ * \brief generate batched memuse accounting for a single instance table
+ *
+ * Entry allocations and frees update a thread local credit, and only hit
+ * the shared memuse atomic when HASH_TEMPLATE_MEMUSE_BATCH bytes need to
+ * be reserved or can be returned. Close to the memcap no batch is
+ * reserved, so the memcap is enforced as before, but memuse may report
+ * up to one batch per thread more than is actually allocated.
+ *
+ * The credit is tied to a generation that PrefixMemuseReset bumps, so a
+ * reinitialized table doesn't inherit credits of its previous life. A
+ * thread that took a batch returns its credit when it exits, through a
+ * pthread key destructor. If the key can't be created no batches are
+ * taken.
+ *
+ * Generates PrefixMemuseReset, PrefixMemuseCheck, PrefixMemuseAdd and
+ * PrefixMemuseSub.
+ */
+#ifdef TLS
+#define HASH_TEMPLATE_MEMUSE_FUNCS(Prefix, memuse, memcap)                  \
+static uint32_t Prefix##_memuse_gen = 0;                                    \
+static __thread uint32_t Prefix##_memuse_tgen = 0;                          \
+static __thread uint64_t Prefix##_memuse_credit = 0;                        \
+static pthread_once_t Prefix##_memuse_once = PTHREAD_ONCE_INIT;             \
+static pthread_key_t Prefix##_memuse_key;                                   \
+static bool Prefix##_memuse_key_ok = false;                                 \
+static __thread bool Prefix##_memuse_tkey = false;                          \
+                                                                            \
+static void Prefix##MemuseThreadExit(void *data)                            \
+{                                                                           \
+    uint32_t gen = __atomic_load_n(&Prefix##_memuse_gen, __ATOMIC_RELAXED); \
+    if (Prefix##_memuse_tgen == gen && Prefix##_memuse_credit > 0)          \
+        (void) SC_ATOMIC_SUB(memuse, Prefix##_memuse_credit);               \
+    Prefix##_memuse_credit = 0;                                             \
+}                                                                           \
+                                                                            \
+static void Prefix##MemuseKeyInit(void)                                     \
+{                                                                           \
+    Prefix##_memuse_key_ok = (pthread_key_create(&Prefix##_memuse_key,     \
+                Prefix##MemuseThreadExit) == 0);                            \
+}                                                                           \
+                                                                            \
+/** \retval true if the thread's credit is returned when it exits */        \
+static inline bool Prefix##MemuseThreadRegister(void)                       \
+{                                                                           \
+    if (likely(Prefix##_memuse_tkey))                                       \
+        return true;                                                        \
+    pthread_once(&Prefix##_memuse_once, Prefix##MemuseKeyInit);             \
+    if (!Prefix##_memuse_key_ok ||                                          \
+            pthread_setspecific(Prefix##_memuse_key, (void *)1) != 0)       \
+        return false;                                                       \
+    Prefix##_memuse_tkey = true;                                            \
+    return true;                                                            \
+}                                                                           \
+                                                                            \
+static inline void Prefix##MemuseReset(void)                                \
+{                                                                           \
+    __atomic_add_fetch(&Prefix##_memuse_gen, 1, __ATOMIC_RELAXED);          \
+}                                                                           \
+                                                                            \
+static inline uint64_t Prefix##MemuseCredit(void)                           \
+{                                                                           \
+    uint32_t gen = __atomic_load_n(&Prefix##_memuse_gen, __ATOMIC_RELAXED); \
+    if (unlikely(Prefix##_memuse_tgen != gen)) {                            \
+        Prefix##_memuse_tgen = gen;                                         \
+        Prefix##_memuse_credit = 0;                                         \
+    }                                                                       \
+    return Prefix##_memuse_credit;                                          \
+}                                                                           \
+                                                                            \
+static inline bool Prefix##MemuseCheck(const uint64_t size)                 \
+{                                                                           \
+    if (Prefix##MemuseCredit() >= size)                                     \
+        return true;                                                        \
+    return ((uint64_t)SC_ATOMIC_GET(memuse) + size <=                       \
+            (uint64_t)SC_ATOMIC_GET(memcap));                               \
+}                                                                           \
+                                                                            \
+static inline void Prefix##MemuseAdd(const uint64_t size)                   \
+{                                                                           \
+    if (Prefix##MemuseCredit() >= size) {                                   \
+        Prefix##_memuse_credit -= size;                                     \
+        return;                                                             \
+    }                                                                       \
+    uint64_t batch = size;                                                  \
+    if ((uint64_t)SC_ATOMIC_GET(memuse) + HASH_TEMPLATE_MEMUSE_BATCH <=     \
+            (uint64_t)SC_ATOMIC_GET(memcap) / 2 &&                          \
+            Prefix##MemuseThreadRegister())                                 \
+        batch = MAX(size, HASH_TEMPLATE_MEMUSE_BATCH);                      \
+    (void) SC_ATOMIC_ADD(memuse, batch);                                    \
+    Prefix##_memuse_credit += batch - size;                                 \
+}                                                                           \
+                                                                            \
+static inline void Prefix##MemuseSub(const uint64_t size)                   \
+{                                                                           \
+    Prefix##_memuse_credit = Prefix##MemuseCredit() + size;                 \
+    if (Prefix##_memuse_credit > HASH_TEMPLATE_MEMUSE_BATCH) {              \
+        (void) SC_ATOMIC_SUB(memuse, Prefix##_memuse_credit);               \
+        Prefix##_memuse_credit = 0;                                         \
+    }                                                                       \
+}
+#else
+#define HASH_TEMPLATE_MEMUSE_FUNCS(Prefix, memuse, memcap)                  \
+static inline void Prefix##MemuseReset(void)                                \
+{                                                                           \
+}                                                                           \
+                                                                            \
+static inline bool Prefix##MemuseCheck(const uint64_t size)                 \
+{                                                                           \
+    return ((uint64_t)SC_ATOMIC_GET(memuse) + size <=                       \
+            (uint64_t)SC_ATOMIC_GET(memcap));                               \
+}                                                                           \
+                                                                            \
+static inline void Prefix##MemuseAdd(const uint64_t size)                   \
+{                                                                           \
+    (void) SC_ATOMIC_ADD(memuse, size);                                     \
+}                                                                           \
+                                                                            \
+static inline void Prefix##MemuseSub(const uint64_t size)                   \
+{                                                                           \
+    (void) SC_ATOMIC_SUB(memuse, size);                                     \
+}
+#endif /* TLS */
+
+#endif /* __UTIL_HASH_TEMPLATE_H__ */
@@ -26,17 +26,25 @@
 #include "suricata-common.h"
 #include "app-layer-ssl.h"
 #include "util-validate.h"
+#include "util-hash-lookup3.h"
+#include "util-unittest.h"
 #include "util-ja3.h"
 
-#define MD5_STRING_LENGTH 33
+/** JA3 string formatted on the stack, longer strings use the heap */
+#define JA3_STRING_STACK_SIZE   1024
+
+/** per thread cache of JA3 hashes keyed on the raw fields */
+#define JA3_CACHE_SIZE          64
+#define JA3_CACHE_KEY_MAX       512
 
 /**
+ * \internal
  * \brief Allocate new buffer.
  *
  * \return pointer to buffer on success.
  * \return NULL on failure.
  */
-JA3Buffer *Ja3BufferInit(void)
+static JA3Buffer *Ja3BufferInit(void)
 {
     JA3Buffer *buffer = SCCalloc(1, sizeof(JA3Buffer));
     if (buffer == NULL) {
@@ -65,189 +73,302 @@ void Ja3BufferFree(JA3Buffer **buffer)
 }
 
 /**
- * \internal
- * \brief Resize buffer if it is full.
- *
- * \param buffer The buffer.
- * \param len    The length of the data that should fit into the buffer.
+ * \brief Initialize JA3 fields, using the stack buffer.
  *
- * \retval 0 on success.
- * \retval -1 on failure.
+ * \param fields The fields.
  */
-static int Ja3BufferResizeIfFull(JA3Buffer *buffer, uint32_t len)
+void Ja3FieldsInit(JA3Fields *fields)
 {
-    DEBUG_VALIDATE_BUG_ON(buffer == NULL);
-
-    while (buffer->used + len + 2 > buffer->size)
-    {
-        buffer->size *= 2;
-        char *tmp = SCRealloc(buffer->data, buffer->size * sizeof(char));
-        if (tmp == NULL) {
-            SCLogError(SC_ERR_MEM_ALLOC, "Error resizing JA3 buffer");
-            return -1;
-        }
-        buffer->data = tmp;
-    }
-
-    return 0;
+    fields->data = fields->stack;
+    fields->len = 0;
+    fields->size = sizeof(fields->stack);
+    fields->field = 0;
 }
 
 /**
- * \brief Append buffer to buffer.
- *
- * Append the second buffer to the first and then free it.
+ * \brief Free JA3 fields that outgrew the stack buffer.
  *
- * \param buffer1 The first buffer.
- * \param buffer2 The second buffer.
+ * \param fields The fields.
+ */
+void Ja3FieldsFree(JA3Fields *fields)
+{
+    if (fields->data != fields->stack)
+        SCFree(fields->data);
+    Ja3FieldsInit(fields);
+}
+
+/**
+ * \internal
+ * \brief Make room for len more bytes, moving to the heap if needed.
  *
  * \retval 0 on success.
  * \retval -1 on failure.
  */
-int Ja3BufferAppendBuffer(JA3Buffer **buffer1, JA3Buffer **buffer2)
+static int Ja3FieldsReserve(JA3Fields *fields, uint32_t len)
 {
-    if (*buffer1 == NULL || *buffer2 == NULL) {
-        SCLogError(SC_ERR_INVALID_ARGUMENT, "Buffers should not be NULL");
-        return -1;
-    }
-
-    /* If buffer1 contains no data, then we just copy the second buffer
-       instead of appending its data. */
-    if ((*buffer1)->data == NULL) {
-        (*buffer1)->data = (*buffer2)->data;
-        (*buffer1)->used = (*buffer2)->used;
-        (*buffer1)->size = (*buffer2)->size;
-        SCFree(*buffer2);
+    if (fields->len + len <= fields->size)
         return 0;
-    }
 
-    int rc = Ja3BufferResizeIfFull(*buffer1, (*buffer2)->used);
-    if (rc != 0) {
-        Ja3BufferFree(buffer1);
-        Ja3BufferFree(buffer2);
-        return -1;
-    }
+    uint32_t size = fields->size * 2;
+    while (fields->len + len > size)
+        size *= 2;
 
-    if ((*buffer2)->used == 0) {
-        (*buffer1)->used += snprintf((*buffer1)->data + (*buffer1)->used,
-                                     (*buffer1)->size - (*buffer1)->used, ",");
+    uint8_t *data;
+    if (fields->data == fields->stack) {
+        data = SCMalloc(size);
+        if (data != NULL)
+            memcpy(data, fields->stack, fields->len);
     } else {
-        (*buffer1)->used += snprintf((*buffer1)->data + (*buffer1)->used,
-                                     (*buffer1)->size - (*buffer1)->used, ",%s",
-                                     (*buffer2)->data);
+        data = SCRealloc(fields->data, size);
     }
-
-    Ja3BufferFree(buffer2);
-
+    if (data == NULL) {
+        SCLogError(SC_ERR_MEM_ALLOC, "Error resizing JA3 fields");
+        return -1;
+    }
+    fields->data = data;
+    fields->size = size;
     return 0;
 }
 
 /**
- * \internal
- * \brief Return number of digits in number.
+ * \brief Start a new field.
  *
- * \param num The number.
+ * \param fields The fields.
  *
- * \return digits Number of digits.
+ * \retval 0 on success.
+ * \retval -1 on failure.
  */
-static uint32_t NumberOfDigits(uint32_t num)
+int Ja3FieldsStart(JA3Fields *fields)
 {
-    if (num < 10) {
-        return 1;
-    }
+    if (Ja3FieldsReserve(fields, 2) != 0)
+        return -1;
 
-    return 1 + NumberOfDigits(num / 10);
+    fields->field = fields->len;
+    fields->data[fields->len++] = 0;
+    fields->data[fields->len++] = 0;
+    return 0;
 }
 
 /**
- * \brief Add value to buffer.
+ * \brief Append raw values to the current field.
  *
- * \param buffer The buffer.
- * \param value  The value.
+ * \param fields The fields.
+ * \param data   The values as found on the wire.
+ * \param len    Length of the values.
  *
  * \retval 0 on success.
  * \retval -1 on failure.
  */
-int Ja3BufferAddValue(JA3Buffer **buffer, uint32_t value)
+int Ja3FieldsAppend(JA3Fields *fields, const uint8_t *data, uint32_t len)
 {
-    if (*buffer == NULL) {
-        SCLogError(SC_ERR_INVALID_ARGUMENT, "Buffer should not be NULL");
+    DEBUG_VALIDATE_BUG_ON(fields->len < 2);
+
+    uint32_t field_len = fields->data[fields->field] << 8 |
+                         fields->data[fields->field + 1];
+    if (field_len + len > UINT16_MAX)
+        return -1;
+    if (Ja3FieldsReserve(fields, len) != 0)
         return -1;
-    }
 
-    if ((*buffer)->data == NULL) {
-        (*buffer)->data = SCMalloc(JA3_BUFFER_INITIAL_SIZE * sizeof(char));
-        if ((*buffer)->data == NULL) {
-            SCLogError(SC_ERR_MEM_ALLOC,
-                       "Error allocating memory for JA3 data");
-            Ja3BufferFree(buffer);
-            return -1;
-        }
-        (*buffer)->size = JA3_BUFFER_INITIAL_SIZE;
-    }
+    memcpy(fields->data + fields->len, data, len);
+    fields->len += len;
 
-    uint32_t value_len = NumberOfDigits(value);
+    field_len += len;
+    fields->data[fields->field] = field_len >> 8;
+    fields->data[fields->field + 1] = field_len & 0xff;
+    return 0;
+}
 
-    int rc = Ja3BufferResizeIfFull(*buffer, value_len);
-    if (rc != 0) {
-        Ja3BufferFree(buffer);
-        return -1;
-    }
+/**
+ * \internal
+ * \brief Check if value is GREASE (0x?a?a with equal bytes).
+ *
+ * http://tools.ietf.org/html/draft-davidben-tls-grease-00
+ */
+static inline bool Ja3IsGREASE(const uint16_t value)
+{
+    return (value & 0x0f0f) == 0x0a0a && (value >> 8) == (value & 0xff);
+}
 
-    if ((*buffer)->used == 0) {
-        (*buffer)->used += snprintf((*buffer)->data, (*buffer)->size, "%d",
-                                    value);
-    }
-    else {
-        (*buffer)->used += snprintf((*buffer)->data + (*buffer)->used,
-                                    (*buffer)->size - (*buffer)->used, "-%d",
-                                    value);
+/**
+ * \internal
+ * \brief Format the JA3 string of the raw fields.
+ *
+ * Writes at most size - 1 characters and a terminating NUL.
+ *
+ * \param data Raw fields.
+ * \param len  Length of the raw fields.
+ * \param buf  Output buffer.
+ * \param size Size of the output buffer.
+ *
+ * \return length of the full JA3 string, which can be larger than size.
+ */
+static uint32_t Ja3FieldsFormat(const uint8_t *data, uint32_t len,
+                                char *buf, uint32_t size)
+{
+    uint32_t out = 0;
+    uint32_t offset = 0;
+
+#define JA3_PUT(c) do {             \
+        const char _c = (c);        \
+        if (out + 1 < size)         \
+            buf[out] = _c;          \
+        out++;                      \
+    } while (0)
+
+    for (int field = 0; offset + 2 <= len; field++) {
+        const uint32_t field_len = data[offset] << 8 | data[offset + 1];
+        offset += 2;
+        if (field_len > len - offset)
+            break;
+
+        /* point formats are single bytes, the other fields 16 bit */
+        const uint32_t width = (field == 4) ? 1 : 2;
+
+        if (field > 0)
+            JA3_PUT(',');
+
+        bool first = true;
+        for (uint32_t i = 0; i + width <= field_len; i += width) {
+            const uint8_t *v = data + offset + i;
+            uint16_t value = (width == 2) ? (v[0] << 8 | v[1]) : v[0];
+
+            /* the version is never GREASE filtered */
+            if (field > 0 && Ja3IsGREASE(value))
+                continue;
+
+            if (!first)
+                JA3_PUT('-');
+            first = false;
+
+            char digits[5];
+            int n = 0;
+            do {
+                digits[n++] = '0' + (value % 10);
+                value /= 10;
+            } while (value != 0);
+            while (n > 0)
+                JA3_PUT(digits[--n]);
+        }
+        offset += field_len;
     }
+#undef JA3_PUT
 
-    return 0;
+    if (size > 0)
+        buf[out < size ? out : size - 1] = '\0';
+    return out;
 }
 
 /**
- * \brief Generate Ja3 hash string.
+ * \brief Build a JA3 string buffer from the raw fields.
  *
- * \param buffer The Ja3 buffer.
+ * \param data Raw fields.
+ * \param len  Length of the raw fields.
  *
- * \retval pointer to hash string on success.
+ * \retval pointer to buffer on success.
  * \retval NULL on failure.
  */
-char *Ja3GenerateHash(JA3Buffer *buffer)
+JA3Buffer *Ja3FieldsToBuffer(const uint8_t *data, uint32_t len)
 {
+    const uint32_t str_len = Ja3FieldsFormat(data, len, NULL, 0);
 
-#ifdef HAVE_NSS
-    if (buffer == NULL) {
-        SCLogError(SC_ERR_INVALID_ARGUMENT, "Buffer should not be NULL");
+    JA3Buffer *buffer = Ja3BufferInit();
+    if (buffer == NULL)
         return NULL;
-    }
 
+    buffer->data = SCMalloc(str_len + 1);
     if (buffer->data == NULL) {
-        SCLogError(SC_ERR_INVALID_VALUE, "Buffer data should not be NULL");
+        Ja3BufferFree(&buffer);
         return NULL;
     }
+    buffer->size = str_len + 1;
+    buffer->used = Ja3FieldsFormat(data, len, buffer->data, buffer->size);
+    return buffer;
+}
 
-    char *ja3_hash = SCMalloc(MD5_STRING_LENGTH * sizeof(char));
-    if (ja3_hash == NULL) {
-        SCLogError(SC_ERR_MEM_ALLOC,
-                   "Error allocating memory for JA3 hash");
-        return NULL;
+#ifdef HAVE_NSS
+static void Ja3FieldsHashString(const uint8_t *data, uint32_t len, char *hash)
+{
+    char stack[JA3_STRING_STACK_SIZE];
+    char *str = stack;
+
+    uint32_t str_len = Ja3FieldsFormat(data, len, stack, sizeof(stack));
+    if (str_len >= sizeof(stack)) {
+        str = SCMalloc(str_len + 1);
+        if (str == NULL) {
+            hash[0] = '\0';
+            return;
+        }
+        (void)Ja3FieldsFormat(data, len, str, str_len + 1);
     }
 
     unsigned char md5[MD5_LENGTH];
-    HASH_HashBuf(HASH_AlgMD5, md5, (unsigned char *)buffer->data, buffer->used);
+    HASH_HashBuf(HASH_AlgMD5, md5, (unsigned char *)str, str_len);
 
-    int i, x;
-    for (i = 0, x = 0; x < MD5_LENGTH; x++) {
-        i += snprintf(ja3_hash + i, MD5_STRING_LENGTH - i, "%02x", md5[x]);
+    static const char hex[] = "0123456789abcdef";
+    for (int x = 0; x < MD5_LENGTH; x++) {
+        hash[x * 2] = hex[md5[x] >> 4];
+        hash[x * 2 + 1] = hex[md5[x] & 0x0f];
     }
+    hash[MD5_LENGTH * 2] = '\0';
 
-    return ja3_hash;
-#else
-    return NULL;
+    if (str != stack)
+        SCFree(str);
+}
+
+#ifdef TLS
+typedef struct Ja3CacheEntry_ {
+    uint32_t key_hash;
+    uint32_t key_len;
+    char hash[JA3_HASH_STRING_LENGTH];
+    uint8_t key[JA3_CACHE_KEY_MAX];
+} Ja3CacheEntry;
+
+/** Clients send the same hellos over and over, so the last hashes are
+ *  kept per thread. Lock free as each thread has its own. */
+static __thread Ja3CacheEntry ja3_cache[JA3_CACHE_SIZE];
+#endif
 #endif /* HAVE_NSS */
 
+/**
+ * \brief Generate JA3 hash string from the raw fields.
+ *
+ * \param data Raw fields.
+ * \param len  Length of the raw fields.
+ * \param hash Output buffer of JA3_HASH_STRING_LENGTH bytes.
+ *
+ * \retval 0 on success.
+ * \retval -1 on failure.
+ */
+int Ja3FieldsGenerateHash(const uint8_t *data, uint32_t len, char *hash)
+{
+#ifdef HAVE_NSS
+#ifdef TLS
+    if (len <= JA3_CACHE_KEY_MAX) {
+        const uint32_t key_hash = hashlittle_safe(data, len, 0);
+        Ja3CacheEntry *e = &ja3_cache[key_hash % JA3_CACHE_SIZE];
+        if (e->key_len == len && e->key_hash == key_hash &&
+                memcmp(e->key, data, len) == 0) {
+            memcpy(hash, e->hash, JA3_HASH_STRING_LENGTH);
+            return 0;
+        }
+
+        Ja3FieldsHashString(data, len, hash);
+        if (hash[0] == '\0')
+            return -1;
+
+        e->key_hash = key_hash;
+        e->key_len = len;
+        memcpy(e->key, data, len);
+        memcpy(e->hash, hash, JA3_HASH_STRING_LENGTH);
+        return 0;
+    }
+#endif
+    Ja3FieldsHashString(data, len, hash);
+    return (hash[0] == '\0') ? -1 : 0;
+#else
+    return -1;
+#endif /* HAVE_NSS */
 }
 
 /**
@@ -284,3 +405,143 @@ int Ja3IsDisabled(const char *type)
 
     return 0;
 }
+
+#ifdef UNITTESTS
+
+/** \test JA3 string of raw client hello fields */
+static int Ja3FieldsTest01(void)
+{
+    JA3Fields fields;
+    Ja3FieldsInit(&fields);
+
+    const uint8_t version[] = { 0x03, 0x03 };
+    /* GREASE, 4865, 49195 */
+    const uint8_t ciphers[] = { 0x1a, 0x1a, 0x13, 0x01, 0xc0, 0x2b };
+    const uint8_t ext1[] = { 0x00, 0x00 };
+    const uint8_t ext2[] = { 0xba, 0xba };
+    const uint8_t ext3[] = { 0x00, 0x0a };
+    const uint8_t curves[] = { 0x00, 0x1d, 0x00, 0x17 };
+    const uint8_t pf[] = { 0x00 };
+
+    FAIL_IF(Ja3FieldsStart(&fields) != 0);
+    FAIL_IF(Ja3FieldsAppend(&fields, version, sizeof(version)) != 0);
+    FAIL_IF(Ja3FieldsStart(&fields) != 0);
+    FAIL_IF(Ja3FieldsAppend(&fields, ciphers, sizeof(ciphers)) != 0);
+    FAIL_IF(Ja3FieldsStart(&fields) != 0);
+    FAIL_IF(Ja3FieldsAppend(&fields, ext1, sizeof(ext1)) != 0);
+    FAIL_IF(Ja3FieldsAppend(&fields, ext2, sizeof(ext2)) != 0);
+    FAIL_IF(Ja3FieldsAppend(&fields, ext3, sizeof(ext3)) != 0);
+    FAIL_IF(Ja3FieldsStart(&fields) != 0);
+    FAIL_IF(Ja3FieldsAppend(&fields, curves, sizeof(curves)) != 0);
+    FAIL_IF(Ja3FieldsStart(&fields) != 0);
+    FAIL_IF(Ja3FieldsAppend(&fields, pf, sizeof(pf)) != 0);
+
+    JA3Buffer *buffer = Ja3FieldsToBuffer(fields.data, fields.len);
+    FAIL_IF_NULL(buffer);
+    FAIL_IF(strcmp(buffer->data, "771,4865-49195,0-10,29-23,0") != 0);
+    FAIL_IF(buffer->used != strlen(buffer->data));
+    Ja3BufferFree(&buffer);
+
+    /* empty fields */
+    Ja3FieldsFree(&fields);
+    FAIL_IF(Ja3FieldsStart(&fields) != 0);
+    FAIL_IF(Ja3FieldsAppend(&fields, version, sizeof(version)) != 0);
+    FAIL_IF(Ja3FieldsStart(&fields) != 0);
+    FAIL_IF(Ja3FieldsStart(&fields) != 0);
+    buffer = Ja3FieldsToBuffer(fields.data, fields.len);
+    FAIL_IF_NULL(buffer);
+    FAIL_IF(strcmp(buffer->data, "771,,") != 0);
+    Ja3BufferFree(&buffer);
+
+    Ja3FieldsFree(&fields);
+    PASS;
+}
+
+/** \test fields growing out of the stack buffer */
+static int Ja3FieldsTest02(void)
+{
+    JA3Fields fields;
+    Ja3FieldsInit(&fields);
+
+    const uint8_t version[] = { 0x03, 0x03 };
+    const uint8_t cipher[] = { 0x00, 0x01 };
+
+    FAIL_IF(Ja3FieldsStart(&fields) != 0);
+    FAIL_IF(Ja3FieldsAppend(&fields, version, sizeof(version)) != 0);
+    FAIL_IF(Ja3FieldsStart(&fields) != 0);
+    for (int i = 0; i < 1000; i++) {
+        FAIL_IF(Ja3FieldsAppend(&fields, cipher, sizeof(cipher)) != 0);
+    }
+    FAIL_IF(fields.data == fields.stack);
+    FAIL_IF(fields.len != 2 + 2 + 2 + 2000);
+
+    JA3Buffer *buffer = Ja3FieldsToBuffer(fields.data, fields.len);
+    FAIL_IF_NULL(buffer);
+    /* "771," and 1000 times "1" separated by '-' */
+    FAIL_IF(buffer->used != 4 + 1000 + 999);
+    Ja3BufferFree(&buffer);
+
+#ifdef HAVE_NSS
+    char hash1[JA3_HASH_STRING_LENGTH];
+    char hash2[JA3_HASH_STRING_LENGTH];
+    FAIL_IF(Ja3FieldsGenerateHash(fields.data, fields.len, hash1) != 0);
+    FAIL_IF(strlen(hash1) != 32);
+    FAIL_IF(Ja3FieldsGenerateHash(fields.data, fields.len, hash2) != 0);
+    FAIL_IF(strcmp(hash1, hash2) != 0);
+#endif
+
+    Ja3FieldsFree(&fields);
+    PASS;
+}
+
+#ifdef HAVE_NSS
+/** \test hash matches the hash of the string, also when cached */
+static int Ja3FieldsTest03(void)
+{
+    JA3Fields fields;
+    Ja3FieldsInit(&fields);
+
+    const uint8_t version[] = { 0x03, 0x01 };
+    const uint8_t ciphers[] = { 0x00, 0x2f, 0x00, 0x35 };
+
+    FAIL_IF(Ja3FieldsStart(&fields) != 0);
+    FAIL_IF(Ja3FieldsAppend(&fields, version, sizeof(version)) != 0);
+    FAIL_IF(Ja3FieldsStart(&fields) != 0);
+    FAIL_IF(Ja3FieldsAppend(&fields, ciphers, sizeof(ciphers)) != 0);
+    FAIL_IF(Ja3FieldsStart(&fields) != 0);
+
+    JA3Buffer *buffer = Ja3FieldsToBuffer(fields.data, fields.len);
+    FAIL_IF_NULL(buffer);
+    FAIL_IF(strcmp(buffer->data, "769,47-53,") != 0);
+
+    unsigned char md5[MD5_LENGTH];
+    HASH_HashBuf(HASH_AlgMD5, md5, (unsigned char *)buffer->data, buffer->used);
+    char expect[JA3_HASH_STRING_LENGTH];
+    for (int i = 0, x = 0; x < MD5_LENGTH; x++) {
+        i += snprintf(expect + i, sizeof(expect) - i, "%02x", md5[x]);
+    }
+
+    for (int i = 0; i < 2; i++) {
+        char hash[JA3_HASH_STRING_LENGTH];
+        FAIL_IF(Ja3FieldsGenerateHash(fields.data, fields.len, hash) != 0);
+        FAIL_IF(strcmp(hash, expect) != 0);
+    }
+
+    Ja3BufferFree(&buffer);
+    Ja3FieldsFree(&fields);
+    PASS;
+}
+#endif
+
+#endif /* UNITTESTS */
+
+void Ja3RegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("Ja3FieldsTest01", Ja3FieldsTest01);
+    UtRegisterTest("Ja3FieldsTest02", Ja3FieldsTest02);
+#ifdef HAVE_NSS
+    UtRegisterTest("Ja3FieldsTest03", Ja3FieldsTest03);
+#endif
+#endif /* UNITTESTS */
+}
@@ -24,20 +24,43 @@
 #ifndef __UTIL_JA3_H__
 #define __UTIL_JA3_H__
 
-#define JA3_BUFFER_INITIAL_SIZE 128
-
 typedef struct JA3Buffer_ {
     char *data;
     size_t size;
     size_t used;
 } JA3Buffer;
 
-JA3Buffer *Ja3BufferInit(void);
+/** JA3 fields collected from a hello on the stack, before they are
+ *  moved to the state. */
+#define JA3_FIELDS_STACK_SIZE 512
+
+#define JA3_HASH_STRING_LENGTH 33
+
+/** Raw JA3 fields of a client or server hello.
+ *
+ *  Each field is a 16 bit length followed by the values as they appear on
+ *  the wire, GREASE values included: version, cipher suites, extension
+ *  types and for client hellos the elliptic curves and point formats.
+ *  The JA3 string is only built from them when it's needed. */
+typedef struct JA3Fields_ {
+    uint8_t *data;
+    uint32_t len;
+    uint32_t size;
+    /** offset of the length of the field that is being added */
+    uint32_t field;
+    uint8_t stack[JA3_FIELDS_STACK_SIZE];
+} JA3Fields;
+
+void Ja3FieldsInit(JA3Fields *);
+void Ja3FieldsFree(JA3Fields *);
+int Ja3FieldsStart(JA3Fields *);
+int Ja3FieldsAppend(JA3Fields *, const uint8_t *, uint32_t);
+int Ja3FieldsGenerateHash(const uint8_t *, uint32_t, char *);
+JA3Buffer *Ja3FieldsToBuffer(const uint8_t *, uint32_t);
+
 void Ja3BufferFree(JA3Buffer **);
-int Ja3BufferAppendBuffer(JA3Buffer **, JA3Buffer **);
-int Ja3BufferAddValue(JA3Buffer **, uint32_t);
-char *Ja3GenerateHash(JA3Buffer *);
 int Ja3IsDisabled(const char *);
+void Ja3RegisterTests(void);
 
 #endif /* __UTIL_JA3_H__ */
 
@@ -26,6 +26,11 @@
 #include "suricata-common.h" /* errno.h, string.h, etc. */
 #include "util-log-redis.h"
 #include "util-logopenfile.h"
+#include "util-atomic.h"
+#include "util-unittest.h"
+#include "util-privs.h"
+#include "counters.h"
+#include "tm-threads.h"
 
 #ifdef HAVE_LIBHIREDIS
 
@@ -36,8 +41,30 @@
 static const char * redis_lpush_cmd = "LPUSH";
 static const char * redis_rpush_cmd = "RPUSH";
 static const char * redis_publish_cmd = "PUBLISH";
+static const char * redis_xadd_cmd = "XADD";
 static const char * redis_default_key = "suricata";
 static const char * redis_default_server = "127.0.0.1";
+/** field holding the record in stream mode */
+static const char * redis_stream_field = "event";
+
+/** default max time in ms a record waits in the pipeline */
+#define REDIS_DEFAULT_FLUSH_INTERVAL    1000
+/** max arguments of a single record command:
+ *  XADD key MAXLEN ~ <len> * event <record> */
+#define REDIS_RECORD_MAX_ARGC           8
+
+/* output counters, shared by all redis outputs */
+SC_ATOMIC_DECLARE(uint64_t, redis_records);
+SC_ATOMIC_DECLARE(uint64_t, redis_batches);
+SC_ATOMIC_DECLARE(uint64_t, redis_pending);
+SC_ATOMIC_DECLARE(uint64_t, redis_dropped);
+
+/* sync outputs with a flush interval, see SCLogRedisFlushThread() */
+static LogFileCtx **redis_flush_outputs = NULL;
+static int redis_flush_outputs_cnt = 0;
+/** time in ms the flush thread sleeps between checks */
+static int redis_flush_wait = 0;
+static SCMutex redis_flush_lock = SCMUTEX_INITIALIZER;
 
 static int SCConfLogReopenSyncRedis(LogFileCtx *log_ctx);
 static void SCLogFileCloseRedis(LogFileCtx *log_ctx);
@@ -52,9 +79,64 @@ void SCLogRedisInit()
 #endif /* HAVE_LIBEVENT_PTHREADS */
 }
 
+static uint64_t SCLogRedisGetRecords(void)
+{
+    return SC_ATOMIC_GET(redis_records);
+}
+
+static uint64_t SCLogRedisGetBatches(void)
+{
+    return SC_ATOMIC_GET(redis_batches);
+}
+
+static uint64_t SCLogRedisGetPending(void)
+{
+    return SC_ATOMIC_GET(redis_pending);
+}
+
+static uint64_t SCLogRedisGetDropped(void)
+{
+    return SC_ATOMIC_GET(redis_dropped);
+}
+
+/** \brief register the redis output counters
+ *
+ *  records: records acknowledged by the server
+ *  batches: pipelined batches sent
+ *  pending: records waiting in the pipeline
+ *  dropped: records lost to errors or an unavailable server
+ */
+static void SCLogRedisRegisterCounters(void)
+{
+    StatsRegisterGlobalCounter("redis.records", SCLogRedisGetRecords);
+    StatsRegisterGlobalCounter("redis.batches", SCLogRedisGetBatches);
+    StatsRegisterGlobalCounter("redis.pending", SCLogRedisGetPending);
+    StatsRegisterGlobalCounter("redis.dropped", SCLogRedisGetDropped);
+}
+
+/** \brief SCLogRedisBatchAlloc() - Allocates the batch and command buffers
+ */
+static void SCLogRedisBatchAlloc(SCLogRedisContext *ctx, const RedisSetup *setup)
+{
+    const int batch_size = MAX(setup->batch_size, 1);
+    const int argc = MAX(batch_size + 2, REDIS_RECORD_MAX_ARGC);
+
+    ctx->batch_lens = SCCalloc(batch_size, sizeof(size_t));
+    ctx->argv = SCCalloc(argc, sizeof(char *));
+    ctx->argvlen = SCCalloc(argc, sizeof(size_t));
+    if (ctx->batch_lens == NULL || ctx->argv == NULL || ctx->argvlen == NULL) {
+        SCLogError(SC_ERR_MEM_ALLOC, "Unable to allocate redis batch");
+        exit(EXIT_FAILURE);
+    }
+    if (setup->stream_maxlen > 0) {
+        snprintf(ctx->stream_maxlen, sizeof(ctx->stream_maxlen), "%"PRIu64,
+                setup->stream_maxlen);
+    }
+}
+
 /** \brief SCLogRedisContextAlloc() - Allocates and initalizes redis context
  */
-static SCLogRedisContext *SCLogRedisContextAlloc(void)
+static SCLogRedisContext *SCLogRedisContextAlloc(const RedisSetup *setup)
 {
     SCLogRedisContext* ctx = (SCLogRedisContext*) SCCalloc(1, sizeof(SCLogRedisContext));
     if (ctx == NULL) {
@@ -68,10 +150,59 @@ static SCLogRedisContext *SCLogRedisContextAlloc(void)
 #endif
     ctx->batch_count = 0;
     ctx->tried = 0;
+    SCLogRedisBatchAlloc(ctx, setup);
 
     return ctx;
 }
 
+static void SCLogRedisContextFree(SCLogRedisContext *ctx)
+{
+    if (ctx->batch_buf != NULL)
+        SCFree(ctx->batch_buf);
+    if (ctx->batch_lens != NULL)
+        SCFree(ctx->batch_lens);
+    if (ctx->argv != NULL)
+        SCFree(ctx->argv);
+    if (ctx->argvlen != NULL)
+        SCFree(ctx->argvlen);
+    SCFree(ctx);
+}
+
+/** \internal
+ *  \brief fill in the command vector to send a single record
+ *  \retval argc number of arguments in the vector
+ */
+static int SCLogRedisRecordArgv(const LogFileCtx *file_ctx, const char **argv,
+        size_t *argvlen, const char *string, size_t string_len)
+{
+    const RedisSetup *setup = &file_ctx->redis_setup;
+    const SCLogRedisContext *ctx = file_ctx->redis;
+    int argc = 0;
+
+    argv[argc] = setup->command;
+    argvlen[argc++] = strlen(setup->command);
+    argv[argc] = setup->key;
+    argvlen[argc++] = strlen(setup->key);
+    if (setup->mode == REDIS_STREAM) {
+        if (setup->stream_maxlen > 0) {
+            argv[argc] = "MAXLEN";
+            argvlen[argc++] = 6;
+            argv[argc] = "~";
+            argvlen[argc++] = 1;
+            argv[argc] = ctx->stream_maxlen;
+            argvlen[argc++] = strlen(ctx->stream_maxlen);
+        }
+        /* let the server assign the entry id */
+        argv[argc] = "*";
+        argvlen[argc++] = 1;
+        argv[argc] = redis_stream_field;
+        argvlen[argc++] = strlen(redis_stream_field);
+    }
+    argv[argc] = string;
+    argvlen[argc++] = string_len;
+    return argc;
+}
+
 #ifdef HAVE_LIBEVENT
 
 static int SCConfLogReopenAsyncRedis(LogFileCtx *log_ctx);
@@ -79,7 +210,7 @@ static int SCConfLogReopenAsyncRedis(LogFileCtx *log_ctx);
 
 /** \brief SCLogRedisAsyncContextAlloc() - Allocates and initalizes redis context with async
  */
-static SCLogRedisContext *SCLogRedisContextAsyncAlloc(void)
+static SCLogRedisContext *SCLogRedisContextAsyncAlloc(const RedisSetup *setup)
 {
     SCLogRedisContext* ctx = (SCLogRedisContext*) SCCalloc(1, sizeof(SCLogRedisContext));
     if (unlikely(ctx == NULL)) {
@@ -93,6 +224,7 @@ static SCLogRedisContext *SCLogRedisContextAsyncAlloc(void)
     ctx->connected = 0;
     ctx->batch_count = 0;
     ctx->tried = 0;
+    SCLogRedisBatchAlloc(ctx, setup);
 
     return ctx;
 }
@@ -112,8 +244,14 @@ static void SCRedisAsyncCommandCallback(redisAsyncContext *ac, void *r, void *pr
         if (ctx->connected > 0)
             SCLogInfo("Missing reply from redis, disconnected.");
         ctx->connected = 0;
+        (void) SC_ATOMIC_ADD(redis_dropped, 1);
     } else {
         ctx->connected = 1;
+        if (reply->type == REDIS_REPLY_ERROR) {
+            (void) SC_ATOMIC_ADD(redis_dropped, 1);
+        } else {
+            (void) SC_ATOMIC_ADD(redis_records, 1);
+        }
         event_base_loopbreak(ctx->ev_base);
     }
 }
@@ -246,6 +384,7 @@ static int SCLogRedisWriteAsync(LogFileCtx *file_ctx, const char *string, size_t
 
     if (! ctx->connected) {
         if (SCConfLogReopenAsyncRedis(file_ctx) == -1) {
+            (void) SC_ATOMIC_ADD(redis_dropped, 1);
             return -1;
         }
         if (ctx->tried == 0) {
@@ -254,21 +393,17 @@ static int SCLogRedisWriteAsync(LogFileCtx *file_ctx, const char *string, size_t
         SCLogAsyncRedisSendEcho(ctx);
     }
 
-    if (!ctx->connected) {
-        return -1;
-    }
-
-    if (ctx->async == NULL) {
+    if (!ctx->connected || ctx->async == NULL) {
+        (void) SC_ATOMIC_ADD(redis_dropped, 1);
         return -1;
     }
 
-    redisAsyncCommand(ctx->async,
+    int argc = SCLogRedisRecordArgv(file_ctx, ctx->argv, ctx->argvlen,
+            string, string_len);
+    redisAsyncCommandArgv(ctx->async,
             SCRedisAsyncCommandCallback,
             file_ctx,
-            "%s %s %s",
-            file_ctx->redis_setup.command,
-            file_ctx->redis_setup.key,
-            string);
+            argc, ctx->argv, ctx->argvlen);
 
     event_base_loop(ctx->ev_base, EVLOOP_NONBLOCK);
 
@@ -314,98 +449,339 @@ static int SCConfLogReopenSyncRedis(LogFileCtx *log_ctx)
     log_ctx->Close = SCLogFileCloseRedis;
     return 0;
 }
-/** \brief SCLogRedisWriteSync() writes string to redis output in sync mode
+/** \internal
+ *  \brief empty the batch, accounting records that were not acknowledged
+ *         as dropped
+ */
+static void SCLogRedisBatchReset(SCLogRedisContext *ctx, int acked)
+{
+    (void) SC_ATOMIC_SUB(redis_pending, ctx->batch_count);
+    (void) SC_ATOMIC_ADD(redis_records, acked);
+    (void) SC_ATOMIC_ADD(redis_dropped, ctx->batch_count - acked);
+    ctx->batch_count = 0;
+    ctx->batch_buf_len = 0;
+}
+
+/** \internal
+ *  \brief copy a record into the batch
+ *  \retval 0 ok
+ *  \retval -1 out of memory, record is dropped
+ */
+static int SCLogRedisBatchAppend(SCLogRedisContext *ctx, const char *string,
+        size_t string_len)
+{
+    if (ctx->batch_buf_len + string_len > ctx->batch_buf_size) {
+        size_t size = MAX(ctx->batch_buf_size * 2, ctx->batch_buf_len + string_len);
+        char *buf = SCRealloc(ctx->batch_buf, size);
+        if (unlikely(buf == NULL)) {
+            return -1;
+        }
+        ctx->batch_buf = buf;
+        ctx->batch_buf_size = size;
+    }
+    if (ctx->batch_count == 0) {
+        gettimeofday(&ctx->batch_start, NULL);
+    }
+    memcpy(ctx->batch_buf + ctx->batch_buf_len, string, string_len);
+    ctx->batch_buf_len += string_len;
+    ctx->batch_lens[ctx->batch_count++] = string_len;
+    (void) SC_ATOMIC_ADD(redis_pending, 1);
+    return 0;
+}
+
+/** \internal
+ *  \brief check if the oldest record waited longer than the flush interval
+ */
+static int SCLogRedisFlushDue(const LogFileCtx *file_ctx)
+{
+    const SCLogRedisContext *ctx = file_ctx->redis;
+    struct timeval now;
+
+    if (file_ctx->redis_setup.flush_interval == 0 || ctx->batch_count == 0)
+        return 0;
+
+    gettimeofday(&now, NULL);
+    int64_t elapsed = (int64_t)(now.tv_sec - ctx->batch_start.tv_sec) * 1000 +
+        (now.tv_usec - ctx->batch_start.tv_usec) / 1000;
+    return elapsed >= file_ctx->redis_setup.flush_interval;
+}
+
+/** \brief SCLogRedisFlushSync() sends the batched records and reads the replies
+ *
+ *  In list mode the whole batch goes out as a single variadic LPUSH or
+ *  RPUSH, which is atomic on the server side without MULTI. Channels and
+ *  streams take a single record per command, so those are pipelined: all
+ *  commands are written before the first reply is read. Either way there
+ *  is a single round trip per batch.
+ *
  *  \param file_ctx Log file context allocated by caller
- *  \param string Buffer to output
+ *  \retval 0 all records were acknowledged
+ *  \retval -1 some or all of the records were dropped
  */
-static int SCLogRedisWriteSync(LogFileCtx *file_ctx, const char *string)
+static int SCLogRedisFlushSync(LogFileCtx *file_ctx)
 {
-    SCLogRedisContext * ctx = file_ctx->redis;
-    int ret = -1;
-    redisContext *redis = ctx->sync;
-    if (redis == NULL) {
+    SCLogRedisContext *ctx = file_ctx->redis;
+    const RedisSetup *setup = &file_ctx->redis_setup;
+    const int count = ctx->batch_count;
+    int replies = 0;
+    int per_reply = 0;
+    int acked = 0;
+    int ret = 0;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    if (ctx->sync == NULL) {
         SCConfLogReopenSyncRedis(file_ctx);
-        redis = ctx->sync;
-        if (redis == NULL) {
+        if (ctx->sync == NULL) {
             SCLogDebug("Redis after re-open is not available.");
+            SCLogRedisBatchReset(ctx, 0);
             return -1;
         }
     }
 
-    /* synchronous mode */
-    if (file_ctx->redis_setup.batch_size) {
-        redisAppendCommand(redis, "%s %s %s",
-                file_ctx->redis_setup.command,
-                file_ctx->redis_setup.key,
-                string);
-        if (ctx->batch_count == file_ctx->redis_setup.batch_size) {
-            redisReply *reply;
-            int i;
-            ctx->batch_count = 0;
-            for (i = 0; i <= file_ctx->redis_setup.batch_size; i++) {
-                if (redisGetReply(redis, (void **)&reply) == REDIS_OK) {
-                    freeReplyObject(reply);
-                    ret = 0;
-                } else {
-                    if (redis->err) {
-                        SCLogInfo("Error when fetching reply: %s (%d)",
-                                redis->errstr,
-                                redis->err);
-                    }
-                    switch (redis->err) {
-                        case REDIS_ERR_EOF:
-                        case REDIS_ERR_IO:
-                            SCLogInfo("Reopening connection to redis server");
-                            SCConfLogReopenSyncRedis(file_ctx);
-                            redis = ctx->sync;
-                            if (redis) {
-                                SCLogInfo("Reconnected to redis server");
-                            } else {
-                                SCLogInfo("Unable to reconnect to redis server");
-                                return -1;
-                            }
-                            break;
-                        default:
-                            SCLogWarning(SC_ERR_INVALID_VALUE,
-                                    "Unsupported error code %d",
-                                    redis->err);
-                            return -1;
-                    }
-                }
-            }
-        } else {
-            ctx->batch_count++;
+    size_t offset = 0;
+    if (setup->mode == REDIS_LIST) {
+        ctx->argv[0] = setup->command;
+        ctx->argvlen[0] = strlen(setup->command);
+        ctx->argv[1] = setup->key;
+        ctx->argvlen[1] = strlen(setup->key);
+        for (int i = 0; i < count; i++) {
+            ctx->argv[i + 2] = ctx->batch_buf + offset;
+            ctx->argvlen[i + 2] = ctx->batch_lens[i];
+            offset += ctx->batch_lens[i];
         }
+        if (redisAppendCommandArgv(ctx->sync, count + 2, ctx->argv,
+                    ctx->argvlen) == REDIS_OK) {
+            replies = 1;
+        }
+        per_reply = count;
     } else {
-        redisReply *reply = redisCommand(redis, "%s %s %s",
-                file_ctx->redis_setup.command,
-                file_ctx->redis_setup.key,
-                string);
-        /* We may lose the reply if disconnection happens*/
-        if (reply) {
-            switch (reply->type) {
-                case REDIS_REPLY_ERROR:
-                    SCLogWarning(SC_ERR_SOCKET, "Redis error: %s", reply->str);
-                    SCConfLogReopenSyncRedis(file_ctx);
-                    break;
-                case REDIS_REPLY_INTEGER:
-                    SCLogDebug("Redis integer %lld", reply->integer);
-                    ret = 0;
-                    break;
-                default:
-                    SCLogError(SC_ERR_INVALID_VALUE,
-                            "Redis default triggered with %d", reply->type);
-                    SCConfLogReopenSyncRedis(file_ctx);
-                    break;
+        for (int i = 0; i < count; i++) {
+            int argc = SCLogRedisRecordArgv(file_ctx, ctx->argv, ctx->argvlen,
+                    ctx->batch_buf + offset, ctx->batch_lens[i]);
+            offset += ctx->batch_lens[i];
+            if (redisAppendCommandArgv(ctx->sync, argc, ctx->argv,
+                        ctx->argvlen) != REDIS_OK) {
+                break;
             }
-            freeReplyObject(reply);
-        } else {
+            replies++;
+        }
+        per_reply = 1;
+    }
+    if (replies == 0 || replies * per_reply != count) {
+        SCLogWarning(SC_ERR_MEM_ALLOC, "Unable to queue redis command");
+        ret = -1;
+    }
+
+    for (int i = 0; i < replies; i++) {
+        redisReply *reply = NULL;
+        if (redisGetReply(ctx->sync, (void **)&reply) != REDIS_OK) {
+            SCLogInfo("Error when fetching reply: %s (%d)",
+                    ctx->sync->errstr, ctx->sync->err);
+            /* the connection is unusable, the records without a reply
+             * are lost */
+            SCLogInfo("Reopening connection to redis server");
             SCConfLogReopenSyncRedis(file_ctx);
+            ret = -1;
+            break;
+        }
+        if (reply->type == REDIS_REPLY_ERROR) {
+            SCLogWarning(SC_ERR_SOCKET, "Redis error: %s", reply->str);
+            ret = -1;
+        } else {
+            acked += per_reply;
         }
+        freeReplyObject(reply);
     }
+
+    (void) SC_ATOMIC_ADD(redis_batches, 1);
+    SCLogRedisBatchReset(ctx, acked);
     return ret;
 }
 
+/** \internal
+ *  \brief register a sync output with the flush thread
+ */
+static void SCLogRedisFlushRegister(LogFileCtx *file_ctx)
+{
+    SCMutexLock(&redis_flush_lock);
+    LogFileCtx **outputs = SCRealloc(redis_flush_outputs,
+            (redis_flush_outputs_cnt + 1) * sizeof(LogFileCtx *));
+    if (outputs == NULL) {
+        SCMutexUnlock(&redis_flush_lock);
+        SCLogWarning(SC_ERR_MEM_ALLOC, "Unable to register redis output "
+                "for flushing, records are only sent with new records");
+        return;
+    }
+    redis_flush_outputs = outputs;
+    redis_flush_outputs[redis_flush_outputs_cnt++] = file_ctx;
+
+    /* check twice per interval, so records don't wait much longer */
+    const int wait = MAX(file_ctx->redis_setup.flush_interval / 2, 1);
+    if (redis_flush_wait == 0 || wait < redis_flush_wait)
+        redis_flush_wait = wait;
+    SCMutexUnlock(&redis_flush_lock);
+}
+
+/** \internal
+ *  \brief remove an output from the flush thread
+ */
+static void SCLogRedisFlushUnregister(LogFileCtx *file_ctx)
+{
+    SCMutexLock(&redis_flush_lock);
+    for (int i = 0; i < redis_flush_outputs_cnt; i++) {
+        if (redis_flush_outputs[i] == file_ctx) {
+            redis_flush_outputs[i] =
+                redis_flush_outputs[--redis_flush_outputs_cnt];
+            break;
+        }
+    }
+    if (redis_flush_outputs_cnt == 0 && redis_flush_outputs != NULL) {
+        SCFree(redis_flush_outputs);
+        redis_flush_outputs = NULL;
+    }
+    SCMutexUnlock(&redis_flush_lock);
+}
+
+/** \internal
+ *  \brief send the batches of the registered outputs that are due
+ *
+ *  Outputs that are locked are skipped: the thread holding the lock is
+ *  writing a record, which flushes a due batch as well, or closing the
+ *  output, which waits for our lock to unregister it.
+ */
+static void SCLogRedisFlushOutputs(void)
+{
+    SCMutexLock(&redis_flush_lock);
+    for (int i = 0; i < redis_flush_outputs_cnt; i++) {
+        LogFileCtx *file_ctx = redis_flush_outputs[i];
+        if (SCMutexTrylock(&file_ctx->fp_mutex) != 0)
+            continue;
+        if (file_ctx->redis != NULL && SCLogRedisFlushDue(file_ctx)) {
+            SCLogRedisFlushSync(file_ctx);
+        }
+        SCMutexUnlock(&file_ctx->fp_mutex);
+    }
+    SCMutexUnlock(&redis_flush_lock);
+}
+
+/** \internal
+ *  \brief management thread that sends batches that wait for longer than
+ *         the flush interval, also when no new records come in
+ */
+static void *SCLogRedisFlushThread(void *arg)
+{
+    ThreadVars *tv = (ThreadVars *)arg;
+
+    if (SCSetThreadName(tv->name) < 0) {
+        SCLogWarning(SC_ERR_THREAD_INIT, "Unable to set thread name");
+    }
+
+    if (tv->thread_setup_flags != 0)
+        TmThreadSetupOptions(tv);
+
+    /* Set the threads capability */
+    tv->cap_flags = 0;
+    SCDropCaps(tv);
+
+    TmThreadsSetFlag(tv, THV_INIT_DONE);
+    while (1) {
+        if (TmThreadsCheckFlag(tv, THV_PAUSE)) {
+            TmThreadsSetFlag(tv, THV_PAUSED);
+            TmThreadTestThreadUnPaused(tv);
+            TmThreadsUnsetFlag(tv, THV_PAUSED);
+        }
+
+        SCMutexLock(&redis_flush_lock);
+        const int wait = redis_flush_wait;
+        SCMutexUnlock(&redis_flush_lock);
+
+        struct timeval cur_timev;
+        gettimeofday(&cur_timev, NULL);
+        struct timespec cond_time = FROM_TIMEVAL(cur_timev);
+        cond_time.tv_sec += wait / 1000;
+        cond_time.tv_nsec += (wait % 1000) * 1000000;
+        if (cond_time.tv_nsec >= 1000000000) {
+            cond_time.tv_sec++;
+            cond_time.tv_nsec -= 1000000000;
+        }
+
+        /* wait for the set time, or until we are woken up by
+         * the shutdown procedure */
+        SCCtrlMutexLock(tv->ctrl_mutex);
+        SCCtrlCondTimedwait(tv->ctrl_cond, tv->ctrl_mutex, &cond_time);
+        SCCtrlMutexUnlock(tv->ctrl_mutex);
+
+        if (TmThreadsCheckFlag(tv, THV_KILL)) {
+            break;
+        }
+
+        SCLogRedisFlushOutputs();
+    }
+
+    TmThreadsSetFlag(tv, THV_RUNNING_DONE);
+    TmThreadWaitForFlag(tv, THV_DEINIT);
+    TmThreadsSetFlag(tv, THV_CLOSED);
+    return NULL;
+}
+
+/**
+ * \brief spawn the thread flushing the pipelines of the sync outputs
+ *
+ * Only started if an output uses pipelining with a flush interval.
+ * Remaining records are sent when the outputs are closed.
+ */
+void SCLogRedisFlushThreadSpawn(void)
+{
+    SCMutexLock(&redis_flush_lock);
+    const int cnt = redis_flush_outputs_cnt;
+    SCMutexUnlock(&redis_flush_lock);
+    if (cnt == 0)
+        return;
+
+    ThreadVars *tv = TmThreadCreateMgmtThread("RedisFlush",
+            SCLogRedisFlushThread, 1);
+    if (tv == NULL) {
+        SCLogError(SC_ERR_THREAD_CREATE, "TmThreadCreateMgmtThread failed");
+        exit(EXIT_FAILURE);
+    }
+    if (TmThreadSpawn(tv) != 0) {
+        SCLogError(SC_ERR_THREAD_SPAWN, "TmThreadSpawn failed for "
+                "SCLogRedisFlushThread");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/** \brief SCLogRedisWriteSync() writes string to redis output in sync mode
+ *
+ *  Records are batched and sent when the batch is full or the oldest
+ *  record waited for longer than the flush interval. The latter is also
+ *  checked periodically by the flush thread. Without pipelining the batch
+ *  holds a single record.
+ *
+ *  \param file_ctx Log file context allocated by caller
+ *  \param string Buffer to output
+ *  \param string_len Length of the buffer
+ */
+static int SCLogRedisWriteSync(LogFileCtx *file_ctx, const char *string,
+        size_t string_len)
+{
+    SCLogRedisContext *ctx = file_ctx->redis;
+
+    if (SCLogRedisBatchAppend(ctx, string, string_len) < 0) {
+        (void) SC_ATOMIC_ADD(redis_dropped, 1);
+        return -1;
+    }
+
+    if (ctx->batch_count >= MAX(file_ctx->redis_setup.batch_size, 1) ||
+            SCLogRedisFlushDue(file_ctx)) {
+        return SCLogRedisFlushSync(file_ctx);
+    }
+    return 0;
+}
+
 /**
  * \brief LogFileWriteRedis() writes log data to redis output.
  * \param log_ctx Log file context allocated by caller
@@ -429,7 +805,7 @@ int LogFileWriteRedis(void *lf_ctx, const char *string, size_t string_len)
 #endif
     /* sync mode */
     if (! file_ctx->redis_setup.is_async) {
-        return SCLogRedisWriteSync(file_ctx, string);
+        return SCLogRedisWriteSync(file_ctx, string, string_len);
     }
     return -1;
 }
@@ -478,6 +854,8 @@ int SCConfLogOpenRedis(ConfNode *redis_node, void *lf_ctx)
 
     log_ctx->redis_setup.is_async = is_async;
     log_ctx->redis_setup.batch_size = 0;
+    log_ctx->redis_setup.flush_interval = 0;
+    log_ctx->redis_setup.stream_maxlen = 0;
     if (redis_node) {
         ConfNode *pipelining = ConfNodeLookupChild(redis_node, "pipelining");
         if (pipelining) {
@@ -488,22 +866,59 @@ int SCConfLogOpenRedis(ConfNode *redis_node, void *lf_ctx)
             if (ret && enabled) {
                 ret = ConfGetChildValueInt(pipelining, "batch-size", &val);
                 if (ret) {
+                    if (val <= 0 || val > INT_MAX - 2) {
+                        SCLogError(SC_ERR_REDIS_CONFIG,
+                                "Invalid redis pipelining batch-size");
+                        exit(EXIT_FAILURE);
+                    }
                     log_ctx->redis_setup.batch_size = val;
                 } else {
                     log_ctx->redis_setup.batch_size = 10;
                 }
+                ret = ConfGetChildValueInt(pipelining, "flush-interval", &val);
+                if (ret) {
+                    if (val < 0 || val > INT_MAX) {
+                        SCLogError(SC_ERR_REDIS_CONFIG,
+                                "Invalid redis pipelining flush-interval");
+                        exit(EXIT_FAILURE);
+                    }
+                    log_ctx->redis_setup.flush_interval = val;
+                } else {
+                    log_ctx->redis_setup.flush_interval =
+                        REDIS_DEFAULT_FLUSH_INTERVAL;
+                }
             }
         }
-    } else {
-        log_ctx->redis_setup.batch_size = 0;
+
+        if (is_async && log_ctx->redis_setup.batch_size > 0) {
+            SCLogWarning(SC_ERR_REDIS_CONFIG, "redis pipelining is not "
+                    "supported in async mode, ignoring it");
+            log_ctx->redis_setup.batch_size = 0;
+            log_ctx->redis_setup.flush_interval = 0;
+        }
+
+        intmax_t maxlen;
+        if (ConfGetChildValueInt(redis_node, "stream-maxlen", &maxlen)) {
+            if (maxlen < 0) {
+                SCLogError(SC_ERR_REDIS_CONFIG, "Invalid redis stream-maxlen");
+                exit(EXIT_FAILURE);
+            }
+            log_ctx->redis_setup.stream_maxlen = maxlen;
+        }
     }
 
     if (!strcmp(redis_mode, "list") || !strcmp(redis_mode,"lpush")) {
+        log_ctx->redis_setup.mode = REDIS_LIST;
         log_ctx->redis_setup.command = redis_lpush_cmd;
     } else if(!strcmp(redis_mode, "rpush")){
+        log_ctx->redis_setup.mode = REDIS_LIST;
         log_ctx->redis_setup.command = redis_rpush_cmd;
     } else if(!strcmp(redis_mode,"channel") || !strcmp(redis_mode,"publish")) {
+        log_ctx->redis_setup.mode = REDIS_CHANNEL;
         log_ctx->redis_setup.command = redis_publish_cmd;
+    } else if(!strcmp(redis_mode,"stream") || !strcmp(redis_mode,"xadd")) {
+        log_ctx->redis_setup.mode = REDIS_STREAM;
+        log_ctx->redis_setup.command = redis_xadd_cmd;
     } else {
         SCLogError(SC_ERR_REDIS_CONFIG,"Invalid redis mode");
         exit(EXIT_FAILURE);
@@ -519,13 +934,18 @@ int SCConfLogOpenRedis(ConfNode *redis_node, void *lf_ctx)
 
 #ifdef HAVE_LIBEVENT
     if (is_async) {
-        log_ctx->redis = SCLogRedisContextAsyncAlloc();
+        log_ctx->redis = SCLogRedisContextAsyncAlloc(&log_ctx->redis_setup);
     }
 #endif /*HAVE_LIBEVENT*/
     if (! is_async) {
-        log_ctx->redis = SCLogRedisContextAlloc();
+        log_ctx->redis = SCLogRedisContextAlloc(&log_ctx->redis_setup);
         SCConfLogReopenSyncRedis(log_ctx);
+        if (log_ctx->redis_setup.batch_size > 1 &&
+                log_ctx->redis_setup.flush_interval > 0) {
+            SCLogRedisFlushRegister(log_ctx);
+        }
     }
+    SCLogRedisRegisterCounters();
     return 0;
 }
 
@@ -555,15 +975,10 @@ void SCLogFileCloseRedis(LogFileCtx *log_ctx)
 
     /* synchronous */
     if (!log_ctx->redis_setup.is_async) {
+        SCLogRedisFlushUnregister(log_ctx);
+        /* send what is left in the pipeline */
+        SCLogRedisFlushSync(log_ctx);
         if (ctx->sync) {
-            redisReply *reply;
-            int i;
-            for (i = 0; i < ctx->batch_count; i++) {
-                redisGetReply(ctx->sync, (void **)&reply);
-                if (reply) {
-                    freeReplyObject(reply);
-                }
-            }
             redisFree(ctx->sync);
             ctx->sync = NULL;
         }
@@ -571,9 +986,221 @@ void SCLogFileCloseRedis(LogFileCtx *log_ctx)
         ctx->batch_count = 0;
     }
 
-    if (ctx != NULL) {
-        SCFree(ctx);
+    SCLogRedisContextFree(ctx);
+    log_ctx->redis = NULL;
+}
+
+#ifdef UNITTESTS
+
+/** \internal
+ *  \brief set up a sync redis output talking to a socket pair instead of
+ *         a server, so the tests can check what goes on the wire
+ */
+static LogFileCtx *RedisTestSetup(enum RedisMode mode, const char *command,
+        int batch_size, uint64_t stream_maxlen, int *peer)
+{
+    int sv[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+        return NULL;
+
+    LogFileCtx *lf = LogFileNewCtx();
+    if (lf == NULL) {
+        close(sv[0]);
+        close(sv[1]);
+        return NULL;
     }
+    lf->type = LOGFILE_TYPE_REDIS;
+    lf->redis_setup.mode = mode;
+    lf->redis_setup.command = command;
+    lf->redis_setup.key = redis_default_key;
+    lf->redis_setup.server = redis_default_server;
+    lf->redis_setup.port = 6379;
+    lf->redis_setup.batch_size = batch_size;
+    lf->redis_setup.stream_maxlen = stream_maxlen;
+    lf->redis = SCLogRedisContextAlloc(&lf->redis_setup);
+    lf->Close = SCLogFileCloseRedis;
+
+    SCLogRedisContext *ctx = lf->redis;
+    ctx->sync = redisConnectFd(sv[0]);
+    /* don't let a failing test try to reach a real server */
+    ctx->tried = time(NULL) + 3600;
+    *peer = sv[1];
+    return lf;
+}
+
+/** \internal
+ *  \brief read what the output wrote so far, without blocking
+ */
+static int RedisTestRecv(int fd, char *buf, size_t size)
+{
+    ssize_t r = recv(fd, buf, size - 1, MSG_DONTWAIT);
+    if (r < 0)
+        r = 0;
+    buf[r] = '\0';
+    return (int)r;
+}
+
+/** \test batch of records in list mode goes out as a single variadic LPUSH
+ *        once the batch is full */
+static int RedisTest01(void)
+{
+    char buf[256];
+    int peer;
+    uint64_t records = SC_ATOMIC_GET(redis_records);
+    uint64_t batches = SC_ATOMIC_GET(redis_batches);
+    uint64_t pending = SC_ATOMIC_GET(redis_pending);
+
+    LogFileCtx *lf = RedisTestSetup(REDIS_LIST, redis_lpush_cmd, 3, 0, &peer);
+    FAIL_IF_NULL(lf);
+
+    FAIL_IF(LogFileWriteRedis(lf, "one", 3) != 0);
+    FAIL_IF(LogFileWriteRedis(lf, "two", 3) != 0);
+    FAIL_IF(RedisTestRecv(peer, buf, sizeof(buf)) != 0);
+    FAIL_IF(SC_ATOMIC_GET(redis_pending) != pending + 2);
+
+    const char *reply = ":3\r\n";
+    FAIL_IF(write(peer, reply, strlen(reply)) != (ssize_t)strlen(reply));
+    FAIL_IF(LogFileWriteRedis(lf, "three", 5) != 0);
+
+    const char *expected = "*5\r\n$5\r\nLPUSH\r\n$8\r\nsuricata\r\n"
+        "$3\r\none\r\n$3\r\ntwo\r\n$5\r\nthree\r\n";
+    FAIL_IF(RedisTestRecv(peer, buf, sizeof(buf)) != (int)strlen(expected));
+    FAIL_IF(strcmp(buf, expected) != 0);
+    FAIL_IF(SC_ATOMIC_GET(redis_records) != records + 3);
+    FAIL_IF(SC_ATOMIC_GET(redis_batches) != batches + 1);
+    FAIL_IF(SC_ATOMIC_GET(redis_pending) != pending);
+
+    LogFileFreeCtx(lf);
+    close(peer);
+    PASS;
+}
+
+/** \test stream mode pipelines one capped XADD per record */
+static int RedisTest02(void)
+{
+    char buf[512];
+    int peer;
+    uint64_t records = SC_ATOMIC_GET(redis_records);
+
+    LogFileCtx *lf = RedisTestSetup(REDIS_STREAM, redis_xadd_cmd, 2, 1000, &peer);
+    FAIL_IF_NULL(lf);
+
+    const char *replies = "$3\r\n1-0\r\n$3\r\n1-1\r\n";
+    FAIL_IF(write(peer, replies, strlen(replies)) != (ssize_t)strlen(replies));
+    FAIL_IF(LogFileWriteRedis(lf, "a", 1) != 0);
+    FAIL_IF(LogFileWriteRedis(lf, "b", 1) != 0);
+
+    const char *expected =
+        "*8\r\n$4\r\nXADD\r\n$8\r\nsuricata\r\n$6\r\nMAXLEN\r\n$1\r\n~\r\n"
+        "$4\r\n1000\r\n$1\r\n*\r\n$5\r\nevent\r\n$1\r\na\r\n"
+        "*8\r\n$4\r\nXADD\r\n$8\r\nsuricata\r\n$6\r\nMAXLEN\r\n$1\r\n~\r\n"
+        "$4\r\n1000\r\n$1\r\n*\r\n$5\r\nevent\r\n$1\r\nb\r\n";
+    FAIL_IF(RedisTestRecv(peer, buf, sizeof(buf)) != (int)strlen(expected));
+    FAIL_IF(strcmp(buf, expected) != 0);
+    FAIL_IF(SC_ATOMIC_GET(redis_records) != records + 2);
+
+    LogFileFreeCtx(lf);
+    close(peer);
+    PASS;
+}
+
+/** \test error reply drops the batch and is accounted for */
+static int RedisTest03(void)
+{
+    char buf[256];
+    int peer;
+    uint64_t records = SC_ATOMIC_GET(redis_records);
+    uint64_t dropped = SC_ATOMIC_GET(redis_dropped);
+
+    LogFileCtx *lf = RedisTestSetup(REDIS_LIST, redis_rpush_cmd, 2, 0, &peer);
+    FAIL_IF_NULL(lf);
+
+    const char *reply = "-WRONGTYPE wrong kind of value\r\n";
+    FAIL_IF(write(peer, reply, strlen(reply)) != (ssize_t)strlen(reply));
+    FAIL_IF(LogFileWriteRedis(lf, "x", 1) != 0);
+    FAIL_IF(LogFileWriteRedis(lf, "y", 1) != -1);
+    FAIL_IF(RedisTestRecv(peer, buf, sizeof(buf)) == 0);
+    FAIL_IF(SC_ATOMIC_GET(redis_records) != records);
+    FAIL_IF(SC_ATOMIC_GET(redis_dropped) != dropped + 2);
+
+    LogFileFreeCtx(lf);
+    close(peer);
+    PASS;
+}
+
+/** \test records left in the pipeline are sent on close */
+static int RedisTest04(void)
+{
+    char buf[256];
+    int peer;
+    uint64_t records = SC_ATOMIC_GET(redis_records);
+
+    LogFileCtx *lf = RedisTestSetup(REDIS_CHANNEL, redis_publish_cmd, 10, 0, &peer);
+    FAIL_IF_NULL(lf);
+
+    const char *reply = ":1\r\n";
+    FAIL_IF(write(peer, reply, strlen(reply)) != (ssize_t)strlen(reply));
+    FAIL_IF(LogFileWriteRedis(lf, "z", 1) != 0);
+    FAIL_IF(RedisTestRecv(peer, buf, sizeof(buf)) != 0);
+
+    LogFileFreeCtx(lf);
+
+    const char *expected = "*3\r\n$7\r\nPUBLISH\r\n$8\r\nsuricata\r\n$1\r\nz\r\n";
+    FAIL_IF(RedisTestRecv(peer, buf, sizeof(buf)) != (int)strlen(expected));
+    FAIL_IF(strcmp(buf, expected) != 0);
+    FAIL_IF(SC_ATOMIC_GET(redis_records) != records + 1);
+
+    close(peer);
+    PASS;
+}
+
+/** \test a due batch is sent by the flush thread without new records */
+static int RedisTest05(void)
+{
+    char buf[256];
+    int peer;
+
+    LogFileCtx *lf = RedisTestSetup(REDIS_CHANNEL, redis_publish_cmd, 10, 0, &peer);
+    FAIL_IF_NULL(lf);
+    SCLogRedisContext *ctx = lf->redis;
+    lf->redis_setup.flush_interval = 1000;
+    SCLogRedisFlushRegister(lf);
+
+    const char *reply = ":1\r\n";
+    FAIL_IF(write(peer, reply, strlen(reply)) != (ssize_t)strlen(reply));
+    FAIL_IF(LogFileWriteRedis(lf, "z", 1) != 0);
+    FAIL_IF(RedisTestRecv(peer, buf, sizeof(buf)) != 0);
+
+    /* not due yet */
+    ctx->batch_start.tv_sec += 3600;
+    SCLogRedisFlushOutputs();
+    FAIL_IF(RedisTestRecv(peer, buf, sizeof(buf)) != 0);
+
+    ctx->batch_start.tv_sec -= 3602;
+    SCLogRedisFlushOutputs();
+    const char *expected = "*3\r\n$7\r\nPUBLISH\r\n$8\r\nsuricata\r\n$1\r\nz\r\n";
+    FAIL_IF(RedisTestRecv(peer, buf, sizeof(buf)) != (int)strlen(expected));
+    FAIL_IF(strcmp(buf, expected) != 0);
+    FAIL_IF(ctx->batch_count != 0);
+
+    LogFileFreeCtx(lf);
+    FAIL_IF(redis_flush_outputs_cnt != 0);
+    close(peer);
+    PASS;
+}
+
+#endif /* UNITTESTS */
+
+void SCLogRedisRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("RedisTest01", RedisTest01);
+    UtRegisterTest("RedisTest02", RedisTest02);
+    UtRegisterTest("RedisTest03", RedisTest03);
+    UtRegisterTest("RedisTest04", RedisTest04);
+    UtRegisterTest("RedisTest05", RedisTest05);
+#endif
 }
 
 #endif //#ifdef HAVE_LIBHIREDIS
@@ -34,7 +34,7 @@
 
 #include "conf.h"            /* ConfNode   */
 
-enum RedisMode { REDIS_LIST, REDIS_CHANNEL };
+enum RedisMode { REDIS_LIST, REDIS_CHANNEL, REDIS_STREAM };
 
 typedef struct RedisSetup_ {
     enum RedisMode mode;
@@ -44,6 +44,10 @@ typedef struct RedisSetup_ {
     int  port;
     int is_async;
     int  batch_size;
+    /** max time in ms a record may wait in the pipeline, 0 for no limit */
+    int  flush_interval;
+    /** approximate max length of the stream in stream mode, 0 for no cap */
+    uint64_t stream_maxlen;
 } RedisSetup;
 
 typedef struct SCLogRedisContext_ {
@@ -55,11 +59,25 @@ typedef struct SCLogRedisContext_ {
 #endif /* HAVE_LIBEVENT */
     time_t tried;
     int  batch_count;
+    /** records waiting to be sent, stored back to back */
+    char *batch_buf;
+    size_t batch_buf_len;
+    size_t batch_buf_size;
+    size_t *batch_lens;
+    /** argument vector for the commands sent to redis */
+    const char **argv;
+    size_t *argvlen;
+    /** arrival time of the oldest record in the batch */
+    struct timeval batch_start;
+    /** stream max length as sent to redis */
+    char stream_maxlen[21];
 } SCLogRedisContext;
 
 void SCLogRedisInit(void);
 int SCConfLogOpenRedis(ConfNode *, void *);
 int LogFileWriteRedis(void *, const char *, size_t);
+void SCLogRedisFlushThreadSpawn(void);
+void SCLogRedisRegisterTests(void);
 
 #endif /* HAVE_LIBHIREDIS */
 #endif /* __UTIL_LOG_REDIS_H__ */
@@ -293,6 +293,170 @@ SCLogOpenFileFp(const char *path, const char *append_setting, uint32_t mode)
     return ret;
 }
 
+/** \brief set up a log file context that writes a file per thread
+ *  \param log_ctx Log file context to set up
+ *  \param append append setting to use when opening the shards
+ *  \retval 0 on success
+ *  \retval -1 on error
+ */
+static int LogFileThreadedInit(LogFileCtx *log_ctx, const char *append)
+{
+    log_ctx->threads = SCCalloc(1, sizeof(LogThreadedFileCtx));
+    if (log_ctx->threads == NULL) {
+        return -1;
+    }
+
+    log_ctx->threads->append = SCStrdup(append);
+    if (log_ctx->threads->append == NULL) {
+        SCFree(log_ctx->threads);
+        log_ctx->threads = NULL;
+        return -1;
+    }
+    SCMutexInit(&log_ctx->threads->mutex, NULL);
+
+    return 0;
+}
+
+/** \brief build the filename of a shard by inserting the thread id
+ *         before the extension, so "eve.json" becomes "eve.<id>.json"
+ *  \retval char* on success
+ *  \retval NULL on error
+ */
+static char *LogFileThreadedName(const char *original_name, int thread_id)
+{
+    char name[PATH_MAX];
+    const char *dot = strrchr(original_name, '.');
+    const char *base = strrchr(original_name, '/');
+
+    if (dot == NULL || (base != NULL && dot < base)) {
+        snprintf(name, sizeof(name), "%s.%d", original_name, thread_id);
+    } else {
+        snprintf(name, sizeof(name), "%.*s.%d%s",
+                (int)(dot - original_name), original_name, thread_id, dot);
+    }
+
+    return SCStrdup(name);
+}
+
+/** \brief create and open the file of a single thread
+ *  \retval LogFileCtx* on success
+ *  \retval NULL on error
+ */
+static LogFileCtx *LogFileNewThreadedCtx(LogFileCtx *parent_ctx, int thread_id)
+{
+    LogFileCtx *thread = LogFileNewCtx();
+    if (thread == NULL) {
+        return NULL;
+    }
+
+    thread->parent = parent_ctx;
+    thread->type = parent_ctx->type;
+    thread->format = parent_ctx->format;
+    thread->filemode = parent_ctx->filemode;
+    thread->json_flags = parent_ctx->json_flags;
+    thread->is_pcap_offline = parent_ctx->is_pcap_offline;
+    thread->nostamp = parent_ctx->nostamp;
+    /* same rotation schedule as the other threads */
+    thread->flags = parent_ctx->flags & LOGFILE_ROTATE_INTERVAL;
+    thread->rotate_time = parent_ctx->rotate_time;
+    thread->rotate_interval = parent_ctx->rotate_interval;
+
+    if (parent_ctx->prefix != NULL) {
+        thread->prefix = SCStrdup(parent_ctx->prefix);
+        if (thread->prefix == NULL)
+            goto error;
+        thread->prefix_len = parent_ctx->prefix_len;
+    }
+    if (parent_ctx->sensor_name != NULL) {
+        thread->sensor_name = SCStrdup(parent_ctx->sensor_name);
+        if (thread->sensor_name == NULL)
+            goto error;
+    }
+
+    thread->filename = LogFileThreadedName(parent_ctx->filename, thread_id);
+    if (thread->filename == NULL)
+        goto error;
+
+    thread->fp = SCLogOpenFileFp(thread->filename, parent_ctx->threads->append,
+            thread->filemode);
+    if (thread->fp == NULL)
+        goto error;
+    thread->is_regular = 1;
+
+    /* rotation requests are sent to all threads of the set */
+    OutputRegisterFileRotationFlag(&thread->rotation_flag);
+
+    SCLogDebug("thread %d logs to %s", thread_id, thread->filename);
+    return thread;
+
+error:
+    LogFileFreeCtx(thread);
+    return NULL;
+}
+
+/** \brief get the log file context to use for a thread
+ *
+ *  For threaded log files the file of the thread is created on first
+ *  use. Otherwise the shared parent context is returned.
+ *
+ *  \param parent_ctx log file context set up by SCConfLogOpenGeneric()
+ *  \param thread_id id of the calling thread
+ *  \retval LogFileCtx* on success
+ *  \retval NULL on error
+ */
+LogFileCtx *LogFileEnsureExists(LogFileCtx *parent_ctx, int thread_id)
+{
+    if (parent_ctx == NULL || !parent_ctx->threaded) {
+        return parent_ctx;
+    }
+    if (thread_id < 0) {
+        return NULL;
+    }
+
+    LogThreadedFileCtx *threads = parent_ctx->threads;
+    LogFileCtx *ret = NULL;
+
+    SCMutexLock(&threads->mutex);
+    if (thread_id >= threads->slot_count) {
+        const int new_count = thread_id + 1;
+        LogFileCtx **slots = SCRealloc(threads->slots,
+                new_count * sizeof(LogFileCtx *));
+        if (slots == NULL) {
+            SCMutexUnlock(&threads->mutex);
+            return NULL;
+        }
+        memset(slots + threads->slot_count, 0,
+                (new_count - threads->slot_count) * sizeof(LogFileCtx *));
+        threads->slots = slots;
+        threads->slot_count = new_count;
+    }
+    if (threads->slots[thread_id] == NULL) {
+        threads->slots[thread_id] = LogFileNewThreadedCtx(parent_ctx, thread_id);
+    }
+    ret = threads->slots[thread_id];
+    SCMutexUnlock(&threads->mutex);
+
+    return ret;
+}
+
+/** \brief get the number of dropped events, including those of
+ *         all threads of a threaded log file */
+uint64_t LogFileGetDropped(LogFileCtx *file_ctx)
+{
+    uint64_t dropped = file_ctx->dropped;
+
+    if (file_ctx->threaded) {
+        SCMutexLock(&file_ctx->threads->mutex);
+        for (int i = 0; i < file_ctx->threads->slot_count; i++) {
+            if (file_ctx->threads->slots[i] != NULL) {
+                dropped += file_ctx->threads->slots[i]->dropped;
+            }
+        }
+        SCMutexUnlock(&file_ctx->threads->mutex);
+    }
+    return dropped;
+}
+
 /** \brief open a generic output "log file", which may be a regular file or a socket
  *  \param conf ConfNode structure for the output section in question
  *  \param log_ctx Log file context allocated by caller
@@ -412,6 +576,13 @@ SCConfLogOpenGeneric(ConfNode *conf,
             log_ctx->json_flags &= ~(JSON_ESCAPE_SLASH);
     }
 
+    if (log_ctx->threaded && strcasecmp(filetype, DEFAULT_LOG_FILETYPE) != 0 &&
+            strcasecmp(filetype, "file") != 0) {
+        SCLogWarning(SC_ERR_INVALID_ARGUMENT, "%s.threaded is only supported "
+                "for regular files, ignoring", conf->name);
+        log_ctx->threaded = false;
+    }
+
     // Now, what have we been asked to open?
     if (strcasecmp(filetype, "unix_stream") == 0) {
 #ifdef BUILD_WITH_UNIXSOCKET
@@ -433,9 +604,15 @@ SCConfLogOpenGeneric(ConfNode *conf,
 #endif
     } else if (strcasecmp(filetype, DEFAULT_LOG_FILETYPE) == 0 ||
                strcasecmp(filetype, "file") == 0) {
-        log_ctx->fp = SCLogOpenFileFp(log_path, append, log_ctx->filemode);
-        if (log_ctx->fp == NULL)
-            return -1; // Error already logged by Open...Fp routine
+        if (log_ctx->threaded) {
+            /* files are opened per thread by LogFileEnsureExists() */
+            if (LogFileThreadedInit(log_ctx, append) < 0)
+                return -1;
+        } else {
+            log_ctx->fp = SCLogOpenFileFp(log_path, append, log_ctx->filemode);
+            if (log_ctx->fp == NULL)
+                return -1; // Error already logged by Open...Fp routine
+        }
         log_ctx->is_regular = 1;
         if (rotate) {
             OutputRegisterFileRotationFlag(&log_ctx->rotation_flag);
@@ -485,6 +662,11 @@ SCConfLogOpenGeneric(ConfNode *conf,
  */
 int SCConfLogReopen(LogFileCtx *log_ctx)
 {
+    if (log_ctx->threaded) {
+        /* the files of the threads are reopened individually */
+        return 0;
+    }
+
     if (!log_ctx->is_regular) {
         /* Not supported and not needed on non-regular files. */
         return 0;
@@ -542,7 +724,8 @@ int LogFileFreeCtx(LogFileCtx *lf_ctx)
         SCReturnInt(0);
     }
 
-    if (lf_ctx->fp != NULL) {
+    /* redis outputs have no fp, but need to send their pipeline */
+    if (lf_ctx->fp != NULL || lf_ctx->type == LOGFILE_TYPE_REDIS) {
         SCMutexLock(&lf_ctx->fp_mutex);
         lf_ctx->Close(lf_ctx);
         SCMutexUnlock(&lf_ctx->fp_mutex);
@@ -550,6 +733,19 @@ int LogFileFreeCtx(LogFileCtx *lf_ctx)
 
     SCMutexDestroy(&lf_ctx->fp_mutex);
 
+    if (lf_ctx->threads != NULL) {
+        for (int i = 0; i < lf_ctx->threads->slot_count; i++) {
+            if (lf_ctx->threads->slots[i] != NULL) {
+                LogFileFreeCtx(lf_ctx->threads->slots[i]);
+            }
+        }
+        if (lf_ctx->threads->slots != NULL)
+            SCFree(lf_ctx->threads->slots);
+        SCFree(lf_ctx->threads->append);
+        SCMutexDestroy(&lf_ctx->threads->mutex);
+        SCFree(lf_ctx->threads);
+    }
+
     if (lf_ctx->prefix != NULL) {
         SCFree(lf_ctx->prefix);
         lf_ctx->prefix_len = 0;
@@ -577,8 +773,10 @@ int LogFileWrite(LogFileCtx *file_ctx, MemBuffer *buffer)
                file_ctx->type == LOGFILE_TYPE_UNIX_DGRAM ||
                file_ctx->type == LOGFILE_TYPE_UNIX_STREAM)
     {
-        /* append \n for files only */
-        MemBufferWriteString(buffer, "\n");
+        /* append \n for files only, binary records are length-prefixed */
+        if (file_ctx->format == LOGFILE_FORMAT_JSON) {
+            MemBufferWriteString(buffer, "\n");
+        }
         file_ctx->Write((const char *)MEMBUFFER_BUFFER(buffer),
                         MEMBUFFER_OFFSET(buffer), file_ctx);
     }
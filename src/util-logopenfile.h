@@ -43,11 +43,25 @@ enum LogFileType { LOGFILE_TYPE_FILE,
                    LOGFILE_TYPE_UNIX_STREAM,
                    LOGFILE_TYPE_REDIS };
 
+/** record encoding used by EVE */
+enum LogFileFormat { LOGFILE_FORMAT_JSON,
+                     LOGFILE_FORMAT_CBOR };
+
 typedef struct SyslogSetup_ {
     int alert_syslog_level;
 } SyslogSetup;
 
 
+/** Per thread shards of a threaded log file */
+typedef struct LogThreadedFileCtx_ {
+    SCMutex mutex;
+    /** shards, indexed by thread id */
+    struct LogFileCtx_ **slots;
+    int slot_count;
+    /** append setting used to open the shards */
+    char *append;
+} LogThreadedFileCtx;
+
 /** Global structure for Output Context */
 typedef struct LogFileCtx_ {
     union {
@@ -75,6 +89,17 @@ typedef struct LogFileCtx_ {
     /** the type of file */
     enum LogFileType type;
 
+    /** the encoding of the records */
+    enum LogFileFormat format;
+
+    /** Set if each thread writes to its own file. The shards are
+     *  kept in 'threads' and are set up by LogFileEnsureExists(). */
+    bool threaded;
+    LogThreadedFileCtx *threads;
+
+    /** set on a shard, points to the LogFileCtx it was created from */
+    struct LogFileCtx_ *parent;
+
     /** The name of the file */
     char *filename;
 
@@ -144,6 +169,8 @@ typedef struct LogFileCtx_ {
 LogFileCtx *LogFileNewCtx(void);
 int LogFileFreeCtx(LogFileCtx *);
 int LogFileWrite(LogFileCtx *file_ctx, MemBuffer *buffer);
+LogFileCtx *LogFileEnsureExists(LogFileCtx *parent_ctx, int thread_id);
+uint64_t LogFileGetDropped(LogFileCtx *file_ctx);
 
 int SCConfLogOpenGeneric(ConfNode *conf, LogFileCtx *, const char *, int);
 int SCConfLogReopen(LogFileCtx *);
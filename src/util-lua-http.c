@@ -39,6 +39,7 @@
 
 #include "output.h"
 #include "app-layer-htp.h"
+#include "app-layer-htp-body.h"
 #include "app-layer.h"
 #include "app-layer-parser.h"
 #include "util-privs.h"
@@ -289,7 +290,7 @@ static int HttpGetBody(lua_State *luastate, int dir)
 
         const uint8_t *data = NULL;
         uint32_t data_len = 0;
-        StreamingBufferSegmentGetData(body->sb, &chunk->sbseg, &data, &data_len);
+        HtpBodyChunkGetData(body, chunk, &data, &data_len);
         LuaPushStringBuffer(luastate, data, data_len);
 
         lua_settable(luastate, -3);
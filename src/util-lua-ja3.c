@@ -96,13 +96,13 @@ static int Ja3GetString(lua_State *luastate)
 
     SSLState *ssl_state = (SSLState *)state;
 
-    if (ssl_state->client_connp.ja3_str == NULL ||
-            ssl_state->client_connp.ja3_str->data == NULL)
+    const JA3Buffer *ja3_str = SSLStateGetJA3String(&ssl_state->client_connp);
+    if (ja3_str == NULL || ja3_str->data == NULL)
         return LuaCallbackError(luastate, "error: no JA3 str");
 
     return LuaPushStringBuffer(luastate,
-                               (uint8_t *)ssl_state->client_connp.ja3_str->data,
-                               ssl_state->client_connp.ja3_str->used);
+                               (uint8_t *)ja3_str->data,
+                               ja3_str->used);
 }
 
 static int Ja3SGetHash(lua_State *luastate)
@@ -143,13 +143,13 @@ static int Ja3SGetString(lua_State *luastate)
 
     SSLState *ssl_state = (SSLState *)state;
 
-    if (ssl_state->server_connp.ja3_str == NULL ||
-            ssl_state->server_connp.ja3_str->data == NULL)
+    const JA3Buffer *ja3_str = SSLStateGetJA3String(&ssl_state->server_connp);
+    if (ja3_str == NULL || ja3_str->data == NULL)
         return LuaCallbackError(luastate, "error: no JA3S str");
 
     return LuaPushStringBuffer(luastate,
-                               (uint8_t *)ssl_state->server_connp.ja3_str->data,
-                               ssl_state->server_connp.ja3_str->used);
+                               (uint8_t *)ja3_str->data,
+                               ja3_str->used);
 }
 
 /** *\brief Register JA3 Lua extensions */
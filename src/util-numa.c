@@ -0,0 +1,205 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * NUMA aware memory placement.
+ *
+ * Threads allocate their packet pool, stream pools and detect thread
+ * context themselves, after their cpu affinity is set. With the local
+ * allocation policy this memory ends up on the node of the thread. This
+ * file makes sure that policy is in place, keeps track of the node of
+ * each thread and lets code that allocates on behalf of another thread,
+ * like the flow prealloc and the detect reload, prefer that thread's node.
+ */
+
+#include "suricata-common.h"
+#include "conf.h"
+#include "util-debug.h"
+#include "util-numa.h"
+
+#ifdef HAVE_LIBNUMA
+#include <numa.h>
+#include <numaif.h>
+#endif
+
+static bool numa_enabled = false;
+static int numa_nodes = 1;
+
+#ifdef TLS
+/** node of the calling thread, -1 if unknown or spread over nodes */
+static __thread int numa_thread_node = -1;
+#endif
+
+/**
+ *  \brief check if NUMA aware placement can and should be used
+ *
+ *  Off by default, enabled with threading.numa-aware on systems with
+ *  more than one node.
+ */
+void NumaInit(void)
+{
+#ifdef HAVE_LIBNUMA
+    int enabled = 0;
+    if (ConfGetBool("threading.numa-aware", &enabled) != 1 || !enabled)
+        return;
+
+    if (numa_available() < 0)
+        return;
+
+    int nodes = numa_max_node() + 1;
+    if (nodes < 2)
+        return;
+    if (nodes > NUMA_NODES_MAX) {
+        SCLogWarning(SC_ERR_INVALID_VALUE, "%d NUMA nodes, only the first %d "
+                "are used for memory placement", nodes, NUMA_NODES_MAX);
+        nodes = NUMA_NODES_MAX;
+    }
+
+    numa_nodes = nodes;
+    numa_enabled = true;
+    SCLogConfig("NUMA aware memory placement for %d nodes", numa_nodes);
+#endif
+}
+
+bool NumaIsEnabled(void)
+{
+    return numa_enabled;
+}
+
+/** \retval nodes number of nodes, 1 if NUMA awareness is not enabled */
+int NumaNodeCount(void)
+{
+    return numa_nodes;
+}
+
+/**
+ *  \brief get the node of the calling thread
+ *
+ *  \retval node node the thread is bound to, or -1 if it's not bound to
+ *               a single node or NUMA awareness is not enabled
+ */
+int NumaThreadNode(void)
+{
+#ifdef TLS
+    return numa_thread_node;
+#else
+    return -1;
+#endif
+}
+
+#ifdef HAVE_LIBNUMA
+/** \internal
+ *  \brief get the node all cpus of the thread's affinity belong to
+ *
+ *  \retval node or -1 if the cpus are on more than one node
+ */
+static int NumaAffinityNode(void)
+{
+    cpu_set_t cs;
+    int node = -1;
+
+    CPU_ZERO(&cs);
+    if (sched_getaffinity(0, sizeof(cs), &cs) != 0)
+        return -1;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &cs))
+            continue;
+        int n = numa_node_of_cpu(cpu);
+        if (n < 0 || (node != -1 && n != node))
+            return -1;
+        node = n;
+    }
+    if (node >= numa_nodes)
+        return -1;
+    return node;
+}
+#endif
+
+/**
+ *  \brief set up the memory policy of a thread
+ *
+ *  To be called by the thread itself, after its affinity is set and
+ *  before it allocates its per thread memory.
+ */
+void NumaThreadSetup(ThreadVars *tv)
+{
+    tv->numa_node = -1;
+#ifdef HAVE_LIBNUMA
+    if (!numa_enabled)
+        return;
+
+    /* a policy inherited from the main thread or from numactl would
+     * override the first touch placement */
+    numa_set_localalloc();
+
+    tv->numa_node = NumaAffinityNode();
+#ifdef TLS
+    numa_thread_node = tv->numa_node;
+#endif
+    SCLogPerf("thread \"%s\" NUMA node %d", tv->name, tv->numa_node);
+#endif
+}
+
+/**
+ *  \brief prefer a node for the allocations of the calling thread
+ *
+ *  Used when allocating memory on behalf of threads on another node.
+ *  The current policy of the thread is saved in \a saved, restore it
+ *  with NumaResetPreferred().
+ *
+ *  \param node node to prefer, ignored if -1
+ *  \param saved policy of the thread before the call
+ */
+void NumaSetPreferred(int node, NumaPolicy *saved)
+{
+    saved->nodes = NULL;
+#ifdef HAVE_LIBNUMA
+    if (!numa_enabled || node < 0)
+        return;
+
+    struct bitmask *nodes = numa_allocate_nodemask();
+    if (nodes == NULL)
+        return;
+    if (get_mempolicy(&saved->mode, nodes->maskp, nodes->size + 1, NULL, 0) != 0) {
+        SCLogDebug("get_mempolicy failed: %s", strerror(errno));
+        numa_free_nodemask(nodes);
+        return;
+    }
+    saved->nodes = nodes;
+    numa_set_preferred(node);
+#endif
+}
+
+/**
+ *  \brief restore the policy saved by NumaSetPreferred()
+ */
+void NumaResetPreferred(NumaPolicy *saved)
+{
+#ifdef HAVE_LIBNUMA
+    struct bitmask *nodes = saved->nodes;
+    if (nodes == NULL)
+        return;
+    if (set_mempolicy(saved->mode, nodes->maskp, nodes->size + 1) != 0) {
+        SCLogDebug("set_mempolicy failed: %s", strerror(errno));
+    }
+    numa_free_nodemask(nodes);
+    saved->nodes = NULL;
+#endif
+}
@@ -0,0 +1,50 @@
+/* Copyright (C) 2020 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * NUMA aware memory placement. Built on libnuma, all functions are
+ * no-ops that report a single node when it is not available.
+ */
+
+#ifndef __UTIL_NUMA_H__
+#define __UTIL_NUMA_H__
+
+#include "threadvars.h"
+
+/** max number of NUMA nodes we keep per node state for. Nodes above
+ *  this are handled as node 0. */
+#define NUMA_NODES_MAX  8
+
+struct bitmask;
+
+/** memory policy of a thread, saved by NumaSetPreferred() */
+typedef struct NumaPolicy_ {
+    int mode;
+    struct bitmask *nodes;  /**< NULL if nothing was saved */
+} NumaPolicy;
+
+void NumaInit(void);
+bool NumaIsEnabled(void);
+int NumaNodeCount(void);
+int NumaThreadNode(void);
+void NumaThreadSetup(ThreadVars *tv);
+void NumaSetPreferred(int node, NumaPolicy *saved);
+void NumaResetPreferred(NumaPolicy *saved);
+
+#endif /* __UTIL_NUMA_H__ */
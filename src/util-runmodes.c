@@ -49,6 +49,7 @@
 #include "util-runmodes.h"
 
 #include "flow-hash.h"
+#include "tmqh-flow.h"
 
 /** \brief create a queue string for autofp to pass to
  *         the flow queue handler.
@@ -134,7 +135,7 @@ int RunModeSetLiveCaptureAutoFp(ConfigIfaceParserFunc ConfigParser,
             ThreadVars *tv_receive =
                 TmThreadCreatePacketHandler(tname,
                         "packetpool", "packetpool",
-                        queues, "flow", "pktacqloop");
+                        queues, TmqhFlowGetAutofpHandlerName(), "pktacqloop");
             if (tv_receive == NULL) {
                 FatalError(SC_ERR_RUNMODE, "TmThreadsCreate failed");
             }
@@ -192,7 +193,7 @@ int RunModeSetLiveCaptureAutoFp(ConfigIfaceParserFunc ConfigParser,
                 ThreadVars *tv_receive =
                     TmThreadCreatePacketHandler(tname,
                             "packetpool", "packetpool",
-                            queues, "flow", "pktacqloop");
+                            queues, TmqhFlowGetAutofpHandlerName(), "pktacqloop");
                 if (tv_receive == NULL) {
                     FatalError(SC_ERR_RUNMODE, "TmThreadsCreate failed");
                 }
@@ -226,7 +227,7 @@ int RunModeSetLiveCaptureAutoFp(ConfigIfaceParserFunc ConfigParser,
 
         ThreadVars *tv_detect_ncpu =
             TmThreadCreatePacketHandler(tname,
-                                        qname, "flow",
+                                        qname, TmqhFlowGetAutofpHandlerName(),
                                         "packetpool", "packetpool",
                                         "varslot");
         if (tv_detect_ncpu == NULL) {
@@ -449,7 +450,7 @@ int RunModeSetIPSAutoFp(ConfigIPSParserFunc ConfigParser,
         ThreadVars *tv_receive =
             TmThreadCreatePacketHandler(tname,
                     "packetpool", "packetpool",
-                    queues, "flow", "pktacqloop");
+                    queues, TmqhFlowGetAutofpHandlerName(), "pktacqloop");
         if (tv_receive == NULL) {
             FatalError(SC_ERR_RUNMODE, "TmThreadsCreate failed");
         }
@@ -481,7 +482,7 @@ int RunModeSetIPSAutoFp(ConfigIPSParserFunc ConfigParser,
 
         ThreadVars *tv_detect_ncpu =
             TmThreadCreatePacketHandler(tname,
-                                        qname, "flow",
+                                        qname, TmqhFlowGetAutofpHandlerName(),
                                         "verdict-queue", "simple",
                                         "varslot");
         if (tv_detect_ncpu == NULL) {
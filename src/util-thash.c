@@ -27,6 +27,7 @@
 
 #include "util-debug.h"
 #include "util-thash.h"
+#include "util-unittest.h"
 
 #include "util-random.h"
 #include "util-misc.h"
@@ -35,7 +36,9 @@
 #include "util-hash-lookup3.h"
 
 static THashData *THashGetUsed(THashTableContext *ctx);
-static void THashDataEnqueue (THashDataQueue *q, THashData *h);
+
+HASH_TEMPLATE_QUEUE_FUNCS(static inline, THashData, THashDataQueue, THashData,
+        next, prev, HQLOCK)
 
 static void THashDataMoveToSpare(THashTableContext *ctx, THashData *h)
 {
@@ -43,15 +46,6 @@ static void THashDataMoveToSpare(THashTableContext *ctx, THashData *h)
     (void) SC_ATOMIC_SUB(ctx->counter, 1);
 }
 
-static THashDataQueue *THashDataQueueInit (THashDataQueue *q)
-{
-    if (q != NULL) {
-        memset(q, 0, sizeof(THashDataQueue));
-        HQLOCK_INIT(q);
-    }
-    return q;
-}
-
 THashDataQueue *THashDataQueueNew(void)
 {
     THashDataQueue *q = (THashDataQueue *)SCMalloc(sizeof(THashDataQueue));
@@ -63,99 +57,6 @@ THashDataQueue *THashDataQueueNew(void)
     return q;
 }
 
-/**
- *  \brief Destroy a queue
- *
- *  \param q the queue to destroy
- */
-static void THashDataQueueDestroy (THashDataQueue *q)
-{
-    HQLOCK_DESTROY(q);
-}
-
-/**
- *  \brief add to queue
- *
- *  \param q queue
- *  \param h data
- */
-static void THashDataEnqueue (THashDataQueue *q, THashData *h)
-{
-#ifdef DEBUG
-    BUG_ON(q == NULL || h == NULL);
-#endif
-
-    HQLOCK_LOCK(q);
-
-    /* more data in queue */
-    if (q->top != NULL) {
-        h->next = q->top;
-        q->top->prev = h;
-        q->top = h;
-    /* only data */
-    } else {
-        q->top = h;
-        q->bot = h;
-    }
-    q->len++;
-#ifdef DBG_PERF
-    if (q->len > q->dbg_maxlen)
-        q->dbg_maxlen = q->len;
-#endif /* DBG_PERF */
-    HQLOCK_UNLOCK(q);
-}
-
-/**
- *  \brief remove data from the queue
- *
- *  \param q queue
- *
- *  \retval h data or NULL if empty list.
- */
-static THashData *THashDataDequeue (THashDataQueue *q)
-{
-    HQLOCK_LOCK(q);
-
-    THashData *h = q->bot;
-    if (h == NULL) {
-        HQLOCK_UNLOCK(q);
-        return NULL;
-    }
-
-    /* more packets in queue */
-    if (q->bot->prev != NULL) {
-        q->bot = q->bot->prev;
-        q->bot->next = NULL;
-    /* just the one we remove, so now empty */
-    } else {
-        q->top = NULL;
-        q->bot = NULL;
-    }
-
-#ifdef DEBUG
-    BUG_ON(q->len == 0);
-#endif
-    if (q->len > 0)
-        q->len--;
-
-    h->next = NULL;
-    h->prev = NULL;
-
-    HQLOCK_UNLOCK(q);
-    return h;
-}
-
-#if 0
-static uint32_t THashDataQueueLen(THashDataQueue *q)
-{
-    uint32_t len;
-    HQLOCK_LOCK(q);
-    len = q->len;
-    HQLOCK_UNLOCK(q);
-    return len;
-}
-#endif
-
 static THashData *THashDataAlloc(THashTableContext *ctx)
 {
     const size_t data_size = THASH_DATA_SIZE(ctx);
@@ -416,16 +317,7 @@ void THashCleanup(THashTableContext *ctx)
             } else {
                 THashData *n = h->next;
                 /* remove from the hash */
-                if (h->prev != NULL)
-                    h->prev->next = h->next;
-                if (h->next != NULL)
-                    h->next->prev = h->prev;
-                if (hb->head == h)
-                    hb->head = h->next;
-                if (hb->tail == h)
-                    hb->tail = h->prev;
-                h->next = NULL;
-                h->prev = NULL;
+                THashDataRowRemove(hb, h);
                 THashDataMoveToSpare(ctx, h);
                 h = n;
             }
@@ -435,29 +327,31 @@ void THashCleanup(THashTableContext *ctx)
     return;
 }
 
-/* calculate the hash key for this packet
+/* calculate the hash for this data
  *
- * we're using:
- *  hash_rand -- set at init time
- *  source address
+ * The full hash is used as fingerprint of the data in its hash row, the
+ * row itself is the hash modulo the hash size.
  */
-static uint32_t THashGetKey(const THashConfig *cnf, void *data)
+static inline uint32_t THashGetHash(const THashConfig *cnf, void *data)
 {
-    uint32_t key;
-
-    key = cnf->DataHash(data);
-    key %= cnf->hash_size;
-
-    return key;
+    return cnf->DataHash(data);
 }
 
-static inline int THashCompare(const THashConfig *cnf, void *a, void *b)
+typedef struct THashKey_ {
+    const THashConfig *cnf;
+    void *data;
+} THashKey;
+
+static bool THashMatch(const THashData *h, const void *key)
 {
-    if (cnf->DataCompare(a, b) == TRUE)
-        return 1;
-    return 0;
+    const THashKey *k = key;
+    return k->cnf->DataCompare(h->data, k->data) == TRUE;
 }
 
+#define THashEvictable(h) (SC_ATOMIC_GET((h)->use_cnt) == 0)
+
+HASH_TEMPLATE_GET_USED_FUNC(THashData, THashHashRow, THashData, HRLOCK, m, THashEvictable)
+
 /**
  *  \brief Get new data
  *
@@ -512,102 +406,38 @@ struct THashDataGetResult
 THashGetFromHash (THashTableContext *ctx, void *data)
 {
     struct THashDataGetResult res = { .data = NULL, .is_new = false, };
-    THashData *h = NULL;
 
-    /* get the key to our bucket */
-    uint32_t key = THashGetKey(&ctx->config, data);
-    /* get our hash bucket and lock it */
-    THashHashRow *hb = &ctx->array[key];
+    /* get the hash and our bucket, and lock it */
+    const uint32_t hash = THashGetHash(&ctx->config, data);
+    THashHashRow *hb = &ctx->array[hash % ctx->config.hash_size];
     HRLOCK_LOCK(hb);
 
-    /* see if the bucket already has data */
-    if (hb->head == NULL) {
-        h = THashDataGetNew(ctx, data);
-        if (h == NULL) {
-            HRLOCK_UNLOCK(hb);
-            return res;
-        }
-
-        /* data is locked */
-        hb->head = h;
-        hb->tail = h;
-
-        /* initialize and return */
+    const THashKey k = { &ctx->config, data };
+    THashData *h = THashDataRowFind(hb, hash, THashMatch, &k);
+    if (h != NULL) {
+        /* found our data, lock & return */
+        SCMutexLock(&h->m);
         (void) THashIncrUsecnt(h);
-
         HRLOCK_UNLOCK(hb);
         res.data = h;
-        res.is_new = true;
+        res.is_new = false;
         return res;
     }
 
-    /* ok, we have data in the bucket. Let's find out if it is our data */
-    h = hb->head;
-
-    /* see if this is the data we are looking for */
-    if (THashCompare(&ctx->config, h->data, data) == 0) {
-        THashData *ph = NULL; /* previous data */
-
-        while (h) {
-            ph = h;
-            h = h->next;
-
-            if (h == NULL) {
-                h = ph->next = THashDataGetNew(ctx, data);
-                if (h == NULL) {
-                    HRLOCK_UNLOCK(hb);
-                    return res;
-                }
-                hb->tail = h;
-
-                /* data is locked */
-
-                h->prev = ph;
-
-                /* initialize and return */
-                (void) THashIncrUsecnt(h);
-
-                HRLOCK_UNLOCK(hb);
-                res.data = h;
-                res.is_new = true;
-                return res;
-            }
-
-            if (THashCompare(&ctx->config, h->data, data) != 0) {
-                /* we found our data, lets put it on top of the
-                 * hash list -- this rewards active data */
-                if (h->next) {
-                    h->next->prev = h->prev;
-                }
-                if (h->prev) {
-                    h->prev->next = h->next;
-                }
-                if (h == hb->tail) {
-                    hb->tail = h->prev;
-                }
-
-                h->next = hb->head;
-                h->prev = NULL;
-                hb->head->prev = h;
-                hb->head = h;
-
-                /* found our data, lock & return */
-                SCMutexLock(&h->m);
-                (void) THashIncrUsecnt(h);
-                HRLOCK_UNLOCK(hb);
-                res.data = h;
-                res.is_new = false;
-                return res;
-            }
-        }
+    h = THashDataGetNew(ctx, data);
+    if (h == NULL) {
+        HRLOCK_UNLOCK(hb);
+        return res;
     }
 
-    /* lock & return */
-    SCMutexLock(&h->m);
+    /* data is locked, initialize, add and return */
+    h->hfp = hash;
     (void) THashIncrUsecnt(h);
+    THashDataRowAppend(hb, h);
+
     HRLOCK_UNLOCK(hb);
     res.data = h;
-    res.is_new = false;
+    res.is_new = true;
     return res;
 }
 
@@ -619,61 +449,18 @@ THashGetFromHash (THashTableContext *ctx, void *data)
  */
 THashData *THashLookupFromHash (THashTableContext *ctx, void *data)
 {
-    THashData *h = NULL;
-
-    /* get the key to our bucket */
-    uint32_t key = THashGetKey(&ctx->config, data);
-    /* get our hash bucket and lock it */
-    THashHashRow *hb = &ctx->array[key];
+    /* get the hash and our bucket, and lock it */
+    const uint32_t hash = THashGetHash(&ctx->config, data);
+    THashHashRow *hb = &ctx->array[hash % ctx->config.hash_size];
     HRLOCK_LOCK(hb);
 
-    if (hb->head == NULL) {
-        HRLOCK_UNLOCK(hb);
-        return h;
-    }
-
-    /* ok, we have data in the bucket. Let's find out if it is our data */
-    h = hb->head;
-
-    /* see if this is the data we are looking for */
-    if (THashCompare(&ctx->config, h->data, data) == 0) {
-        while (h) {
-            h = h->next;
-            if (h == NULL) {
-                HRLOCK_UNLOCK(hb);
-                return h;
-            }
-
-            if (THashCompare(&ctx->config, h->data, data) != 0) {
-                /* we found our data, lets put it on top of the
-                 * hash list -- this rewards active data */
-                if (h->next) {
-                    h->next->prev = h->prev;
-                }
-                if (h->prev) {
-                    h->prev->next = h->next;
-                }
-                if (h == hb->tail) {
-                    hb->tail = h->prev;
-                }
-
-                h->next = hb->head;
-                h->prev = NULL;
-                hb->head->prev = h;
-                hb->head = h;
-
-                /* found our data, lock & return */
-                SCMutexLock(&h->m);
-                (void) THashIncrUsecnt(h);
-                HRLOCK_UNLOCK(hb);
-                return h;
-            }
-        }
+    const THashKey k = { &ctx->config, data };
+    THashData *h = THashDataRowFind(hb, hash, THashMatch, &k);
+    if (h != NULL) {
+        /* lock & return */
+        SCMutexLock(&h->m);
+        (void) THashIncrUsecnt(h);
     }
-
-    /* lock & return */
-    SCMutexLock(&h->m);
-    (void) THashIncrUsecnt(h);
     HRLOCK_UNLOCK(hb);
     return h;
 }
@@ -693,54 +480,98 @@ THashData *THashLookupFromHash (THashTableContext *ctx, void *data)
  */
 static THashData *THashGetUsed(THashTableContext *ctx)
 {
-    uint32_t idx = SC_ATOMIC_GET(ctx->prune_idx) % ctx->config.hash_size;
-    uint32_t cnt = ctx->config.hash_size;
+    uint32_t walked = 0;
+    THashData *h = THashDataGetUsed(ctx->array, ctx->config.hash_size,
+            SC_ATOMIC_GET(ctx->prune_idx), &walked);
+    if (h == NULL)
+        return NULL;
 
-    while (cnt--) {
-        if (++idx >= ctx->config.hash_size)
-            idx = 0;
+    /* release the old data before it's set up again */
+    ctx->config.DataFree(h->data);
 
-        THashHashRow *hb = &ctx->array[idx];
+    SCMutexUnlock(&h->m);
 
-        if (HRLOCK_TRYLOCK(hb) != 0)
-            continue;
+    (void) SC_ATOMIC_ADD(ctx->prune_idx, walked);
+    return h;
+}
 
-        THashData *h = hb->tail;
-        if (h == NULL) {
-            HRLOCK_UNLOCK(hb);
-            continue;
-        }
+#ifdef UNITTESTS
+#include "conf-yaml-loader.h"
 
-        if (SCMutexTrylock(&h->m) != 0) {
-            HRLOCK_UNLOCK(hb);
-            continue;
-        }
+static int thash_test_freed = 0;
+static uint32_t thash_test_freed_key = 0;
 
-        if (SC_ATOMIC_GET(h->use_cnt) > 0) {
-            HRLOCK_UNLOCK(hb);
-            SCMutexUnlock(&h->m);
-            continue;
-        }
+static int THashTestSet(void *dst, void *src)
+{
+    *(uint32_t *)dst = *(uint32_t *)src;
+    return 0;
+}
 
-        /* remove from the hash */
-        if (h->prev != NULL)
-            h->prev->next = h->next;
-        if (h->next != NULL)
-            h->next->prev = h->prev;
-        if (hb->head == h)
-            hb->head = h->next;
-        if (hb->tail == h)
-            hb->tail = h->prev;
-
-        h->next = NULL;
-        h->prev = NULL;
-        HRLOCK_UNLOCK(hb);
+static void THashTestFree(void *data)
+{
+    thash_test_freed++;
+    thash_test_freed_key = *(uint32_t *)data;
+}
+
+static uint32_t THashTestHash(void *data)
+{
+    return *(uint32_t *)data;
+}
 
-        SCMutexUnlock(&h->m);
+static bool THashTestCompare(void *a, void *b)
+{
+    return *(uint32_t *)a == *(uint32_t *)b;
+}
 
-        (void) SC_ATOMIC_ADD(ctx->prune_idx, (ctx->config.hash_size - cnt));
-        return h;
+/** \test recycling used data at the memcap must free the old data */
+static int THashTest01(void)
+{
+    /* room for the rows and 2 entries */
+    char memcap[32];
+    snprintf(memcap, sizeof(memcap), "%"PRIuMAX,
+            (uintmax_t)(2 * sizeof(THashHashRow) +
+                        2 * (sizeof(THashData) + sizeof(uint32_t))));
+
+    char conf[256];
+    snprintf(conf, sizeof(conf), "%%YAML 1.1\n---\n"
+            "thash-test:\n"
+            "  memcap: %s\n"
+            "  hash-size: 2\n"
+            "  prealloc: 0\n", memcap);
+
+    ConfCreateContextBackup();
+    ConfInit();
+    ConfYamlLoadString(conf, strlen(conf));
+
+    thash_test_freed = 0;
+    THashTableContext *ctx = THashInit("thash-test", sizeof(uint32_t),
+            THashTestSet, THashTestFree, THashTestHash, THashTestCompare);
+    FAIL_IF_NULL(ctx);
+
+    /* keys 0 and 2 share row 0, key 1 has to recycle one of them */
+    uint32_t keys[3] = { 0, 2, 1 };
+    for (int i = 0; i < 3; i++) {
+        struct THashDataGetResult res = THashGetFromHash(ctx, &keys[i]);
+        FAIL_IF_NULL(res.data);
+        FAIL_IF_NOT(res.is_new);
+        THashDecrUsecnt(res.data);
+        THashDataUnlock(res.data);
     }
+    FAIL_IF_NOT(thash_test_freed == 1);
+    FAIL_IF_NOT(thash_test_freed_key == 2);
 
-    return NULL;
+    THashShutdown(ctx);
+    FAIL_IF_NOT(thash_test_freed == 3);
+
+    ConfDeInit();
+    ConfRestoreContextBackup();
+    PASS;
+}
+#endif
+
+void THashRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("THashTest01", THashTest01);
+#endif
 }
@@ -28,6 +28,7 @@
 
 #include "decode.h"
 #include "util-storage.h"
+#include "util-hash-template.h"
 
 /** Spinlocks or Mutex for the buckets. */
 //#define HRLOCK_SPIN
@@ -92,16 +93,20 @@ typedef struct THashData_ {
 
     void *data;
 
+    /** hash of the data, used as fingerprint in the hash row */
+    uint32_t hfp;
+
+    /** hash or spare queue pointers */
     struct THashData_ *next;
     struct THashData_ *prev;
 } THashData;
 
 typedef struct THashHashRow_ {
-    HRLOCK_TYPE lock;
-    THashData *head;
-    THashData *tail;
+    HASH_TEMPLATE_ROW_FIELDS(THashData, HRLOCK_TYPE)
 } __attribute__((aligned(CLS))) THashHashRow;
 
+HASH_TEMPLATE_ROW_FUNCS(THashData, THashHashRow, THashData, next, prev)
+
 typedef struct THashDataQueue_
 {
     THashData *top;
@@ -212,4 +217,6 @@ THashDataQueue *THashDataQueueNew(void);
 void THashCleanup(THashTableContext *ctx);
 int THashWalk(THashTableContext *, THashFormatFunc, THashOutputFunc, void *);
 
+void THashRegisterTests(void);
+
 #endif /* __THASH_H__ */